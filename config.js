@@ -151,6 +151,11 @@ config.RPC_PING_INTERVAL_MS = 20000;
 // setting number of pings above the time it takes to get connect timeout
 config.RPC_PING_EXHAUSTED_COUNT = (config.RPC_CONNECT_TIMEOUT / config.RPC_PING_INTERVAL_MS) + 2;
 
+// encode message bodies with the native binary codec (see rpc_codec.js) instead of json
+// on persistent connections where the peer announced the same codec.
+// when disabled the codec is neither announced nor used, and json is sent as before.
+config.RPC_NATIVE_CODEC_ENABLED = false;
+
 config.RECONN_BACKOFF_BASE = 250;
 config.RECONN_BACKOFF_MAX = 5000;
 config.RECONN_BACKOFF_FACTOR = 1.2;
@@ -160,6 +165,8 @@ config.CLOUD_AGENTS_N2N_PORT = 60100;
 config.MONGO_AGENTS_N2N_PORT = 60100;
 
 config.N2N_OFFER_INTERNAL = false;
+// send runs of equal sized n2n udp packets as one UDP_SEGMENT message when the kernel supports it
+config.N2N_UDP_GSO = true;
 
 /////////////////////
 // ENDPOINT CONFIG //
@@ -170,6 +177,14 @@ config.ENDPOINT_MONITOR_INTERVAL = 10 * 60 * 1000; // 10min
 // Keep connection on long requests
 config.S3_KEEP_ALIVE_WHITESPACE_INTERVAL = 15 * 1000;
 config.S3_MD_SIZE_LIMIT = 2 * 1024;
+// decode aws-chunked uploads with nb_native AwsChunkedDecoder (falls back to js when not available)
+config.S3_CHUNKED_NATIVE_DECODER = true;
+// verify sigv4 chunk signatures of streaming uploads (STREAMING-AWS4-HMAC-SHA256-PAYLOAD)
+config.S3_CHUNKED_VERIFY_SIGNATURES = true;
+// compute sigv4 signatures with nb_native, which caches the derived signing keys (falls back to aws-sdk)
+config.S3_SIGV4_NATIVE = true;
+// verify that the body of a put object/part matches its signed x-amz-content-sha256
+config.S3_VERIFY_PAYLOAD_SHA256 = true;
 // Semaphore monitoring execution interval
 config.SEMAPHORE_MONITOR_DELAY = 10 * 1000;
 // Semaphore metrics average calculation intervals in minutes, values need to be in ascending order
@@ -343,6 +358,13 @@ config.IO_WRITE_CONCURRENCY_AGENT_CLOUD = 128;
 config.IO_REPLICATE_CONCURRENCY_AGENT = 16;
 config.IO_READ_CONCURRENCY_AGENT = 16;
 config.IO_READ_RANGE_CONCURRENCY = 32;
+// hedged reads of erasure coded chunks - when the data frags take longer than this percentile
+// of the recent block reads, the parity frags are read too and the chunk is decoded from the first frags to arrive
+config.IO_READ_HEDGE_ENABLED = true;
+config.IO_READ_HEDGE_PERCENTILE = 95;
+config.IO_READ_HEDGE_MIN_DELAY_MS = 5;
+config.IO_READ_HEDGE_INITIAL_DELAY_MS = 500;
+config.IO_READ_HEDGE_SAMPLES = 1000;
 
 config.IO_STREAM_SPLIT_SIZE = 32 * 1024 * 1024;
 // This is the maximum IO memory usage cap inside single semaphore job
@@ -359,6 +381,8 @@ config.IO_SEMAPHORE_CAP = Math.max(
 config.DEDUP_ENABLED = true;
 config.IO_CALC_MD5_ENABLED = true;
 config.IO_CALC_SHA256_ENABLED = true;
+// split and encode uploads in a single native stage (ChunkIngest) instead of ChunkSplitter + ChunkCoder
+config.IO_NATIVE_INGEST_ENABLED = true;
 
 config.ERROR_INJECTON_ON_WRITE = 0;
 config.ERROR_INJECTON_ON_READ = 0;
@@ -584,6 +608,11 @@ config.EVENT_LEVEL = 5;
 
 config.LOG_TO_STDERR_ENABLED = true;
 config.LOG_TO_SYSLOG_ENABLED = false;
+// write the log lines from a native background thread (stderr and syslog), so that a slow
+// pipe or syslog daemon does not block the event loop. when the queue is full new lines are dropped and counted.
+config.LOG_ASYNC_ENABLED = false;
+config.LOG_ASYNC_QUEUE_SIZE = 64 * 1024;
+config.LOG_ASYNC_EXIT_FLUSH_MS = 2000;
 
 config.LOG_COLOR_ENABLED = process.env.NOOBAA_LOG_COLOR ? process.env.NOOBAA_LOG_COLOR === 'true' : true;
 
@@ -886,6 +915,8 @@ config.NSFS_FOLDER_OBJECT_NAME = '.folder';
 config.NSFS_DIR_CACHE_MAX_DIR_SIZE = 64 * 1024 * 1024;
 config.NSFS_DIR_CACHE_MIN_DIR_SIZE = 64;
 config.NSFS_DIR_CACHE_MAX_TOTAL_SIZE = 4 * config.NSFS_DIR_CACHE_MAX_DIR_SIZE;
+// number of cached listing entries converted to JS objects at a time while listing a dir
+config.NSFS_DIR_CACHE_PAGE_SIZE = 1000;
 
 config.NSFS_OPEN_READ_MODE = 'r'; // use 'rd' for direct io
 
@@ -899,6 +930,11 @@ config.NSFS_WARN_THRESHOLD_MS = 100;
 
 config.NSFS_CALCULATE_MD5 = false;
 config.NSFS_TRIGGER_FSYNC = true;
+// concurrent uploads into the same directory share one fsync of the directory
+config.NSFS_FSYNC_COALESCE_DIRS = true;
+// use fdatasync for uploaded files that have no xattr (versioning disabled only, since the version id
+// depends on the mtime which fdatasync does not flush)
+config.NSFS_FDATASYNC_NO_XATTR_FILES = false;
 config.NSFS_CHECK_BUCKET_BOUNDARIES = true;
 config.NSFS_CHECK_BUCKET_PATH_EXISTS = true;
 config.NSFS_REMOVE_PARTS_ON_COMPLETE = true;
@@ -908,6 +944,11 @@ config.NSFS_SEM_WARNING_TIMEOUT = 10 * 60 * 1000;
 // number of rename retries in case of deleted destination directory
 config.NSFS_RENAME_RETRIES = 10;
 config.NSFS_MKDIR_PATH_RETRIES = 3;
+// skip the mkdir syscalls of the parent dirs of nested keys that were recently verified
+config.NSFS_MKDIRP_CACHE_ENABLED = true;
+// max number of threads that remove a directory tree (e.g bucket temp dirs and multipart upload dirs),
+// the extra threads start only when the tree has subdirectories to remove in parallel
+config.NSFS_REMOVE_TREE_CONCURRENCY = 8;
 config.NSFS_RANDOM_DELAY_BASE = 70;
 
 config.NSFS_VERSIONING_ENABLED = true;
@@ -1091,6 +1132,13 @@ config.NSFS_LOGGER_LOCK_CHECK_INTERVAL = process.env.NODE_ENV === 'test' ? 10 :
 config.ANONYMOUS_ACCOUNT_NAME = 'anonymous';
 
 config.NSFS_UPLOAD_STREAM_MEM_THRESHOLD = 8 * 1024 * 1024;
+// uploads of a known size from this size preallocate their blocks before writing (0 to disable)
+config.NSFS_WRITE_PREALLOCATE_MIN_SIZE = 64 * 1024 * 1024;
+// uploads start the writeback of every range of this size they write, and wait for it one range later,
+// to avoid piling dirty pages for a long fsync at the end of the upload (0 to disable)
+config.NSFS_WRITE_BEHIND_SIZE = 16 * 1024 * 1024;
+// drop the ranges that were written back from the page cache, since uploaded data is rarely read back soon
+config.NSFS_WRITE_BEHIND_DROP_CACHE = true;
 config.NSFS_DOWNLOAD_STREAM_MEM_THRESHOLD = 8 * 1024 * 1024;
 
 // we want to change our handling related to EACCESS error
@@ -1192,6 +1240,12 @@ config.NC_LIFECYCLE_GPFS_ILM_ENABLED = true;
 config.NC_LIFECYCLE_GPFS_ALLOW_SCAN_ON_REMOTE = true;
 config.NC_GPFS_BIN_DIR = '/usr/lpp/mmfs/bin/';
 config.NC_LIFECYCLE_GPFS_MMAPPLY_ILM_POLICY_CONCURRENCY = 1;
+// on non GPFS file systems, find the expiration candidates with the native multi-threaded lifecycle_scan
+// instead of listing all the objects of the bucket
+config.NC_LIFECYCLE_POSIX_SCAN_ENABLED = false;
+// threads per bucket scan, and buckets scanned in parallel
+config.NC_LIFECYCLE_POSIX_SCAN_CONCURRENCY = 8;
+config.NC_LIFECYCLE_POSIX_SCAN_BUCKETS_CONCURRENCY = 2;
 
 ////////// GPFS //////////
 config.GPFS_DOWN_DELAY = 1000;
@@ -1229,6 +1283,28 @@ config.BLOCK_STORE_FS_XATTR_TRIGGER_RECALL = 'user._trigger.recall';
 config.BLOCK_STORE_FS_XATTR_TRIGGER_MIGRATE = 'user._trigger.migrate';
 config.BLOCK_STORE_FS_XATTR_TRIGGER_PREMIGRATE = 'user._trigger.premigrate';
 
+// packed container for small blocks - blocks up to MAX_BLOCK_SIZE are appended to
+// large segment files instead of a file per block (not used when TMFS is enabled).
+config.BLOCK_STORE_FS_CONTAINER_ENABLED = false;
+config.BLOCK_STORE_FS_CONTAINER_MAX_BLOCK_SIZE = 128 * 1024;
+config.BLOCK_STORE_FS_CONTAINER_SEGMENT_SIZE = 256 * 1024 * 1024;
+config.BLOCK_STORE_FS_CONTAINER_SYNC_BYTES = 4 * 1024 * 1024;
+// compaction runs after deletes once dead bytes exceed both the min size and ratio of the total
+config.BLOCK_STORE_FS_CONTAINER_COMPACT_MIN_DEAD_BYTES = 512 * 1024 * 1024;
+config.BLOCK_STORE_FS_CONTAINER_COMPACT_DEAD_RATIO = 0.5;
+
+// background scrubber that verifies block digests natively to detect silent corruption.
+// throttled by io rate and cpu percent (of one core) to leave room for foreground traffic.
+config.BLOCK_STORE_FS_SCRUB_ENABLED = false;
+config.BLOCK_STORE_FS_SCRUB_INTERVAL = 7 * 24 * 60 * 60 * 1000; // 7 days between full passes
+config.BLOCK_STORE_FS_SCRUB_BATCH_SIZE = 64;
+config.BLOCK_STORE_FS_SCRUB_LANES = 4;
+config.BLOCK_STORE_FS_SCRUB_BUFFER_SIZE = 8 * 1024 * 1024;
+config.BLOCK_STORE_FS_SCRUB_IO_RATE = 20 * 1024 * 1024; // bytes per second
+config.BLOCK_STORE_FS_SCRUB_CPU_PERCENT = 10;
+// max corrupt block ids reported to the server in every agent info
+config.BLOCK_STORE_FS_SCRUB_REPORT_MAX_BLOCKS = 1000;
+
 config.TIERING_TTL_WORKER_ENABLED = false;
 config.TIERING_TTL_WORKER_BATCH_SIZE = 1000;
 config.TIERING_TTL_WORKER_BATCH_DELAY = 1 * 60 * 1000; // 1 minutes
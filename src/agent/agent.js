@@ -797,6 +797,10 @@ class Agent {
             location_info: this.location_info,
             io_stats: this.block_store && this.block_store.get_and_reset_io_stats(),
         };
+        const corrupt_block_ids = this.block_store && this.block_store.get_corrupt_block_ids();
+        if (corrupt_block_ids && corrupt_block_ids.length) {
+            reply.corrupt_block_ids = corrupt_block_ids;
+        }
         if (this.cloud_info && this.cloud_info.pool_name) {
             reply.pool_name = this.cloud_info.pool_name;
         }
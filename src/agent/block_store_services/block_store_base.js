@@ -288,6 +288,15 @@ class BlockStoreBase {
         return old_stats;
     }
 
+    /**
+     * get_corrupt_block_ids returns ids of blocks that the store found corrupt by itself,
+     * which the agent reports to the server to rebuild their chunks. Override me.
+     * @returns {string[]}
+     */
+    get_corrupt_block_ids() {
+        return [];
+    }
+
     async replicate_block(req) {
         const target_md = req.rpc_params.target;
         const source_md = req.rpc_params.source;
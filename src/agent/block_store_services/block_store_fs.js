@@ -34,6 +34,19 @@ class BlockStoreFs extends BlockStoreBase {
         this.old_blocks_path = path.join(this.root_path, 'blocks');
         this.config_path = path.join(this.root_path, 'config');
         this.usage_path = path.join(this.root_path, 'usage');
+        this.container_path = path.join(this.root_path, 'blocks_container');
+
+        // packed container for small blocks, see config.BLOCK_STORE_FS_CONTAINER_ENABLED
+        /** @type {nb.BlockContainer} */
+        this.container = null;
+        this.container_compacting = false;
+        // block dirs of the files layout that may still hold blocks while migrating to the container
+        /** @type {Set<string>} */
+        this.files_layout_dirs = null;
+
+        // block ids that the scrubber found corrupt and were not rewritten or deleted since,
+    // reported to the server in the agent info, see get_corrupt_block_ids()
+        this.scrub_corrupt_block_ids = new Set();
 
         // stores the cached df data for the root path
         this.cached_df_data = null;
@@ -61,6 +74,7 @@ class BlockStoreFs extends BlockStoreBase {
         dir_list.push(path.join(this.blocks_path_root, 'other.blocks'));
 
         return P.map_with_concurrency(10, dir_list, dir => fs_utils.create_path(dir))
+            .then(() => this._init_container())
             .then(() => fs.promises.stat(this.usage_path)
                 .catch(ignore_not_found)
             )
@@ -76,9 +90,129 @@ class BlockStoreFs extends BlockStoreBase {
                             this._usage = null;
                         });
                 }
+            })
+            .then(() => {
+                // scrubbing would trigger recalls of migrated blocks on TMFS
+                if (config.BLOCK_STORE_FS_SCRUB_ENABLED && !config.BLOCK_STORE_FS_TMFS_ENABLED) {
+                    this._scrub_loop();
+                }
             });
     }
 
+    async _init_container() {
+        if (!config.BLOCK_STORE_FS_CONTAINER_ENABLED || config.BLOCK_STORE_FS_TMFS_ENABLED) return;
+        const container = new (nb_native().BlockContainer)({
+            dir: this.container_path,
+            segment_size: config.BLOCK_STORE_FS_CONTAINER_SEGMENT_SIZE,
+            sync_bytes: config.BLOCK_STORE_FS_CONTAINER_SYNC_BYTES,
+        });
+        await container.open();
+        this.container = container;
+        await this._init_files_layout_dirs();
+        const stats = container.stats();
+        if (stats.corrupt_bytes) {
+            dbg.error('opened blocks container with corrupt records that were skipped',
+                this.container_path, stats);
+        } else {
+            dbg.log0('opened blocks container', this.container_path, stats);
+        }
+    }
+
+    /**
+     * _init_files_layout_dirs finds the block dirs of the files layout that are not empty.
+     * A block written to the container removes its previous copy from the files layout
+     * only when its dir is one of these, so once the files layout is drained
+     * container writes do not pay for extra stats and unlinks.
+     */
+    async _init_files_layout_dirs() {
+        const dirs = await nb_native().fs.readdir(this.fs_context, this.blocks_path_root);
+        const used_dirs = new Set();
+        await P.map_with_concurrency(10, dirs, async dir => {
+            if (!dir.name.endsWith('.blocks')) return;
+            const dir_handle = await fs.promises.opendir(path.join(this.blocks_path_root, dir.name));
+            try {
+                if (await dir_handle.read()) used_dirs.add(dir.name);
+            } finally {
+                await dir_handle.close();
+            }
+        });
+        this.files_layout_dirs = used_dirs;
+        dbg.log0('blocks files layout dirs that are not empty:', used_dirs.size);
+    }
+
+    /**
+     * _scrub_loop runs the native block scrubber over the blocks files in the background
+     * to detect silent corruption before the blocks are read, see config.BLOCK_STORE_FS_SCRUB_*.
+     * Blocks in the container are not scrubbed here since container reads verify their own crc.
+     */
+    async _scrub_loop() {
+        const scrubber = new (nb_native().BlockScrubber)({
+            md_xattr: config.BLOCK_STORE_FS_XATTR_BLOCK_MD,
+            io_bytes_per_sec: config.BLOCK_STORE_FS_SCRUB_IO_RATE,
+            cpu_percent: config.BLOCK_STORE_FS_SCRUB_CPU_PERCENT,
+        });
+        const buffers = _.times(config.BLOCK_STORE_FS_SCRUB_LANES,
+            () => nb_native().fs.dio_buffer_alloc(config.BLOCK_STORE_FS_SCRUB_BUFFER_SIZE));
+        for (;;) {
+            try {
+                await this._scrub_pass(scrubber, buffers);
+            } catch (err) {
+                dbg.error('scrub blocks: pass failed', err);
+            }
+            await P.delay(config.BLOCK_STORE_FS_SCRUB_INTERVAL);
+        }
+    }
+
+    /**
+     * @param {nb.BlockScrubber} scrubber
+     * @param {Buffer[]} buffers
+     */
+    async _scrub_pass(scrubber, buffers) {
+        const start_time = Date.now();
+        const dirs = await nb_native().fs.readdir(this.fs_context, this.blocks_path_root);
+        for (const dir of dirs) {
+            if (!dir.name.endsWith('.blocks')) continue;
+            const dir_path = path.join(this.blocks_path_root, dir.name);
+            const entries = await nb_native().fs.readdir(this.fs_context, dir_path).catch(ignore_not_found);
+            if (!entries) continue;
+            const block_paths = entries
+                .filter(entry => entry.name.endsWith('.data'))
+                .map(entry => path.join(dir_path, entry.name));
+            for (const batch of _.chunk(block_paths, config.BLOCK_STORE_FS_SCRUB_BATCH_SIZE)) {
+                const res = await scrubber.verify(batch, buffers);
+                for (const failure of res.failures) {
+                    if (failure.status === 'CORRUPT') {
+                        const block_id = path.basename(failure.path, '.data');
+                        this.scrub_corrupt_block_ids.add(block_id);
+                        dbg.error('scrub blocks: found corrupt block', block_id, failure);
+                    } else if (failure.status === 'FAILED' && failure.code !== 'ENOENT') {
+                        dbg.warn('scrub blocks: failed to verify block', failure);
+                    }
+                }
+                if (res.throttle_ms) await P.delay(res.throttle_ms);
+            }
+        }
+        dbg.log0('scrub blocks: pass done',
+            'took', Date.now() - start_time, 'ms',
+            'stats', scrubber.stats(),
+            'corrupt_block_ids', Array.from(this.scrub_corrupt_block_ids));
+    }
+
+    /**
+     * returns the block ids that the scrubber found corrupt.
+     * they are reported until the server deletes the blocks after rebuilding their chunks,
+     * or until the blocks are rewritten.
+     * @returns {string[]}
+     */
+    get_corrupt_block_ids() {
+        const block_ids = [];
+        for (const block_id of this.scrub_corrupt_block_ids) {
+            if (block_ids.length >= config.BLOCK_STORE_FS_SCRUB_REPORT_MAX_BLOCKS) break;
+            block_ids.push(block_id);
+        }
+        return block_ids;
+    }
+
     async get_storage_info() {
         try {
             const now = Date.now();
@@ -133,6 +267,11 @@ class BlockStoreFs extends BlockStoreBase {
         const fs_context = this.fs_context;
         const block_path = this._get_block_data_path(block_md.id);
 
+        if (this.container) {
+            const res = await this.container.read(block_md.id);
+            if (res) return { block_md: try_parse_block_md(res.md) || block_md, data: res.data };
+        }
+
         // block_file holds reference to the block file, and is used to close it in case of error.
         let block_file;
 
@@ -217,6 +356,7 @@ class BlockStoreFs extends BlockStoreBase {
         const fs_context = this.fs_context;
         const block_path = this._get_block_data_path(block_md.id);
         const is_test_block = Boolean(options?.ignore_usage);
+        this.scrub_corrupt_block_ids.delete(block_md.id);
 
         const usage = {
             size: block_md.is_preallocated ? 0 : data.length,
@@ -228,6 +368,28 @@ class BlockStoreFs extends BlockStoreBase {
         const block_md_data = JSON.stringify(block_md_to_store);
         const meta_path = this._get_block_meta_path(block_md.id);
 
+        if (this.container && data.length <= config.BLOCK_STORE_FS_CONTAINER_MAX_BLOCK_SIZE) {
+            const prev_len = await this.container.write(block_md.id, block_md_data, data);
+            if (prev_len >= 0) {
+                usage.size -= prev_len;
+                usage.count -= 1;
+            } else if (this.files_layout_dirs.has(get_block_internal_dir(block_md.id))) {
+                // a block that was previously written to the files layout should not be left behind
+                await this._delete_block_files(block_md.id);
+            }
+            if (!is_test_block && (usage.size || usage.count)) {
+                this._update_usage(usage);
+            }
+            return;
+        }
+
+        if (this.container) {
+            // the container is read first, so make sure it does not shadow this write
+            const removed_len = await this.container.delete(block_md.id);
+            if (removed_len >= 0 && !is_test_block) this._update_usage({ size: -removed_len, count: -1 });
+            this.files_layout_dirs.add(get_block_internal_dir(block_md.id));
+        }
+
         // a map of xattrs which will not fail the operation, but only warn
         /** @type {nb.NativeFSXattr} */
         let xattr_try;
@@ -313,10 +475,23 @@ class BlockStoreFs extends BlockStoreBase {
     }
 
     async _delete_block(block_id) {
+        dbg.log1("delete block", block_id);
+        this.scrub_corrupt_block_ids.delete(block_id);
+        if (this.container) {
+            const removed_len = await this.container.delete(block_id);
+            if (removed_len >= 0) {
+                this._update_usage({ size: -removed_len, count: -1 });
+                this._compact_container_if_needed();
+                return;
+            }
+        }
+        await this._delete_block_files(block_id);
+    }
+
+    async _delete_block_files(block_id) {
         const fs_context = this.fs_context;
         const block_path = this._get_block_data_path(block_id);
         const meta_path = this._get_block_meta_path(block_id);
-        dbg.log1("delete block", block_id);
 
         const [block_stat, meta_stat] = await Promise.all([
             nb_native().fs.stat(fs_context, block_path).catch(ignore_not_found),
@@ -409,19 +584,46 @@ class BlockStoreFs extends BlockStoreBase {
         return evicting;
     }
 
+    /**
+     * _compact_container_if_needed starts a background compaction of the blocks container
+     * once enough of its bytes are dead (overwritten/deleted blocks).
+     * Only one compaction runs at a time.
+     */
+    _compact_container_if_needed() {
+        if (this.container_compacting) return;
+        const stats = this.container.stats();
+        if (stats.dead_bytes < config.BLOCK_STORE_FS_CONTAINER_COMPACT_MIN_DEAD_BYTES ||
+            stats.dead_bytes < stats.total_bytes * config.BLOCK_STORE_FS_CONTAINER_COMPACT_DEAD_RATIO) return;
+        this.container_compacting = true;
+        dbg.log0('compacting blocks container', stats);
+        this.container.compact(config.BLOCK_STORE_FS_CONTAINER_COMPACT_DEAD_RATIO)
+            .then(compacted => dbg.log0('compacted blocks container segments', compacted, this.container.stats()))
+            .catch(err => dbg.error('compact blocks container failed', err))
+            .finally(() => {
+                this.container_compacting = false;
+            });
+    }
+
     _get_usage() {
         return this._usage || this._count_usage();
     }
 
     async _count_usage() {
         const usage = await fs_utils.disk_usage(this.blocks_path_root);
+        if (this.container) {
+            const stats = this.container.stats();
+            usage.size += stats.data_bytes;
+            usage.count += stats.count;
+        }
         dbg.log0('counted disk usage', usage);
         this._usage = usage; // object with properties size and count
         await this._write_usage_internal(); // update the usage file
         return usage;
     }
 
-    _write_usage_internal() {
+    async _write_usage_internal() {
+        // checkpoint the container index along with the usage so that reopening it is quick
+        if (this.container) await this.container.sync(true);
         return fs_utils.replace_file(this.usage_path, JSON.stringify(this._usage));
     }
 
@@ -113,6 +113,15 @@ module.exports = {
                         $ref: 'common_api#/definitions/io_stats'
                     },
 
+                    // blocks that the agent found corrupt by itself (e.g. by the block scrubber)
+                    // and should be rebuilt from the other blocks of their chunks
+                    corrupt_block_ids: {
+                        type: 'array',
+                        items: {
+                            type: 'string'
+                        }
+                    },
+
                     // the agent's "recommendation" of it's roles. nodes_monitor will only use it
                     // when initializing the node and the role is not yet known.
                     roles: {
@@ -1205,7 +1205,8 @@ module.exports = {
 
         compress_type: {
             type: 'string',
-            enum: ['snappy', 'zlib', 'none']
+            // igzip-l<level> are zlib streams compressed with isa-l igzip
+            enum: ['snappy', 'zlib', 'igzip-l0', 'igzip-l1', 'igzip-l2', 'igzip-l3', 'none']
         },
 
         cipher_type: {
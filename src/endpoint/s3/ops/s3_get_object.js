@@ -50,6 +50,7 @@ async function get_object(req, res) {
     const object_md = await req.object_sdk.read_object_md(md_params);
 
     s3_utils.set_response_object_md(res, object_md);
+    if (req.headers['x-amz-checksum-mode'] === 'ENABLED') s3_utils.set_response_checksum(res, object_md.checksum);
     s3_utils.set_encryption_response_headers(req, res, object_md.encryption);
     throw_if_restore_incomplete(req.params.bucket, object_md);
     http_utils.set_response_headers_from_request(req, res);
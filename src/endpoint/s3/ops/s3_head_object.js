@@ -29,6 +29,7 @@ async function head_object(req, res) {
     const object_md = await req.object_sdk.read_object_md(params);
 
     s3_utils.set_response_object_md(res, object_md);
+    if (req.headers['x-amz-checksum-mode'] === 'ENABLED') s3_utils.set_response_checksum(res, object_md.checksum);
     s3_utils.set_encryption_response_headers(req, res, object_md.encryption);
     http_utils.set_response_headers_from_request(req, res);
     if (!params.version_id) await http_utils.set_expiration_header(req, res, object_md); // setting expiration header for bucket lifecycle
@@ -51,6 +51,7 @@ async function post_object_uploadId(req, res) {
             Key: req.params.key,
             ETag: `"${reply.etag}"`,
             Location: req.originalUrl,
+            ...reply.checksum,
         }
     };
 }
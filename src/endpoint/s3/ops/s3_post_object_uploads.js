@@ -15,6 +15,7 @@ async function post_object_uploads(req, res) {
     const encryption = s3_utils.parse_encryption(req);
     const storage_class = s3_utils.parse_storage_class_header(req);
     const lock_settings = s3_utils.parse_lock_header(req);
+    const checksum = s3_utils.parse_checksum_create_params(req);
     if (config.DENY_UPLOAD_TO_STORAGE_CLASS_STANDARD && storage_class === s3_utils.STORAGE_CLASS_STANDARD) {
         throw new S3Error(S3Error.InvalidStorageClass);
     }
@@ -28,10 +29,15 @@ async function post_object_uploads(req, res) {
         storage_class,
         tagging,
         encryption,
-        lock_settings
+        lock_settings,
+        checksum,
     });
 
     s3_utils.set_encryption_response_headers(req, res, reply.encryption);
+    if (checksum) {
+        res.setHeader('x-amz-checksum-algorithm', checksum.algorithm);
+        res.setHeader('x-amz-checksum-type', checksum.type);
+    }
 
     return ({
         InitiateMultipartUploadResult: {
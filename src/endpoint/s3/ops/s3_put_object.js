@@ -30,6 +30,7 @@ async function put_object(req, res) {
         throw new S3Error(S3Error.InvalidStorageClass);
     }
     const lock_settings = s3_utils.parse_lock_header(req);
+    const checksum = copy_source ? undefined : s3_utils.parse_checksum_params(req);
     // Copy request sends empty content and not relevant to the object data
     const { size, md5_b64, sha256_b64 } = copy_source ? {} : {
         size: http_utils.parse_content_length(req, s3_error_options),
@@ -54,6 +55,7 @@ async function put_object(req, res) {
         size,
         md5_b64,
         sha256_b64,
+        checksum,
         md_conditions: http_utils.get_md_conditions(req),
         source_md_conditions: http_utils.get_md_conditions(req, 'x-amz-copy-source-'),
         xattr: s3_utils.get_request_xattr(req),
@@ -70,6 +72,7 @@ async function put_object(req, res) {
         res.setHeader('x-amz-version-id', reply.version_id);
     }
     s3_utils.set_encryption_response_headers(req, res, reply.encryption);
+    if (checksum) s3_utils.set_response_checksum(res, reply.checksum);
     rdma_utils.set_rdma_response_headers(req, res, rdma_info, reply.rdma_reply);
 
     res.size_for_notif = size || reply.size;
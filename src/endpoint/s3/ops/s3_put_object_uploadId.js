@@ -23,6 +23,7 @@ async function put_object_uploadId(req, res) {
     const num = s3_utils.parse_part_number(req.query.partNumber, S3Error.InvalidArgument);
     const copy_source = s3_utils.parse_copy_source(req);
     const rdma_info = rdma_utils.parse_rdma_info(req);
+    const checksum = copy_source ? undefined : s3_utils.parse_checksum_params(req);
 
     // Copy request sends empty content and not relevant to the object data
     const { size, md5_b64, sha256_b64 } = copy_source ? {} : {
@@ -47,6 +48,7 @@ async function put_object_uploadId(req, res) {
             size,
             md5_b64,
             sha256_b64,
+            checksum,
             source_md_conditions: http_utils.get_md_conditions(req, 'x-amz-copy-source-'),
             encryption
         });
@@ -58,6 +60,7 @@ async function put_object_uploadId(req, res) {
         throw e;
     }
     s3_utils.set_encryption_response_headers(req, res, reply.encryption);
+    if (checksum) s3_utils.set_response_checksum(res, reply.checksum);
     rdma_utils.set_rdma_response_headers(req, res, rdma_info, reply.rdma_reply);
 
     // TODO: We do not return the VersionId of the object that was copied
@@ -13,6 +13,7 @@ const crypto = require('crypto');
 const config = require('../../.././config');
 const ChunkedContentDecoder = require('../../util/chunked_content_decoder');
 const stream_utils = require('../../util/stream_utils');
+const signature_utils = require('../../util/signature_utils');
 const { AWS_RESTORE_FIELD_REGEXP, AWS_RESTORE_EXPIRY_DATE_REGEXP } = require('../../util/string_utils');
 
 /** @type {nb.StorageClass} */
@@ -46,6 +47,11 @@ const X_NOOBAA_AVAILABLE_STORAGE_CLASSES = 'x-noobaa-available-storage-classes';
 const OBJECT_ATTRIBUTES = Object.freeze(['ETag', 'Checksum', 'ObjectParts', 'StorageClass', 'ObjectSize']);
 const OBJECT_ATTRIBUTES_UNSUPPORTED = Object.freeze(['Checksum', 'ObjectParts']);
 
+// S3 flexible checksums - https://docs.aws.amazon.com/AmazonS3/latest/userguide/checking-object-integrity.html
+const CHECKSUM_ALGORITHMS = Object.freeze(['CRC32', 'CRC32C', 'CRC64NVME', 'SHA1', 'SHA256']);
+const CHECKSUM_TYPES = Object.freeze(['COMPOSITE', 'FULL_OBJECT']);
+const CHECKSUM_CRC_ALGORITHMS = Object.freeze(['CRC32', 'CRC32C', 'CRC64NVME']);
+
 /** 
  * Set of storage classes which support RestoreObject S3 API
  * 
@@ -96,14 +102,22 @@ function get_object_owner(obj) {
     }
 }
 
-function decode_chunked_upload(source_stream) {
-    const decoder = new ChunkedContentDecoder();
+/**
+ * @param {nb.S3Request} req
+ */
+function decode_chunked_upload(req) {
+    const decoder = new ChunkedContentDecoder({
+        signing: config.S3_CHUNKED_VERIFY_SIGNATURES ?
+            signature_utils.get_chunk_signing_params(req, req.object_sdk.get_auth_token()) :
+            undefined,
+        checksum_trailer: req.headers['x-amz-trailer'],
+    });
     // pipeline will back-propagate errors from the decoder to stop streaming from the source,
     // so the error callback here is only needed for logging.
     // Previously were implemented using callback with error
     // Latest implementation of pipeline is async so chaining .catch would behave the same way as callback errors
     // We are not waiting for the pipeline to end like previously
-    stream_utils.pipeline([source_stream, decoder], true)
+    stream_utils.pipeline([req, decoder], true)
         .catch(err => console.warn('decode_chunked_upload: pipeline error', err.stack || err));
 
     decoder.on('error', err1 => dbg.error('s3_utils: error occured on stream ChunkedContentDecoder: ', err1));
@@ -404,6 +418,89 @@ function parse_storage_class(storage_class) {
     throw new Error(`No such s3 storage class ${storage_class}`);
 }
 
+/**
+ * @param {string} [algorithm]
+ * @returns {nb.ChecksumAlgorithm}
+ */
+function parse_checksum_algorithm(algorithm) {
+    if (!algorithm) return;
+    const upper = algorithm.toUpperCase();
+    if (!CHECKSUM_ALGORITHMS.includes(upper)) {
+        dbg.warn('parse_checksum_algorithm: unsupported checksum algorithm', algorithm);
+        throw new S3Error(S3Error.InvalidRequest);
+    }
+    return /** @type {nb.ChecksumAlgorithm} */ (upper);
+}
+
+/**
+ * parse_checksum_params returns the checksum requested for an object or part upload -
+ * x-amz-checksum-<algorithm> header with the value to verify, or just the algorithm
+ * from x-amz-trailer (value verified by the chunked decoder) or x-amz-sdk-checksum-algorithm.
+ * @param {nb.S3Request} req
+ * @returns {nb.ChecksumParams}
+ */
+function parse_checksum_params(req) {
+    for (const algorithm of CHECKSUM_ALGORITHMS) {
+        const value_b64 = req.headers['x-amz-checksum-' + algorithm.toLowerCase()];
+        if (value_b64) {
+            if (typeof value_b64 !== 'string' || !base64_regex.test(value_b64)) {
+                throw new S3Error(S3Error.InvalidDigest);
+            }
+            return { algorithm, value_b64 };
+        }
+    }
+    const trailer = req.headers['x-amz-trailer'];
+    const trailer_algorithm = typeof trailer === 'string' && trailer.toLowerCase().startsWith('x-amz-checksum-') ?
+        trailer.slice('x-amz-checksum-'.length) : undefined;
+    const algorithm = parse_checksum_algorithm(trailer_algorithm ||
+        /** @type {string} */ (req.headers['x-amz-sdk-checksum-algorithm']));
+    return algorithm ? { algorithm } : undefined;
+}
+
+/**
+ * parse_checksum_create_params returns the checksum algorithm and type of a multipart upload
+ * @param {nb.S3Request} req
+ * @returns {nb.ChecksumParams}
+ */
+function parse_checksum_create_params(req) {
+    const algorithm = parse_checksum_algorithm(/** @type {string} */ (req.headers['x-amz-checksum-algorithm']));
+    const type_header = /** @type {string} */ (req.headers['x-amz-checksum-type']);
+    if (!algorithm) {
+        if (type_header) throw new S3Error(S3Error.InvalidRequest);
+        return;
+    }
+    const type = /** @type {nb.ChecksumType} */ (type_header ? type_header.toUpperCase() : default_multipart_checksum_type(algorithm));
+    if (!CHECKSUM_TYPES.includes(type) ||
+        (type === 'FULL_OBJECT' && !CHECKSUM_CRC_ALGORITHMS.includes(algorithm)) ||
+        (type === 'COMPOSITE' && algorithm === 'CRC64NVME')) {
+        dbg.warn('parse_checksum_create_params: unsupported checksum type', algorithm, type_header);
+        throw new S3Error(S3Error.InvalidRequest);
+    }
+    return { algorithm, type };
+}
+
+/**
+ * CRC64NVME supports only full object multipart checksums, the rest default to composite.
+ * @param {nb.ChecksumAlgorithm} algorithm
+ * @returns {nb.ChecksumType}
+ */
+function default_multipart_checksum_type(algorithm) {
+    return algorithm === 'CRC64NVME' ? 'FULL_OBJECT' : 'COMPOSITE';
+}
+
+/**
+ * @param {nb.S3Response} res
+ * @param {nb.Checksum} [checksum]
+ */
+function set_response_checksum(res, checksum) {
+    if (!checksum) return;
+    for (const algorithm of CHECKSUM_ALGORITHMS) {
+        const value_b64 = checksum['Checksum' + algorithm];
+        if (value_b64) res.setHeader('x-amz-checksum-' + algorithm.toLowerCase(), value_b64);
+    }
+    if (checksum.ChecksumType) res.setHeader('x-amz-checksum-type', checksum.ChecksumType);
+}
+
 // Source: https://docs.aws.amazon.com/AmazonS3/latest/dev/object-tagging.html
 function parse_body_tagging_xml(req) {
     const tagging = req.body.Tagging;
@@ -933,4 +1030,9 @@ exports.parse_body_public_access_block = parse_body_public_access_block;
 exports.parse_s3_restore_field = parse_s3_restore_field;
 exports.OBJECT_ATTRIBUTES = OBJECT_ATTRIBUTES;
 exports.OBJECT_ATTRIBUTES_UNSUPPORTED = OBJECT_ATTRIBUTES_UNSUPPORTED;
+exports.CHECKSUM_ALGORITHMS = CHECKSUM_ALGORITHMS;
+exports.parse_checksum_params = parse_checksum_params;
+exports.parse_checksum_create_params = parse_checksum_create_params;
+exports.default_multipart_checksum_type = default_multipart_checksum_type;
+exports.set_response_checksum = set_response_checksum;
 exports.GLACIER_STORAGE_CLASSES = GLACIER_STORAGE_CLASSES;
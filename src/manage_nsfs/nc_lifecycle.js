@@ -45,6 +45,8 @@ const TIMED_OPS = Object.freeze({
     LIST_BUCKETS: 'list_buckets',
     CREATE_GPFS_CANDIDATES_FILES: 'create_gpfs_candidates_files',
     CREATE_GPFS_CANDIDATE_FILE_BY_ILM_POLICY: 'create_candidates_file_by_gpfs_ilm_policy',
+    CREATE_POSIX_CANDIDATES_FILES: 'create_posix_candidates_files',
+    CREATE_POSIX_CANDIDATES_FILES_BY_SCAN: 'create_candidates_files_by_posix_scan',
     PROCESS_BUCKETS: 'process_buckets',
     PROCESS_BUCKET: 'process_bucket',
     PROCESS_RULE: 'process_rule',
@@ -173,7 +175,7 @@ class NCLifecycle {
 
     /**
      * process_buckets does the following -
-     * 1. if it's a GPFS optimization - create candidates files
+     * 1. if it's a GPFS optimization or a native posix scan - create candidates files
      * 2. iterates over buckets and handles their rules
      * @param {String[]} bucket_names
      * @param {Object} system_json
@@ -187,6 +189,11 @@ class NCLifecycle {
                 op_name: TIMED_OPS.CREATE_GPFS_CANDIDATES_FILES,
                 op_func: async () => this.create_gpfs_candidates_files(bucket_names)
             });
+        } else if (this._should_use_posix_scan()) {
+            await this._call_op_and_update_status({
+                op_name: TIMED_OPS.CREATE_POSIX_CANDIDATES_FILES,
+                op_func: async () => this.create_posix_candidates_files(bucket_names)
+            });
         }
 
         while (!this.lifecycle_run_status.state.is_finished) {
@@ -519,7 +526,8 @@ class NCLifecycle {
      * @returns {Promise<Object[]>}
      */
     async get_candidates_by_expiration_rule(lifecycle_rule, bucket_json, object_sdk) {
-        if (this._should_use_gpfs_optimization()) {
+        // the posix scan candidates files are in the GPFS ILM format
+        if (this._should_use_gpfs_optimization() || this._should_use_posix_scan()) {
             return this.get_candidates_by_expiration_rule_gpfs(lifecycle_rule, bucket_json);
         } else {
             return this.get_candidates_by_expiration_rule_posix(lifecycle_rule, bucket_json, object_sdk);
@@ -777,7 +785,8 @@ class NCLifecycle {
                 const create_path = path.join(mpu_path, dir_entry.name, 'create_object_upload');
                 const { data: create_params_buffer } = await nb_native().fs.readFile(this.fs_context, create_path);
                 const create_params_parsed = JSON.parse(create_params_buffer.toString());
-                const stat = await nb_native().fs.stat(this.fs_context, path.join(mpu_path, dir_entry.name));
+                const stat = await native_fs_utils.statx(this.fs_context, path.join(mpu_path, dir_entry.name),
+                    { mask: nb_native().fs.statx_mask.mtime });
                 const object_lifecycle_info = this._get_lifecycle_object_info_for_mpu(create_params_parsed, stat);
                 if (filter_func(object_lifecycle_info)) {
                     res.push({ obj_id: dir_entry.name, key: create_params_parsed.key, bucket: bucket_json.name});
@@ -894,6 +903,8 @@ class NCLifecycle {
                 this.init_bucket_status(bucket_name);
             } else if (op_name === TIMED_OPS.CREATE_GPFS_CANDIDATE_FILE_BY_ILM_POLICY) {
                 this.init_mount_status(mount_point);
+            } else if (op_name === TIMED_OPS.CREATE_POSIX_CANDIDATES_FILES_BY_SCAN) {
+                this.init_bucket_status(bucket_name);
             }
         }
         if (op_times.end_time) {
@@ -1203,6 +1214,96 @@ class NCLifecycle {
     // GPFS ILM POLICIES OPTIMIZATION HELPERS //
     ////////////////////////////////////////////
 
+    /**
+     * _should_use_posix_scan returns true if the expiration candidates should be found by the native posix scan
+     * @returns {Boolean}
+     */
+    _should_use_posix_scan() {
+        return !this._should_use_gpfs_optimization() && config.NC_LIFECYCLE_POSIX_SCAN_ENABLED &&
+            Boolean(nb_native().fs.lifecycle_scan);
+    }
+
+    /**
+     * create_posix_candidates_files creates the expiration candidates files of the buckets by the native lifecycle_scan,
+     * which walks a bucket once for all its expiration rules and evaluates the rules filters during the walk.
+     * the files have the same path and format as the GPFS ILM candidates files, so they are parsed the same way.
+     * rules that already have a candidates file (when continuing the last run) are not scanned again.
+     * @param {String[]} bucket_names
+     * @returns {Promise<Void>}
+     */
+    async create_posix_candidates_files(bucket_names) {
+        await native_fs_utils._create_path(ILM_CANDIDATES_TMP_DIR, this.non_gpfs_fs_context, config.BASE_MODE_CONFIG_DIR);
+        await P.map_with_concurrency(config.NC_LIFECYCLE_POSIX_SCAN_BUCKETS_CONCURRENCY, bucket_names, async bucket_name => {
+            try {
+                const bucket_json = await this.config_fs.get_bucket_by_name(bucket_name, config_fs_options);
+                if (!bucket_json?.lifecycle_configuration_rules?.length) return;
+                const scan_rules = [];
+                for (const lifecycle_rule of bucket_json.lifecycle_configuration_rules) {
+                    if (!lifecycle_rule.expiration || !this.validate_rule_enabled(lifecycle_rule, bucket_json)) continue;
+                    const expiration = this._get_expiration_time(lifecycle_rule.expiration);
+                    if (expiration < 0) continue;
+                    const candidates_path = this.get_gpfs_ilm_candidates_file_path(bucket_json, lifecycle_rule);
+                    if (await native_fs_utils.is_path_exists(this.non_gpfs_fs_context, candidates_path)) continue;
+                    scan_rules.push(this.convert_lifecycle_rule_to_posix_scan_rule(lifecycle_rule, expiration, candidates_path));
+                }
+                if (!scan_rules.length) return;
+                await this._call_op_and_update_status({
+                    bucket_name,
+                    op_name: TIMED_OPS.CREATE_POSIX_CANDIDATES_FILES_BY_SCAN,
+                    op_func: async () => this.create_candidates_files_by_posix_scan(bucket_json, scan_rules)
+                });
+            } catch (err) {
+                dbg.error('create_posix_candidates_files failed with error', bucket_name, err, err.code, err.message);
+            }
+        });
+    }
+
+    /**
+     * convert_lifecycle_rule_to_posix_scan_rule converts the lifecycle rule filter to the native lifecycle_scan rule,
+     * which applies the same conditions as lifecycle_utils.build_lifecycle_filter
+     * @param {*} lifecycle_rule
+     * @param {Number} expiration days, or 0 for all the objects
+     * @param {String} candidates_path
+     * @returns {Object}
+     */
+    convert_lifecycle_rule_to_posix_scan_rule(lifecycle_rule, expiration, candidates_path) {
+        const filter = lifecycle_rule.filter || {};
+        return {
+            candidates_path,
+            prefix: filter.prefix || '',
+            days: expiration,
+            size_greater_than: filter.object_size_greater_than || 0,
+            size_less_than: filter.object_size_less_than || 0,
+            tags: filter.tags,
+        };
+    }
+
+    /**
+     * create_candidates_files_by_posix_scan writes the candidates files of the bucket scan rules
+     * to tmp files and then renames them in place, so that a partial scan is never parsed as a complete one
+     * @param {Object} bucket_json
+     * @param {Object[]} scan_rules
+     * @returns {Promise<Void>}
+     */
+    async create_candidates_files_by_posix_scan(bucket_json, scan_rules) {
+        const tmp_suffix = `.tmp.${process.pid}`;
+        const res = await nb_native().fs.lifecycle_scan(this.fs_context, bucket_json.path,
+            scan_rules.map(rule => ({ ...rule, candidates_path: rule.candidates_path + tmp_suffix })), {
+                concurrency: config.NC_LIFECYCLE_POSIX_SCAN_CONCURRENCY,
+                now: Date.now(),
+                exclude_root_prefix: config.NSFS_TEMP_DIR_NAME,
+                mode: native_fs_utils.get_umasked_mode(config.BASE_MODE_FILE),
+            });
+        for (const rule of scan_rules) {
+            await nb_native().fs.rename(this.non_gpfs_fs_context, rule.candidates_path + tmp_suffix, rule.candidates_path);
+        }
+        if (res.skipped) {
+            dbg.warn(`create_candidates_files_by_posix_scan: skipped ${res.skipped} files with a newline in their name`,
+                bucket_json.name);
+        }
+        dbg.log1('create_candidates_files_by_posix_scan:', bucket_json.name, res);
+    }
+
     /**
      * _should_use_gpfs_optimization returns true is gpfs optimization should be used
      * @returns {Boolean}
@@ -1452,7 +1553,7 @@ class NCLifecycle {
     async write_tmp_ilm_policy(mount_point_path, ilm_policy_string) {
         try {
             const ilm_policy_tmp_path = this.get_gpfs_ilm_policy_file_path(mount_point_path);
-            const ilm_policy_stat = await native_fs_utils.stat_ignore_enoent(this.non_gpfs_fs_context, ilm_policy_tmp_path);
+            const ilm_policy_stat = await native_fs_utils.statx_ignore_enoent(this.non_gpfs_fs_context, ilm_policy_tmp_path);
             if (ilm_policy_stat) {
                 dbg.log2('write_tmp_ilm_policy: policy already exists, ', ilm_policy_tmp_path);
             } else {
@@ -0,0 +1,717 @@
+/* Copyright (C) 2016 NooBaa */
+#include "block_container.h"
+
+#include "../third_party/isa-l/include/crc.h"
+#include "../util/common.h"
+#include "../util/endian.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace noobaa
+{
+
+DBG_INIT(0);
+
+static const uint32_t BC_RECORD_MAGIC = 0x4342424e; // "NBBC"
+static const uint32_t BC_INDEX_MAGIC = 0x4942424e;  // "NBBI"
+static const uint32_t BC_INDEX_VERSION = 1;
+static const uint16_t BC_PUT = 1;
+static const uint16_t BC_DEL = 2;
+static const uint32_t BC_MAX_ID_LEN = 1024;
+static const size_t BC_SCAN_WINDOW = 1024 * 1024;
+
+// record header layout (little endian):
+// magic u32 | type u16 | id_len u16 | md_len u32 | data_len u32 | payload_crc u32 | header_crc u32
+static const uint32_t BC_HEADER_LEN = 24;
+static const uint32_t BC_HEADER_CRC_LEN = 20;
+
+static inline void
+put_u16(uint8_t* p, uint16_t v)
+{
+    v = htole16(v);
+    memcpy(p, &v, 2);
+}
+
+static inline void
+put_u32(uint8_t* p, uint32_t v)
+{
+    v = htole32(v);
+    memcpy(p, &v, 4);
+}
+
+static inline void
+put_u64(uint8_t* p, uint64_t v)
+{
+    v = htole64(v);
+    memcpy(p, &v, 8);
+}
+
+static inline uint16_t
+get_u16(const uint8_t* p)
+{
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return le16toh(v);
+}
+
+static inline uint32_t
+get_u32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return le32toh(v);
+}
+
+static inline uint64_t
+get_u64(const uint8_t* p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return le64toh(v);
+}
+
+static inline uint32_t
+crc32c(uint32_t crc, const void* data, size_t len)
+{
+    return crc32_iscsi((unsigned char*)data, (int)len, crc);
+}
+
+static int
+fsync_dir(const std::string& dir)
+{
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return errno;
+    int r = fsync(fd) ? errno : 0;
+    ::close(fd);
+    return r;
+}
+
+BlockContainer::Segment::~Segment()
+{
+    if (fd >= 0) ::close(fd);
+}
+
+uint32_t
+BlockContainer::Location::rec_len() const
+{
+    return BC_HEADER_LEN + md_len + data_len;
+}
+
+BlockContainer::BlockContainer(const Options& options)
+    : _opts(options)
+    , _unsynced(0)
+    , _data_bytes(0)
+    , _opened(false)
+{
+}
+
+BlockContainer::~BlockContainer()
+{
+    close();
+}
+
+std::string
+BlockContainer::_segment_path(uint32_t num) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%08x.seg", num);
+    return _opts.dir + "/" + name;
+}
+
+std::string
+BlockContainer::_index_path() const
+{
+    return _opts.dir + "/index";
+}
+
+int
+BlockContainer::_open_segment(uint32_t num, bool create, SegmentPtr& seg)
+{
+    std::string path = _segment_path(num);
+    int flags = O_RDWR | O_CLOEXEC;
+    if (create) flags |= O_CREAT | O_EXCL;
+    int fd = ::open(path.c_str(), flags, 0600);
+    if (fd < 0) return errno;
+    seg = std::make_shared<Segment>(num, fd);
+    struct stat st;
+    if (fstat(fd, &st)) return errno;
+    seg->size = st.st_size;
+    if (create) return fsync_dir(_opts.dir);
+    return 0;
+}
+
+int
+BlockContainer::open()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_opened) return 0;
+
+    if (mkdir(_opts.dir.c_str(), 0700) && errno != EEXIST) return errno;
+
+    DIR* d = opendir(_opts.dir.c_str());
+    if (!d) return errno;
+    while (true) {
+        errno = 0;
+        struct dirent* e = readdir(d);
+        if (!e) break;
+        unsigned int num = 0;
+        char tail = 0;
+        if (sscanf(e->d_name, "%08x.se%c", &num, &tail) != 2 || tail != 'g' || strlen(e->d_name) != 12) continue;
+        SegmentPtr seg;
+        int r = _open_segment(num, false, seg);
+        if (r) {
+            closedir(d);
+            return r;
+        }
+        _segments[num] = seg;
+    }
+    int dir_errno = errno;
+    closedir(d);
+    if (dir_errno) return dir_errno;
+
+    // load the index checkpoint and scan only the segment tails that it does not cover
+    std::map<uint32_t, uint64_t> covered;
+    if (_load_checkpoint(covered)) {
+        _index.clear();
+        covered.clear();
+    }
+
+    for (auto& it : _segments) {
+        const SegmentPtr& seg = it.second;
+        auto cov = covered.find(seg->num);
+        uint64_t from = cov == covered.end() ? 0 : cov->second;
+        std::vector<Record> records;
+        uint64_t skipped = 0;
+        int r = _scan_segment(seg, from, records, &skipped);
+        if (r) return r;
+        for (const Record& rec : records) _apply(seg->num, rec);
+        seg->corrupt += skipped;
+        _counters.corrupt_bytes += skipped;
+    }
+
+    // dead bytes are whatever is not referenced by the index
+    std::map<uint32_t, uint64_t> live;
+    _data_bytes = 0;
+    for (auto& it : _index) {
+        live[it.second.seg] += it.second.rec_len();
+        _data_bytes += it.second.data_len;
+    }
+    for (auto& it : _segments) {
+        it.second->dead = it.second->size - std::min(it.second->size, live[it.first]);
+    }
+
+    if (_segments.empty()) {
+        SegmentPtr seg;
+        int r = _open_segment(1, true, seg);
+        if (r) return r;
+        _segments[1] = seg;
+    }
+    _active = _segments.rbegin()->second;
+    _unsynced = 0;
+    _opened = true;
+    DBG1("BlockContainer::open: " << DVAL(_opts.dir) << DVAL(_index.size()) << DVAL(_segments.size()));
+    return 0;
+}
+
+int
+BlockContainer::close()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_opened) return 0;
+    int r = _sync_active();
+    if (!r) r = _write_checkpoint();
+    _opened = false;
+    _active.reset();
+    _segments.clear();
+    _index.clear();
+    return r;
+}
+
+void
+BlockContainer::_apply(uint32_t seg, const Record& r)
+{
+    if (r.type == BC_PUT) {
+        _index[r.id] = Location{ seg, r.offset, r.md_len, r.data_len };
+    } else {
+        _index.erase(r.id);
+    }
+}
+
+/**
+ * _scan_segment parses the record headers of a segment starting at offset from.
+ * Reads are done through a window buffer so that small records are parsed
+ * without a syscall per record, while large data payloads are skipped.
+ * An invalid record is skipped by searching for the next valid record header,
+ * and the skipped bytes are returned in skipped so that the caller can report them.
+ * When no valid record follows in the last segment, it is a torn tail (crash during append)
+ * and is truncated instead.
+ */
+int
+BlockContainer::_scan_segment(const SegmentPtr& seg, uint64_t from, std::vector<Record>& records, uint64_t* skipped)
+{
+    std::vector<uint8_t> win(BC_SCAN_WINDOW);
+    uint64_t win_off = 0;
+    size_t win_len = 0;
+    uint64_t off = from;
+    const bool is_last = seg->num == _segments.rbegin()->first;
+    *skipped = 0;
+
+    auto fill = [&](uint64_t at, size_t need) -> int {
+        if (at >= win_off && at + need <= win_off + win_len) return 0;
+        if (need > win.size()) win.resize(need);
+        ssize_t n = pread(seg->fd, win.data(), win.size(), at);
+        if (n < 0) return errno;
+        win_off = at;
+        win_len = n;
+        return win_len >= need ? 0 : -1;
+    };
+
+    // parses a record at offset at, returns 0 if valid, -1 if invalid, or an errno
+    auto parse = [&](uint64_t at, Record& rec) -> int {
+        if (at + BC_HEADER_LEN > seg->size) return -1;
+        int r = fill(at, BC_HEADER_LEN);
+        if (r) return r;
+        const uint8_t* h = win.data() + (at - win_off);
+        if (get_u32(h) != BC_RECORD_MAGIC) return -1;
+        rec.type = get_u16(h + 4);
+        uint16_t id_len = get_u16(h + 6);
+        rec.md_len = get_u32(h + 8);
+        rec.data_len = get_u32(h + 12);
+        rec.offset = at;
+        rec.rec_len = BC_HEADER_LEN + id_len + rec.md_len + rec.data_len;
+        if (get_u32(h + 20) != crc32c(0, h, BC_HEADER_CRC_LEN) ||
+            (rec.type != BC_PUT && rec.type != BC_DEL) ||
+            id_len == 0 || id_len > BC_MAX_ID_LEN ||
+            at + rec.rec_len > seg->size) {
+            return -1;
+        }
+        r = fill(at, BC_HEADER_LEN + id_len);
+        if (r) return r;
+        rec.id.assign((const char*)win.data() + (at - win_off) + BC_HEADER_LEN, id_len);
+        // the md length stored in the index includes the id so that reads fetch both in one pread
+        rec.md_len += id_len;
+        return 0;
+    };
+
+    while (off < seg->size) {
+        Record rec;
+        int r = parse(off, rec);
+        if (r > 0) return r;
+        if (r == 0) {
+            off += rec.rec_len;
+            records.push_back(std::move(rec));
+            continue;
+        }
+
+        // resync - look for the next offset that holds a valid record header
+        uint64_t next = off + 1;
+        for (; next + BC_HEADER_LEN <= seg->size; ++next) {
+            r = fill(next, BC_HEADER_LEN);
+            if (r > 0) return r;
+            if (r < 0) break;
+            if (get_u32(win.data() + (next - win_off)) != BC_RECORD_MAGIC) continue;
+            r = parse(next, rec);
+            if (r > 0) return r;
+            if (r == 0) break;
+        }
+        if (next + BC_HEADER_LEN > seg->size || r < 0) next = seg->size;
+
+        if (next >= seg->size && is_last) {
+            LOG("BlockContainer::_scan_segment: WARN truncating torn tail " << DVAL(_segment_path(seg->num)) << DVAL(off) << DVAL(seg->size));
+            if (ftruncate(seg->fd, off)) return errno;
+            seg->size = off;
+            break;
+        }
+        LOG("BlockContainer::_scan_segment: ERROR skipping invalid records " << DVAL(_segment_path(seg->num)) << DVAL(off) << DVAL(next) << DVAL(seg->size));
+        *skipped += next - off;
+        off = next;
+    }
+    return 0;
+}
+
+int
+BlockContainer::_roll_if_needed(uint32_t rec_len)
+{
+    if (_active->size == 0 || _active->size + rec_len <= _opts.segment_size) return 0;
+    int r = _sync_active();
+    if (r) return r;
+    SegmentPtr seg;
+    r = _open_segment(_active->num + 1, true, seg);
+    if (r) return r;
+    _segments[seg->num] = seg;
+    _active = seg;
+    return 0;
+}
+
+int
+BlockContainer::_append(uint16_t type, const std::string& id, const std::string& md, const uint8_t* data, uint32_t len, Location& loc)
+{
+    if (id.empty() || id.size() > BC_MAX_ID_LEN) return EINVAL;
+    uint32_t rec_len = BC_HEADER_LEN + id.size() + md.size() + len;
+    int r = _roll_if_needed(rec_len);
+    if (r) return r;
+
+    uint32_t payload_crc = crc32c(0, id.data(), id.size());
+    payload_crc = crc32c(payload_crc, md.data(), md.size());
+    payload_crc = crc32c(payload_crc, data, len);
+
+    uint8_t h[BC_HEADER_LEN];
+    put_u32(h, BC_RECORD_MAGIC);
+    put_u16(h + 4, type);
+    put_u16(h + 6, id.size());
+    put_u32(h + 8, md.size());
+    put_u32(h + 12, len);
+    put_u32(h + 16, payload_crc);
+    put_u32(h + 20, crc32c(0, h, BC_HEADER_CRC_LEN));
+
+    struct iovec iov[4] = {
+        { h, BC_HEADER_LEN },
+        { (void*)id.data(), id.size() },
+        { (void*)md.data(), md.size() },
+        { (void*)data, len },
+    };
+    uint64_t offset = _active->size;
+    ssize_t n = pwritev(_active->fd, iov, 4, offset);
+    if (n != (ssize_t)rec_len) {
+        int err = n < 0 ? errno : EIO;
+        // drop the partial record so the segment stays parsable
+        if (ftruncate(_active->fd, offset)) LOG("BlockContainer::_append: ftruncate failed " << DVAL(offset) << DVAL(errno));
+        return err;
+    }
+    _active->size += rec_len;
+    _unsynced += rec_len;
+    loc = Location{ _active->num, offset, uint32_t(id.size() + md.size()), len };
+    if (_unsynced >= _opts.sync_bytes) return _sync_active();
+    return 0;
+}
+
+int
+BlockContainer::_sync_active()
+{
+    if (!_active || !_unsynced) return 0;
+    if (fdatasync(_active->fd)) return errno;
+    _unsynced = 0;
+    _counters.syncs += 1;
+    return 0;
+}
+
+int
+BlockContainer::write(const std::string& id, const std::string& md, const uint8_t* data, uint32_t len, int64_t* prev_len)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_opened) return EBADF;
+    Location loc;
+    int r = _append(BC_PUT, id, md, data, len, loc);
+    if (r) return r;
+    *prev_len = -1;
+    auto it = _index.find(id);
+    if (it != _index.end()) {
+        _segments[it->second.seg]->dead += it->second.rec_len();
+        _data_bytes -= it->second.data_len;
+        *prev_len = it->second.data_len;
+        it->second = loc;
+    } else {
+        _index.emplace(id, loc);
+    }
+    _data_bytes += len;
+    return 0;
+}
+
+int
+BlockContainer::read(const std::string& id, std::string& md, uint8_t** data, uint32_t* len)
+{
+    Location loc;
+    SegmentPtr seg;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_opened) return EBADF;
+        auto it = _index.find(id);
+        if (it == _index.end()) return ENOENT;
+        loc = it->second;
+        seg = _segments[loc.seg];
+    }
+
+    // the segment fd stays open while we hold the segment pointer,
+    // even if compaction removes the segment concurrently.
+    std::vector<uint8_t> head(BC_HEADER_LEN + loc.md_len);
+    uint8_t* buf = (uint8_t*)malloc(loc.data_len ? loc.data_len : 1);
+    if (!buf) return ENOMEM;
+    struct iovec iov[2] = {
+        { head.data(), head.size() },
+        { buf, loc.data_len },
+    };
+    ssize_t n = preadv(seg->fd, iov, 2, loc.offset);
+    if (n != (ssize_t)loc.rec_len()) {
+        int err = n < 0 ? errno : EIO;
+        free(buf);
+        return err;
+    }
+    const uint8_t* h = head.data();
+    uint16_t id_len = get_u16(h + 6);
+    uint32_t payload_crc = crc32c(0, h + BC_HEADER_LEN, loc.md_len);
+    payload_crc = crc32c(payload_crc, buf, loc.data_len);
+    if (get_u32(h) != BC_RECORD_MAGIC ||
+        get_u16(h + 4) != BC_PUT ||
+        id_len != id.size() ||
+        memcmp(h + BC_HEADER_LEN, id.data(), id_len) != 0 ||
+        get_u32(h + 16) != payload_crc) {
+        LOG("BlockContainer::read: ERROR record corrupted " << DVAL(id) << DVAL(loc.seg) << DVAL(loc.offset));
+        free(buf);
+        return EIO;
+    }
+    md.assign((const char*)h + BC_HEADER_LEN + id_len, loc.md_len - id_len);
+    *data = buf;
+    *len = loc.data_len;
+    return 0;
+}
+
+int
+BlockContainer::remove(const std::string& id, int64_t* removed_len)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_opened) return EBADF;
+    *removed_len = -1;
+    auto it = _index.find(id);
+    if (it == _index.end()) return 0;
+    Location tomb;
+    int r = _append(BC_DEL, id, "", 0, 0, tomb);
+    if (r) return r;
+    // the tombstone itself is garbage once the older records are compacted
+    _active->dead += tomb.rec_len();
+    _segments[it->second.seg]->dead += it->second.rec_len();
+    _data_bytes -= it->second.data_len;
+    *removed_len = it->second.data_len;
+    _index.erase(it);
+    return 0;
+}
+
+int
+BlockContainer::sync(bool checkpoint)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_opened) return EBADF;
+    int r = _sync_active();
+    if (r) return r;
+    if (checkpoint) return _write_checkpoint();
+    return 0;
+}
+
+/**
+ * _compact_segment moves the live records of a sealed segment to the active segment.
+ * Record payloads are read without holding the lock since sealed segments are immutable,
+ * and the index is only updated if it still points to the record we copied.
+ */
+int
+BlockContainer::_compact_segment(const SegmentPtr& seg)
+{
+    std::vector<Record> records;
+    uint64_t skipped = 0;
+    int r;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        r = _scan_segment(seg, 0, records, &skipped);
+        if (!r && skipped) {
+            // the skipped bytes may hold records that the index points to, so the segment must be kept
+            seg->corrupt += skipped;
+            _counters.corrupt_bytes += skipped;
+            r = EIO;
+        }
+    }
+    if (r) return r;
+
+    std::vector<uint8_t> buf;
+    uint64_t moved = 0;
+    for (const Record& rec : records) {
+        uint32_t id_len = rec.id.size();
+        if (rec.type == BC_PUT) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                auto it = _index.find(rec.id);
+                if (it == _index.end() || it->second.seg != seg->num || it->second.offset != rec.offset) continue;
+            }
+            buf.resize(rec.rec_len);
+            ssize_t n = pread(seg->fd, buf.data(), rec.rec_len, rec.offset);
+            if (n != (ssize_t)rec.rec_len) return n < 0 ? errno : EIO;
+            std::string md((const char*)buf.data() + BC_HEADER_LEN + id_len, rec.md_len - id_len);
+            const uint8_t* data = buf.data() + BC_HEADER_LEN + rec.md_len;
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = _index.find(rec.id);
+            if (it == _index.end() || it->second.seg != seg->num || it->second.offset != rec.offset) continue;
+            Location loc;
+            r = _append(BC_PUT, rec.id, md, data, rec.data_len, loc);
+            if (r) return r;
+            it->second = loc;
+            moved += rec.rec_len;
+        } else {
+            // keep the tombstone only while an older segment may still hold a put for this id
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_segments.begin()->first >= seg->num || _index.count(rec.id)) continue;
+            Location tomb;
+            r = _append(BC_DEL, rec.id, "", 0, 0, tomb);
+            if (r) return r;
+            _active->dead += tomb.rec_len();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    // the moved records must be durable before the old copies are removed
+    r = _sync_active();
+    if (r) return r;
+    if (unlink(_segment_path(seg->num).c_str())) return errno;
+    _segments.erase(seg->num);
+    _counters.compacted_segments += 1;
+    _counters.compacted_bytes += moved;
+    return 0;
+}
+
+int
+BlockContainer::compact(double min_dead_ratio, uint32_t* compacted)
+{
+    std::vector<SegmentPtr> candidates;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_opened) return EBADF;
+        for (auto& it : _segments) {
+            const SegmentPtr& seg = it.second;
+            // segments with corrupt bytes are kept as is for offline recovery
+            if (seg == _active || !seg->size || seg->corrupt) continue;
+            if (double(seg->dead) / double(seg->size) >= min_dead_ratio) candidates.push_back(seg);
+        }
+    }
+    *compacted = 0;
+    for (const SegmentPtr& seg : candidates) {
+        int r = _compact_segment(seg);
+        if (r) return r;
+        *compacted += 1;
+    }
+    if (!*compacted) return 0;
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _write_checkpoint();
+}
+
+BlockContainer::Stats
+BlockContainer::stats()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Stats s = _counters;
+    s.count = _index.size();
+    s.data_bytes = _data_bytes;
+    s.segments = _segments.size();
+    for (auto& it : _segments) {
+        if (it.second->corrupt) s.corrupt_segments += 1;
+        s.total_bytes += it.second->size;
+        s.dead_bytes += it.second->dead;
+    }
+    return s;
+}
+
+/**
+ * Index checkpoint layout (little endian):
+ * magic u32 | version u32 | nsegs u32 | count u64
+ * nsegs * [ num u32 | size u64 ]
+ * count * [ id_len u16 | seg u32 | offset u64 | md_len u32 | data_len u32 | id ]
+ * crc u32 (crc32c of everything before it)
+ */
+int
+BlockContainer::_write_checkpoint()
+{
+    std::vector<uint8_t> out;
+    out.reserve(20 + _segments.size() * 12 + _index.size() * 48 + 4);
+    auto grow = [&](size_t n) {
+        out.resize(out.size() + n);
+        return out.data() + out.size() - n;
+    };
+    uint8_t* p = grow(20);
+    put_u32(p, BC_INDEX_MAGIC);
+    put_u32(p + 4, BC_INDEX_VERSION);
+    put_u32(p + 8, _segments.size());
+    put_u64(p + 12, _index.size());
+    for (auto& it : _segments) {
+        p = grow(12);
+        put_u32(p, it.first);
+        put_u64(p + 4, it.second->size);
+    }
+    for (auto& it : _index) {
+        p = grow(22 + it.first.size());
+        put_u16(p, it.first.size());
+        put_u32(p + 2, it.second.seg);
+        put_u64(p + 6, it.second.offset);
+        put_u32(p + 14, it.second.md_len);
+        put_u32(p + 18, it.second.data_len);
+        memcpy(p + 22, it.first.data(), it.first.size());
+    }
+    uint32_t crc = crc32c(0, out.data(), out.size());
+    put_u32(grow(4), crc);
+
+    std::string tmp_path = _index_path() + ".tmp";
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return errno;
+    ssize_t n = ::write(fd, out.data(), out.size());
+    int r = n < 0 ? errno : (n != (ssize_t)out.size() ? EIO : 0);
+    if (!r && fdatasync(fd)) r = errno;
+    ::close(fd);
+    if (!r && rename(tmp_path.c_str(), _index_path().c_str())) r = errno;
+    if (!r) r = fsync_dir(_opts.dir);
+    return r;
+}
+
+int
+BlockContainer::_load_checkpoint(std::map<uint32_t, uint64_t>& covered)
+{
+    int fd = ::open(_index_path().c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return errno;
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size < 24) {
+        ::close(fd);
+        return EINVAL;
+    }
+    size_t size = st.st_size;
+    void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) return errno;
+    StackCleaner unmap([&] { munmap(map, size); });
+
+    const uint8_t* p = (const uint8_t*)map;
+    const uint8_t* end = p + size - 4;
+    if (get_u32(p) != BC_INDEX_MAGIC ||
+        get_u32(p + 4) != BC_INDEX_VERSION ||
+        get_u32(end) != crc32c(0, p, size - 4)) {
+        LOG("BlockContainer::_load_checkpoint: WARN invalid index file, will scan segments " << DVAL(_opts.dir));
+        return EINVAL;
+    }
+    uint32_t nsegs = get_u32(p + 8);
+    uint64_t count = get_u64(p + 12);
+    p += 20;
+    for (uint32_t i = 0; i < nsegs; ++i) {
+        if (p + 12 > end) return EINVAL;
+        uint32_t num = get_u32(p);
+        uint64_t seg_size = get_u64(p + 4);
+        p += 12;
+        // a segment that was removed or truncated since the checkpoint makes it stale
+        auto it = _segments.find(num);
+        if (it == _segments.end() || it->second->size < seg_size) return ESTALE;
+        covered[num] = seg_size;
+    }
+    _index.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        if (p + 22 > end) return EINVAL;
+        uint16_t id_len = get_u16(p);
+        if (p + 22 + id_len > end) return EINVAL;
+        Location loc{ get_u32(p + 2), get_u64(p + 6), get_u32(p + 14), get_u32(p + 18) };
+        if (!covered.count(loc.seg)) return ESTALE;
+        _index.emplace(std::string((const char*)p + 22, id_len), loc);
+        p += 22 + id_len;
+    }
+    // segments that were created after the checkpoint are scanned from the start
+    return 0;
+}
+
+} // namespace noobaa
@@ -0,0 +1,146 @@
+/* Copyright (C) 2016 NooBaa */
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace noobaa
+{
+
+/**
+ * BlockContainer is a log structured store for small agent blocks.
+ *
+ * Instead of keeping every block in its own file (see block_store_fs.js),
+ * blocks are appended as records to large segment files, and an in-memory
+ * index maps block id to the record location.
+ *
+ * - Segments are append only, named by an increasing number (%08x.seg),
+ *   and the highest numbered segment is the active one receiving appends.
+ * - A put record holds the block id, the block md and the block data.
+ *   A delete appends a tombstone record holding only the block id.
+ *   Records carry a crc32c of the header and of the payload.
+ * - The index is checkpointed to an index file on sync/close/compact, so that
+ *   open() only scans the segment tails that were written after the checkpoint.
+ *   If the index file is missing or stale, all the segments are scanned.
+ * - fdatasync is batched - the active segment is synced once sync_bytes were
+ *   appended, or on an explicit sync().
+ * - compact() rewrites the live records of segments that accumulated enough dead
+ *   bytes (overwritten/deleted records and tombstones) and removes those segments.
+ * - Invalid records found when scanning a segment are skipped up to the next valid record
+ *   and counted in stats().corrupt_bytes, and segments holding them are never compacted.
+ *
+ * All methods are thread safe and return 0 or an errno value.
+ */
+class BlockContainer
+{
+public:
+    struct Options
+    {
+        std::string dir;
+        uint64_t segment_size = 256 * 1024 * 1024;
+        uint64_t sync_bytes = 4 * 1024 * 1024;
+    };
+
+    struct Stats
+    {
+        uint64_t count = 0;
+        uint64_t data_bytes = 0;
+        uint64_t total_bytes = 0;
+        uint64_t dead_bytes = 0;
+        uint64_t segments = 0;
+        uint64_t syncs = 0;
+        uint64_t compacted_segments = 0;
+        uint64_t compacted_bytes = 0;
+        // bytes of invalid records that were skipped by segment scans, and the segments holding them
+        uint64_t corrupt_bytes = 0;
+        uint64_t corrupt_segments = 0;
+    };
+
+    explicit BlockContainer(const Options& options);
+    ~BlockContainer();
+
+    int open();
+    int close();
+
+    // prev_len returns the data length of the block that was overwritten, or -1
+    int write(const std::string& id, const std::string& md, const uint8_t* data, uint32_t len, int64_t* prev_len);
+
+    // data is malloc'ed and owned by the caller on success, ENOENT if missing
+    int read(const std::string& id, std::string& md, uint8_t** data, uint32_t* len);
+
+    // removed_len returns the data length of the deleted block, or -1 if not found
+    int remove(const std::string& id, int64_t* removed_len);
+
+    int sync(bool checkpoint);
+
+    // compacts the segments with dead_bytes/size >= min_dead_ratio
+    int compact(double min_dead_ratio, uint32_t* compacted);
+
+    Stats stats();
+
+    const std::string& dir() const { return _opts.dir; }
+
+private:
+    struct Segment
+    {
+        uint32_t num;
+        int fd;
+        uint64_t size;
+        uint64_t dead;
+        uint64_t corrupt;
+        Segment(uint32_t n, int f)
+            : num(n), fd(f), size(0), dead(0), corrupt(0) {}
+        ~Segment();
+    };
+    typedef std::shared_ptr<Segment> SegmentPtr;
+
+    struct Location
+    {
+        uint32_t seg;
+        uint64_t offset;
+        uint32_t md_len;
+        uint32_t data_len;
+        uint32_t rec_len() const;
+    };
+
+    struct Record
+    {
+        uint16_t type;
+        uint64_t offset;
+        uint32_t rec_len;
+        uint32_t md_len;
+        uint32_t data_len;
+        std::string id;
+    };
+
+    const Options _opts;
+    std::mutex _mutex;
+    std::unordered_map<std::string, Location> _index;
+    std::map<uint32_t, SegmentPtr> _segments;
+    SegmentPtr _active;
+    uint64_t _unsynced;
+    uint64_t _data_bytes;
+    Stats _counters;
+    bool _opened;
+
+    std::string _segment_path(uint32_t num) const;
+    std::string _index_path() const;
+    int _open_segment(uint32_t num, bool create, SegmentPtr& seg);
+    int _roll_if_needed(uint32_t rec_len);
+    int _append(uint16_t type, const std::string& id, const std::string& md, const uint8_t* data, uint32_t len, Location& loc);
+    int _sync_active();
+    void _apply(uint32_t seg, const Record& r);
+    int _scan_segment(const SegmentPtr& seg, uint64_t from, std::vector<Record>& records, uint64_t* skipped);
+    int _load_checkpoint(std::map<uint32_t, uint64_t>& covered);
+    int _write_checkpoint();
+    int _compact_segment(const SegmentPtr& seg);
+};
+
+} // namespace noobaa
@@ -0,0 +1,285 @@
+/* Copyright (C) 2016 NooBaa */
+#include "../util/common.h"
+#include "../util/napi.h"
+#include "../util/worker.h"
+#include "block_container.h"
+
+namespace noobaa
+{
+
+DBG_INIT(0);
+
+/**
+ * BlockContainerWrap exposes BlockContainer to JS.
+ * All the operations except stats() run in the threadpool and return promises.
+ */
+struct BlockContainerWrap : public Napi::ObjectWrap<BlockContainerWrap>
+{
+    std::unique_ptr<BlockContainer> _container;
+
+    static Napi::FunctionReference constructor;
+    static void init(Napi::Env env)
+    {
+        constructor = Napi::Persistent(DefineClass(
+            env,
+            "BlockContainer",
+            {
+                InstanceMethod("open", &BlockContainerWrap::open),
+                InstanceMethod("close", &BlockContainerWrap::close),
+                InstanceMethod("write", &BlockContainerWrap::write),
+                InstanceMethod("read", &BlockContainerWrap::read),
+                InstanceMethod("delete", &BlockContainerWrap::remove),
+                InstanceMethod("sync", &BlockContainerWrap::sync),
+                InstanceMethod("compact", &BlockContainerWrap::compact),
+                InstanceMethod("stats", &BlockContainerWrap::stats),
+            }));
+        constructor.SuppressDestruct();
+    }
+    BlockContainerWrap(const Napi::CallbackInfo& info)
+        : Napi::ObjectWrap<BlockContainerWrap>(info)
+    {
+        auto params = info[0].As<Napi::Object>();
+        BlockContainer::Options opts;
+        opts.dir = napi_get_str(params, "dir");
+        opts.segment_size = napi_get_i64_or(params, "segment_size", opts.segment_size);
+        opts.sync_bytes = napi_get_i64_or(params, "sync_bytes", opts.sync_bytes);
+        _container.reset(new BlockContainer(opts));
+    }
+    Napi::Value open(const Napi::CallbackInfo& info);
+    Napi::Value close(const Napi::CallbackInfo& info);
+    Napi::Value write(const Napi::CallbackInfo& info);
+    Napi::Value read(const Napi::CallbackInfo& info);
+    Napi::Value remove(const Napi::CallbackInfo& info);
+    Napi::Value sync(const Napi::CallbackInfo& info);
+    Napi::Value compact(const Napi::CallbackInfo& info);
+    Napi::Value stats(const Napi::CallbackInfo& info);
+};
+
+Napi::FunctionReference BlockContainerWrap::constructor;
+
+/**
+ * BlockContainerWorker calls Work() in the threadpool and rejects with
+ * a system error (with code) when it returns an errno value.
+ */
+struct BlockContainerWorker : public ObjectWrapWorker<BlockContainerWrap>
+{
+    std::string _desc;
+    int _errno;
+    BlockContainerWorker(const Napi::CallbackInfo& info, std::string desc)
+        : ObjectWrapWorker<BlockContainerWrap>(info)
+        , _desc(desc)
+        , _errno(0)
+    {
+    }
+    virtual int Work() = 0;
+    virtual void Execute() override
+    {
+        _errno = Work();
+        if (_errno) SetError(_desc + " " + _wrap->_container->dir());
+    }
+    virtual void OnError(Napi::Error const& error) override
+    {
+        DBG1("BlockContainerWorker::OnError: " << DVAL(_desc) << DVAL(_errno));
+        _promise.Reject(napi_sys_error(Env(), _errno, error.Message()).Value());
+    }
+};
+
+struct BlockContainerOpen : public BlockContainerWorker
+{
+    BlockContainerOpen(const Napi::CallbackInfo& info)
+        : BlockContainerWorker(info, "BlockContainer::open")
+    {
+    }
+    virtual int Work() override { return _wrap->_container->open(); }
+};
+
+struct BlockContainerClose : public BlockContainerWorker
+{
+    BlockContainerClose(const Napi::CallbackInfo& info)
+        : BlockContainerWorker(info, "BlockContainer::close")
+    {
+    }
+    virtual int Work() override { return _wrap->_container->close(); }
+};
+
+struct BlockContainerWrite : public BlockContainerWorker
+{
+    std::string _id;
+    std::string _md;
+    uint8_t* _data;
+    uint32_t _len;
+    int64_t _prev_len;
+    BlockContainerWrite(const Napi::CallbackInfo& info)
+        : BlockContainerWorker(info, "BlockContainer::write")
+        , _id(napi_get_str(info[0]))
+        , _md(napi_get_str(info[1]))
+        , _data(0)
+        , _len(0)
+        , _prev_len(-1)
+    {
+        auto buf = info[2].As<Napi::Buffer<uint8_t>>();
+        _data = buf.Data();
+        _len = buf.Length();
+    }
+    virtual int Work() override { return _wrap->_container->write(_id, _md, _data, _len, &_prev_len); }
+    virtual void OnOK() override
+    {
+        _promise.Resolve(Napi::Number::New(Env(), _prev_len));
+    }
+};
+
+struct BlockContainerRead : public BlockContainerWorker
+{
+    std::string _id;
+    std::string _md;
+    uint8_t* _data;
+    uint32_t _len;
+    bool _found;
+    BlockContainerRead(const Napi::CallbackInfo& info)
+        : BlockContainerWorker(info, "BlockContainer::read")
+        , _id(napi_get_str(info[0]))
+        , _data(0)
+        , _len(0)
+        , _found(false)
+    {
+    }
+    virtual ~BlockContainerRead()
+    {
+        if (_data) free(_data);
+    }
+    virtual int Work() override
+    {
+        int r = _wrap->_container->read(_id, _md, &_data, &_len);
+        if (r == ENOENT) return 0;
+        _found = !r;
+        return r;
+    }
+    virtual void OnOK() override
+    {
+        Napi::Env env = Env();
+        if (!_found) {
+            _promise.Resolve(env.Null());
+            return;
+        }
+        auto res = Napi::Object::New(env);
+        res["md"] = Napi::String::New(env, _md);
+        res["data"] = Napi::Buffer<uint8_t>::New(env, _data, _len, [](Napi::Env, uint8_t* p) { free(p); });
+        _data = 0;
+        _promise.Resolve(res);
+    }
+};
+
+struct BlockContainerRemove : public BlockContainerWorker
+{
+    std::string _id;
+    int64_t _removed_len;
+    BlockContainerRemove(const Napi::CallbackInfo& info)
+        : BlockContainerWorker(info, "BlockContainer::delete")
+        , _id(napi_get_str(info[0]))
+        , _removed_len(-1)
+    {
+    }
+    virtual int Work() override { return _wrap->_container->remove(_id, &_removed_len); }
+    virtual void OnOK() override
+    {
+        _promise.Resolve(Napi::Number::New(Env(), _removed_len));
+    }
+};
+
+struct BlockContainerSync : public BlockContainerWorker
+{
+    bool _checkpoint;
+    BlockContainerSync(const Napi::CallbackInfo& info)
+        : BlockContainerWorker(info, "BlockContainer::sync")
+        , _checkpoint(info[0].ToBoolean())
+    {
+    }
+    virtual int Work() override { return _wrap->_container->sync(_checkpoint); }
+};
+
+struct BlockContainerCompact : public BlockContainerWorker
+{
+    double _min_dead_ratio;
+    uint32_t _compacted;
+    BlockContainerCompact(const Napi::CallbackInfo& info)
+        : BlockContainerWorker(info, "BlockContainer::compact")
+        , _min_dead_ratio(info[0].IsNumber() ? info[0].As<Napi::Number>().DoubleValue() : 0.5)
+        , _compacted(0)
+    {
+    }
+    virtual int Work() override { return _wrap->_container->compact(_min_dead_ratio, &_compacted); }
+    virtual void OnOK() override
+    {
+        _promise.Resolve(Napi::Number::New(Env(), _compacted));
+    }
+};
+
+Napi::Value
+BlockContainerWrap::open(const Napi::CallbackInfo& info)
+{
+    return await_worker<BlockContainerOpen>(info);
+}
+
+Napi::Value
+BlockContainerWrap::close(const Napi::CallbackInfo& info)
+{
+    return await_worker<BlockContainerClose>(info);
+}
+
+Napi::Value
+BlockContainerWrap::write(const Napi::CallbackInfo& info)
+{
+    return await_worker<BlockContainerWrite>(info);
+}
+
+Napi::Value
+BlockContainerWrap::read(const Napi::CallbackInfo& info)
+{
+    return await_worker<BlockContainerRead>(info);
+}
+
+Napi::Value
+BlockContainerWrap::remove(const Napi::CallbackInfo& info)
+{
+    return await_worker<BlockContainerRemove>(info);
+}
+
+Napi::Value
+BlockContainerWrap::sync(const Napi::CallbackInfo& info)
+{
+    return await_worker<BlockContainerSync>(info);
+}
+
+Napi::Value
+BlockContainerWrap::compact(const Napi::CallbackInfo& info)
+{
+    return await_worker<BlockContainerCompact>(info);
+}
+
+Napi::Value
+BlockContainerWrap::stats(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    BlockContainer::Stats s = _container->stats();
+    auto res = Napi::Object::New(env);
+    res["count"] = Napi::Number::New(env, s.count);
+    res["data_bytes"] = Napi::Number::New(env, s.data_bytes);
+    res["total_bytes"] = Napi::Number::New(env, s.total_bytes);
+    res["dead_bytes"] = Napi::Number::New(env, s.dead_bytes);
+    res["segments"] = Napi::Number::New(env, s.segments);
+    res["syncs"] = Napi::Number::New(env, s.syncs);
+    res["compacted_segments"] = Napi::Number::New(env, s.compacted_segments);
+    res["compacted_bytes"] = Napi::Number::New(env, s.compacted_bytes);
+    res["corrupt_bytes"] = Napi::Number::New(env, s.corrupt_bytes);
+    res["corrupt_segments"] = Napi::Number::New(env, s.corrupt_segments);
+    return res;
+}
+
+void
+block_container_napi(Napi::Env env, Napi::Object exports)
+{
+    BlockContainerWrap::init(env);
+    exports["BlockContainer"] = BlockContainerWrap::constructor.Value();
+}
+
+} // namespace noobaa
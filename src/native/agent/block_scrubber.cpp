@@ -0,0 +1,305 @@
+/* Copyright (C) 2016 NooBaa */
+#include "block_scrubber.h"
+
+#include "../third_party/isa-l_crypto/include/sha1_mb.h"
+#include "../util/b64.h"
+#include "../util/common.h"
+#include "../util/endian.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <openssl/evp.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace noobaa
+{
+
+DBG_INIT(0);
+
+static const size_t DIO_ALIGN = 4096;
+static const size_t MD_MAX_LEN = 4096;
+
+struct BlockScrubber::Lane
+{
+    const std::string* path;
+    Buffer buf;
+    Status status;
+    int err;
+    uint64_t size;
+    std::string digest_type;
+    std::string digest_b64;
+    DECLARE_ALIGNED(SHA1_HASH_CTX sha1_ctx, 16);
+};
+
+static uint64_t
+now_usec(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// extracts a string value from the block md json written by block_store_fs.js,
+// the values we look for (digest type and base64) never contain escapes.
+static std::string
+md_json_str(const std::string& md, const char* key)
+{
+    std::string pattern = std::string("\"") + key + "\":\"";
+    size_t pos = md.find(pattern);
+    if (pos == std::string::npos) return std::string();
+    pos += pattern.size();
+    size_t end = md.find('"', pos);
+    if (end == std::string::npos) return std::string();
+    return md.substr(pos, end - pos);
+}
+
+static std::string
+digest_to_b64(const uint8_t* digest, int len)
+{
+    std::string out(b64_encode_len(len), '\0');
+    int n = b64_encode(digest, len, (uint8_t*)&out[0]);
+    out.resize(n);
+    return out;
+}
+
+BlockScrubber::BlockScrubber(const Options& options)
+    : _opts(options)
+{
+}
+
+bool
+BlockScrubber::_read_md(int fd, const std::string& path, std::string& md)
+{
+    char buf[MD_MAX_LEN];
+    if (!_opts.md_xattr.empty()) {
+        ssize_t n = fgetxattr(fd, _opts.md_xattr.c_str(), buf, sizeof(buf));
+        if (n > 0) {
+            md.assign(buf, n);
+            return true;
+        }
+    }
+    // fallback to the .meta file used when xattrs are not supported
+    static const std::string DATA_SUFFIX = ".data";
+    if (path.size() <= DATA_SUFFIX.size() || path.compare(path.size() - DATA_SUFFIX.size(), DATA_SUFFIX.size(), DATA_SUFFIX)) {
+        return false;
+    }
+    std::string meta_path = path.substr(0, path.size() - DATA_SUFFIX.size()) + ".meta";
+    int meta_fd = open(meta_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (meta_fd < 0) return false;
+    ssize_t n = read(meta_fd, buf, sizeof(buf));
+    close(meta_fd);
+    if (n <= 0) return false;
+    md.assign(buf, n);
+    return true;
+}
+
+void
+BlockScrubber::_read_lane(Lane& lane)
+{
+    const std::string& path = *lane.path;
+    bool aligned = (uintptr_t(lane.buf.data) % DIO_ALIGN) == 0 && (lane.buf.len % DIO_ALIGN) == 0;
+    int fd = -1;
+#ifdef O_DIRECT
+    if (aligned) fd = open(path.c_str(), O_RDONLY | O_DIRECT | O_CLOEXEC);
+#endif
+    // some filesystems (e.g tmpfs) reject O_DIRECT with EINVAL
+    if (fd < 0 && (!aligned || errno == EINVAL)) fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        lane.status = FAILED;
+        lane.err = errno;
+        return;
+    }
+    StackCleaner cleaner([fd] { close(fd); });
+
+    struct stat st;
+    if (fstat(fd, &st)) {
+        lane.status = FAILED;
+        lane.err = errno;
+        return;
+    }
+    lane.size = st.st_size;
+    if (lane.size > lane.buf.len) {
+        lane.status = SKIPPED;
+        lane.err = EFBIG;
+        return;
+    }
+
+    std::string md;
+    if (!_read_md(fd, path, md)) {
+        lane.status = NO_MD;
+        return;
+    }
+    lane.digest_type = md_json_str(md, "digest_type");
+    lane.digest_b64 = md_json_str(md, "digest_b64");
+    if (lane.digest_type.empty() || lane.digest_b64.empty()) {
+        lane.status = NO_MD;
+        return;
+    }
+
+    // direct io requires aligned lengths, the last read will return short
+    size_t pos = 0;
+    size_t want = (lane.size + DIO_ALIGN - 1) / DIO_ALIGN * DIO_ALIGN;
+    if (want > lane.buf.len) want = lane.buf.len;
+    while (pos < lane.size) {
+        ssize_t n = pread(fd, lane.buf.data + pos, want - pos, pos);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            lane.status = FAILED;
+            lane.err = errno;
+            return;
+        }
+        if (n == 0) break;
+        pos += n;
+    }
+    if (pos != lane.size) {
+        // the file was truncated while reading
+        lane.status = FAILED;
+        lane.err = EIO;
+        return;
+    }
+    lane.status = OK;
+}
+
+void
+BlockScrubber::_digest_lanes(std::vector<Lane>& lanes)
+{
+    DECLARE_ALIGNED(SHA1_HASH_CTX_MGR sha1_mgr, 16);
+    bool sha1_used = false;
+
+    for (Lane& lane : lanes) {
+        if (lane.status != OK) continue;
+        if (lane.digest_type == "sha1") {
+            if (!sha1_used) {
+                sha1_ctx_mgr_init(&sha1_mgr);
+                sha1_used = true;
+            }
+            hash_ctx_init(&lane.sha1_ctx);
+            hash_ctx_user_data(&lane.sha1_ctx) = &lane;
+            sha1_ctx_mgr_submit(&sha1_mgr, &lane.sha1_ctx, lane.buf.data, lane.size, HASH_ENTIRE);
+            continue;
+        }
+        const EVP_MD* evp_md = EVP_get_digestbyname(lane.digest_type.c_str());
+        if (!evp_md) {
+            lane.status = NO_MD;
+            continue;
+        }
+        uint8_t digest[EVP_MAX_MD_SIZE];
+        unsigned int digest_len = 0;
+        if (!EVP_Digest(lane.buf.data, lane.size, digest, &digest_len, evp_md, NULL)) {
+            lane.status = FAILED;
+            lane.err = EIO;
+            continue;
+        }
+        if (digest_to_b64(digest, digest_len) != lane.digest_b64) lane.status = CORRUPT;
+    }
+
+    if (!sha1_used) return;
+    while (sha1_ctx_mgr_flush(&sha1_mgr)) {
+    }
+    for (Lane& lane : lanes) {
+        if (lane.status != OK || lane.digest_type != "sha1") continue;
+        uint32_t words[SHA1_DIGEST_NWORDS];
+        for (int i = 0; i < SHA1_DIGEST_NWORDS; ++i) {
+            words[i] = htobe32(hash_ctx_digest(&lane.sha1_ctx)[i]);
+        }
+        if (digest_to_b64((const uint8_t*)words, sizeof(words)) != lane.digest_b64) lane.status = CORRUPT;
+    }
+}
+
+void
+BlockScrubber::verify(
+    const std::vector<std::string>& paths,
+    const std::vector<Buffer>& buffers,
+    std::vector<Result>& results,
+    uint64_t* bytes,
+    uint64_t* throttle_ms)
+{
+    const uint64_t start_wall = now_usec(CLOCK_MONOTONIC);
+    const uint64_t start_cpu = now_usec(CLOCK_THREAD_CPUTIME_ID);
+    Stats s;
+    *bytes = 0;
+    *throttle_ms = 0;
+    if (buffers.empty()) return;
+    std::vector<Lane> lanes(buffers.size());
+
+    for (size_t i = 0; i < paths.size(); i += buffers.size()) {
+        size_t n = std::min(buffers.size(), paths.size() - i);
+        lanes.resize(n);
+        for (size_t j = 0; j < n; ++j) {
+            Lane& lane = lanes[j];
+            lane.path = &paths[i + j];
+            lane.buf = buffers[j];
+            lane.status = OK;
+            lane.err = 0;
+            lane.size = 0;
+            lane.digest_type.clear();
+            lane.digest_b64.clear();
+            _read_lane(lane);
+        }
+        _digest_lanes(lanes);
+        for (Lane& lane : lanes) {
+            s.blocks += 1;
+            s.bytes += lane.size;
+            switch (lane.status) {
+            case OK:
+                continue;
+            case CORRUPT:
+                LOG("BlockScrubber::verify: ERROR digest mismatch " << DVAL(*lane.path) << DVAL(lane.digest_type));
+                s.corrupt += 1;
+                break;
+            case NO_MD:
+                s.no_md += 1;
+                break;
+            case SKIPPED:
+                s.skipped += 1;
+                break;
+            case FAILED:
+                DBG1("BlockScrubber::verify: failed " << DVAL(*lane.path) << DVAL(lane.err));
+                s.failed += 1;
+                break;
+            }
+            results.push_back(Result{ *lane.path, lane.status, lane.err, lane.size });
+        }
+    }
+
+    s.wall_usec = now_usec(CLOCK_MONOTONIC) - start_wall;
+    s.cpu_usec = now_usec(CLOCK_THREAD_CPUTIME_ID) - start_cpu;
+
+    // compute how long the caller should wait before the next call
+    // so that the average io rate and cpu usage stay within the budget
+    uint64_t delay_usec = 0;
+    if (_opts.io_bytes_per_sec) {
+        uint64_t io_usec = s.bytes * 1000000 / _opts.io_bytes_per_sec;
+        if (io_usec > s.wall_usec) delay_usec = io_usec - s.wall_usec;
+    }
+    if (_opts.cpu_percent > 0 && _opts.cpu_percent < 100) {
+        uint64_t cpu_usec = s.cpu_usec * 100 / _opts.cpu_percent;
+        if (cpu_usec > s.wall_usec) delay_usec = std::max(delay_usec, cpu_usec - s.wall_usec);
+    }
+    *bytes = s.bytes;
+    *throttle_ms = delay_usec / 1000;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stats.blocks += s.blocks;
+    _stats.bytes += s.bytes;
+    _stats.corrupt += s.corrupt;
+    _stats.no_md += s.no_md;
+    _stats.skipped += s.skipped;
+    _stats.failed += s.failed;
+    _stats.wall_usec += s.wall_usec;
+    _stats.cpu_usec += s.cpu_usec;
+}
+
+BlockScrubber::Stats
+BlockScrubber::stats()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+} // namespace noobaa
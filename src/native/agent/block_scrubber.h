@@ -0,0 +1,90 @@
+/* Copyright (C) 2016 NooBaa */
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace noobaa
+{
+
+/**
+ * BlockScrubber verifies the data digest of agent block files against
+ * the digest stored in the block md (xattr or .meta file).
+ *
+ * - Blocks are read with O_DIRECT (when the buffers are aligned and the fs supports it)
+ *   to avoid polluting the page cache with cold data.
+ * - Every call verifies the paths in rounds of buffers.size() blocks,
+ *   and sha1 digests of a round are computed together with multi-buffer hashing.
+ *   Other digest types are computed one by one with openssl.
+ * - Throttling is left to the caller - verify() returns the delay needed to
+ *   keep within the io rate and cpu budget, so that the calling thread is not
+ *   held while sleeping.
+ */
+class BlockScrubber
+{
+public:
+    struct Options
+    {
+        std::string md_xattr;
+        uint64_t io_bytes_per_sec = 0; // 0 means unlimited
+        int cpu_percent = 0;           // 0 means unlimited
+    };
+
+    enum Status
+    {
+        OK = 0,
+        CORRUPT,
+        NO_MD,
+        SKIPPED,
+        FAILED,
+    };
+
+    struct Result
+    {
+        std::string path;
+        Status status;
+        int err;
+        uint64_t size;
+    };
+
+    struct Buffer
+    {
+        uint8_t* data;
+        size_t len;
+    };
+
+    struct Stats
+    {
+        uint64_t blocks = 0;
+        uint64_t bytes = 0;
+        uint64_t corrupt = 0;
+        uint64_t no_md = 0;
+        uint64_t skipped = 0;
+        uint64_t failed = 0;
+        uint64_t wall_usec = 0;
+        uint64_t cpu_usec = 0;
+    };
+
+    explicit BlockScrubber(const Options& options);
+
+    // results are returned only for blocks that did not verify OK
+    void verify(const std::vector<std::string>& paths, const std::vector<Buffer>& buffers, std::vector<Result>& results, uint64_t* bytes, uint64_t* throttle_ms);
+
+    Stats stats();
+
+private:
+    struct Lane;
+
+    const Options _opts;
+    std::mutex _mutex;
+    Stats _stats;
+
+    void _read_lane(Lane& lane);
+    void _digest_lanes(std::vector<Lane>& lanes);
+    bool _read_md(int fd, const std::string& path, std::string& md);
+};
+
+} // namespace noobaa
@@ -0,0 +1,149 @@
+/* Copyright (C) 2016 NooBaa */
+#include "../util/common.h"
+#include "../util/napi.h"
+#include "../util/worker.h"
+#include "block_scrubber.h"
+
+#include <uv.h>
+
+namespace noobaa
+{
+
+static const char*
+scrub_status_name(BlockScrubber::Status status)
+{
+    switch (status) {
+    case BlockScrubber::OK:
+        return "OK";
+    case BlockScrubber::CORRUPT:
+        return "CORRUPT";
+    case BlockScrubber::NO_MD:
+        return "NO_MD";
+    case BlockScrubber::SKIPPED:
+        return "SKIPPED";
+    case BlockScrubber::FAILED:
+        return "FAILED";
+    }
+    return "UNKNOWN";
+}
+
+/**
+ * BlockScrubberWrap exposes BlockScrubber to JS.
+ * verify() runs in the threadpool, and the caller is expected to wait
+ * throttle_ms before the next call to stay within the configured budget.
+ */
+struct BlockScrubberWrap : public Napi::ObjectWrap<BlockScrubberWrap>
+{
+    std::unique_ptr<BlockScrubber> _scrubber;
+
+    static Napi::FunctionReference constructor;
+    static void init(Napi::Env env)
+    {
+        constructor = Napi::Persistent(DefineClass(
+            env,
+            "BlockScrubber",
+            {
+                InstanceMethod("verify", &BlockScrubberWrap::verify),
+                InstanceMethod("stats", &BlockScrubberWrap::stats),
+            }));
+        constructor.SuppressDestruct();
+    }
+    BlockScrubberWrap(const Napi::CallbackInfo& info)
+        : Napi::ObjectWrap<BlockScrubberWrap>(info)
+    {
+        auto params = info[0].As<Napi::Object>();
+        BlockScrubber::Options opts;
+        if (params.Get("md_xattr").IsString()) opts.md_xattr = napi_get_str(params, "md_xattr");
+        opts.io_bytes_per_sec = napi_get_i64_or(params, "io_bytes_per_sec", 0);
+        opts.cpu_percent = napi_get_i32_or(params, "cpu_percent", 0);
+        _scrubber.reset(new BlockScrubber(opts));
+    }
+    Napi::Value verify(const Napi::CallbackInfo& info);
+    Napi::Value stats(const Napi::CallbackInfo& info);
+};
+
+Napi::FunctionReference BlockScrubberWrap::constructor;
+
+struct BlockScrubberVerify : public ObjectWrapWorker<BlockScrubberWrap>
+{
+    std::vector<std::string> _paths;
+    std::vector<BlockScrubber::Buffer> _buffers;
+    std::vector<BlockScrubber::Result> _results;
+    uint64_t _bytes;
+    uint64_t _throttle_ms;
+    BlockScrubberVerify(const Napi::CallbackInfo& info)
+        : ObjectWrapWorker<BlockScrubberWrap>(info)
+        , _bytes(0)
+        , _throttle_ms(0)
+    {
+        auto paths = info[0].As<Napi::Array>();
+        auto buffers = info[1].As<Napi::Array>();
+        if (!buffers.Length()) {
+            throw Napi::Error::New(info.Env(), "BlockScrubber::verify: expected buffers");
+        }
+        for (uint32_t i = 0; i < paths.Length(); ++i) {
+            _paths.push_back(napi_get_str(paths.Get(i)));
+        }
+        // the buffers are kept alive by the worker args ref
+        for (uint32_t i = 0; i < buffers.Length(); ++i) {
+            auto buf = buffers.Get(i).As<Napi::Buffer<uint8_t>>();
+            _buffers.push_back(BlockScrubber::Buffer{ buf.Data(), buf.Length() });
+        }
+    }
+    virtual void Execute() override
+    {
+        _wrap->_scrubber->verify(_paths, _buffers, _results, &_bytes, &_throttle_ms);
+    }
+    virtual void OnOK() override
+    {
+        Napi::Env env = Env();
+        auto res = Napi::Object::New(env);
+        auto failures = Napi::Array::New(env, _results.size());
+        for (uint32_t i = 0; i < _results.size(); ++i) {
+            const BlockScrubber::Result& r = _results[i];
+            auto f = Napi::Object::New(env);
+            f["path"] = Napi::String::New(env, r.path);
+            f["status"] = Napi::String::New(env, scrub_status_name(r.status));
+            f["size"] = Napi::Number::New(env, r.size);
+            if (r.err) f["code"] = Napi::String::New(env, uv_err_name(uv_translate_sys_error(r.err)));
+            failures[i] = f;
+        }
+        res["scanned"] = Napi::Number::New(env, _paths.size());
+        res["bytes"] = Napi::Number::New(env, _bytes);
+        res["throttle_ms"] = Napi::Number::New(env, _throttle_ms);
+        res["failures"] = failures;
+        _promise.Resolve(res);
+    }
+};
+
+Napi::Value
+BlockScrubberWrap::verify(const Napi::CallbackInfo& info)
+{
+    return await_worker<BlockScrubberVerify>(info);
+}
+
+Napi::Value
+BlockScrubberWrap::stats(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    BlockScrubber::Stats s = _scrubber->stats();
+    auto res = Napi::Object::New(env);
+    res["blocks"] = Napi::Number::New(env, s.blocks);
+    res["bytes"] = Napi::Number::New(env, s.bytes);
+    res["corrupt"] = Napi::Number::New(env, s.corrupt);
+    res["no_md"] = Napi::Number::New(env, s.no_md);
+    res["skipped"] = Napi::Number::New(env, s.skipped);
+    res["failed"] = Napi::Number::New(env, s.failed);
+    res["wall_usec"] = Napi::Number::New(env, s.wall_usec);
+    res["cpu_usec"] = Napi::Number::New(env, s.cpu_usec);
+    return res;
+}
+
+void
+block_scrubber_napi(Napi::Env env, Napi::Object exports)
+{
+    BlockScrubberWrap::init(env);
+    exports["BlockScrubber"] = BlockScrubberWrap::constructor.Value();
+}
+
+} // namespace noobaa
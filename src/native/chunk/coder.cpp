@@ -7,6 +7,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include <openssl/crypto.h>
 #include <openssl/err.h>
 #include <openssl/evp.h>
 #include <openssl/rand.h>
@@ -14,7 +21,15 @@
 
 #include "../third_party/cm256/cm256.h"
 #include "../third_party/isa-l/include/erasure_code.h"
+#ifdef USE_ISAL_AES_GCM
+#include "../third_party/isa-l_crypto/include/aes_gcm.h"
+#if defined(__aarch64__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+#endif
 #include "../util/b64.h"
+#include "../util/buf_pool.h"
 #include "../util/common.h"
 #include "../util/snappy.h"
 #include "../util/zlib.h"
@@ -27,25 +42,38 @@ namespace noobaa
 #define MAX_TOTAL_FRAGS (MAX_DATA_FRAGS + MAX_PARITY_FRAGS)
 #define MAX_MATRIX_SIZE (MAX_DATA_FRAGS * MAX_TOTAL_FRAGS)
 
-// for now just ignore the auth tag to save performance
-// our chunk digest is already covering for data integrity
-#define USE_GCM_AUTH_TAG false
+// decode matrices are cached by erasure pattern, see _nb_ec_decode_matrix()
+#define MAX_DECODE_MATRIX_CACHE 1024
+
+// gcm chunks carry the auth tag, and when it is verified on decode
+// it already covers the data integrity so the chunk digest is not recomputed.
+// chunks that were encoded without a tag are still checked by their digest.
+#define GCM_AUTH_TAG_LEN 16
 
 static void _nb_encode(struct NB_Coder_Chunk* chunk);
 static void _nb_encrypt(struct NB_Coder_Chunk* chunk, const EVP_CIPHER* evp_cipher);
+static void _nb_encrypt_init_key(struct NB_Coder_Chunk* chunk, int key_len, int iv_len, struct NB_Buf* iv);
+template <typename UpdateFunc>
+static bool _nb_encrypt_frags(struct NB_Coder_Chunk* chunk, UpdateFunc update);
 static void _nb_no_encrypt(struct NB_Coder_Chunk* chunk);
 static void _nb_erasure(struct NB_Coder_Chunk* chunk);
 
 static void _nb_decode(struct NB_Coder_Chunk* chunk);
 static void
 _nb_derasure(struct NB_Coder_Chunk* chunk, struct NB_Coder_Frag** frags_map, int total_frags);
-static void _nb_decrypt(
+static bool _nb_decrypt(
     struct NB_Coder_Chunk* chunk, struct NB_Coder_Frag** frags_map, const EVP_CIPHER* evp_cipher);
 static void _nb_no_decrypt(struct NB_Coder_Chunk* chunk, struct NB_Coder_Frag** frags_map);
 
 static void _nb_digest(const EVP_MD* md, struct NB_Bufs* bufs, struct NB_Buf* digest);
 static bool _nb_digest_match(const EVP_MD* md, struct NB_Bufs* data, struct NB_Buf* digest);
 
+#ifdef USE_ISAL_AES_GCM
+static bool _nb_use_isal_gcm(const EVP_CIPHER* evp_cipher);
+static void _nb_isal_gcm_encrypt(struct NB_Coder_Chunk* chunk);
+static bool _nb_isal_gcm_decrypt(struct NB_Coder_Chunk* chunk, struct NB_Coder_Frag** frags_map);
+#endif
+
 static inline int
 _nb_div_up(int n, int align)
 {
@@ -58,6 +86,17 @@ _nb_align_up(int n, int align)
     return _nb_div_up(n, align) * align;
 }
 
+// returns the level of "igzip-l<level>" compress types or -1
+static inline int
+_nb_igzip_level(const char* compress_type)
+{
+    static const char IGZIP_PREFIX[] = "igzip-l";
+    if (strncmp(compress_type, IGZIP_PREFIX, sizeof(IGZIP_PREFIX) - 1) != 0) return -1;
+    const char* level = compress_type + sizeof(IGZIP_PREFIX) - 1;
+    if (level[0] < '0' || level[0] > '9' || level[1]) return -1;
+    return level[0] - '0';
+}
+
 void
 nb_chunk_coder_init()
 {
@@ -217,6 +256,8 @@ _nb_encode(struct NB_Coder_Chunk* chunk)
             if (nb_snappy_compress(&chunk->data, &chunk->errors)) return;
         } else if (strcmp(chunk->compress_type, "zlib") == 0) {
             if (nb_zlib_compress(&chunk->data, &chunk->errors)) return;
+        } else if (_nb_igzip_level(chunk->compress_type) >= 0) {
+            if (nb_igzip_compress(&chunk->data, _nb_igzip_level(chunk->compress_type), &chunk->errors)) return;
         } else {
             nb_chunk_error(
                 chunk, "Chunk Encoder: unsupported compress type %s", chunk->compress_type);
@@ -278,49 +319,102 @@ _nb_encode(struct NB_Coder_Chunk* chunk)
 static void
 _nb_encrypt(struct NB_Coder_Chunk* chunk, const EVP_CIPHER* evp_cipher)
 {
+#ifdef USE_ISAL_AES_GCM
+    if (_nb_use_isal_gcm(evp_cipher)) {
+        _nb_isal_gcm_encrypt(chunk);
+        return;
+    }
+#endif
+
     EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
     struct NB_Buf iv;
     int evp_ret = 0;
 
-    // generate random cipher key
-    // using iv of zeros since we generate random key per chunk
-    const int key_len = EVP_CIPHER_key_length(evp_cipher);
-    const int iv_len = EVP_CIPHER_iv_length(evp_cipher);
+    _nb_encrypt_init_key(
+        chunk, EVP_CIPHER_key_length(evp_cipher), EVP_CIPHER_iv_length(evp_cipher), &iv);
+
+    StackCleaner cleaner([&] {
+        EVP_CIPHER_CTX_free(ctx);
+        nb_buf_free(&iv);
+    });
+
+    evp_ret = EVP_EncryptInit_ex(ctx, evp_cipher, NULL, chunk->cipher_key.data, iv.data);
+    if (!evp_ret) {
+        nb_chunk_error(chunk, "Chunk Encoder: cipher encrypt init failed %s", chunk->cipher_type);
+        return;
+    }
 
+    const bool ok = _nb_encrypt_frags(chunk, [&](uint8_t* out, const uint8_t* in, int len) {
+        int out_len = 0;
+        evp_ret = EVP_EncryptUpdate(ctx, out, &out_len, in, len);
+        if (!evp_ret) {
+            nb_chunk_error(
+                chunk, "Chunk Encoder: cipher encrypt update failed %s", chunk->cipher_type);
+            return -1;
+        }
+        return out_len;
+    });
+    if (!ok) return;
+
+    int out_len = 0;
+    evp_ret = EVP_EncryptFinal_ex(ctx, 0, &out_len);
+    if (!evp_ret) {
+        nb_chunk_error(chunk, "Chunk Encoder: cipher encrypt final failed %s", chunk->cipher_type);
+        return;
+    }
+    assert(!out_len);
+
+    if (EVP_CIPHER_CTX_mode(ctx) == EVP_CIPH_GCM_MODE) {
+        nb_buf_free(&chunk->cipher_auth_tag);
+        nb_buf_init_alloc(&chunk->cipher_auth_tag, GCM_AUTH_TAG_LEN);
+        evp_ret = EVP_CIPHER_CTX_ctrl(
+            ctx, EVP_CTRL_GCM_GET_TAG, chunk->cipher_auth_tag.len, chunk->cipher_auth_tag.data);
+        if (!evp_ret) {
+            nb_chunk_error(
+                chunk, "Chunk Encoder: cipher encrypt get tag failed %s", chunk->cipher_type);
+            return;
+        }
+    }
+}
+
+/**
+ * sets chunk->cipher_key and initializes iv (shared or owned, caller frees)
+ */
+static void
+_nb_encrypt_init_key(struct NB_Coder_Chunk* chunk, int key_len, int iv_len, struct NB_Buf* iv)
+{
     if (chunk->cipher_key.len) {
         assert(chunk->cipher_key.len == key_len);
         if (chunk->cipher_iv.len) {
             // key provided iv provided => key=provided, iv=provided
             assert(chunk->cipher_iv.len == iv_len);
-            nb_buf_init_shared(&iv, chunk->cipher_iv.data, chunk->cipher_iv.len);
+            nb_buf_init_shared(iv, chunk->cipher_iv.data, chunk->cipher_iv.len);
         } else {
             // key provided iv not provided => key=provided, iv=random
             nb_buf_free(&chunk->cipher_iv);
             nb_buf_init_alloc(&chunk->cipher_iv, iv_len);
             RAND_bytes(chunk->cipher_iv.data, chunk->cipher_iv.len);
-            nb_buf_init_shared(&iv, chunk->cipher_iv.data, chunk->cipher_iv.len);
+            nb_buf_init_shared(iv, chunk->cipher_iv.data, chunk->cipher_iv.len);
         }
     } else {
         // key/iv not provided => key=random, iv=zeros
-        nb_buf_init_zeros(&iv, iv_len);
+        // using iv of zeros since we generate random key per chunk
+        nb_buf_init_zeros(iv, iv_len);
         nb_buf_free(&chunk->cipher_iv);
         nb_buf_free(&chunk->cipher_key);
         nb_buf_init_alloc(&chunk->cipher_key, key_len);
         RAND_bytes(chunk->cipher_key.data, chunk->cipher_key.len);
     }
+}
 
-    StackCleaner cleaner([&] {
-        EVP_CIPHER_CTX_free(ctx);
-        nb_buf_free(&iv);
-    });
-
-    evp_ret = EVP_EncryptInit_ex(ctx, evp_cipher, NULL, chunk->cipher_key.data, iv.data);
-    if (!evp_ret) {
-        nb_chunk_error(chunk, "Chunk Encoder: cipher encrypt init failed %s", chunk->cipher_type);
-        return;
-    }
-
-    // allocate blocks for all data frags
+/**
+ * allocates blocks for all data frags and fills them by calling
+ * update(out, in, len) over the chunk data, which returns the output length or -1 on error.
+ */
+template <typename UpdateFunc>
+static bool
+_nb_encrypt_frags(struct NB_Coder_Chunk* chunk, UpdateFunc update)
+{
     for (int i = 0; i < chunk->data_frags; ++i) {
         struct NB_Coder_Frag* f = chunk->frags + i;
         nb_bufs_push_alloc(&f->block, chunk->frag_size);
@@ -337,7 +431,7 @@ _nb_encrypt(struct NB_Coder_Chunk* chunk, const EVP_CIPHER* evp_cipher)
             if (f >= chunk->frags + chunk->data_frags) {
                 assert(!"data frags exceeded");
                 nb_chunk_error(chunk, "Chunk Encoder: data frags exceeded");
-                return;
+                return false;
             }
 
             struct NB_Buf* fb = nb_bufs_get(&f->block, 0);
@@ -346,7 +440,7 @@ _nb_encrypt(struct NB_Coder_Chunk* chunk, const EVP_CIPHER* evp_cipher)
             if (frag_pos > fb->len) {
                 assert(!"block len exceeded");
                 nb_chunk_error(chunk, "Chunk Encoder: block len exceeded");
-                return;
+                return false;
             }
 
             if (frag_pos == fb->len) {
@@ -359,13 +453,8 @@ _nb_encrypt(struct NB_Coder_Chunk* chunk, const EVP_CIPHER* evp_cipher)
             const int avail = b->len - pos;
             const int len = avail < needed ? avail : needed;
 
-            int out_len = 0;
-            evp_ret = EVP_EncryptUpdate(ctx, fb->data + frag_pos, &out_len, b->data + pos, len);
-            if (!evp_ret) {
-                nb_chunk_error(
-                    chunk, "Chunk Encoder: cipher encrypt update failed %s", chunk->cipher_type);
-                return;
-            }
+            const int out_len = update(fb->data + frag_pos, b->data + pos, len);
+            if (out_len < 0) return false;
 
             pos += len;
             frag_pos += out_len;
@@ -375,7 +464,7 @@ _nb_encrypt(struct NB_Coder_Chunk* chunk, const EVP_CIPHER* evp_cipher)
     if (f + 1 != chunk->frags + chunk->data_frags) {
         assert(!"data frags incomplete");
         nb_chunk_error(chunk, "Chunk Encoder: data frags incomplete");
-        return;
+        return false;
     }
 
     if (frag_pos != chunk->frag_size) {
@@ -386,28 +475,10 @@ _nb_encrypt(struct NB_Coder_Chunk* chunk, const EVP_CIPHER* evp_cipher)
             frag_pos,
             chunk->frag_size,
             chunk->cipher_type);
-        return;
+        return false;
     }
 
-    int out_len = 0;
-    evp_ret = EVP_EncryptFinal_ex(ctx, 0, &out_len);
-    if (!evp_ret) {
-        nb_chunk_error(chunk, "Chunk Encoder: cipher encrypt final failed %s", chunk->cipher_type);
-        return;
-    }
-    assert(!out_len);
-
-    if (USE_GCM_AUTH_TAG && EVP_CIPHER_CTX_mode(ctx) == EVP_CIPH_GCM_MODE) {
-        nb_buf_free(&chunk->cipher_auth_tag);
-        nb_buf_init_alloc(&chunk->cipher_auth_tag, 16);
-        evp_ret = EVP_CIPHER_CTX_ctrl(
-            ctx, EVP_CTRL_GCM_GET_TAG, chunk->cipher_auth_tag.len, chunk->cipher_auth_tag.data);
-        if (!evp_ret) {
-            nb_chunk_error(
-                chunk, "Chunk Encoder: cipher encrypt get tag failed %s", chunk->cipher_type);
-            return;
-        }
-    }
+    return true;
 }
 
 static void
@@ -504,7 +575,7 @@ _nb_erasure(struct NB_Coder_Chunk* chunk)
     for (int i = 0; i < chunk->parity_frags; ++i) {
         struct NB_Coder_Frag* f = chunk->frags + chunk->data_frags + i;
         if (i == 0) {
-            nb_bufs_push_owned(&f->block, parity_buf.data, chunk->frag_size);
+            nb_bufs_push_pooled(&f->block, parity_buf.data, chunk->frag_size);
         } else {
             nb_bufs_push_shared(
                 &f->block, parity_buf.data + (i * chunk->frag_size), chunk->frag_size);
@@ -627,8 +698,9 @@ _nb_decode(struct NB_Coder_Chunk* chunk)
 
     if (chunk->errors.count) return;
 
+    bool authenticated = false;
     if (evp_cipher) {
-        _nb_decrypt(chunk, frags_map, evp_cipher);
+        authenticated = _nb_decrypt(chunk, frags_map, evp_cipher);
     } else {
         _nb_no_decrypt(chunk, frags_map);
     }
@@ -649,8 +721,9 @@ _nb_decode(struct NB_Coder_Chunk* chunk)
     if (chunk->compress_type[0]) {
         if (strcmp(chunk->compress_type, "snappy") == 0) {
             nb_snappy_uncompress(&chunk->data, &chunk->errors);
-        } else if (strcmp(chunk->compress_type, "zlib") == 0) {
-            nb_zlib_uncompress(&chunk->data, chunk->size, &chunk->errors);
+        } else if (strcmp(chunk->compress_type, "zlib") == 0 || _nb_igzip_level(chunk->compress_type) >= 0) {
+            // igzip writes zlib streams, and isal_inflate is faster for both
+            nb_igzip_uncompress(&chunk->data, chunk->size, &chunk->errors);
         } else {
             nb_chunk_error(
                 chunk, "Chunk Decoder: unsupported compress type %s", chunk->compress_type);
@@ -666,40 +739,81 @@ _nb_decode(struct NB_Coder_Chunk* chunk)
     }
 
     // check that chunk data digest matches the digest computed during encoding
-    if (evp_md) {
+    // unless the cipher auth tag was verified which already covers it
+    if (evp_md && !authenticated) {
         if (!_nb_digest_match(evp_md, &chunk->data, &chunk->digest)) {
             nb_chunk_error(chunk, "Chunk Decoder: chunk digest mismatch %s", chunk->digest_type);
         }
     }
 }
 
-static void
-_nb_ec_select_available_fragments(
-    struct NB_Coder_Frag** frags_map,
-    int k,
-    int m,
-    uint8_t* a,
-    uint8_t* b,
-    uint8_t* out_index,
-    int* p_out_len,
-    uint8_t** in_bufs)
+/**
+ * NB_Decode_Matrix holds the ec tables to reconstruct the missing data fragments
+ * from the k available fragments selected by in_mask (bit per fragment row).
+ * The rows to reconstruct are the missing data rows in ascending order.
+ */
+struct NB_Decode_Matrix
 {
+    int out_len;
+    std::vector<uint8_t> ec_table;
+};
+
+typedef std::tuple<NB_Parity_Type, int, int, uint64_t> NB_Decode_Matrix_Key;
+
+static std::mutex _nb_decode_matrix_mutex;
+static std::map<NB_Decode_Matrix_Key, std::shared_ptr<const NB_Decode_Matrix>> _nb_decode_matrix_cache;
+
+/**
+ * returns the decode matrix for the erasure pattern, or null if the matrix is not invertible.
+ * while a node is down the same few patterns repeat for every chunk read,
+ * so the matrix inversion and table expansion are cached instead of redone per chunk.
+ */
+static std::shared_ptr<const NB_Decode_Matrix>
+_nb_ec_decode_matrix(NB_Parity_Type parity_type, int k, int m, uint64_t in_mask)
+{
+    const NB_Decode_Matrix_Key key(parity_type, k, m, in_mask);
+    {
+        std::lock_guard<std::mutex> lock(_nb_decode_matrix_mutex);
+        auto it = _nb_decode_matrix_cache.find(key);
+        if (it != _nb_decode_matrix_cache.end()) return it->second;
+    }
+
+    uint8_t a[MAX_MATRIX_SIZE];
+    uint8_t b[MAX_MATRIX_SIZE];
+    uint8_t out_index[MAX_PARITY_FRAGS];
     int out_len = 0;
-    for (int i = 0, r = 0; i < k; ++i, ++r) {
-        assert(r >= 0 && r < m);
-        while (!frags_map[r]) {
-            if (r < k) {
-                // decoding only data fragments
-                out_index[out_len] = r;
-                ++out_len;
-            }
-            ++r;
-            assert(r >= 0 && r < m);
+    if (parity_type == NB_Parity_Type::C1) {
+        gf_gen_cauchy1_matrix(a, m, k);
+    } else {
+        gf_gen_rs_matrix(a, m, k);
+    }
+    // select the rows of the available fragments
+    for (int r = 0, i = 0; r < m && i < k; ++r) {
+        if (in_mask & (1ull << r)) {
+            memcpy(&b[k * i], &a[k * r], k);
+            ++i;
+        } else if (r < k) {
+            out_index[out_len] = r;
+            ++out_len;
         }
-        in_bufs[i] = nb_bufs_merge(&frags_map[r]->block, 0);
-        memcpy(&b[k * i], &a[k * r], k);
     }
-    *p_out_len = out_len;
+    if (gf_invert_matrix(b, a, k) < 0) return nullptr;
+    // select rows of missing data fragments
+    for (int i = 0; i < out_len; ++i) {
+        memcpy(&b[k * i], &a[k * out_index[i]], k);
+    }
+    auto dm = std::make_shared<NB_Decode_Matrix>();
+    dm->out_len = out_len;
+    dm->ec_table.resize(32 * k * out_len);
+    ec_init_tables(k, out_len, b, dm->ec_table.data());
+
+    std::lock_guard<std::mutex> lock(_nb_decode_matrix_mutex);
+    // the patterns are few in practice, so a full cache is just dropped
+    if (_nb_decode_matrix_cache.size() >= MAX_DECODE_MATRIX_CACHE) {
+        _nb_decode_matrix_cache.clear();
+    }
+    _nb_decode_matrix_cache.emplace(key, dm);
+    return dm;
 }
 
 static void
@@ -722,7 +836,7 @@ _nb_ec_update_decoded_fragments(
         f->data_index = j;
         nb_bufs_free(&f->block);
         nb_bufs_init(&f->block);
-        nb_bufs_push_owned(&f->block, out_bufs[i], frag_size);
+        nb_bufs_push_pooled(&f->block, out_bufs[i], frag_size);
         frags_map[r] = 0;
         frags_map[j] = f;
     }
@@ -754,42 +868,49 @@ _nb_derasure(struct NB_Coder_Chunk* chunk, struct NB_Coder_Frag** frags_map, int
         frags_map[i] = 0;
     }
 
-    for (int i = 0; i < chunk->frags_count; ++i) {
-        struct NB_Coder_Frag* f = chunk->frags + i;
-        int index = -1;
-        if (f->data_index >= 0 && f->data_index < chunk->data_frags) {
-            index = f->data_index;
-        } else if (f->parity_index >= 0 && f->parity_index < chunk->parity_frags) {
-            index = chunk->data_frags + f->parity_index;
-        } else if (f->lrc_index >= 0 && f->lrc_index < total_frags - chunk->data_frags - chunk->parity_frags) {
-            continue; // lrc not yet applicable
-        } else {
-            continue; // invalid chunk index
-        }
-        if (f->block.len != chunk->frag_size) {
-            if (f->block.len) {
-                printf(
-                    "CODER MISMATCHING BLOCK SIZE i=%i index=%i block_size=%i frag_size=%i\n",
-                    i,
-                    index,
-                    f->block.len,
-                    chunk->frag_size);
+    // take the data frags first, and then only as many parity frags as needed,
+    // so that a chunk read with hedged parity frags does not digest the surplus frags.
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < chunk->frags_count; ++i) {
+            if (pass && num_avail_data_frags + num_avail_parity_frags >= chunk->data_frags) break;
+            struct NB_Coder_Frag* f = chunk->frags + i;
+            int index = -1;
+            if (f->data_index >= 0 && f->data_index < chunk->data_frags) {
+                if (pass) continue;
+                index = f->data_index;
+            } else if (f->parity_index >= 0 && f->parity_index < chunk->parity_frags) {
+                if (!pass) continue;
+                index = chunk->data_frags + f->parity_index;
+            } else if (f->lrc_index >= 0 && f->lrc_index < total_frags - chunk->data_frags - chunk->parity_frags) {
+                continue; // lrc not yet applicable
+            } else {
+                continue; // invalid chunk index
             }
-            continue; // mismatching block size
-        }
-        if (frags_map[index]) {
-            continue; // duplicate frag
-        }
-        if (evp_md_frag) {
-            if (!_nb_digest_match(evp_md_frag, &f->block, &f->digest)) {
-                continue; // mismatching block digest
+            if (f->block.len != chunk->frag_size) {
+                if (f->block.len) {
+                    printf(
+                        "CODER MISMATCHING BLOCK SIZE i=%i index=%i block_size=%i frag_size=%i\n",
+                        i,
+                        index,
+                        f->block.len,
+                        chunk->frag_size);
+                }
+                continue; // mismatching block size
+            }
+            if (frags_map[index]) {
+                continue; // duplicate frag
+            }
+            if (evp_md_frag) {
+                if (!_nb_digest_match(evp_md_frag, &f->block, &f->digest)) {
+                    continue; // mismatching block digest
+                }
+            }
+            frags_map[index] = f;
+            if (index < chunk->data_frags) {
+                num_avail_data_frags++;
+            } else {
+                num_avail_parity_frags++;
             }
-        }
-        frags_map[index] = f;
-        if (index < chunk->data_frags) {
-            num_avail_data_frags++;
-        } else {
-            num_avail_parity_frags++;
         }
     }
 
@@ -809,22 +930,17 @@ _nb_derasure(struct NB_Coder_Chunk* chunk, struct NB_Coder_Frag** frags_map, int
         if (parity_type == NB_Parity_Type::C1 || parity_type == NB_Parity_Type::RS) {
             const int k = chunk->data_frags;
             const int m = chunk->data_frags + chunk->parity_frags;
-            uint8_t ec_table[MAX_MATRIX_SIZE * 32];
-            uint8_t a[MAX_MATRIX_SIZE];
-            uint8_t b[MAX_MATRIX_SIZE];
             uint8_t* in_bufs[MAX_DATA_FRAGS];
             uint8_t* out_bufs[MAX_PARITY_FRAGS];
-            uint8_t out_index[MAX_PARITY_FRAGS];
-            int out_len = 0;
-            // calculate the decode matrix:
-            if (parity_type == NB_Parity_Type::C1) {
-                gf_gen_cauchy1_matrix(a, m, k);
-            } else {
-                gf_gen_rs_matrix(a, m, k);
+            uint64_t in_mask = 0;
+            for (int r = 0, i = 0; r < m && i < k; ++r) {
+                if (!frags_map[r]) continue;
+                in_mask |= 1ull << r;
+                in_bufs[i] = nb_bufs_merge(&frags_map[r]->block, 0);
+                ++i;
             }
-            _nb_ec_select_available_fragments(frags_map, k, m, a, b, out_index, &out_len, in_bufs);
-            assert(out_len == chunk->data_frags - num_avail_data_frags);
-            if (gf_invert_matrix(b, a, k) < 0) {
+            auto dm = _nb_ec_decode_matrix(parity_type, k, m, in_mask);
+            if (!dm) {
                 nb_chunk_error(
                     chunk,
                     "Chunk Decoder: erasure decode invert failed"
@@ -836,14 +952,14 @@ _nb_derasure(struct NB_Coder_Chunk* chunk, struct NB_Coder_Frag** frags_map, int
                     chunk->parity_frags);
                 return;
             }
-            // select rows of missing data fragments
-            for (int i = 0; i < out_len; ++i) {
-                memcpy(&b[k * i], &a[k * out_index[i]], k);
-                out_bufs[i] = nb_new_mem(chunk->frag_size);
+            assert(dm->out_len == chunk->data_frags - num_avail_data_frags);
+            for (int i = 0; i < dm->out_len; ++i) {
+                out_bufs[i] = nb_pool_alloc(chunk->frag_size);
             }
-            ec_init_tables(k, out_len, b, ec_table);
-            ec_encode_data(chunk->frag_size, k, out_len, ec_table, in_bufs, out_bufs);
-            _nb_ec_update_decoded_fragments(frags_map, k, m, out_len, out_bufs, chunk->frag_size);
+            // isa-l does not take a const table but only reads it
+            uint8_t* ec_table = const_cast<uint8_t*>(dm->ec_table.data());
+            ec_encode_data(chunk->frag_size, k, dm->out_len, ec_table, in_bufs, out_bufs);
+            _nb_ec_update_decoded_fragments(frags_map, k, m, dm->out_len, out_bufs, chunk->frag_size);
 
         } else if (parity_type == NB_Parity_Type::CM) {
             cm256_encoder_params cm_params;
@@ -859,12 +975,21 @@ _nb_derasure(struct NB_Coder_Chunk* chunk, struct NB_Coder_Frag** frags_map, int
                     frags_map[next_parity] = 0;
                     ++next_parity;
                 }
-                if (frags_map[i]->data_index >= 0) {
-                    cm_blocks[i].Index = frags_map[i]->data_index;
+                struct NB_Coder_Frag* f = frags_map[i];
+                if (f->data_index >= 0) {
+                    cm_blocks[i].Index = f->data_index;
+                    cm_blocks[i].Block = nb_bufs_merge(&f->block, 0);
                 } else {
-                    cm_blocks[i].Index = chunk->data_frags + frags_map[i]->parity_index;
+                    // cm256 recovers the data in place of the parity block, so decode into a copy
+                    // and keep the caller's frag intact for a retry with more frags (hedged reads).
+                    uint8_t* copy = nb_pool_alloc(chunk->frag_size);
+                    nb_bufs_read(&f->block, copy, chunk->frag_size);
+                    nb_bufs_free(&f->block);
+                    nb_bufs_init(&f->block);
+                    nb_bufs_push_pooled(&f->block, copy, chunk->frag_size);
+                    cm_blocks[i].Index = chunk->data_frags + f->parity_index;
+                    cm_blocks[i].Block = copy;
                 }
-                cm_blocks[i].Block = nb_bufs_merge(&frags_map[i]->block, 0);
             }
             int decode_err = cm256_decode(cm_params, cm_blocks);
             if (decode_err) {
@@ -900,14 +1025,24 @@ _nb_derasure(struct NB_Coder_Chunk* chunk, struct NB_Coder_Frag** frags_map, int
     }
 }
 
-static void
+/**
+ * returns true if the data was authenticated by the gcm tag
+ */
+static bool
 _nb_decrypt(
     struct NB_Coder_Chunk* chunk, struct NB_Coder_Frag** frags_map, const EVP_CIPHER* evp_cipher)
 {
+#ifdef USE_ISAL_AES_GCM
+    if (_nb_use_isal_gcm(evp_cipher)) {
+        return _nb_isal_gcm_decrypt(chunk, frags_map);
+    }
+#endif
+
     EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
     struct NB_Buf iv;
     int evp_ret = 0;
     bool skip_auth = false;
+    bool authenticated = false;
 
     // const int key_len = EVP_CIPHER_key_length(evp_cipher);
     const int iv_len = EVP_CIPHER_iv_length(evp_cipher);
@@ -929,11 +1064,20 @@ _nb_decrypt(
     evp_ret = EVP_DecryptInit_ex(ctx, evp_cipher, NULL, chunk->cipher_key.data, iv.data);
     if (!evp_ret) {
         nb_chunk_error(chunk, "Chunk Decoder: cipher decrypt init failed %s", chunk->cipher_type);
-        return;
+        return false;
     }
 
     if (EVP_CIPHER_CTX_mode(ctx) == EVP_CIPH_GCM_MODE) {
-        if (USE_GCM_AUTH_TAG && chunk->cipher_auth_tag.len) {
+        if (chunk->cipher_auth_tag.len) {
+            // a shorter tag would be easier to guess, and an authenticated chunk skips the digest check
+            if (chunk->cipher_auth_tag.len != GCM_AUTH_TAG_LEN) {
+                nb_chunk_error(
+                    chunk,
+                    "Chunk Decoder: cipher auth tag length %d is invalid %s",
+                    chunk->cipher_auth_tag.len,
+                    chunk->cipher_type);
+                return false;
+            }
             evp_ret = EVP_CIPHER_CTX_ctrl(
                 ctx,
                 EVP_CTRL_GCM_SET_TAG,
@@ -942,8 +1086,9 @@ _nb_decrypt(
             if (!evp_ret) {
                 nb_chunk_error(
                     chunk, "Chunk Decoder: cipher decrypt set tag failed %s", chunk->cipher_type);
-                return;
+                return false;
             }
+            authenticated = true;
         } else {
             skip_auth = true;
         }
@@ -962,7 +1107,7 @@ _nb_decrypt(
             if (!evp_ret) {
                 nb_chunk_error(
                     chunk, "Chunk Decoder: cipher decrypt update failed %s", chunk->cipher_type);
-                return;
+                return false;
             }
             pos += out_len;
         }
@@ -971,10 +1116,15 @@ _nb_decrypt(
     int out_len = 0;
     evp_ret = EVP_DecryptFinal_ex(ctx, 0, &out_len);
     if (!evp_ret && !skip_auth) {
-        nb_chunk_error(chunk, "Chunk Decoder: cipher decrypt final failed %s", chunk->cipher_type);
-        return;
+        if (authenticated) {
+            nb_chunk_error(chunk, "Chunk Decoder: cipher auth tag mismatch %s", chunk->cipher_type);
+        } else {
+            nb_chunk_error(chunk, "Chunk Decoder: cipher decrypt final failed %s", chunk->cipher_type);
+        }
+        return false;
     }
     assert(!out_len);
+    return authenticated;
 }
 
 static void
@@ -989,6 +1139,142 @@ _nb_no_decrypt(struct NB_Coder_Chunk* chunk, struct NB_Coder_Frag** frags_map)
     }
 }
 
+#ifdef USE_ISAL_AES_GCM
+
+static bool
+_nb_isal_gcm_cpu_supported()
+{
+#if defined(__x86_64__)
+    static const bool supported = __builtin_cpu_supports("aes") &&
+        __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#elif defined(__aarch64__)
+    static const bool supported = (getauxval(AT_HWCAP) & (HWCAP_ASIMD | HWCAP_AES | HWCAP_PMULL)) ==
+        (HWCAP_ASIMD | HWCAP_AES | HWCAP_PMULL);
+#else
+    static const bool supported = false;
+#endif
+    return supported;
+}
+
+/**
+ * isa-l_crypto aes-gcm produces the same ciphertext and tag as openssl,
+ * so it is used for aes-256-gcm when the cpu supports it,
+ * but not in fips mode where only the openssl validated module should be used.
+ */
+static bool
+_nb_use_isal_gcm(const EVP_CIPHER* evp_cipher)
+{
+    extern bool fips_mode;
+    return !fips_mode && EVP_CIPHER_nid(evp_cipher) == NID_aes_256_gcm && _nb_isal_gcm_cpu_supported();
+}
+
+static void
+_nb_isal_gcm_encrypt(struct NB_Coder_Chunk* chunk)
+{
+    struct gcm_key_data key_data;
+    struct gcm_context_data ctx;
+    struct NB_Buf iv;
+
+    _nb_encrypt_init_key(chunk, GCM_256_KEY_LEN, GCM_IV_DATA_LEN, &iv);
+
+    StackCleaner cleaner([&] {
+        OPENSSL_cleanse(&key_data, sizeof(key_data));
+        OPENSSL_cleanse(&ctx, sizeof(ctx));
+        nb_buf_free(&iv);
+    });
+
+    // the key schedule and hash keys are expanded once and reused for all the frags
+    aes_gcm_pre_256(chunk->cipher_key.data, &key_data);
+    aes_gcm_init_256(&key_data, &ctx, iv.data, 0, 0);
+
+    const bool ok = _nb_encrypt_frags(chunk, [&](uint8_t* out, const uint8_t* in, int len) {
+        aes_gcm_enc_256_update(&key_data, &ctx, out, in, len);
+        return len;
+    });
+    if (!ok) return;
+
+    nb_buf_free(&chunk->cipher_auth_tag);
+    nb_buf_init_alloc(&chunk->cipher_auth_tag, GCM_AUTH_TAG_LEN);
+    aes_gcm_enc_256_finalize(&key_data, &ctx, chunk->cipher_auth_tag.data, GCM_AUTH_TAG_LEN);
+}
+
+/**
+ * returns true if the data was authenticated by the gcm tag
+ */
+static bool
+_nb_isal_gcm_decrypt(struct NB_Coder_Chunk* chunk, struct NB_Coder_Frag** frags_map)
+{
+    struct gcm_key_data key_data;
+    struct gcm_context_data ctx;
+    struct NB_Buf iv;
+    uint8_t tag[GCM_AUTH_TAG_LEN];
+
+    const int decrypted_size = chunk->compress_size > 0 ? chunk->compress_size : chunk->size;
+    const int padded_size = _nb_align_up(decrypted_size, chunk->data_frags);
+
+    if (chunk->cipher_key.len != GCM_256_KEY_LEN) {
+        nb_chunk_error(chunk, "Chunk Decoder: cipher key length mismatch %s", chunk->cipher_type);
+        return false;
+    }
+    if (chunk->cipher_iv.len) {
+        if (chunk->cipher_iv.len != GCM_IV_DATA_LEN) {
+            nb_chunk_error(chunk, "Chunk Decoder: cipher iv length mismatch %s", chunk->cipher_type);
+            return false;
+        }
+        nb_buf_init_shared(&iv, chunk->cipher_iv.data, chunk->cipher_iv.len);
+    } else {
+        // using iv of zeros since we generate random key per chunk
+        nb_buf_init_zeros(&iv, GCM_IV_DATA_LEN);
+    }
+
+    StackCleaner cleaner([&] {
+        OPENSSL_cleanse(&key_data, sizeof(key_data));
+        OPENSSL_cleanse(&ctx, sizeof(ctx));
+        nb_buf_free(&iv);
+    });
+
+    aes_gcm_pre_256(chunk->cipher_key.data, &key_data);
+    aes_gcm_init_256(&key_data, &ctx, iv.data, 0, 0);
+
+    int pos = 0;
+    struct NB_Buf* b = nb_bufs_push_alloc(&chunk->data, padded_size);
+
+    for (int i = 0; i < chunk->data_frags; ++i) {
+        struct NB_Coder_Frag* f = frags_map[i];
+        for (int j = 0; j < f->block.count; ++j) {
+            struct NB_Buf* fb = nb_bufs_get(&f->block, j);
+            if (pos + fb->len > b->len) {
+                nb_chunk_error(chunk, "Chunk Decoder: block len exceeded");
+                return false;
+            }
+            aes_gcm_dec_256_update(&key_data, &ctx, b->data + pos, fb->data, fb->len);
+            pos += fb->len;
+        }
+    }
+
+    aes_gcm_dec_256_finalize(&key_data, &ctx, tag, GCM_AUTH_TAG_LEN);
+
+    // chunks encoded without a tag are left to the chunk digest check
+    if (!chunk->cipher_auth_tag.len) return false;
+
+    // same as the openssl path - only a full tag authenticates the chunk
+    if (chunk->cipher_auth_tag.len != GCM_AUTH_TAG_LEN) {
+        nb_chunk_error(
+            chunk,
+            "Chunk Decoder: cipher auth tag length %d is invalid %s",
+            chunk->cipher_auth_tag.len,
+            chunk->cipher_type);
+        return false;
+    }
+    if (CRYPTO_memcmp(tag, chunk->cipher_auth_tag.data, GCM_AUTH_TAG_LEN) != 0) {
+        nb_chunk_error(chunk, "Chunk Decoder: cipher auth tag mismatch %s", chunk->cipher_type);
+        return false;
+    }
+    return true;
+}
+
+#endif
+
 static void
 _nb_digest(const EVP_MD* md, struct NB_Bufs* data, struct NB_Buf* digest)
 {
@@ -1,11 +1,13 @@
 /* Copyright (C) 2016 NooBaa */
 #include "../util/b64.h"
+#include "../util/buf_pool.h"
 #include "../util/napi.h"
 #include "coder.h"
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <utility>
 
 namespace noobaa
 {
@@ -21,6 +23,7 @@ struct CoderAsync {
 };
 
 static napi_value _nb_chunk_coder(napi_env env, napi_callback_info info);
+static napi_value _nb_buf_pool_stats(napi_env env, napi_callback_info info);
 static void _nb_coder_async_execute(napi_env env, void* data);
 static void _nb_coder_async_complete(napi_env env, napi_status status, void* data);
 static void _nb_coder_load_chunk(napi_env env, napi_value v_chunk, struct NB_Coder_Chunk* chunk);
@@ -34,6 +37,39 @@ chunk_coder_napi(napi_env env, napi_value exports)
     napi_value func = 0;
     napi_create_function(env, "chunk_coder", NAPI_AUTO_LENGTH, _nb_chunk_coder, NULL, &func);
     napi_set_named_property(env, exports, "chunk_coder", func);
+    napi_create_function(env, "buf_pool_stats", NAPI_AUTO_LENGTH, _nb_buf_pool_stats, NULL, &func);
+    napi_set_named_property(env, exports, "buf_pool_stats", func);
+}
+
+/**
+ * buf_pool_stats() returns the counters of the buffer pool that backs the coder buffers.
+ * frees lag behind allocs until the js buffers of the chunks are garbage collected.
+ */
+static napi_value
+_nb_buf_pool_stats(napi_env env, napi_callback_info info)
+{
+    struct NB_Pool_Stats stats;
+    nb_pool_stats(&stats);
+    napi_value v_stats = 0;
+    napi_create_object(env, &v_stats);
+    const std::pair<const char*, double> fields[] = {
+        { "allocs", (double)stats.allocs },
+        { "frees", (double)stats.frees },
+        { "thread_hits", (double)stats.thread_hits },
+        { "depot_hits", (double)stats.depot_hits },
+        { "sys_allocs", (double)stats.sys_allocs },
+        { "sys_frees", (double)stats.sys_frees },
+        { "cap_frees", (double)stats.cap_frees },
+        { "bytes_in_use", (double)stats.bytes_in_use },
+        { "bytes_cached", (double)stats.bytes_cached },
+        { "max_cached_bytes", (double)stats.max_cached_bytes },
+    };
+    for (const auto& field : fields) {
+        napi_value v = 0;
+        napi_create_double(env, field.second, &v);
+        napi_set_named_property(env, v_stats, field.first, v);
+    }
+    return v_stats;
 }
 
 static napi_value
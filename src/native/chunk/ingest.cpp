@@ -0,0 +1,166 @@
+/* Copyright (C) 2016 NooBaa */
+#include "ingest.h"
+
+#include "../util/buf_pool.h"
+#include "../util/common.h"
+
+namespace noobaa
+{
+
+Ingest::Ingest(
+    int min_chunk,
+    int max_chunk,
+    int avg_chunk_bits,
+    bool calc_md5,
+    bool calc_sha256,
+    const struct NB_Coder_Chunk& config)
+    : _splitter(min_chunk, max_chunk, avg_chunk_bits, calc_md5, calc_sha256)
+    , _next_ticket(0)
+    , _split_ticket(0)
+    , _pos(0)
+{
+    nb_chunk_init(&_config);
+    memcpy(_config.digest_type, config.digest_type, sizeof(_config.digest_type));
+    memcpy(_config.frag_digest_type, config.frag_digest_type, sizeof(_config.frag_digest_type));
+    memcpy(_config.compress_type, config.compress_type, sizeof(_config.compress_type));
+    memcpy(_config.cipher_type, config.cipher_type, sizeof(_config.cipher_type));
+    memcpy(_config.parity_type, config.parity_type, sizeof(_config.parity_type));
+    _config.data_frags = config.data_frags;
+    _config.parity_frags = config.parity_frags;
+    _config.lrc_group = config.lrc_group;
+    _config.lrc_frags = config.lrc_frags;
+    if (config.cipher_key.len) {
+        nb_buf_init_copy(&_config.cipher_key, config.cipher_key.data, config.cipher_key.len);
+    }
+}
+
+Ingest::~Ingest()
+{
+    nb_chunk_free(&_config);
+}
+
+void
+Ingest::push(uint64_t ticket, const std::vector<Input>& input, Chunks& chunks)
+{
+    _split(ticket, input, false, chunks, 0, 0);
+    _encode(chunks);
+}
+
+void
+Ingest::finish(uint64_t ticket, const std::vector<Input>& input, Chunks& chunks, uint8_t* md5, uint8_t* sha256)
+{
+    _split(ticket, input, true, chunks, md5, sha256);
+    _encode(chunks);
+}
+
+void
+Ingest::_split(
+    uint64_t ticket,
+    const std::vector<Input>& input,
+    bool finish,
+    Chunks& chunks,
+    uint8_t* md5,
+    uint8_t* sha256)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    // pushes are queued to the worker threads in ticket order,
+    // so the previous ticket is already running and this wait is bounded by its split.
+    _cond.wait(lock, [&] { return _split_ticket == ticket; });
+
+    for (const Input& in : input) {
+        if (in.len <= 0) continue;
+        _pending.push_back(Segment{ in.data, in.len, nullptr });
+        _splitter.push(in.data, in.len);
+        for (const Splitter::Point size : _splitter.extract_points()) {
+            _take_chunk(size, chunks);
+        }
+    }
+
+    if (finish) {
+        int size = 0;
+        for (const Segment& s : _pending) size += s.len;
+        if (size) _take_chunk(size, chunks);
+        _splitter.finish(md5, sha256);
+    } else {
+        // copy the remaining input aside since the input buffers
+        // are released when this push completes
+        int len = 0;
+        for (const Segment& s : _pending) {
+            if (!s.owner) len += s.len;
+        }
+        if (len) {
+            std::shared_ptr<uint8_t> owner(nb_pool_alloc(len), nb_pool_free);
+            uint8_t* p = owner.get();
+            for (Segment& s : _pending) {
+                if (s.owner) continue;
+                memcpy(p, s.data, s.len);
+                s.data = p;
+                s.owner = owner;
+                p += s.len;
+            }
+        }
+    }
+
+    _split_ticket++;
+    lock.unlock();
+    _cond.notify_all();
+}
+
+void
+Ingest::_take_chunk(int size, Chunks& chunks)
+{
+    std::unique_ptr<IngestChunk> c(new IngestChunk);
+    struct NB_Coder_Chunk* chunk = &c->coder;
+    memcpy(chunk->digest_type, _config.digest_type, sizeof(chunk->digest_type));
+    memcpy(chunk->frag_digest_type, _config.frag_digest_type, sizeof(chunk->frag_digest_type));
+    memcpy(chunk->compress_type, _config.compress_type, sizeof(chunk->compress_type));
+    memcpy(chunk->cipher_type, _config.cipher_type, sizeof(chunk->cipher_type));
+    memcpy(chunk->parity_type, _config.parity_type, sizeof(chunk->parity_type));
+    chunk->data_frags = _config.data_frags;
+    chunk->parity_frags = _config.parity_frags;
+    chunk->lrc_group = _config.lrc_group;
+    chunk->lrc_frags = _config.lrc_frags;
+    if (_config.cipher_key.len) {
+        nb_buf_init_copy(&chunk->cipher_key, _config.cipher_key.data, _config.cipher_key.len);
+    }
+    chunk->size = size;
+    c->pos = _pos;
+    _pos += size;
+
+    while (size > 0) {
+        Segment& s = _pending.front();
+        const int len = std::min(size, s.len);
+        nb_bufs_push_shared(&chunk->data, (uint8_t*)s.data, len);
+        if (s.owner) c->owners.push_back(s.owner);
+        size -= len;
+        if (len == s.len) {
+            _pending.pop_front();
+        } else {
+            s.data += len;
+            s.len -= len;
+        }
+    }
+
+    chunks.push_back(std::move(c));
+}
+
+void
+Ingest::_encode(Chunks& chunks)
+{
+    for (auto& c : chunks) {
+        struct NB_Coder_Chunk* chunk = &c->coder;
+        nb_chunk_coder(chunk);
+        if (chunk->errors.count) continue;
+        // frags may share the chunk data (and each other for parity),
+        // so detach all of them before releasing the data.
+        c->frag_bufs.resize(chunk->frags_count);
+        for (int i = 0; i < chunk->frags_count; ++i) {
+            nb_bufs_detach(&chunk->frags[i].block, &c->frag_bufs[i]);
+        }
+        nb_bufs_free(&chunk->data);
+        nb_bufs_init(&chunk->data);
+        c->owners.clear();
+    }
+}
+
+} // namespace noobaa
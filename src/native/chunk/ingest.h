@@ -0,0 +1,109 @@
+/* Copyright (C) 2016 NooBaa */
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "coder.h"
+#include "splitter.h"
+
+namespace noobaa
+{
+
+/**
+ * IngestChunk is a chunk split and encoded by Ingest.
+ * The frag blocks are detached to single buffers (frag_bufs) on the worker thread,
+ * so that handing them to JS is just wrapping them as external buffers.
+ */
+struct IngestChunk
+{
+    struct NB_Coder_Chunk coder;
+    int64_t pos;
+    std::vector<struct NB_Buf> frag_bufs;
+    // keeps the tail copies that the chunk data shares alive until coded
+    std::vector<std::shared_ptr<uint8_t>> owners;
+
+    IngestChunk()
+        : pos(0)
+    {
+        nb_chunk_init(&coder);
+    }
+    ~IngestChunk()
+    {
+        for (auto& b : frag_bufs) nb_buf_free(&b);
+        nb_chunk_free(&coder);
+    }
+    IngestChunk(const IngestChunk&) = delete;
+    IngestChunk& operator=(const IngestChunk&) = delete;
+};
+
+/**
+ * Ingest fuses the chunk splitter and the chunk encoder for uploads.
+ *
+ * Every push gets a ticket on the calling (event loop) thread, and then runs
+ * on a worker thread where it splits its input strictly in ticket order
+ * and encodes its complete chunks concurrently with the following pushes.
+ * The data after the last split point is copied aside to be the head of the next chunk,
+ * so the input buffers only need to stay alive until their own push completes.
+ */
+class Ingest
+{
+public:
+    struct Input
+    {
+        const uint8_t* data;
+        int len;
+    };
+
+    typedef std::vector<std::unique_ptr<IngestChunk>> Chunks;
+
+    // config holds the coder config (types, frags) and optionally a cipher_key to copy to every chunk
+    Ingest(
+        int min_chunk,
+        int max_chunk,
+        int avg_chunk_bits,
+        bool calc_md5,
+        bool calc_sha256,
+        const struct NB_Coder_Chunk& config);
+    ~Ingest();
+
+    // called from the event loop thread in the order of the pushes
+    uint64_t next_ticket() { return _next_ticket++; }
+
+    // called from a worker thread, waits for the previous tickets to split
+    void push(uint64_t ticket, const std::vector<Input>& input, Chunks& chunks);
+
+    // like push but flushes the remaining data as the last chunk and fills the digests
+    void finish(uint64_t ticket, const std::vector<Input>& input, Chunks& chunks, uint8_t* md5, uint8_t* sha256);
+
+    bool calc_md5() { return _splitter.calc_md5(); }
+    bool calc_sha256() { return _splitter.calc_sha256(); }
+
+private:
+    struct Segment
+    {
+        const uint8_t* data;
+        int len;
+        std::shared_ptr<uint8_t> owner;
+    };
+
+    void _split(uint64_t ticket, const std::vector<Input>& input, bool finish, Chunks& chunks, uint8_t* md5, uint8_t* sha256);
+    void _take_chunk(int size, Chunks& chunks);
+    void _encode(Chunks& chunks);
+
+    Splitter _splitter;
+    struct NB_Coder_Chunk _config;
+    uint64_t _next_ticket;
+
+    // guarded by _mutex - the split state is handed from ticket to ticket
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    uint64_t _split_ticket;
+    std::deque<Segment> _pending;
+    int64_t _pos;
+};
+
+} // namespace noobaa
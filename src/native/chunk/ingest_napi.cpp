@@ -0,0 +1,272 @@
+/* Copyright (C) 2016 NooBaa */
+#include "../util/napi.h"
+#include "../util/worker.h"
+#include "ingest.h"
+
+#include <openssl/md5.h>
+#include <openssl/sha.h>
+
+namespace noobaa
+{
+
+#define INGEST_JS_SIGNATURE "new ChunkIngest({ min_chunk, max_chunk, avg_chunk_bits, calc_md5, calc_sha256, chunk_coder_config, cipher_key_b64 })"
+
+/**
+ * ChunkIngestWrap exposes Ingest to JS (see chunk_ingest.js).
+ *
+ * push(buffers) resolves to the chunks that were completed by these buffers,
+ * already encoded like chunk_coder('enc') would (frags, digests, cipher keys),
+ * and finish(buffers?) resolves to { chunks, md5, sha256 } with the last chunks and the stream digests.
+ * Pushes may be called without waiting for the previous ones to resolve,
+ * and each resolves once its own chunks are encoded.
+ */
+struct ChunkIngestWrap : public Napi::ObjectWrap<ChunkIngestWrap>
+{
+    std::unique_ptr<Ingest> _ingest;
+
+    static Napi::FunctionReference constructor;
+    static void init(Napi::Env env)
+    {
+        constructor = Napi::Persistent(DefineClass(
+            env,
+            "ChunkIngest",
+            {
+                InstanceMethod("push", &ChunkIngestWrap::push),
+                InstanceMethod("finish", &ChunkIngestWrap::finish),
+            }));
+        constructor.SuppressDestruct();
+    }
+    ChunkIngestWrap(const Napi::CallbackInfo& info)
+        : Napi::ObjectWrap<ChunkIngestWrap>(info)
+    {
+        Napi::Env env = info.Env();
+        if (!info[0].IsObject()) {
+            throw Napi::TypeError::New(env, "Argument 'params' should be Object - " INGEST_JS_SIGNATURE);
+        }
+        auto params = info[0].As<Napi::Object>();
+        const int min_chunk = napi_get_i32_or(params, "min_chunk", 0);
+        const int max_chunk = napi_get_i32_or(params, "max_chunk", 0);
+        const int avg_chunk_bits = napi_get_i32_or(params, "avg_chunk_bits", -1);
+        if (min_chunk <= 0 || max_chunk < min_chunk || avg_chunk_bits < 0) {
+            throw Napi::Error::New(env, "Invalid splitter config");
+        }
+        if (!params.Get("chunk_coder_config").IsObject()) {
+            throw Napi::TypeError::New(env, "Argument 'chunk_coder_config' should be Object - " INGEST_JS_SIGNATURE);
+        }
+        struct NB_Coder_Chunk config;
+        nb_chunk_init(&config);
+        napi_value v_config = params.Get("chunk_coder_config");
+        nb_napi_get_str(env, v_config, "digest_type", config.digest_type, sizeof(config.digest_type));
+        nb_napi_get_str(env, v_config, "compress_type", config.compress_type, sizeof(config.compress_type));
+        nb_napi_get_str(env, v_config, "cipher_type", config.cipher_type, sizeof(config.cipher_type));
+        nb_napi_get_str(env, v_config, "frag_digest_type", config.frag_digest_type, sizeof(config.frag_digest_type));
+        nb_napi_get_int(env, v_config, "data_frags", &config.data_frags);
+        nb_napi_get_int(env, v_config, "parity_frags", &config.parity_frags);
+        nb_napi_get_str(env, v_config, "parity_type", config.parity_type, sizeof(config.parity_type));
+        nb_napi_get_int(env, v_config, "lrc_group", &config.lrc_group);
+        nb_napi_get_int(env, v_config, "lrc_frags", &config.lrc_frags);
+        nb_napi_get_buf_b64(env, params, "cipher_key_b64", &config.cipher_key);
+        _ingest.reset(new Ingest(
+            min_chunk,
+            max_chunk,
+            avg_chunk_bits,
+            params.Get("calc_md5").ToBoolean(),
+            params.Get("calc_sha256").ToBoolean(),
+            config));
+        nb_chunk_free(&config);
+    }
+    Napi::Value push(const Napi::CallbackInfo& info);
+    Napi::Value finish(const Napi::CallbackInfo& info);
+};
+
+Napi::FunctionReference ChunkIngestWrap::constructor;
+
+/**
+ * IngestWorker holds the ticket of a push or finish and converts the encoded chunks to JS.
+ * The ticket is taken last in the constructor, after the arguments were validated,
+ * because every ticket must reach Execute() for the following pushes to split.
+ */
+struct IngestWorker : public ObjectWrapWorker<ChunkIngestWrap>
+{
+    uint64_t _ticket;
+    std::vector<Ingest::Input> _input;
+    Ingest::Chunks _chunks;
+    IngestWorker(const Napi::CallbackInfo& info)
+        : ObjectWrapWorker<ChunkIngestWrap>(info)
+        , _ticket(0)
+    {
+    }
+
+    // the buffers are kept alive by the worker args refs until the worker completes
+    void load_input(Napi::Value v, const char* signature)
+    {
+        if (v.IsBuffer()) {
+            auto buf = v.As<Napi::Buffer<uint8_t>>();
+            _input.push_back(Ingest::Input{ buf.Data(), (int)buf.Length() });
+            return;
+        }
+        if (!v.IsArray()) {
+            throw Napi::TypeError::New(Env(), std::string("Argument 'buffers' should be Buffer[] - ") + signature);
+        }
+        auto arr = v.As<Napi::Array>();
+        _input.reserve(arr.Length());
+        for (uint32_t i = 0; i < arr.Length(); ++i) {
+            Napi::Value item = arr[i];
+            if (!item.IsBuffer()) {
+                throw Napi::TypeError::New(Env(), std::string("Argument 'buffers[i]' should be Buffer - ") + signature);
+            }
+            auto buf = item.As<Napi::Buffer<uint8_t>>();
+            _input.push_back(Ingest::Input{ buf.Data(), (int)buf.Length() });
+        }
+    }
+
+    Napi::Array chunks_to_js(Napi::Env env, Napi::Value& err)
+    {
+        auto arr = Napi::Array::New(env, _chunks.size());
+        Napi::Array err_chunks;
+        for (uint32_t i = 0; i < _chunks.size(); ++i) {
+            IngestChunk* c = _chunks[i].get();
+            struct NB_Coder_Chunk* chunk = &c->coder;
+            auto v_chunk = Napi::Object::New(env);
+            arr[i] = v_chunk;
+            v_chunk["size"] = Napi::Number::New(env, chunk->size);
+            v_chunk["pos"] = Napi::Number::New(env, c->pos);
+
+            if (chunk->errors.count) {
+                if (err.IsEmpty()) {
+                    auto e = Napi::Error::New(env, "had chunk errors");
+                    err_chunks = Napi::Array::New(env);
+                    e.Set("chunks", err_chunks);
+                    err = e.Value();
+                }
+                err_chunks[err_chunks.Length()] = v_chunk;
+                auto v_errors = Napi::Array::New(env, chunk->errors.count);
+                for (int k = 0; k < chunk->errors.count; ++k) {
+                    v_errors[k] = Napi::String::New(env, (const char*)nb_bufs_get(&chunk->errors, k)->data);
+                }
+                v_chunk["errors"] = v_errors;
+                continue;
+            }
+
+            v_chunk["frag_size"] = Napi::Number::New(env, chunk->frag_size);
+            if (chunk->compress_type[0]) {
+                v_chunk["compress_size"] = Napi::Number::New(env, chunk->compress_size);
+            }
+            if (chunk->digest_type[0]) {
+                nb_napi_set_buf_b64(env, v_chunk, "digest_b64", &chunk->digest);
+            }
+            if (chunk->cipher_type[0]) {
+                nb_napi_set_buf_b64(env, v_chunk, "cipher_key_b64", &chunk->cipher_key);
+                if (chunk->cipher_iv.len) {
+                    nb_napi_set_buf_b64(env, v_chunk, "cipher_iv_b64", &chunk->cipher_iv);
+                }
+                if (chunk->cipher_auth_tag.len) {
+                    nb_napi_set_buf_b64(env, v_chunk, "cipher_auth_tag_b64", &chunk->cipher_auth_tag);
+                }
+            }
+            auto v_frags = Napi::Array::New(env, chunk->frags_count);
+            v_chunk["frags"] = v_frags;
+            for (int k = 0; k < chunk->frags_count; ++k) {
+                struct NB_Coder_Frag* f = chunk->frags + k;
+                struct NB_Buf* b = &c->frag_bufs[k];
+                auto v_frag = Napi::Object::New(env);
+                v_frags[k] = v_frag;
+                if (f->data_index >= 0) v_frag["data_index"] = Napi::Number::New(env, f->data_index);
+                if (f->parity_index >= 0) v_frag["parity_index"] = Napi::Number::New(env, f->parity_index);
+                if (f->lrc_index >= 0) v_frag["lrc_index"] = Napi::Number::New(env, f->lrc_index);
+                napi_value v_data = 0;
+                napi_create_external_buffer(env, b->len, b->data, nb_napi_finalize_pool_data, 0, &v_data);
+                // ownership moved to the js buffer
+                nb_buf_init(b);
+                v_frag["data"] = Napi::Value(env, v_data);
+                if (chunk->frag_digest_type[0]) {
+                    nb_napi_set_buf_b64(env, v_frag, "digest_b64", &f->digest);
+                }
+            }
+        }
+        return arr;
+    }
+};
+
+struct IngestPush : public IngestWorker
+{
+    IngestPush(const Napi::CallbackInfo& info)
+        : IngestWorker(info)
+    {
+        load_input(info[0], "ChunkIngest.push(buffers)");
+        _ticket = _wrap->_ingest->next_ticket();
+    }
+    virtual void Execute()
+    {
+        _wrap->_ingest->push(_ticket, _input, _chunks);
+    }
+    virtual void OnOK()
+    {
+        Napi::Env env = Env();
+        Napi::Value err;
+        auto chunks = chunks_to_js(env, err);
+        if (!err.IsEmpty()) {
+            _promise.Reject(err);
+        } else {
+            _promise.Resolve(chunks);
+        }
+    }
+};
+
+struct IngestFinish : public IngestWorker
+{
+    uint8_t _md5[MD5_DIGEST_LENGTH];
+    uint8_t _sha256[SHA256_DIGEST_LENGTH];
+    IngestFinish(const Napi::CallbackInfo& info)
+        : IngestWorker(info)
+    {
+        if (!info[0].IsUndefined()) load_input(info[0], "ChunkIngest.finish(buffers?)");
+        _ticket = _wrap->_ingest->next_ticket();
+    }
+    virtual void Execute()
+    {
+        Ingest* ingest = _wrap->_ingest.get();
+        ingest->finish(
+            _ticket,
+            _input,
+            _chunks,
+            ingest->calc_md5() ? _md5 : 0,
+            ingest->calc_sha256() ? _sha256 : 0);
+    }
+    virtual void OnOK()
+    {
+        Napi::Env env = Env();
+        Ingest* ingest = _wrap->_ingest.get();
+        Napi::Value err;
+        auto res = Napi::Object::New(env);
+        res["chunks"] = chunks_to_js(env, err);
+        if (ingest->calc_md5()) res["md5"] = Napi::Buffer<uint8_t>::Copy(env, _md5, MD5_DIGEST_LENGTH);
+        if (ingest->calc_sha256()) res["sha256"] = Napi::Buffer<uint8_t>::Copy(env, _sha256, SHA256_DIGEST_LENGTH);
+        if (!err.IsEmpty()) {
+            _promise.Reject(err);
+        } else {
+            _promise.Resolve(res);
+        }
+    }
+};
+
+Napi::Value
+ChunkIngestWrap::push(const Napi::CallbackInfo& info)
+{
+    return await_worker<IngestPush>(info);
+}
+
+Napi::Value
+ChunkIngestWrap::finish(const Napi::CallbackInfo& info)
+{
+    return await_worker<IngestFinish>(info);
+}
+
+void
+chunk_ingest_napi(Napi::Env env, Napi::Object exports)
+{
+    ChunkIngestWrap::init(env);
+    exports["ChunkIngest"] = ChunkIngestWrap::constructor.Value();
+}
+
+} // namespace noobaa
@@ -0,0 +1,236 @@
+/* Copyright (C) 2016 NooBaa */
+#include "dir_cache.h"
+
+#include <algorithm>
+
+#include <string.h>
+
+#ifdef __APPLE__
+    #define ST_MTIM st_mtimespec
+#else
+    #define ST_MTIM st_mtim
+#endif
+
+namespace noobaa
+{
+
+// utf-8 byte order is code point order, while js compares utf-16 code units,
+// where code points above U+FFFF (surrogates 0xD800-0xDFFF) sort before U+E000-U+FFFF.
+// in utf-8 these are the lead bytes 0xF0-0xF4 vs 0xEE-0xEF, so we rank those
+// at the first differing byte, which is either a lead byte in both names or a continuation byte in both.
+static inline int
+_utf16_rank(uint8_t c)
+{
+    if (c < 0xEE) return c;
+    if (c < 0xF0) return c + 7; // 0xEE-0xEF -> after 0xF4
+    if (c < 0xF5) return c - 2; // 0xF0-0xF4 -> 0xEE-0xF2
+    return c + 2;
+}
+
+int
+DirListing::compare_names(std::string_view a, std::string_view b)
+{
+    const size_t len = std::min(a.size(), b.size());
+    for (size_t i = 0; i < len; ++i) {
+        const uint8_t x = a[i];
+        const uint8_t y = b[i];
+        if (x != y) return _utf16_rank(x) < _utf16_rank(y) ? -1 : 1;
+    }
+    if (a.size() == b.size()) return 0;
+    return a.size() < b.size() ? -1 : 1;
+}
+
+DirListing::DirListing(const struct stat& st, std::vector<Entry>& entries)
+    : _dev(st.st_dev)
+    , _ino(st.st_ino)
+    , _mtime(st.ST_MTIM)
+{
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return compare_names(a.name, b.name) < 0;
+    });
+    size_t names_len = 0;
+    for (const auto& e : entries) names_len += e.name.size();
+    _names.reserve(names_len);
+    _offsets.reserve(entries.size() + 1);
+    _types.reserve(entries.size());
+    _offsets.push_back(0);
+    for (const auto& e : entries) {
+        _names.append(e.name);
+        _offsets.push_back(_names.size());
+        _types.push_back(e.type);
+    }
+    _usage = sizeof(*this) + _names.capacity() +
+        (_offsets.capacity() * sizeof(uint32_t)) + _types.capacity();
+}
+
+bool
+DirListing::same_stat(const struct stat& st) const
+{
+    return _dev == st.st_dev && _ino == st.st_ino &&
+        _mtime.tv_sec == st.ST_MTIM.tv_sec && _mtime.tv_nsec == st.ST_MTIM.tv_nsec;
+}
+
+size_t
+DirListing::upper_bound(std::string_view marker) const
+{
+    size_t lo = 0;
+    size_t hi = count();
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (compare_names(name(mid), marker) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+size_t
+DirListing::lower_bound(std::string_view prefix) const
+{
+    size_t lo = 0;
+    size_t hi = count();
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (compare_names(name(mid), prefix) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+std::shared_ptr<const DirListing>
+DirCache::get(const std::string& path, const struct stat& st)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _items.find(path);
+    if (it == _items.end()) return nullptr;
+    if (!it->second.listing->same_stat(st)) {
+        _remove(it);
+        return nullptr;
+    }
+    _lru.splice(_lru.begin(), _lru, it->second.lru_it);
+    return it->second.listing;
+}
+
+void
+DirCache::put(const std::string& path, std::shared_ptr<const DirListing> listing)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _items.find(path);
+    if (it != _items.end()) _remove(it);
+    if (listing->usage() > _max_total_size) return;
+    _lru.push_front(path);
+    _total_size += listing->usage();
+    _items.emplace(path, Item{ std::move(listing), _lru.begin() });
+    while (_total_size > _max_total_size && !_lru.empty()) {
+        _remove(_items.find(_lru.back()));
+    }
+}
+
+void
+DirCache::invalidate(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _items.find(path);
+    if (it != _items.end()) _remove(it);
+}
+
+size_t
+DirCache::total_size() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _total_size;
+}
+
+size_t
+DirCache::count() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _items.size();
+}
+
+void
+DirCache::_remove(std::unordered_map<std::string, Item>::iterator it)
+{
+    _total_size -= it->second.listing->usage();
+    _lru.erase(it->second.lru_it);
+    _items.erase(it);
+}
+
+bool
+DirExistsCache::contains(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _items.find(path);
+    if (it == _items.end()) {
+        _misses++;
+        return false;
+    }
+    _hits++;
+    _lru.splice(_lru.begin(), _lru, it->second);
+    return true;
+}
+
+void
+DirExistsCache::add(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _items.find(path);
+    if (it != _items.end()) {
+        _lru.splice(_lru.begin(), _lru, it->second);
+        return;
+    }
+    if (!_max_count) return;
+    _lru.push_front(path);
+    _items.emplace(path, _lru.begin());
+    while (_items.size() > _max_count) {
+        _items.erase(_lru.back());
+        _lru.pop_back();
+    }
+}
+
+void
+DirExistsCache::invalidate_tree(const std::string& path)
+{
+    std::string dir(path);
+    while (dir.size() > 1 && dir.back() == '/') dir.pop_back();
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _items.find(dir);
+    if (it != _items.end()) {
+        _lru.erase(it->second);
+        _items.erase(it);
+    }
+    if (dir != "/") dir += '/';
+    it = _items.lower_bound(dir);
+    while (it != _items.end() && it->first.compare(0, dir.size(), dir) == 0) {
+        _lru.erase(it->second);
+        it = _items.erase(it);
+    }
+}
+
+size_t
+DirExistsCache::count() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _items.size();
+}
+
+uint64_t
+DirExistsCache::hits() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _hits;
+}
+
+uint64_t
+DirExistsCache::misses() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _misses;
+}
+
+} // namespace noobaa
@@ -0,0 +1,156 @@
+/* Copyright (C) 2016 NooBaa */
+#pragma once
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+namespace noobaa
+{
+
+/**
+ * DirListing is an immutable sorted listing of a directory.
+ *
+ * The names are kept back to back in a single arena string with an offsets array,
+ * instead of an object per entry, so that large directories take a couple of allocations
+ * and nothing on the JS heap. The sort order is the same as JS string comparison
+ * (utf-16 code units) so that markers compared in JS agree with the native search.
+ */
+class DirListing
+{
+public:
+    struct Entry
+    {
+        std::string name;
+        uint8_t type;
+    };
+
+    DirListing(const struct stat& st, std::vector<Entry>& entries);
+
+    dev_t dev() const { return _dev; }
+    ino_t ino() const { return _ino; }
+    bool same_stat(const struct stat& st) const;
+
+    size_t count() const { return _types.size(); }
+    std::string_view name(size_t i) const
+    {
+        return std::string_view(_names.data() + _offsets[i], _offsets[i + 1] - _offsets[i]);
+    }
+    uint8_t type(size_t i) const { return _types[i]; }
+
+    // index of the first name > marker
+    size_t upper_bound(std::string_view marker) const;
+    // index of the first name >= prefix
+    size_t lower_bound(std::string_view prefix) const;
+
+    // memory used by the listing, accounted against the cache max size
+    size_t usage() const { return _usage; }
+
+    // compares utf-8 names in js (utf-16) order
+    static int compare_names(std::string_view a, std::string_view b);
+
+private:
+    dev_t _dev;
+    ino_t _ino;
+    struct timespec _mtime;
+    std::string _names;
+    std::vector<uint32_t> _offsets;
+    std::vector<uint8_t> _types;
+    size_t _usage;
+};
+
+/**
+ * DirCache keeps the sorted listings of directories by path, in LRU order,
+ * up to max_total_size bytes of listings.
+ *
+ * Cached listings are valid as long as the directory (dev, ino, mtime) did not change,
+ * which is checked by the caller providing a fresh stat of the directory.
+ * Listings are handed out as shared_ptr so a listing that is evicted
+ * while a caller is paging over it stays valid until released.
+ */
+class DirCache
+{
+public:
+    explicit DirCache(size_t max_total_size)
+        : _max_total_size(max_total_size)
+        , _total_size(0)
+    {
+    }
+
+    // returns the cached listing if it matches the stat, otherwise drops it and returns null
+    std::shared_ptr<const DirListing> get(const std::string& path, const struct stat& st);
+
+    // inserts the listing for path and evicts least recently used listings over max_total_size
+    void put(const std::string& path, std::shared_ptr<const DirListing> listing);
+
+    void invalidate(const std::string& path);
+
+    size_t total_size() const;
+    size_t count() const;
+
+private:
+    struct Item
+    {
+        std::shared_ptr<const DirListing> listing;
+        std::list<std::string>::iterator lru_it;
+    };
+
+    void _remove(std::unordered_map<std::string, Item>::iterator it);
+
+    const size_t _max_total_size;
+    size_t _total_size;
+    std::unordered_map<std::string, Item> _items;
+    // most recently used at the front
+    std::list<std::string> _lru;
+    mutable std::mutex _mutex;
+};
+
+/**
+ * DirExistsCache remembers absolute paths of directories that mkdirp recently created
+ * or found existing, in LRU order up to max_count paths, so that creating the parents
+ * of nested keys usually costs no syscalls.
+ *
+ * Paths are dropped with all their descendants on rmdir/rename through this process.
+ * Directories removed by other processes are not noticed, so callers that get ENOENT
+ * under a cached path should retry mkdirp without the cache, which drops the stale paths.
+ */
+class DirExistsCache
+{
+public:
+    explicit DirExistsCache(size_t max_count)
+        : _max_count(max_count)
+        , _hits(0)
+        , _misses(0)
+    {
+    }
+
+    bool contains(const std::string& path);
+    void add(const std::string& path);
+
+    // drops the path and every cached path under it
+    void invalidate_tree(const std::string& path);
+
+    size_t count() const;
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+private:
+    const size_t _max_count;
+    uint64_t _hits;
+    uint64_t _misses;
+    // ordered so that the paths under a dir are a contiguous range
+    std::map<std::string, std::list<std::string>::iterator> _items;
+    // most recently used at the front
+    std::list<std::string> _lru;
+    mutable std::mutex _mutex;
+};
+
+} // namespace noobaa
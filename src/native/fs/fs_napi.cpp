@@ -4,6 +4,10 @@
 #include "../util/common.h"
 #include "../util/napi.h"
 #include "../util/os.h"
+#include "dir_cache.h"
+#include "fsync_coalescer.h"
+#include "lifecycle_scan.h"
+#include "remove_tree.h"
 
 // Disable pedantic warning temporarily to include GPFS headers which have zero-length arrays
 #pragma GCC diagnostic push
@@ -17,10 +21,12 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <atomic>
 #include <map>
 #include <math.h>
 #include <grp.h>
 #include <pwd.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <sys/fcntl.h>
 #include <sys/file.h>
@@ -40,6 +46,19 @@
     #include <sys/param.h>
 #else
     #include <sys/statfs.h>
+    #include <sys/sysmacros.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/openat2.h>)
+    #include <linux/openat2.h>
+    #define HAVE_OPENAT2 1
+#endif
+
+// O_PATH opens a dir only for resolving paths under it, without read permission on it
+#ifdef O_PATH
+    #define O_PATH_OR_RDONLY O_PATH
+#else
+    #define O_PATH_OR_RDONLY O_RDONLY
 #endif
 
 #ifndef __APPLE__
@@ -445,6 +464,38 @@ cmp_ver_id(int64_t link_expected_mtime, int64_t link_expected_inode, struct stat
     return link_expected_mtime == actual_mtimeNs && link_expected_inode == stat_actual_ino;
 }
 
+// renameat2 flags, mapped to renameatx_np on mac.
+// filesystems that do not support a flag fail with EINVAL, and old kernels/libc with ENOSYS.
+#if defined(__linux__) && defined(RENAME_NOREPLACE)
+    #define NB_RENAME_NOREPLACE RENAME_NOREPLACE
+    #define NB_RENAME_EXCHANGE RENAME_EXCHANGE
+#elif defined(__APPLE__) && defined(RENAME_EXCL)
+    #define NB_RENAME_NOREPLACE RENAME_EXCL
+    #define NB_RENAME_EXCHANGE RENAME_SWAP
+#else
+    #define NB_RENAME_NOREPLACE 1
+    #define NB_RENAME_EXCHANGE 2
+#endif
+
+static int
+rename_flags(const char* from, const char* to, unsigned int flags)
+{
+#if defined(__linux__) && defined(RENAME_NOREPLACE)
+    return renameat2(AT_FDCWD, from, AT_FDCWD, to, flags);
+#elif defined(__APPLE__) && defined(RENAME_EXCL)
+    return renameatx_np(AT_FDCWD, from, AT_FDCWD, to, flags);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static inline bool
+rename_flags_unsupported(int err)
+{
+    return err == EINVAL || err == ENOSYS || err == ENOTSUP;
+}
+
 static int
 get_single_user_xattr(int fd, std::string key, std::string& value)
 {
@@ -615,6 +666,99 @@ get_groups_as_string()
     return stringfy_vector(groups);
 }
 
+#ifdef HAVE_OPENAT2
+static int
+_openat2_beneath(int dirfd, const char* path, int flags, mode_t mode)
+{
+    struct open_how how;
+    memset(&how, 0, sizeof(how));
+    how.flags = flags;
+    // openat2 rejects a mode without O_CREAT/O_TMPFILE
+    if ((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE) how.mode = mode;
+    how.resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS;
+    return syscall(SYS_openat2, dirfd, path, &how, sizeof(how));
+}
+#endif
+
+/**
+ * openat2 is available since linux 5.6, but seccomp profiles of some container runtimes
+ * still deny it, so we probe it once instead of trusting the headers.
+ */
+static bool
+openat2_beneath_supported()
+{
+#ifdef HAVE_OPENAT2
+    static const bool supported = [] {
+        int fd = _openat2_beneath(AT_FDCWD, ".", O_PATH | O_DIRECTORY, 0);
+        if (fd < 0) {
+            LOG("FS::openat2_beneath_supported: openat2 unavailable, falling back to openat " << DVAL(errno));
+            return false;
+        }
+        close(fd);
+        return true;
+    }();
+    return supported;
+#else
+    return false;
+#endif
+}
+
+/**
+ * openat_beneath opens a path relative to dirfd, and fails with EXDEV if resolving it
+ * would escape dirfd - by an absolute path, a ".." above it, or a symlink pointing out of it.
+ * Without openat2 only the lexical checks are done here, and symlinks are not contained.
+ */
+static int
+openat_beneath(int dirfd, const char* path, int flags, mode_t mode = 0)
+{
+#ifdef HAVE_OPENAT2
+    if (openat2_beneath_supported()) return _openat2_beneath(dirfd, path, flags, mode);
+#endif
+    int depth = 0;
+    const char* p = path;
+    if (*p == '/') {
+        errno = EXDEV;
+        return -1;
+    }
+    while (*p) {
+        const char* end = strchr(p, '/');
+        if (!end) end = p + strlen(p);
+        const size_t len = end - p;
+        if (len == 2 && p[0] == '.' && p[1] == '.') {
+            if (--depth < 0) {
+                errno = EXDEV;
+                return -1;
+            }
+        } else if (len > 0 && !(len == 1 && p[0] == '.')) {
+            depth++;
+        }
+        p = *end ? end + 1 : end;
+    }
+    return openat(dirfd, path, flags, mode);
+}
+
+/**
+ * AtPath is a path resolved for the *at syscalls (mkdirat, unlinkat, renameat...).
+ * For a path under a BucketRoot the parent dir is opened beneath the root and the
+ * syscall is applied to the last component, otherwise it is the path as is.
+ */
+struct AtPath
+{
+    int dirfd = AT_FDCWD;
+    std::string name;
+    int _parent_fd = -1;
+    AtPath() {}
+    AtPath(const AtPath&) = delete;
+    AtPath& operator=(const AtPath&) = delete;
+    ~AtPath()
+    {
+        if (_parent_fd >= 0) close(_parent_fd);
+    }
+};
+
+struct BucketRootWrap;
+static void bucket_root_op_done(BucketRootWrap* root);
+
 /**
  * FSWorker is a general async worker for our fs operations
  */
@@ -646,6 +790,12 @@ struct FSWorker : public Napi::AsyncWorker
 
     bool _use_dmapi;
 
+    // set by BucketRootWrap for ops on paths relative to the bucket root (see openat_beneath)
+    bool _beneath;
+    int _root_fd;
+    std::string _root_path;
+    BucketRootWrap* _root_wrap;
+
     FSWorker(const Napi::CallbackInfo& info)
         : AsyncWorker(info.Env())
         , _deferred(Napi::Promise::Deferred::New(info.Env()))
@@ -660,6 +810,9 @@ struct FSWorker : public Napi::AsyncWorker
         , _supplemental_groups()
         , _do_ctime_check(false)
         , _use_dmapi(false)
+        , _beneath(false)
+        , _root_fd(-1)
+        , _root_wrap(nullptr)
     {
         for (int i = 0; i < (int)info.Length(); ++i) _args_ref.Set(i, info[i]);
         if (info[0].ToBoolean()) {
@@ -682,6 +835,11 @@ struct FSWorker : public Napi::AsyncWorker
             _use_dmapi = fs_context.Get("use_dmapi").ToBoolean();
         }
     }
+    ~FSWorker()
+    {
+        // runs on the main thread once the op completed, so a pending close of the root can proceed
+        if (_root_wrap) bucket_root_op_done(_root_wrap);
+    }
     void Begin(std::string desc)
     {
         _desc = desc;
@@ -739,6 +897,64 @@ struct FSWorker : public Napi::AsyncWorker
     {
         _should_add_thread_capabilities = true;
     }
+    void SetRoot(BucketRootWrap* root_wrap, int root_fd, const std::string& root_path)
+    {
+        _root_wrap = root_wrap;
+        _beneath = true;
+        _root_fd = root_fd;
+        _root_path = root_path;
+        _desc += " beneath " + root_path;
+    }
+    // the absolute path, which is what the path caches are keyed by
+    std::string full_path(const std::string& path)
+    {
+        return _beneath ? _root_path + "/" + path : path;
+    }
+    int open_path(const std::string& path, int flags, mode_t mode = 0)
+    {
+        return _beneath ? openat_beneath(_root_fd, path.c_str(), flags, mode) : open(path.c_str(), flags, mode);
+    }
+    DIR* opendir_path(const std::string& path)
+    {
+        if (!_beneath) return opendir(path.c_str());
+        int fd = open_path(path, O_RDONLY | O_DIRECTORY);
+        if (fd < 0) return NULL;
+        DIR* dir = fdopendir(fd);
+        if (!dir) {
+            int err = errno;
+            close(fd);
+            errno = err;
+        }
+        return dir;
+    }
+    // returns -1 with errno (like a syscall) if the parent cannot be opened beneath the root
+    int resolve_at(const std::string& path, AtPath& at)
+    {
+        if (!_beneath) {
+            at.name = path;
+            return 0;
+        }
+        std::string p = path;
+        while (p.size() > 1 && p.back() == '/') p.pop_back();
+        if (p[0] == '/') {
+            errno = EXDEV;
+            return -1;
+        }
+        const size_t slash = p.rfind('/');
+        at.name = slash == std::string::npos ? p : p.substr(slash + 1);
+        if (at.name.empty() || at.name == "." || at.name == "..") {
+            errno = EINVAL;
+            return -1;
+        }
+        if (slash == std::string::npos) {
+            at.dirfd = _root_fd;
+            return 0;
+        }
+        at._parent_fd = openat_beneath(_root_fd, p.substr(0, slash).c_str(), O_PATH_OR_RDONLY | O_DIRECTORY);
+        if (at._parent_fd < 0) return -1;
+        at.dirfd = at._parent_fd;
+        return 0;
+    }
     virtual void OnOK() override
     {
         DBG1("FS::FSWorker::OnOK: undefined " << _desc);
@@ -836,7 +1052,7 @@ struct Stat : public FSWorker
 #else
         if (_use_lstat) flags = O_PATH | O_NOFOLLOW;
 #endif
-        int fd = open(_path.c_str(), flags);
+        int fd = open_path(_path, flags);
         CHECK_OPEN_FD(fd);
         SYSCALL_OR_RETURN(fstat(fd, &_stat_res));
         // With O_PATH The file itself is not opened, and other file operations (e.g., fgetxattr(2) - in our case),
@@ -863,6 +1079,199 @@ struct Stat : public FSWorker
     }
 };
 
+/**
+ * Statx is a lightweight stat that fills the fields into a Float64Array given by the caller
+ * (see statx_index) instead of creating a JS object, and takes a single statx syscall -
+ * without the open of Stat, and so also without its read permission check on the file.
+ * The mask option selects the fields that must be fetched (see statx_mask), so that
+ * network filesystems can skip the rest, and dont_sync allows them to return cached attributes.
+ * Only with read_xattr it opens the file and resolves to its xattrs.
+ */
+enum StatxIndex {
+    STATX_INDEX_MASK,
+    STATX_INDEX_MODE,
+    STATX_INDEX_NLINK,
+    STATX_INDEX_UID,
+    STATX_INDEX_GID,
+    STATX_INDEX_INO,
+    STATX_INDEX_SIZE,
+    STATX_INDEX_BLOCKS,
+    STATX_INDEX_DEV,
+    STATX_INDEX_ATIME_SEC,
+    STATX_INDEX_ATIME_NSEC,
+    STATX_INDEX_MTIME_SEC,
+    STATX_INDEX_MTIME_NSEC,
+    STATX_INDEX_CTIME_SEC,
+    STATX_INDEX_CTIME_NSEC,
+    STATX_INDEX_BTIME_SEC,
+    STATX_INDEX_BTIME_NSEC,
+    STATX_INDEX_COUNT,
+};
+
+#ifndef STATX_BASIC_STATS
+// the mask bits of linux, used also where we fall back to fstatat (which returns all but btime)
+#define STATX_TYPE 0x0001U
+#define STATX_MODE 0x0002U
+#define STATX_NLINK 0x0004U
+#define STATX_UID 0x0008U
+#define STATX_GID 0x0010U
+#define STATX_ATIME 0x0020U
+#define STATX_MTIME 0x0040U
+#define STATX_CTIME 0x0080U
+#define STATX_INO 0x0100U
+#define STATX_SIZE 0x0200U
+#define STATX_BLOCKS 0x0400U
+#define STATX_BASIC_STATS 0x07ffU
+#define STATX_BTIME 0x0800U
+#define NB_STATX_FALLBACK 1
+#endif
+
+struct Statx : public FSWorker
+{
+    std::string _path;
+    double* _out;
+    unsigned int _mask;
+    bool _use_lstat;
+    bool _dont_sync;
+    bool _read_xattr;
+    XattrMap _xattr;
+    std::vector<std::string> _xattr_get_keys;
+
+    Statx(const Napi::CallbackInfo& info)
+        : FSWorker(info)
+        , _out(0)
+        , _mask(STATX_BASIC_STATS)
+        , _use_lstat(false)
+        , _dont_sync(false)
+        , _read_xattr(false)
+    {
+        _path = info[1].As<Napi::String>();
+        // the array is kept referenced by _args_ref until the worker is done
+        auto out = info[2].As<Napi::Float64Array>();
+        if (out.ElementLength() >= STATX_INDEX_COUNT) {
+            _out = out.Data();
+        } else {
+            SetError(XSTR() << "Statx: output array too short " << out.ElementLength());
+        }
+        if (info[3].ToBoolean()) {
+            Napi::Object options = info[3].As<Napi::Object>();
+            if (options.Get("mask").IsNumber()) _mask = options.Get("mask").As<Napi::Number>().Uint32Value();
+            _use_lstat = options.Get("use_lstat").ToBoolean();
+            _dont_sync = options.Get("dont_sync").ToBoolean();
+            // like Stat, a symlink itself is opened with O_PATH which cannot read xattrs
+            _read_xattr = !_use_lstat && options.Get("read_xattr").ToBoolean();
+            if (_read_xattr) load_xattr_get_keys(options, _xattr_get_keys);
+        }
+        Begin(XSTR() << "Statx " << DVAL(_path) << DVAL(_mask) << DVAL(_use_lstat) << DVAL(_dont_sync) << DVAL(_read_xattr));
+    }
+    virtual void Work()
+    {
+        if (!_out) return;
+        // xattrs need an open fd, and beneath a root the path must be resolved by openat_beneath
+        int fd = -1;
+        if (_read_xattr || _beneath) {
+            int flags = _read_xattr ? O_RDONLY : O_PATH_OR_RDONLY;
+            if (_use_lstat) flags |= O_NOFOLLOW;
+            fd = open_path(_path, flags);
+            if (fd < 0) {
+                SetSyscallError();
+                return;
+            }
+        }
+        AutoCloser closer(this, fd);
+        SYSCALL_OR_RETURN(_statx(fd));
+        if (_read_xattr) {
+            SYSCALL_OR_RETURN(get_fd_xattr(fd, _xattr, _xattr_get_keys));
+            if (use_gpfs_lib()) {
+                GPFS_FCNTL_OR_RETURN(get_fd_gpfs_xattr(fd, _xattr, gpfs_error, _use_dmapi));
+            }
+        }
+    }
+#ifndef NB_STATX_FALLBACK
+    int _statx(int fd)
+    {
+        struct statx stx;
+        int flags = _dont_sync ? AT_STATX_DONT_SYNC : AT_STATX_SYNC_AS_STAT;
+        if (fd >= 0) flags |= AT_EMPTY_PATH;
+        if (_use_lstat && fd < 0) flags |= AT_SYMLINK_NOFOLLOW;
+        int r = statx(fd >= 0 ? fd : AT_FDCWD, fd >= 0 ? "" : _path.c_str(), flags, _mask, &stx);
+        if (r) return r;
+        _out[STATX_INDEX_MASK] = stx.stx_mask;
+        _out[STATX_INDEX_MODE] = stx.stx_mode;
+        _out[STATX_INDEX_NLINK] = stx.stx_nlink;
+        _out[STATX_INDEX_UID] = stx.stx_uid;
+        _out[STATX_INDEX_GID] = stx.stx_gid;
+        _out[STATX_INDEX_INO] = stx.stx_ino;
+        _out[STATX_INDEX_SIZE] = stx.stx_size;
+        _out[STATX_INDEX_BLOCKS] = stx.stx_blocks;
+        _out[STATX_INDEX_DEV] = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+        _out[STATX_INDEX_ATIME_SEC] = stx.stx_atime.tv_sec;
+        _out[STATX_INDEX_ATIME_NSEC] = stx.stx_atime.tv_nsec;
+        _out[STATX_INDEX_MTIME_SEC] = stx.stx_mtime.tv_sec;
+        _out[STATX_INDEX_MTIME_NSEC] = stx.stx_mtime.tv_nsec;
+        _out[STATX_INDEX_CTIME_SEC] = stx.stx_ctime.tv_sec;
+        _out[STATX_INDEX_CTIME_NSEC] = stx.stx_ctime.tv_nsec;
+        _out[STATX_INDEX_BTIME_SEC] = stx.stx_btime.tv_sec;
+        _out[STATX_INDEX_BTIME_NSEC] = stx.stx_btime.tv_nsec;
+        return 0;
+    }
+#else
+    int _statx(int fd)
+    {
+        struct stat st;
+        int r = fd >= 0
+            ? fstat(fd, &st)
+            : fstatat(AT_FDCWD, _path.c_str(), &st, _use_lstat ? AT_SYMLINK_NOFOLLOW : 0);
+        if (r) return r;
+        _out[STATX_INDEX_MASK] = STATX_BASIC_STATS;
+        _out[STATX_INDEX_MODE] = st.st_mode;
+        _out[STATX_INDEX_NLINK] = st.st_nlink;
+        _out[STATX_INDEX_UID] = st.st_uid;
+        _out[STATX_INDEX_GID] = st.st_gid;
+        _out[STATX_INDEX_INO] = st.st_ino;
+        _out[STATX_INDEX_SIZE] = st.st_size;
+        _out[STATX_INDEX_BLOCKS] = st.st_blocks;
+        _out[STATX_INDEX_DEV] = st.st_dev;
+#ifdef __APPLE__
+        _out[STATX_INDEX_MASK] = STATX_BASIC_STATS | STATX_BTIME;
+        _out[STATX_INDEX_ATIME_SEC] = st.st_atimespec.tv_sec;
+        _out[STATX_INDEX_ATIME_NSEC] = st.st_atimespec.tv_nsec;
+        _out[STATX_INDEX_MTIME_SEC] = st.st_mtimespec.tv_sec;
+        _out[STATX_INDEX_MTIME_NSEC] = st.st_mtimespec.tv_nsec;
+        _out[STATX_INDEX_CTIME_SEC] = st.st_ctimespec.tv_sec;
+        _out[STATX_INDEX_CTIME_NSEC] = st.st_ctimespec.tv_nsec;
+        _out[STATX_INDEX_BTIME_SEC] = st.st_birthtimespec.tv_sec;
+        _out[STATX_INDEX_BTIME_NSEC] = st.st_birthtimespec.tv_nsec;
+#else
+        _out[STATX_INDEX_ATIME_SEC] = st.st_atim.tv_sec;
+        _out[STATX_INDEX_ATIME_NSEC] = st.st_atim.tv_nsec;
+        _out[STATX_INDEX_MTIME_SEC] = st.st_mtim.tv_sec;
+        _out[STATX_INDEX_MTIME_NSEC] = st.st_mtim.tv_nsec;
+        _out[STATX_INDEX_CTIME_SEC] = st.st_ctim.tv_sec;
+        _out[STATX_INDEX_CTIME_NSEC] = st.st_ctim.tv_nsec;
+        _out[STATX_INDEX_BTIME_SEC] = 0;
+        _out[STATX_INDEX_BTIME_NSEC] = 0;
+#endif
+        return 0;
+    }
+#endif
+    virtual void OnOK()
+    {
+        DBG1("FS::Statx::OnOK: " << DVAL(_path));
+        Napi::Env env = Env();
+        if (_read_xattr) {
+            auto xattr = Napi::Object::New(env);
+            for (auto it = _xattr.begin(); it != _xattr.end(); ++it) {
+                xattr.Set(it->first, it->second);
+            }
+            _deferred.Resolve(xattr);
+        } else {
+            _deferred.Resolve(env.Undefined());
+        }
+        ReportWorkerStats(0);
+    }
+};
+
 /**
  * Statfs is an fs op
  */
@@ -907,7 +1316,7 @@ struct CheckAccess : public FSWorker
     }
     virtual void Work()
     {
-        int fd = open(_path.c_str(), O_RDONLY);
+        int fd = open_path(_path, O_RDONLY);
         CHECK_OPEN_FD(fd);
     }
 };
@@ -926,7 +1335,9 @@ struct Unlink : public FSWorker
     }
     virtual void Work()
     {
-        SYSCALL_OR_RETURN(unlink(_path.c_str()));
+        AtPath at;
+        SYSCALL_OR_RETURN(resolve_at(_path, at));
+        SYSCALL_OR_RETURN(unlinkat(at.dirfd, at.name.c_str(), 0));
     }
 };
 
@@ -1023,6 +1434,10 @@ struct Symlink : public FSWorker
     }
 };
 
+// paths verified by mkdirp, shared by all the fs contexts (see DirExistsCache)
+const size_t MKDIRP_CACHE_MAX_COUNT = 64 * 1024;
+static DirExistsCache g_mkdirp_cache(MKDIRP_CACHE_MAX_COUNT);
+
 /**
  * Mkdir is an fs op
  */
@@ -1042,107 +1457,599 @@ struct Mkdir : public FSWorker
     }
     virtual void Work()
     {
-        SYSCALL_OR_RETURN(mkdir(_path.c_str(), _mode));
+        AtPath at;
+        SYSCALL_OR_RETURN(resolve_at(_path, at));
+        SYSCALL_OR_RETURN(mkdirat(at.dirfd, at.name.c_str(), _mode));
     }
 };
 
 /**
- * Rmdir is an fs op
+ * Mkdirp is an fs op that creates a directory and its missing parents (like mkdir -p)
+ * and resolves to the number of directories it created.
+ *
+ * The leaf is tried first, since the parents usually exist, and we walk back
+ * only while mkdir fails with ENOENT, and then create the missing dirs forward.
+ * With fsync it syncs the created dirs and the parent of the first one.
+ * With use_cache a path that was verified before (keyed by its absolute path,
+ * also when it is relative to a BucketRoot) takes no syscalls -
+ * the permission checks are then left to the following open under that path.
  */
-struct Rmdir : public FSWorker
+struct Mkdirp : public FSWorker
 {
     std::string _path;
-    Rmdir(const Napi::CallbackInfo& info)
+    int _mode;
+    bool _fsync;
+    bool _use_cache;
+    int _created;
+    Mkdirp(const Napi::CallbackInfo& info)
         : FSWorker(info)
+        , _mode(0777)
+        , _fsync(false)
+        , _use_cache(false)
+        , _created(0)
     {
         _path = info[1].As<Napi::String>();
-        Begin(XSTR() << "Rmdir " << DVAL(_path));
+        if (info.Length() > 2 && !info[2].IsUndefined()) {
+            _mode = info[2].As<Napi::Number>().Uint32Value();
+        }
+        if (info.Length() > 3 && info[3].IsObject()) {
+            auto options = info[3].As<Napi::Object>();
+            _fsync = options.Get("fsync").ToBoolean();
+            _use_cache = options.Get("use_cache").ToBoolean();
+        }
+        while (_path.size() > 1 && _path.back() == '/') _path.pop_back();
+        Begin(XSTR() << "Mkdirp " << DVAL(_path) << DVAL(_mode) << DVAL(_fsync) << DVAL(_use_cache));
     }
     virtual void Work()
     {
-        SYSCALL_OR_RETURN(rmdir(_path.c_str()));
+        if (_path.empty()) {
+            errno = ENOENT;
+            SetSyscallError();
+            return;
+        }
+        const bool cacheable = _use_cache && full_path(_path)[0] == '/';
+        if (cacheable && g_mkdirp_cache.contains(full_path(_path))) return;
+
+        // lengths of the path prefixes that are missing, from the leaf up
+        std::vector<size_t> missing;
+        size_t len = _path.size();
+        bool created_first = false;
+        for (;;) {
+            const std::string dir = _path.substr(0, len);
+            if (_mkdir(dir) == 0) {
+                created_first = true;
+                break;
+            }
+            if (errno == EEXIST || errno == EISDIR) break;
+            if (errno != ENOENT) {
+                SetSyscallError();
+                return;
+            }
+            // a cached parent that was removed by another process
+            if (cacheable) g_mkdirp_cache.invalidate_tree(full_path(dir));
+            missing.push_back(len);
+            const size_t slash = len > 1 ? _path.rfind('/', len - 1) : std::string::npos;
+            if (slash == std::string::npos || slash == 0) {
+                errno = ENOENT;
+                SetSyscallError();
+                return;
+            }
+            len = slash;
+        }
+
+        if (missing.empty() && !created_first) {
+            // the leaf exists - make sure it is a dir before caching it
+            if (cacheable) {
+                struct stat st;
+                int fd = open_path(_path, O_PATH_OR_RDONLY);
+                CHECK_OPEN_FD(fd);
+                SYSCALL_OR_RETURN(fstat(fd, &st));
+                if (!S_ISDIR(st.st_mode)) {
+                    errno = ENOTDIR;
+                    SetSyscallError();
+                    return;
+                }
+                g_mkdirp_cache.add(full_path(_path));
+            }
+            return;
+        }
+
+        // the first dir that was created, either by the walk back or the first forward mkdir
+        const size_t first_len = created_first ? len : missing.back();
+        if (created_first) _created++;
+        for (auto it = missing.rbegin(); it != missing.rend(); ++it) {
+            const std::string dir = _path.substr(0, *it);
+            if (_mkdir(dir) == 0) {
+                _created++;
+            } else if (errno != EEXIST) { // EEXIST when racing with another mkdirp
+                SetSyscallError();
+                return;
+            }
+        }
+
+        if (_fsync) {
+            const size_t parent_len = _path.rfind('/', first_len - 1);
+            if (parent_len != std::string::npos) {
+                if (!_fsync_dir(_path.substr(0, parent_len ? parent_len : 1))) return;
+            } else if (_beneath) {
+                if (!_fsync_dir(".")) return;
+            }
+            if (!_fsync_dir(_path.substr(0, first_len))) return;
+            for (auto it = missing.rbegin(); it != missing.rend(); ++it) {
+                if (*it != first_len && !_fsync_dir(_path.substr(0, *it))) return;
+            }
+        }
+
+        if (cacheable) g_mkdirp_cache.add(full_path(_path));
+    }
+    int _mkdir(const std::string& dir)
+    {
+        AtPath at;
+        if (resolve_at(dir, at)) return -1;
+        return mkdirat(at.dirfd, at.name.c_str(), _mode);
+    }
+    bool _fsync_dir(const std::string& dir)
+    {
+        int fd = open_path(dir, O_RDONLY | O_DIRECTORY);
+        if (fd < 0) {
+            SetSyscallError();
+            return false;
+        }
+        const int r = fsync(fd);
+        if (r) SetSyscallError();
+        close(fd);
+        return r == 0;
+    }
+    virtual void OnOK()
+    {
+        DBG1("FS::Mkdirp::OnOK: " << DVAL(_path) << DVAL(_created));
+        _deferred.Resolve(Napi::Number::New(Env(), _created));
+        ReportWorkerStats(0);
     }
 };
 
 /**
- * SafeLink is an fs op
- * 1. link
- * 2. check if the target has the expected version
- *   2.1. if yes - return
- *   2.2. else - unlink and retry
+ * Rmdir is an fs op
  */
-struct SafeLink : public FSWorker
+struct Rmdir : public FSWorker
 {
-    std::string _link_from;
-    std::string _link_to;
-    int64_t _link_expected_mtime;
-    int64_t _link_expected_inode;
-    SafeLink(const Napi::CallbackInfo& info)
+    std::string _path;
+    Rmdir(const Napi::CallbackInfo& info)
         : FSWorker(info)
     {
-        _link_from = info[1].As<Napi::String>();
-        _link_to = info[2].As<Napi::String>();
-        // TODO: handle lossless
-        bool lossless = true;
-        _link_expected_mtime = info[3].As<Napi::BigInt>().Int64Value(&lossless);
-        _link_expected_inode = info[4].As<Napi::Number>().Int64Value();
-        Begin(XSTR() << "SafeLink " << DVAL(_link_from.c_str()) << DVAL(_link_to.c_str()) << DVAL(_link_expected_mtime) << DVAL(_link_expected_inode));
+        _path = info[1].As<Napi::String>();
+        Begin(XSTR() << "Rmdir " << DVAL(_path));
     }
     virtual void Work()
     {
-        SYSCALL_OR_RETURN(link(_link_from.c_str(), _link_to.c_str()));
-        struct stat _stat_res;
-        SYSCALL_OR_RETURN(stat(_link_to.c_str(), &_stat_res));
-        if (cmp_ver_id(_link_expected_mtime, _link_expected_inode, _stat_res) == true) return;
-        SYSCALL_OR_RETURN(unlink(_link_to.c_str()));
-        DBG0("FS::SafeLink::Execute: ERROR link target doesn't match the expected inode + mtime" << DVAL(_link_to)
-                                                                                                 << DVAL(_link_expected_mtime) << DVAL(_link_expected_inode));
-        SetError(XSTR() << "FS::SafeLink ERROR link target doesn't match expected inode and mtime");
+        AtPath at;
+        SYSCALL_OR_RETURN(resolve_at(_path, at));
+        SYSCALL_OR_RETURN(unlinkat(at.dirfd, at.name.c_str(), AT_REMOVEDIR));
+        g_mkdirp_cache.invalidate_tree(full_path(_path));
     }
 };
 
+enum RemoveTreeIndex {
+    REMOVE_TREE_INDEX_FILES,
+    REMOVE_TREE_INDEX_DIRS,
+    REMOVE_TREE_INDEX_CANCEL,
+    REMOVE_TREE_INDEX_COUNT,
+};
+
 /**
- * SafeUnlink is an fs op
- *  1. mv to tmp file
- *  2. check if the tmp file has the expected inode + mtime
- *   2.1. if yes - unlink
- *   2.2. else - mv back to source path and retry
+ * RemoveTree is an fs op that deletes a directory tree with a bounded number of threads (see TreeRemover).
+ * The optional progress Float64Array (see remove_tree_index) is updated with the files and dirs removed so far,
+ * and setting its cancel index to non zero stops the removal with ECANCELED.
  */
-struct SafeUnlink : public FSWorker
+struct RemoveTree : public FSWorker
 {
-    std::string _to_unlink;
-    std::string _mv_to;
-    int64_t _unlink_expected_mtime;
-    int64_t _unlink_expected_inode;
-    SafeUnlink(const Napi::CallbackInfo& info)
+    std::string _path;
+    int _concurrency;
+    double* _progress;
+    uint64_t _files;
+    uint64_t _dirs;
+    RemoveTree(const Napi::CallbackInfo& info)
         : FSWorker(info)
+        , _concurrency(1)
+        , _progress(0)
+        , _files(0)
+        , _dirs(0)
     {
-        _to_unlink = info[1].As<Napi::String>();
-        _mv_to = info[2].As<Napi::String>();
-        if (info.Length() > 4 && !info[3].IsUndefined() && !info[4].IsUndefined()) {
-            // TODO: handle lossless
-            bool lossless = true;
-            _unlink_expected_mtime = info[3].As<Napi::BigInt>().Int64Value(&lossless);
-            _unlink_expected_inode = info[4].As<Napi::Number>().Int64Value();
+        _path = info[1].As<Napi::String>();
+        if (info[2].ToBoolean()) {
+            Napi::Object options = info[2].As<Napi::Object>();
+            if (options.Get("concurrency").IsNumber()) {
+                _concurrency = options.Get("concurrency").As<Napi::Number>().Int32Value();
+            }
+            if (options.Get("progress").IsTypedArray()) {
+                auto progress = options.Get("progress").As<Napi::Float64Array>();
+                if (progress.ElementLength() >= REMOVE_TREE_INDEX_COUNT) {
+                    // keep the array referenced by _args_ref until the worker is done
+                    _args_ref.Set("progress", progress);
+                    _progress = progress.Data();
+                } else {
+                    SetError(XSTR() << "RemoveTree: progress array too short " << progress.ElementLength());
+                }
+            }
         }
-        Begin(XSTR() << "SafeUnlink " << DVAL(_to_unlink) << DVAL(_mv_to) << DVAL(_unlink_expected_mtime) << DVAL(_unlink_expected_inode));
+        Begin(XSTR() << "RemoveTree " << DVAL(_path) << DVAL(_concurrency));
     }
     virtual void Work()
     {
-        SYSCALL_OR_RETURN(rename(_to_unlink.c_str(), _mv_to.c_str()));
-        struct stat _stat_res;
-        SYSCALL_OR_RETURN(stat(_mv_to.c_str(), &_stat_res));
-        if (cmp_ver_id(_unlink_expected_mtime, _unlink_expected_inode, _stat_res) == true) {
-            SYSCALL_OR_RETURN(unlink(_mv_to.c_str()));
-            return;
+        TreeRemover remover(_uid, _gid, _supplemental_groups, _concurrency);
+        if (_progress) {
+            double* progress = _progress;
+            remover.on_progress = [progress](uint64_t files, uint64_t dirs) {
+                double cancel;
+                __atomic_load(&progress[REMOVE_TREE_INDEX_CANCEL], &cancel, __ATOMIC_RELAXED);
+                double val = files;
+                __atomic_store(&progress[REMOVE_TREE_INDEX_FILES], &val, __ATOMIC_RELAXED);
+                val = dirs;
+                __atomic_store(&progress[REMOVE_TREE_INDEX_DIRS], &val, __ATOMIC_RELAXED);
+                return cancel == 0;
+            };
+        }
+        int err = remover.run(_path);
+        _files = remover.files();
+        _dirs = remover.dirs();
+        if (_progress) {
+            _progress[REMOVE_TREE_INDEX_FILES] = _files;
+            _progress[REMOVE_TREE_INDEX_DIRS] = _dirs;
+        }
+        if (err) {
+            errno = err;
+            SetSyscallError();
         }
-        SYSCALL_OR_RETURN(link(_mv_to.c_str(), _to_unlink.c_str()));
-        DBG0("FS::SafeUnlink::Execute: ERROR unlink target doesn't match the expected inode + mtime, retry"
-            << DVAL(_to_unlink) << DVAL(_unlink_expected_mtime) << DVAL(_unlink_expected_inode));
-        SetError(XSTR() << "FS::SafeUnlink ERROR unlink target doesn't match expected inode and mtime");
     }
-};
-
+    virtual void OnOK()
+    {
+        DBG1("FS::RemoveTree::OnOK: " << DVAL(_path) << DVAL(_files) << DVAL(_dirs));
+        Napi::Env env = Env();
+        auto res = Napi::Object::New(env);
+        res["files"] = Napi::Number::New(env, _files);
+        res["dirs"] = Napi::Number::New(env, _dirs);
+        _deferred.Resolve(res);
+        ReportWorkerStats(0);
+    }
+};
+
+/**
+ * LifecycleScan is an fs op that writes the expiration candidates of lifecycle rules in a bucket directory
+ * to a candidates file per rule, with a bounded number of threads (see LifecycleScanner).
+ */
+struct LifecycleScan : public FSWorker
+{
+    std::string _bucket_path;
+    std::vector<std::string> _candidates_paths;
+    int _mode;
+    std::unique_ptr<LifecycleScanner> _scanner;
+    LifecycleScan(const Napi::CallbackInfo& info)
+        : FSWorker(info)
+        , _mode(0600)
+    {
+        _bucket_path = info[1].As<Napi::String>();
+        auto rules = info[2].As<Napi::Array>();
+        int concurrency = 1;
+        int64_t now_ms = 0;
+        std::string exclude_root_prefix;
+        if (info[3].ToBoolean()) {
+            Napi::Object options = info[3].As<Napi::Object>();
+            if (options.Get("concurrency").IsNumber()) {
+                concurrency = options.Get("concurrency").As<Napi::Number>().Int32Value();
+            }
+            if (options.Get("now").IsNumber()) now_ms = options.Get("now").As<Napi::Number>().Int64Value();
+            if (options.Get("mode").IsNumber()) _mode = options.Get("mode").As<Napi::Number>().Int32Value();
+            if (options.Get("exclude_root_prefix").IsString()) {
+                exclude_root_prefix = options.Get("exclude_root_prefix").As<Napi::String>();
+            }
+        }
+        _scanner.reset(new LifecycleScanner(_uid, _gid, _supplemental_groups, concurrency));
+        _scanner->now_ms = now_ms;
+        _scanner->exclude_root_prefix = exclude_root_prefix;
+        for (uint32_t i = 0; i < rules.Length(); ++i) {
+            Napi::Object r = rules.Get(i).As<Napi::Object>();
+            std::unique_ptr<LifecycleScanner::Rule> rule(new LifecycleScanner::Rule());
+            _candidates_paths.push_back(r.Get("candidates_path").As<Napi::String>());
+            if (r.Get("prefix").IsString()) rule->prefix = r.Get("prefix").As<Napi::String>();
+            if (r.Get("days").IsNumber()) rule->days = r.Get("days").As<Napi::Number>().Int64Value();
+            if (r.Get("size_greater_than").IsNumber()) {
+                rule->size_greater_than = r.Get("size_greater_than").As<Napi::Number>().Int64Value();
+            }
+            if (r.Get("size_less_than").IsNumber()) {
+                rule->size_less_than = r.Get("size_less_than").As<Napi::Number>().Int64Value();
+            }
+            if (r.Get("tags").IsArray()) {
+                auto tags = r.Get("tags").As<Napi::Array>();
+                for (uint32_t j = 0; j < tags.Length(); ++j) {
+                    Napi::Object tag = tags.Get(j).As<Napi::Object>();
+                    rule->tags.push_back({ tag.Get("key").ToString(), tag.Get("value").ToString() });
+                }
+            }
+            _scanner->rules.push_back(std::move(rule));
+        }
+        Begin(XSTR() << "LifecycleScan " << DVAL(_bucket_path) << DVAL(rules.Length()) << DVAL(concurrency));
+    }
+    virtual void Work()
+    {
+        auto& rules = _scanner->rules;
+        for (size_t i = 0; i < rules.size(); ++i) {
+            rules[i]->fd = open(_candidates_paths[i].c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, _mode);
+            if (rules[i]->fd < 0) {
+                SetSyscallError();
+                break;
+            }
+        }
+        if (!_errno) {
+            int err = _scanner->run(_bucket_path);
+            if (err) {
+                errno = err;
+                SetSyscallError();
+            }
+        }
+        for (auto& rule : rules) {
+            if (rule->fd >= 0 && close(rule->fd)) SetSyscallError();
+            rule->fd = -1;
+        }
+    }
+    virtual void OnOK()
+    {
+        DBG1("FS::LifecycleScan::OnOK: " << DVAL(_bucket_path) << DVAL(_scanner->files()) << DVAL(_scanner->dirs()));
+        Napi::Env env = Env();
+        auto res = Napi::Object::New(env);
+        auto candidates = Napi::Array::New(env, _scanner->rules.size());
+        for (size_t i = 0; i < _scanner->rules.size(); ++i) {
+            candidates.Set(i, Napi::Number::New(env, _scanner->rules[i]->candidates));
+        }
+        res["files"] = Napi::Number::New(env, _scanner->files());
+        res["dirs"] = Napi::Number::New(env, _scanner->dirs());
+        res["skipped"] = Napi::Number::New(env, _scanner->skipped());
+        res["candidates"] = candidates;
+        _deferred.Resolve(res);
+        ReportWorkerStats(0);
+    }
+};
+
+/**
+ * SafeLink is an fs op
+ * 1. link
+ * 2. check if the target has the expected version
+ *   2.1. if yes - return
+ *   2.2. else - unlink and retry
+ */
+struct SafeLink : public FSWorker
+{
+    std::string _link_from;
+    std::string _link_to;
+    int64_t _link_expected_mtime;
+    int64_t _link_expected_inode;
+    SafeLink(const Napi::CallbackInfo& info)
+        : FSWorker(info)
+    {
+        _link_from = info[1].As<Napi::String>();
+        _link_to = info[2].As<Napi::String>();
+        // TODO: handle lossless
+        bool lossless = true;
+        _link_expected_mtime = info[3].As<Napi::BigInt>().Int64Value(&lossless);
+        _link_expected_inode = info[4].As<Napi::Number>().Int64Value();
+        Begin(XSTR() << "SafeLink " << DVAL(_link_from.c_str()) << DVAL(_link_to.c_str()) << DVAL(_link_expected_mtime) << DVAL(_link_expected_inode));
+    }
+    virtual void Work()
+    {
+        SYSCALL_OR_RETURN(link(_link_from.c_str(), _link_to.c_str()));
+        struct stat _stat_res;
+        SYSCALL_OR_RETURN(stat(_link_to.c_str(), &_stat_res));
+        if (cmp_ver_id(_link_expected_mtime, _link_expected_inode, _stat_res) == true) return;
+        SYSCALL_OR_RETURN(unlink(_link_to.c_str()));
+        DBG0("FS::SafeLink::Execute: ERROR link target doesn't match the expected inode + mtime" << DVAL(_link_to)
+                                                                                                 << DVAL(_link_expected_mtime) << DVAL(_link_expected_inode));
+        SetError(XSTR() << "FS::SafeLink ERROR link target doesn't match expected inode and mtime");
+    }
+};
+
+/**
+ * SafeUnlink is an fs op
+ *  1. mv to tmp file
+ *  2. check if the tmp file has the expected inode + mtime
+ *   2.1. if yes - unlink
+ *   2.2. else - mv back to source path and retry
+ */
+struct SafeUnlink : public FSWorker
+{
+    std::string _to_unlink;
+    std::string _mv_to;
+    int64_t _unlink_expected_mtime;
+    int64_t _unlink_expected_inode;
+    SafeUnlink(const Napi::CallbackInfo& info)
+        : FSWorker(info)
+    {
+        _to_unlink = info[1].As<Napi::String>();
+        _mv_to = info[2].As<Napi::String>();
+        if (info.Length() > 4 && !info[3].IsUndefined() && !info[4].IsUndefined()) {
+            // TODO: handle lossless
+            bool lossless = true;
+            _unlink_expected_mtime = info[3].As<Napi::BigInt>().Int64Value(&lossless);
+            _unlink_expected_inode = info[4].As<Napi::Number>().Int64Value();
+        }
+        Begin(XSTR() << "SafeUnlink " << DVAL(_to_unlink) << DVAL(_mv_to) << DVAL(_unlink_expected_mtime) << DVAL(_unlink_expected_inode));
+    }
+    virtual void Work()
+    {
+        SYSCALL_OR_RETURN(rename(_to_unlink.c_str(), _mv_to.c_str()));
+        struct stat _stat_res;
+        SYSCALL_OR_RETURN(stat(_mv_to.c_str(), &_stat_res));
+        if (cmp_ver_id(_unlink_expected_mtime, _unlink_expected_inode, _stat_res) == true) {
+            SYSCALL_OR_RETURN(unlink(_mv_to.c_str()));
+            return;
+        }
+        SYSCALL_OR_RETURN(link(_mv_to.c_str(), _to_unlink.c_str()));
+        DBG0("FS::SafeUnlink::Execute: ERROR unlink target doesn't match the expected inode + mtime, retry"
+            << DVAL(_to_unlink) << DVAL(_unlink_expected_mtime) << DVAL(_unlink_expected_inode));
+        SetError(XSTR() << "FS::SafeUnlink ERROR unlink target doesn't match expected inode and mtime");
+    }
+};
+
+static std::atomic<uint64_t> g_safe_move_tmp_seq{ 0 };
+
+/**
+ * SafeMove is an fs op that moves a version to a path that must not exist
+ * 1. rename with RENAME_NOREPLACE
+ * 2. check if the target has the expected version
+ *   2.1. if yes - return
+ *   2.2. else - rename back and retry
+ * When the filesystem does not support RENAME_NOREPLACE (EINVAL) it falls back
+ * to the SafeLink + SafeUnlink sequence in the same worker, using tmp_dir/lost+found.
+ */
+struct SafeMove : public FSWorker
+{
+    std::string _from;
+    std::string _to;
+    std::string _tmp_dir;
+    int64_t _expected_mtime;
+    int64_t _expected_inode;
+    SafeMove(const Napi::CallbackInfo& info)
+        : FSWorker(info)
+    {
+        _from = info[1].As<Napi::String>();
+        _to = info[2].As<Napi::String>();
+        // TODO: handle lossless
+        bool lossless = true;
+        _expected_mtime = info[3].As<Napi::BigInt>().Int64Value(&lossless);
+        _expected_inode = info[4].As<Napi::Number>().Int64Value();
+        if (info.Length() > 5 && info[5].IsString()) {
+            _tmp_dir = info[5].As<Napi::String>();
+        }
+        Begin(XSTR() << "SafeMove " << DVAL(_from) << DVAL(_to) << DVAL(_expected_mtime) << DVAL(_expected_inode));
+    }
+    virtual void Work()
+    {
+        if (rename_flags(_from.c_str(), _to.c_str(), NB_RENAME_NOREPLACE) == 0) {
+            struct stat _stat_res;
+            SYSCALL_OR_RETURN(stat(_to.c_str(), &_stat_res));
+            if (cmp_ver_id(_expected_mtime, _expected_inode, _stat_res) == true) return;
+            // we moved another version, put it back and let the caller retry
+            if (rename_flags(_to.c_str(), _from.c_str(), NB_RENAME_NOREPLACE) != 0) {
+                if (errno != EEXIST) {
+                    SetSyscallError();
+                    return;
+                }
+                // the source was recreated meanwhile so the version we moved cannot go back.
+                // it is a committed version of another writer, so leave it visible at the target
+                // and fail without a retry, since a retry would only find the target taken.
+                DBG0("FS::SafeMove::Execute: ERROR source was recreated, the moved version is left at the target"
+                    << DVAL(_from) << DVAL(_to) << DVAL(_stat_res.st_ino));
+                SetError(XSTR() << "FS::SafeMove ERROR source was recreated, moved version left at the target " << DVAL(_to));
+                return;
+            }
+            DBG0("FS::SafeMove::Execute: ERROR move source doesn't match the expected inode + mtime"
+                << DVAL(_from) << DVAL(_expected_mtime) << DVAL(_expected_inode));
+            SetError(XSTR() << "FS::SafeMove ERROR move source doesn't match expected inode and mtime");
+            return;
+        }
+        if (!rename_flags_unsupported(errno)) {
+            SetSyscallError();
+            return;
+        }
+        DBG1("FS::SafeMove::Execute: rename flags not supported, fallback to link + unlink" << DVAL(_from) << DVAL(_to));
+        _link_unlink();
+    }
+    void _link_unlink()
+    {
+        struct stat _stat_res;
+        SYSCALL_OR_RETURN(link(_from.c_str(), _to.c_str()));
+        SYSCALL_OR_RETURN(stat(_to.c_str(), &_stat_res));
+        if (cmp_ver_id(_expected_mtime, _expected_inode, _stat_res) == false) {
+            SYSCALL_OR_RETURN(unlink(_to.c_str()));
+            DBG0("FS::SafeMove::Execute: ERROR link target doesn't match the expected inode + mtime"
+                << DVAL(_to) << DVAL(_expected_mtime) << DVAL(_expected_inode));
+            SetError(XSTR() << "FS::SafeMove ERROR move source doesn't match expected inode and mtime");
+            return;
+        }
+        if (_tmp_dir.empty()) {
+            SetError(XSTR() << "FS::SafeMove ERROR tmp_dir is required to unlink the source " << DVAL(_from));
+            return;
+        }
+        // the target is in place, now unlink the source only if it is still the same version
+        std::string mv_to;
+        if (_rename_to_lost_found(_from, mv_to) != 0) {
+            // source already deleted
+            if (errno == ENOENT) return;
+            SetSyscallError();
+            return;
+        }
+        SYSCALL_OR_RETURN(stat(mv_to.c_str(), &_stat_res));
+        if (cmp_ver_id(_expected_mtime, _expected_inode, _stat_res) == true) {
+            SYSCALL_OR_RETURN(unlink(mv_to.c_str()));
+            return;
+        }
+        SYSCALL_OR_RETURN(link(mv_to.c_str(), _from.c_str()));
+        // the version is linked back at the source, so its name in lost+found is not needed
+        if (unlink(mv_to.c_str()) != 0) {
+            DBG0("FS::SafeMove::Execute: failed to unlink the lost+found link" << DVAL(mv_to) << DVAL(errno));
+        }
+        DBG0("FS::SafeMove::Execute: ERROR unlink target doesn't match the expected inode + mtime, retry"
+            << DVAL(_from) << DVAL(_expected_mtime) << DVAL(_expected_inode));
+        SetError(XSTR() << "FS::SafeUnlink ERROR unlink target doesn't match expected inode and mtime");
+    }
+    // renames path to a unique name in the lost+found dir of _tmp_dir (created on demand),
+    // returns -1 with errno like a syscall, where ENOENT means that path does not exist
+    int _rename_to_lost_found(const std::string& path, std::string& mv_to)
+    {
+        const std::string lost_found = _tmp_dir + "/lost+found";
+        mv_to = XSTR() << lost_found << "/safe_move." << getpid() << "." << g_safe_move_tmp_seq++;
+        if (rename(path.c_str(), mv_to.c_str()) == 0) return 0;
+        if (errno != ENOENT) return -1;
+        if (mkdir(lost_found.c_str(), 0777) != 0 && errno != EEXIST) return -1;
+        return rename(path.c_str(), mv_to.c_str());
+    }
+};
+
+/**
+ * SafeExchange is an fs op that atomically swaps two existing paths
+ * 1. rename with RENAME_EXCHANGE
+ * 2. check that each path now holds the expected version of the other
+ *   2.1. if yes - return
+ *   2.2. else - swap back and retry
+ * There is no fallback - filesystems without RENAME_EXCHANGE fail with EINVAL.
+ */
+struct SafeExchange : public FSWorker
+{
+    std::string _path_a;
+    std::string _path_b;
+    int64_t _a_expected_mtime;
+    int64_t _a_expected_inode;
+    int64_t _b_expected_mtime;
+    int64_t _b_expected_inode;
+    SafeExchange(const Napi::CallbackInfo& info)
+        : FSWorker(info)
+    {
+        _path_a = info[1].As<Napi::String>();
+        _path_b = info[2].As<Napi::String>();
+        // TODO: handle lossless
+        bool lossless = true;
+        _a_expected_mtime = info[3].As<Napi::BigInt>().Int64Value(&lossless);
+        _a_expected_inode = info[4].As<Napi::Number>().Int64Value();
+        _b_expected_mtime = info[5].As<Napi::BigInt>().Int64Value(&lossless);
+        _b_expected_inode = info[6].As<Napi::Number>().Int64Value();
+        Begin(XSTR() << "SafeExchange " << DVAL(_path_a) << DVAL(_path_b)
+                     << DVAL(_a_expected_mtime) << DVAL(_a_expected_inode)
+                     << DVAL(_b_expected_mtime) << DVAL(_b_expected_inode));
+    }
+    virtual void Work()
+    {
+        SYSCALL_OR_RETURN(rename_flags(_path_a.c_str(), _path_b.c_str(), NB_RENAME_EXCHANGE));
+        struct stat _stat_a;
+        struct stat _stat_b;
+        SYSCALL_OR_RETURN(stat(_path_b.c_str(), &_stat_b));
+        SYSCALL_OR_RETURN(stat(_path_a.c_str(), &_stat_a));
+        if (cmp_ver_id(_a_expected_mtime, _a_expected_inode, _stat_b) == true &&
+            cmp_ver_id(_b_expected_mtime, _b_expected_inode, _stat_a) == true) return;
+        SYSCALL_OR_RETURN(rename_flags(_path_a.c_str(), _path_b.c_str(), NB_RENAME_EXCHANGE));
+        DBG0("FS::SafeExchange::Execute: ERROR exchanged paths don't match the expected inode + mtime"
+            << DVAL(_path_a) << DVAL(_path_b));
+        SetError(XSTR() << "FS::SafeExchange ERROR exchanged paths don't match expected inode and mtime");
+    }
+};
+
 /**
  * Rename is an fs op
  */
@@ -1159,7 +2066,14 @@ struct Rename : public FSWorker
     }
     virtual void Work()
     {
-        SYSCALL_OR_RETURN(rename(_old_path.c_str(), _new_path.c_str()));
+        AtPath old_at;
+        AtPath new_at;
+        SYSCALL_OR_RETURN(resolve_at(_old_path, old_at));
+        SYSCALL_OR_RETURN(resolve_at(_new_path, new_at));
+        SYSCALL_OR_RETURN(renameat(old_at.dirfd, old_at.name.c_str(), new_at.dirfd, new_at.name.c_str()));
+        // a renamed dir takes its subtree along, and may replace an empty dir
+        g_mkdirp_cache.invalidate_tree(full_path(_old_path));
+        g_mkdirp_cache.invalidate_tree(full_path(_new_path));
     }
 };
 
@@ -1206,7 +2120,7 @@ struct Writefile : public FSWorker
     }
     virtual void Work()
     {
-        int fd = open(_path.c_str(), O_TRUNC | O_CREAT | O_WRONLY, _mode);
+        int fd = open_path(_path, O_TRUNC | O_CREAT | O_WRONLY, _mode);
         CHECK_OPEN_FD(fd);
 
         ssize_t len = write(fd, _data, _len);
@@ -1266,7 +2180,7 @@ struct Readfile : public FSWorker
     }
     virtual void Work()
     {
-        int fd = open(_path.c_str(), O_RDONLY);
+        int fd = open_path(_path, O_RDONLY);
         CHECK_OPEN_FD(fd);
         SYSCALL_OR_RETURN(fstat(fd, &_stat_res));
         if (_read_xattr) {
@@ -1340,7 +2254,7 @@ struct Readdir : public FSWorker
     virtual void Work()
     {
         DIR* dir;
-        dir = opendir(_path.c_str());
+        dir = opendir_path(_path);
         if (dir == NULL) {
             SetSyscallError();
             return;
@@ -1397,23 +2311,43 @@ struct Readdir : public FSWorker
     }
 };
 
+// concurrent fsyncs of the same directory, shared by all the fs contexts (see FsyncCoalescer)
+static FsyncCoalescer g_fsync_coalescer;
+
 /**
  * Fsync is an fs op
+ * With coalesce it joins the concurrent fsyncs of the same inode into rounds of one fsync,
+ * which is meant for the parent dirs of uploads.
  */
 struct Fsync : public FSWorker
 {
     std::string _path;
+    bool _coalesce;
     Fsync(const Napi::CallbackInfo& info)
         : FSWorker(info)
+        , _coalesce(false)
     {
         _path = info[1].As<Napi::String>();
-        Begin(XSTR() << "Fsync " << DVAL(_path));
+        if (info.Length() > 2 && info[2].IsObject()) {
+            _coalesce = info[2].As<Napi::Object>().Get("coalesce").ToBoolean();
+        }
+        Begin(XSTR() << "Fsync " << DVAL(_path) << DVAL(_coalesce));
     }
     virtual void Work()
     {
-        int fd = open(_path.c_str(), 0);
+        int fd = open_path(_path, 0);
         CHECK_OPEN_FD(fd);
-        SYSCALL_OR_RETURN(fsync(fd));
+        if (!_coalesce) {
+            SYSCALL_OR_RETURN(fsync(fd));
+            return;
+        }
+        struct stat st;
+        SYSCALL_OR_RETURN(fstat(fd, &st));
+        int err = g_fsync_coalescer.sync(fd, st.st_dev, st.st_ino);
+        if (err) {
+            errno = err;
+            SetSyscallError();
+        }
     }
 };
 
@@ -1616,6 +2550,7 @@ struct FileWrap : public Napi::ObjectWrap<FileWrap>
             {
                 InstanceMethod<&FileWrap::close>("close"),
                 InstanceMethod<&FileWrap::read>("read"),
+                InstanceMethod<&FileWrap::read_lines>("read_lines"),
                 InstanceMethod<&FileWrap::write>("write"),
                 InstanceMethod<&FileWrap::writev>("writev"),
                 InstanceMethod<&FileWrap::read_rdma>("read_rdma"),
@@ -1625,6 +2560,10 @@ struct FileWrap : public Napi::ObjectWrap<FileWrap>
                 InstanceMethod<&FileWrap::unlinkfileat>("unlinkfileat"),
                 InstanceMethod<&FileWrap::stat>("stat"),
                 InstanceMethod<&FileWrap::fsync>("fsync"),
+                InstanceMethod<&FileWrap::fallocate>("fallocate"),
+                InstanceMethod<&FileWrap::truncate>("truncate"),
+                InstanceMethod<&FileWrap::sync_range>("sync_range"),
+                InstanceMethod<&FileWrap::fadvise>("fadvise"),
                 InstanceMethod<&FileWrap::flock>("flock"),
                 InstanceMethod<&FileWrap::fcntllock>("fcntllock"),
                 InstanceMethod<&FileWrap::fcntlgetlock>("fcntlgetlock"),
@@ -1648,6 +2587,7 @@ struct FileWrap : public Napi::ObjectWrap<FileWrap>
     }
     Napi::Value close(const Napi::CallbackInfo& info);
     Napi::Value read(const Napi::CallbackInfo& info);
+    Napi::Value read_lines(const Napi::CallbackInfo& info);
     Napi::Value write(const Napi::CallbackInfo& info);
     Napi::Value writev(const Napi::CallbackInfo& info);
     Napi::Value read_rdma(const Napi::CallbackInfo& info);
@@ -1657,6 +2597,10 @@ struct FileWrap : public Napi::ObjectWrap<FileWrap>
     Napi::Value unlinkfileat(const Napi::CallbackInfo& info);
     Napi::Value stat(const Napi::CallbackInfo& info);
     Napi::Value fsync(const Napi::CallbackInfo& info);
+    Napi::Value fallocate(const Napi::CallbackInfo& info);
+    Napi::Value truncate(const Napi::CallbackInfo& info);
+    Napi::Value sync_range(const Napi::CallbackInfo& info);
+    Napi::Value fadvise(const Napi::CallbackInfo& info);
     Napi::Value getfd(const Napi::CallbackInfo& info);
     Napi::Value flock(const Napi::CallbackInfo& info);
     Napi::Value fcntllock(const Napi::CallbackInfo& info);
@@ -1689,7 +2633,7 @@ struct FileOpen : public FSWorker
     }
     virtual void Work()
     {
-        _fd = open(_path.c_str(), _flags, _mode);
+        _fd = open_path(_path, _flags, _mode);
         if (_fd < 0) SetSyscallError();
     }
     virtual void OnOK()
@@ -1764,6 +2708,69 @@ struct FileRead : public FSWrapWorker<FileWrap>
     }
 };
 
+/**
+ * FileReadLines is a FileRead that also scans the bytes it read for newlines,
+ * and returns the buffer offsets of all the newlines it found in an Int32Array.
+ * This lets line readers (like NewlineReader) split a whole buffer into lines
+ * without searching for every line separately on the event loop.
+ * The scan uses memchr which glibc already implements with SSE2/AVX2/NEON.
+ */
+struct FileReadLines : public FSWrapWorker<FileWrap>
+{
+    uint8_t* _buf;
+    int _offset;
+    int _len;
+    off_t _pos;
+    ssize_t _br;
+    std::vector<int32_t> _lines;
+    FileReadLines(const Napi::CallbackInfo& info)
+        : FSWrapWorker<FileWrap>(info)
+        , _buf(0)
+        , _offset(0)
+        , _len(0)
+        , _pos(0)
+        , _br(0)
+    {
+        auto buf = info[1].As<Napi::Buffer<uint8_t>>();
+        _buf = buf.Data();
+        _offset = info[2].As<Napi::Number>();
+        _len = info[3].As<Napi::Number>();
+        _pos = info[4].As<Napi::Number>();
+        Begin(XSTR() << "FileReadLines " << DVAL(_wrap->_path) << DVAL(_wrap->_fd) << DVAL(_pos) << DVAL(_offset) << DVAL(_len));
+    }
+    virtual void Work()
+    {
+        int fd = _wrap->_fd;
+        CHECK_WRAP_FD(fd);
+        _br = pread(fd, _buf + _offset, _len, _pos);
+        if (_br < 0) {
+            SetSyscallError();
+            return;
+        }
+        const uint8_t* start = _buf + _offset;
+        const uint8_t* end = start + _br;
+        const uint8_t* p = start;
+        while (p < end) {
+            const uint8_t* nl = (const uint8_t*)memchr(p, '\n', end - p);
+            if (!nl) break;
+            _lines.push_back(_offset + (nl - start));
+            p = nl + 1;
+        }
+    }
+    virtual void OnOK()
+    {
+        DBG1("FS::FileReadLines::OnOK: " << DVAL(_wrap->_path) << DVAL(_br) << DVAL(_lines.size()));
+        Napi::Env env = Env();
+        auto lines = Napi::Int32Array::New(env, _lines.size());
+        if (_lines.size()) memcpy(lines.Data(), _lines.data(), _lines.size() * sizeof(int32_t));
+        auto res = Napi::Object::New(env);
+        res["read"] = Napi::Number::New(env, _br);
+        res["lines"] = lines;
+        _deferred.Resolve(res);
+        ReportWorkerStats(0);
+    }
+};
+
 struct FileWrite : public FSWrapWorker<FileWrap>
 {
     const uint8_t* _buf;
@@ -2148,38 +3155,188 @@ struct FileStat : public FSWrapWorker<FileWrap>
     }
 };
 
+/**
+ * FileFsync flushes the file data and metadata.
+ * With datasync it uses fdatasync, which skips the metadata that is not needed to read the data back
+ * (like mtime), and so should not be used when the file attributes must be durable.
+ */
 struct FileFsync : public FSWrapWorker<FileWrap>
 {
+    bool _datasync;
     FileFsync(const Napi::CallbackInfo& info)
         : FSWrapWorker<FileWrap>(info)
+        , _datasync(false)
     {
-        Begin(XSTR() << "FileFsync " << DVAL(_wrap->_path));
+        if (info.Length() > 1 && info[1].IsObject()) {
+            _datasync = info[1].As<Napi::Object>().Get("datasync").ToBoolean();
+        }
+        Begin(XSTR() << "FileFsync " << DVAL(_wrap->_path) << DVAL(_datasync));
     }
     virtual void Work()
     {
         int fd = _wrap->_fd;
         CHECK_WRAP_FD(fd);
+#ifdef __APPLE__
         SYSCALL_OR_RETURN(fsync(fd));
+#else
+        SYSCALL_OR_RETURN(_datasync ? fdatasync(fd) : fsync(fd));
+#endif
     }
 };
 
-struct FileFlock : public FSWrapWorker<FileWrap>
+/**
+ * FileFallocate allocates the blocks of a range in advance of writing it, without changing
+ * the file size, so that large writes get contiguous extents and fail early on ENOSPC.
+ * Blocks preallocated beyond the end of the file are released by truncating it.
+ */
+struct FileFallocate : public FSWrapWorker<FileWrap>
 {
-    int lock_mode;
-    FileFlock(const Napi::CallbackInfo& info)
+    off_t _offset;
+    off_t _len;
+    FileFallocate(const Napi::CallbackInfo& info)
         : FSWrapWorker<FileWrap>(info)
-        , lock_mode(LOCK_SH)
+        , _offset(0)
+        , _len(0)
     {
-        if (info.Length() > 1 && !info[1].IsUndefined()) {
-            auto mode = info[1].As<Napi::String>().Utf8Value();
-            if (mode == "EXCLUSIVE") {
-                lock_mode = LOCK_EX;
-            } else if (mode == "UNLOCK") {
-                lock_mode = LOCK_UN;
-            } else if (mode == "SHARED") {
-                lock_mode = LOCK_SH;
-            } else {
-                SetError("invalid lock type");
+        _offset = info[1].As<Napi::Number>().Int64Value();
+        _len = info[2].As<Napi::Number>().Int64Value();
+        Begin(XSTR() << "FileFallocate " << DVAL(_wrap->_path) << DVAL(_offset) << DVAL(_len));
+    }
+    virtual void Work()
+    {
+        int fd = _wrap->_fd;
+        CHECK_WRAP_FD(fd);
+#ifdef __linux__
+        SYSCALL_OR_RETURN(fallocate(fd, FALLOC_FL_KEEP_SIZE, _offset, _len));
+#else
+        errno = ENOTSUP;
+        SetSyscallError();
+#endif
+    }
+};
+
+struct FileTruncate : public FSWrapWorker<FileWrap>
+{
+    off_t _len;
+    FileTruncate(const Napi::CallbackInfo& info)
+        : FSWrapWorker<FileWrap>(info)
+        , _len(0)
+    {
+        _len = info[1].As<Napi::Number>().Int64Value();
+        Begin(XSTR() << "FileTruncate " << DVAL(_wrap->_path) << DVAL(_len));
+    }
+    virtual void Work()
+    {
+        int fd = _wrap->_fd;
+        CHECK_WRAP_FD(fd);
+        SYSCALL_OR_RETURN(ftruncate(fd, _len));
+    }
+};
+
+/**
+ * FileSyncRange starts the writeback of a range of dirty pages ("write"), or also waits
+ * for it to complete ("wait"). Unlike fsync it does not flush the metadata or the device cache,
+ * so it only spreads the writeback over the write, and the final fsync is still required.
+ */
+struct FileSyncRange : public FSWrapWorker<FileWrap>
+{
+    off_t _offset;
+    off_t _len;
+    bool _wait;
+    FileSyncRange(const Napi::CallbackInfo& info)
+        : FSWrapWorker<FileWrap>(info)
+        , _offset(0)
+        , _len(0)
+        , _wait(false)
+    {
+        _offset = info[1].As<Napi::Number>().Int64Value();
+        _len = info[2].As<Napi::Number>().Int64Value();
+        if (info.Length() > 3 && !info[3].IsUndefined()) {
+            const std::string mode = info[3].As<Napi::String>();
+            if (mode == "wait") {
+                _wait = true;
+            } else if (mode != "write") {
+                SetError(XSTR() << "Unexpected sync range mode " << mode);
+            }
+        }
+        Begin(XSTR() << "FileSyncRange " << DVAL(_wrap->_path) << DVAL(_offset) << DVAL(_len) << DVAL(_wait));
+    }
+    virtual void Work()
+    {
+        int fd = _wrap->_fd;
+        CHECK_WRAP_FD(fd);
+#ifdef __linux__
+        unsigned int flags = SYNC_FILE_RANGE_WRITE;
+        if (_wait) flags |= SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WAIT_AFTER;
+        SYSCALL_OR_RETURN(sync_file_range(fd, _offset, _len, flags));
+#else
+        errno = ENOTSUP;
+        SetSyscallError();
+#endif
+    }
+};
+
+/**
+ * FileFadvise passes an access pattern hint for a range of the file,
+ * mainly "dontneed" to drop the pages of a range that was already written back.
+ */
+struct FileFadvise : public FSWrapWorker<FileWrap>
+{
+    off_t _offset;
+    off_t _len;
+    int _advice;
+    FileFadvise(const Napi::CallbackInfo& info)
+        : FSWrapWorker<FileWrap>(info)
+        , _offset(0)
+        , _len(0)
+        , _advice(-1)
+    {
+        _offset = info[1].As<Napi::Number>().Int64Value();
+        _len = info[2].As<Napi::Number>().Int64Value();
+        const std::string advice = info[3].As<Napi::String>();
+#ifndef __APPLE__
+        if (advice == "normal") _advice = POSIX_FADV_NORMAL;
+        if (advice == "sequential") _advice = POSIX_FADV_SEQUENTIAL;
+        if (advice == "random") _advice = POSIX_FADV_RANDOM;
+        if (advice == "willneed") _advice = POSIX_FADV_WILLNEED;
+        if (advice == "dontneed") _advice = POSIX_FADV_DONTNEED;
+        if (advice == "noreuse") _advice = POSIX_FADV_NOREUSE;
+#endif
+        if (_advice < 0) SetError(XSTR() << "Unexpected fadvise advice " << advice);
+        Begin(XSTR() << "FileFadvise " << DVAL(_wrap->_path) << DVAL(_offset) << DVAL(_len) << DVAL(advice));
+    }
+    virtual void Work()
+    {
+        int fd = _wrap->_fd;
+        CHECK_WRAP_FD(fd);
+#ifndef __APPLE__
+        // posix_fadvise returns the error instead of setting errno
+        int r = posix_fadvise(fd, _offset, _len, _advice);
+        if (r) {
+            errno = r;
+            SetSyscallError();
+        }
+#endif
+    }
+};
+
+struct FileFlock : public FSWrapWorker<FileWrap>
+{
+    int lock_mode;
+    FileFlock(const Napi::CallbackInfo& info)
+        : FSWrapWorker<FileWrap>(info)
+        , lock_mode(LOCK_SH)
+    {
+        if (info.Length() > 1 && !info[1].IsUndefined()) {
+            auto mode = info[1].As<Napi::String>().Utf8Value();
+            if (mode == "EXCLUSIVE") {
+                lock_mode = LOCK_EX;
+            } else if (mode == "UNLOCK") {
+                lock_mode = LOCK_UN;
+            } else if (mode == "SHARED") {
+                lock_mode = LOCK_SH;
+            } else {
+                SetError("invalid lock type");
             }
         }
 
@@ -2378,6 +3535,12 @@ FileWrap::writev(const Napi::CallbackInfo& info)
     return api<FileWritev>(info);
 }
 
+Napi::Value
+FileWrap::read_lines(const Napi::CallbackInfo& info)
+{
+    return api<FileReadLines>(info);
+}
+
 Napi::Value
 FileWrap::read_rdma(const Napi::CallbackInfo& info)
 {
@@ -2426,6 +3589,30 @@ FileWrap::fsync(const Napi::CallbackInfo& info)
     return api<FileFsync>(info);
 }
 
+Napi::Value
+FileWrap::fallocate(const Napi::CallbackInfo& info)
+{
+    return api<FileFallocate>(info);
+}
+
+Napi::Value
+FileWrap::truncate(const Napi::CallbackInfo& info)
+{
+    return api<FileTruncate>(info);
+}
+
+Napi::Value
+FileWrap::sync_range(const Napi::CallbackInfo& info)
+{
+    return api<FileSyncRange>(info);
+}
+
+Napi::Value
+FileWrap::fadvise(const Napi::CallbackInfo& info)
+{
+    return api<FileFadvise>(info);
+}
+
 Napi::Value
 FileWrap::flock(const Napi::CallbackInfo& info)
 {
@@ -2501,7 +3688,7 @@ struct DirOpen : public FSWorker
     }
     virtual void Work()
     {
-        _dir = opendir(_path.c_str());
+        _dir = opendir_path(_path);
         if (_dir == NULL) SetSyscallError();
     }
     virtual void OnOK()
@@ -2666,6 +3853,438 @@ DirWrap::seekdir(const Napi::CallbackInfo& info)
     return api<SeekDir>(info);
 }
 
+struct BucketRootClose;
+
+/**
+ * BucketRootWrap holds an O_PATH fd of a bucket root dir, and runs the path ops on paths
+ * relative to it, resolved with openat2(RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS).
+ * This saves the kernel from walking the bucket path prefix on every op, and guarantees
+ * that a path (including symlinks on it) cannot escape the bucket - such ops fail with EXDEV.
+ * The ops take the same args as the matching fs functions, with a relative path.
+ * Where openat2 is not available it falls back to openat, see openat_beneath().
+ */
+struct BucketRootWrap : public Napi::ObjectWrap<BucketRootWrap>
+{
+    std::string _path;
+    int _fd;
+    // the workers use _fd from their threads, so close() waits for the ops in flight
+    // and ops that start once close() was called are rejected with EBADF.
+    // both are only accessed from the main thread.
+    int _inflight;
+    bool _closing;
+    std::vector<BucketRootClose*> _pending_closes;
+    static Napi::FunctionReference constructor;
+    static void init(Napi::Env env)
+    {
+        constructor = Napi::Persistent(DefineClass(
+            env,
+            "BucketRoot",
+            {
+                InstanceMethod<&BucketRootWrap::close>("close"),
+                InstanceMethod<&BucketRootWrap::beneath<Stat>>("stat"),
+                InstanceMethod<&BucketRootWrap::beneath<Statx>>("statx"),
+                InstanceMethod<&BucketRootWrap::beneath<CheckAccess>>("checkAccess"),
+                InstanceMethod<&BucketRootWrap::beneath<Unlink>>("unlink"),
+                InstanceMethod<&BucketRootWrap::beneath<Rename>>("rename"),
+                InstanceMethod<&BucketRootWrap::beneath<Mkdir>>("mkdir"),
+                InstanceMethod<&BucketRootWrap::beneath<Mkdirp>>("mkdirp"),
+                InstanceMethod<&BucketRootWrap::beneath<Rmdir>>("rmdir"),
+                InstanceMethod<&BucketRootWrap::beneath<Writefile>>("writeFile"),
+                InstanceMethod<&BucketRootWrap::beneath<Readfile>>("readFile"),
+                InstanceMethod<&BucketRootWrap::beneath<Readdir>>("readdir"),
+                InstanceMethod<&BucketRootWrap::beneath<Fsync>>("fsync"),
+                InstanceMethod<&BucketRootWrap::beneath<FileOpen>>("open"),
+                InstanceMethod<&BucketRootWrap::beneath<DirOpen>>("opendir"),
+                InstanceAccessor<&BucketRootWrap::getfd>("fd"),
+                InstanceAccessor<&BucketRootWrap::getpath>("path"),
+                InstanceAccessor<&BucketRootWrap::getresolve>("resolve_beneath"),
+            }));
+        constructor.SuppressDestruct();
+    }
+    BucketRootWrap(const Napi::CallbackInfo& info)
+        : Napi::ObjectWrap<BucketRootWrap>(info)
+        , _fd(-1)
+        , _inflight(0)
+        , _closing(false)
+    {
+    }
+    ~BucketRootWrap()
+    {
+        if (_fd >= 0) {
+            LOG("FS::BucketRootWrap::dtor: bucket root not closed " << DVAL(_path) << DVAL(_fd));
+            int r = ::close(_fd);
+            if (r) LOG("FS::BucketRootWrap::dtor: bucket root close failed " << DVAL(_path) << DVAL(_fd) << DVAL(r));
+            _fd = -1;
+        }
+    }
+    template <typename T>
+    Napi::Value beneath(const Napi::CallbackInfo& info)
+    {
+        if (_closing) {
+            auto deferred = Napi::Promise::Deferred::New(info.Env());
+            deferred.Reject(napi_sys_error(info.Env(), EBADF, "BucketRoot " + _path + " is closed").Value());
+            return deferred.Promise();
+        }
+        auto w = new T(info);
+        // the worker args keep this object referenced until the op is done
+        w->_args_ref.Set("root", info.This());
+        w->SetRoot(this, _fd, _path);
+        _inflight++;
+        Napi::Promise promise = w->_deferred.Promise();
+        w->Queue();
+        return promise;
+    }
+    Napi::Value close(const Napi::CallbackInfo& info);
+    void op_done();
+    Napi::Value getfd(const Napi::CallbackInfo& info)
+    {
+        return Napi::Number::New(info.Env(), _fd);
+    }
+    Napi::Value getpath(const Napi::CallbackInfo& info)
+    {
+        return Napi::String::New(info.Env(), _path);
+    }
+    Napi::Value getresolve(const Napi::CallbackInfo& info)
+    {
+        return Napi::Boolean::New(info.Env(), openat2_beneath_supported());
+    }
+};
+
+Napi::FunctionReference BucketRootWrap::constructor;
+
+struct BucketRootOpen : public FSWorker
+{
+    std::string _path;
+    int _fd;
+    BucketRootOpen(const Napi::CallbackInfo& info)
+        : FSWorker(info)
+        , _fd(-1)
+    {
+        _path = info[1].As<Napi::String>();
+        while (_path.size() > 1 && _path.back() == '/') _path.pop_back();
+        Begin(XSTR() << "BucketRootOpen " << DVAL(_path));
+    }
+    virtual void Work()
+    {
+        _fd = open(_path.c_str(), O_PATH_OR_RDONLY | O_DIRECTORY);
+        if (_fd < 0) SetSyscallError();
+    }
+    virtual void OnOK()
+    {
+        DBG1("FS::BucketRootOpen::OnOK: " << DVAL(_path) << DVAL(_fd));
+        Napi::Object res = BucketRootWrap::constructor.New({});
+        BucketRootWrap* w = BucketRootWrap::Unwrap(res);
+        w->_path = _path;
+        w->_fd = _fd;
+        _deferred.Resolve(res);
+        ReportWorkerStats(0);
+    }
+};
+
+struct BucketRootClose : public FSWrapWorker<BucketRootWrap>
+{
+    // taken from the wrap on the main thread when the close is queued
+    int _close_fd;
+    BucketRootClose(const Napi::CallbackInfo& info)
+        : FSWrapWorker<BucketRootWrap>(info)
+        , _close_fd(-1)
+    {
+        Begin(XSTR() << "BucketRootClose " << DVAL(_wrap->_path) << DVAL(_wrap->_fd));
+    }
+    void QueueClose()
+    {
+        _close_fd = _wrap->_fd;
+        _wrap->_fd = -1;
+        Queue();
+    }
+    virtual void Work()
+    {
+        if (_close_fd >= 0) {
+            int r = close(_close_fd);
+            if (r) SetSyscallError();
+        }
+    }
+};
+
+Napi::Value
+BucketRootWrap::close(const Napi::CallbackInfo& info)
+{
+    auto w = new BucketRootClose(info);
+    Napi::Promise promise = w->_deferred.Promise();
+    _closing = true;
+    if (_inflight) {
+        _pending_closes.push_back(w);
+    } else {
+        w->QueueClose();
+    }
+    return promise;
+}
+
+void
+BucketRootWrap::op_done()
+{
+    _inflight--;
+    if (_inflight) return;
+    auto pending_closes = std::move(_pending_closes);
+    _pending_closes.clear();
+    for (auto w : pending_closes) w->QueueClose();
+}
+
+static void
+bucket_root_op_done(BucketRootWrap* root)
+{
+    root->op_done();
+}
+
+/**
+ * DirListingWrap holds a sorted listing from the DirCache for paging it from JS.
+ * Only the requested page is converted to JS entries ({ name, type } like readdir).
+ */
+struct DirListingWrap : public Napi::ObjectWrap<DirListingWrap>
+{
+    std::shared_ptr<const DirListing> _listing;
+    static Napi::FunctionReference constructor;
+    static void init(Napi::Env env)
+    {
+        constructor = Napi::Persistent(DefineClass(
+            env,
+            "DirListing",
+            {
+                InstanceMethod<&DirListingWrap::upper_bound>("upper_bound"),
+                InstanceMethod<&DirListingWrap::lower_bound>("lower_bound"),
+                InstanceMethod<&DirListingWrap::entries>("entries"),
+                InstanceAccessor<&DirListingWrap::length>("length"),
+            }));
+        constructor.SuppressDestruct();
+    }
+    DirListingWrap(const Napi::CallbackInfo& info)
+        : Napi::ObjectWrap<DirListingWrap>(info)
+    {
+    }
+    Napi::Value upper_bound(const Napi::CallbackInfo& info)
+    {
+        return Napi::Number::New(info.Env(), _listing->upper_bound(info[0].As<Napi::String>().Utf8Value()));
+    }
+    Napi::Value lower_bound(const Napi::CallbackInfo& info)
+    {
+        return Napi::Number::New(info.Env(), _listing->lower_bound(info[0].As<Napi::String>().Utf8Value()));
+    }
+    Napi::Value length(const Napi::CallbackInfo& info)
+    {
+        return Napi::Number::New(info.Env(), _listing->count());
+    }
+    Napi::Value entries(const Napi::CallbackInfo& info);
+};
+
+Napi::FunctionReference DirListingWrap::constructor;
+
+/**
+ * entries(start, { prefix, limit }) returns up to limit entries from index start,
+ * stopping at the first name that does not start with prefix.
+ */
+Napi::Value
+DirListingWrap::entries(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    size_t start = info[0].ToNumber().Int64Value();
+    size_t limit = _listing->count();
+    std::string prefix;
+    if (info[1].IsObject()) {
+        auto options = info[1].As<Napi::Object>();
+        if (options.Get("prefix").IsString()) prefix = options.Get("prefix").As<Napi::String>().Utf8Value();
+        if (options.Get("limit").IsNumber()) limit = options.Get("limit").ToNumber().Int64Value();
+    }
+    std::vector<size_t> indexes;
+    for (size_t i = start; i < _listing->count() && indexes.size() < limit; ++i) {
+        if (!_listing->name(i).starts_with(prefix)) break;
+        indexes.push_back(i);
+    }
+    auto res = Napi::Array::New(env, indexes.size());
+    for (uint32_t k = 0; k < indexes.size(); ++k) {
+        const std::string_view name = _listing->name(indexes[k]);
+        auto ent = Napi::Object::New(env);
+        ent["name"] = Napi::String::New(env, name.data(), name.size());
+        ent["type"] = Napi::Number::New(env, _listing->type(indexes[k]));
+        res.Set(k, ent);
+    }
+    return res;
+}
+
+/**
+ * DirCacheWrap is the native listing cache for namespace_fs list objects.
+ * The listings are kept outside the JS heap and accounted against max_total_size,
+ * and directories larger than max_dir_size (by stat size) are not listed at all
+ * so the caller falls back to streaming them.
+ */
+struct DirCacheWrap : public Napi::ObjectWrap<DirCacheWrap>
+{
+    std::unique_ptr<DirCache> _cache;
+    size_t _max_dir_size;
+    static Napi::FunctionReference constructor;
+    static void init(Napi::Env env)
+    {
+        constructor = Napi::Persistent(DefineClass(
+            env,
+            "DirCache",
+            {
+                InstanceMethod<&DirCacheWrap::load>("load"),
+                InstanceMethod<&DirCacheWrap::invalidate>("invalidate"),
+                InstanceMethod<&DirCacheWrap::stats>("stats"),
+            }));
+        constructor.SuppressDestruct();
+    }
+    DirCacheWrap(const Napi::CallbackInfo& info)
+        : Napi::ObjectWrap<DirCacheWrap>(info)
+    {
+        auto params = info[0].IsObject() ? info[0].As<Napi::Object>() : Napi::Object::New(info.Env());
+        size_t max_total_size = params.Get("max_total_size").IsNumber() ? params.Get("max_total_size").ToNumber().Int64Value() : 256 * 1024 * 1024;
+        _max_dir_size = params.Get("max_dir_size").IsNumber() ? params.Get("max_dir_size").ToNumber().Int64Value() : 64 * 1024 * 1024;
+        _cache.reset(new DirCache(max_total_size));
+    }
+    Napi::Value load(const Napi::CallbackInfo& info);
+    Napi::Value invalidate(const Napi::CallbackInfo& info)
+    {
+        _cache->invalidate(info[0].As<Napi::String>().Utf8Value());
+        return info.Env().Undefined();
+    }
+    Napi::Value stats(const Napi::CallbackInfo& info)
+    {
+        Napi::Env env = info.Env();
+        auto res = Napi::Object::New(env);
+        res["count"] = Napi::Number::New(env, _cache->count());
+        res["total_size"] = Napi::Number::New(env, _cache->total_size());
+        return res;
+    }
+};
+
+Napi::FunctionReference DirCacheWrap::constructor;
+
+/**
+ * DirCacheLoad stats the dir (with xattrs like Stat) and returns the cached listing
+ * if the dir did not change since it was listed, otherwise lists and caches it.
+ */
+struct DirCacheLoad : public FSWrapWorker<DirCacheWrap>
+{
+    std::string _path;
+    struct stat _stat_res;
+    XattrMap _xattr;
+    std::vector<std::string> _xattr_get_keys;
+    std::shared_ptr<const DirListing> _listing;
+    bool _cached;
+    DirCacheLoad(const Napi::CallbackInfo& info)
+        : FSWrapWorker<DirCacheWrap>(info)
+        , _cached(false)
+    {
+        _path = info[1].As<Napi::String>();
+        if (info[2].ToBoolean()) {
+            Napi::Object options = info[2].As<Napi::Object>();
+            load_xattr_get_keys(options, _xattr_get_keys);
+        }
+        Begin(XSTR() << "DirCacheLoad " << DVAL(_path));
+    }
+    virtual void Work()
+    {
+        int fd = open(_path.c_str(), O_RDONLY);
+        CHECK_OPEN_FD(fd);
+        SYSCALL_OR_RETURN(fstat(fd, &_stat_res));
+        SYSCALL_OR_RETURN(get_fd_xattr(fd, _xattr, _xattr_get_keys));
+        if (use_gpfs_lib()) {
+            GPFS_FCNTL_OR_RETURN(get_fd_gpfs_xattr(fd, _xattr, gpfs_error, _use_dmapi));
+        }
+
+        _listing = _wrap->_cache->get(_path, _stat_res);
+        if (_listing) {
+            _cached = true;
+            return;
+        }
+        if (size_t(_stat_res.st_size) > _wrap->_max_dir_size) return;
+
+        // the stat was taken before listing, so a change during the listing
+        // will fail the validation of the next load.
+        int dir_fd = dup(fd);
+        if (dir_fd < 0) {
+            SetSyscallError();
+            return;
+        }
+        DIR* dir = fdopendir(dir_fd);
+        if (dir == NULL) {
+            SetSyscallError();
+            ::close(dir_fd);
+            return;
+        }
+        std::vector<DirListing::Entry> entries;
+        while (true) {
+            // need to set errno before the call to readdir() to detect between EOF and error
+            errno = 0;
+            struct dirent* e = readdir(dir);
+            if (e) {
+                if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+                entries.push_back(DirListing::Entry{ std::string(e->d_name), e->d_type });
+            } else {
+                if (errno) SetSyscallError();
+                break;
+            }
+        }
+        int r = closedir(dir);
+        if (r) SetSyscallError();
+        if (_errno) return;
+
+        _listing = std::make_shared<const DirListing>(_stat_res, entries);
+        _wrap->_cache->put(_path, _listing);
+    }
+    virtual void OnOK()
+    {
+        DBG1("FS::DirCacheLoad::OnOK: " << DVAL(_path) << DVAL(_cached) << DVAL(_listing.get()));
+        Napi::Env env = Env();
+        auto res = Napi::Object::New(env);
+        auto stat = Napi::Object::New(env);
+        set_stat_res(stat, env, _stat_res, _xattr);
+        res["stat"] = stat;
+        res["cached"] = Napi::Boolean::New(env, _cached);
+        if (_listing) {
+            Napi::Object listing = DirListingWrap::constructor.New({});
+            DirListingWrap::Unwrap(listing)->_listing = _listing;
+            res["listing"] = listing;
+        }
+        _deferred.Resolve(res);
+        ReportWorkerStats(0);
+    }
+};
+
+Napi::Value
+DirCacheWrap::load(const Napi::CallbackInfo& info)
+{
+    return api<DirCacheLoad>(info);
+}
+
+static Napi::Value
+mkdirp_cache_stats(const Napi::CallbackInfo& info)
+{
+    auto res = Napi::Object::New(info.Env());
+    res["count"] = Napi::Number::New(info.Env(), g_mkdirp_cache.count());
+    res["hits"] = Napi::Number::New(info.Env(), g_mkdirp_cache.hits());
+    res["misses"] = Napi::Number::New(info.Env(), g_mkdirp_cache.misses());
+    return res;
+}
+
+static Napi::Value
+fsync_coalescer_stats(const Napi::CallbackInfo& info)
+{
+    auto res = Napi::Object::New(info.Env());
+    res["requests"] = Napi::Number::New(info.Env(), g_fsync_coalescer.requests());
+    res["rounds"] = Napi::Number::New(info.Env(), g_fsync_coalescer.rounds());
+    res["max_batch"] = Napi::Number::New(info.Env(), g_fsync_coalescer.max_batch());
+    res["inflight"] = Napi::Number::New(info.Env(), g_fsync_coalescer.inflight());
+    return res;
+}
+
+static Napi::Value
+fsync_coalescer_hold(const Napi::CallbackInfo& info)
+{
+    g_fsync_coalescer.hold(info[0].As<Napi::Boolean>());
+    return info.Env().Undefined();
+}
+
 static Napi::Value
 set_debug_level(const Napi::CallbackInfo& info)
 {
@@ -2804,6 +4423,7 @@ fs_napi(Napi::Env env, Napi::Object exports)
     }
 
     exports_fs["stat"] = Napi::Function::New(env, api<Stat>);
+    exports_fs["statx"] = Napi::Function::New(env, api<Statx>);
     exports_fs["statfs"] = Napi::Function::New(env, api<Statfs>);
     exports_fs["checkAccess"] = Napi::Function::New(env, api<CheckAccess>);
     exports_fs["unlink"] = Napi::Function::New(env, api<Unlink>);
@@ -2811,11 +4431,16 @@ fs_napi(Napi::Env env, Napi::Object exports)
     exports_fs["safe_unlink"] = Napi::Function::New(env, api<SafeUnlink>);
     exports_fs["rename"] = Napi::Function::New(env, api<Rename>);
     exports_fs["mkdir"] = Napi::Function::New(env, api<Mkdir>);
+    exports_fs["mkdirp"] = Napi::Function::New(env, api<Mkdirp>);
     exports_fs["rmdir"] = Napi::Function::New(env, api<Rmdir>);
+    exports_fs["remove_tree"] = Napi::Function::New(env, api<RemoveTree>);
+    exports_fs["lifecycle_scan"] = Napi::Function::New(env, api<LifecycleScan>);
     exports_fs["writeFile"] = Napi::Function::New(env, api<Writefile>);
     exports_fs["readFile"] = Napi::Function::New(env, api<Readfile>);
     exports_fs["readdir"] = Napi::Function::New(env, api<Readdir>);
     exports_fs["safe_link"] = Napi::Function::New(env, api<SafeLink>);
+    exports_fs["safe_move"] = Napi::Function::New(env, api<SafeMove>);
+    exports_fs["safe_exchange"] = Napi::Function::New(env, api<SafeExchange>);
     exports_fs["link"] = Napi::Function::New(env, api<Link>);
     exports_fs["linkat"] = Napi::Function::New(env, api<Linkat>);
     exports_fs["fsync"] = Napi::Function::New(env, api<Fsync>);
@@ -2833,12 +4458,63 @@ fs_napi(Napi::Env env, Napi::Object exports)
     DirWrap::init(env);
     exports_fs["opendir"] = Napi::Function::New(env, api<DirOpen>);
 
+    BucketRootWrap::init(env);
+    exports_fs["open_bucket_root"] = Napi::Function::New(env, api<BucketRootOpen>);
+
+    DirListingWrap::init(env);
+    DirCacheWrap::init(env);
+    exports_fs["DirCache"] = DirCacheWrap::constructor.Value();
+
     exports_fs["S_IFMT"] = Napi::Number::New(env, S_IFMT);
     exports_fs["S_IFDIR"] = Napi::Number::New(env, S_IFDIR);
     exports_fs["S_IFLNK"] = Napi::Number::New(env, S_IFLNK);
     exports_fs["DT_DIR"] = Napi::Number::New(env, DT_DIR);
     exports_fs["DT_LNK"] = Napi::Number::New(env, DT_LNK);
     exports_fs["PLATFORM_IOV_MAX"] = Napi::Number::New(env, IOV_MAX);
+
+    auto statx_index = Napi::Object::New(env);
+    statx_index["mask"] = Napi::Number::New(env, STATX_INDEX_MASK);
+    statx_index["mode"] = Napi::Number::New(env, STATX_INDEX_MODE);
+    statx_index["nlink"] = Napi::Number::New(env, STATX_INDEX_NLINK);
+    statx_index["uid"] = Napi::Number::New(env, STATX_INDEX_UID);
+    statx_index["gid"] = Napi::Number::New(env, STATX_INDEX_GID);
+    statx_index["ino"] = Napi::Number::New(env, STATX_INDEX_INO);
+    statx_index["size"] = Napi::Number::New(env, STATX_INDEX_SIZE);
+    statx_index["blocks"] = Napi::Number::New(env, STATX_INDEX_BLOCKS);
+    statx_index["dev"] = Napi::Number::New(env, STATX_INDEX_DEV);
+    statx_index["atime_sec"] = Napi::Number::New(env, STATX_INDEX_ATIME_SEC);
+    statx_index["atime_nsec"] = Napi::Number::New(env, STATX_INDEX_ATIME_NSEC);
+    statx_index["mtime_sec"] = Napi::Number::New(env, STATX_INDEX_MTIME_SEC);
+    statx_index["mtime_nsec"] = Napi::Number::New(env, STATX_INDEX_MTIME_NSEC);
+    statx_index["ctime_sec"] = Napi::Number::New(env, STATX_INDEX_CTIME_SEC);
+    statx_index["ctime_nsec"] = Napi::Number::New(env, STATX_INDEX_CTIME_NSEC);
+    statx_index["btime_sec"] = Napi::Number::New(env, STATX_INDEX_BTIME_SEC);
+    statx_index["btime_nsec"] = Napi::Number::New(env, STATX_INDEX_BTIME_NSEC);
+    statx_index["count"] = Napi::Number::New(env, STATX_INDEX_COUNT);
+    exports_fs["statx_index"] = statx_index;
+
+    auto statx_mask = Napi::Object::New(env);
+    statx_mask["type"] = Napi::Number::New(env, STATX_TYPE);
+    statx_mask["mode"] = Napi::Number::New(env, STATX_MODE);
+    statx_mask["nlink"] = Napi::Number::New(env, STATX_NLINK);
+    statx_mask["uid"] = Napi::Number::New(env, STATX_UID);
+    statx_mask["gid"] = Napi::Number::New(env, STATX_GID);
+    statx_mask["atime"] = Napi::Number::New(env, STATX_ATIME);
+    statx_mask["mtime"] = Napi::Number::New(env, STATX_MTIME);
+    statx_mask["ctime"] = Napi::Number::New(env, STATX_CTIME);
+    statx_mask["ino"] = Napi::Number::New(env, STATX_INO);
+    statx_mask["size"] = Napi::Number::New(env, STATX_SIZE);
+    statx_mask["blocks"] = Napi::Number::New(env, STATX_BLOCKS);
+    statx_mask["basic"] = Napi::Number::New(env, STATX_BASIC_STATS);
+    statx_mask["btime"] = Napi::Number::New(env, STATX_BTIME);
+    exports_fs["statx_mask"] = statx_mask;
+
+    auto remove_tree_index = Napi::Object::New(env);
+    remove_tree_index["files"] = Napi::Number::New(env, REMOVE_TREE_INDEX_FILES);
+    remove_tree_index["dirs"] = Napi::Number::New(env, REMOVE_TREE_INDEX_DIRS);
+    remove_tree_index["cancel"] = Napi::Number::New(env, REMOVE_TREE_INDEX_CANCEL);
+    remove_tree_index["count"] = Napi::Number::New(env, REMOVE_TREE_INDEX_COUNT);
+    exports_fs["remove_tree_index"] = remove_tree_index;
     ThreadScope::init_passwd_buf_size();
 
 #ifdef O_DIRECT
@@ -2849,6 +4525,12 @@ fs_napi(Napi::Env env, Napi::Object exports)
 #endif
 
     exports_fs["dio_buffer_alloc"] = Napi::Function::New(env, dio_buffer_alloc);
+    exports_fs["mkdirp_cache_stats"] = Napi::Function::New(env, mkdirp_cache_stats);
+    exports_fs["fsync_coalescer_stats"] = Napi::Function::New(env, fsync_coalescer_stats);
+    // test hooks are exported only to processes that set NOOBAA_NATIVE_TEST_HOOKS (the unit tests)
+    if (std::getenv("NOOBAA_NATIVE_TEST_HOOKS")) {
+        exports_fs["fsync_coalescer_hold"] = Napi::Function::New(env, fsync_coalescer_hold);
+    }
     exports_fs["set_debug_level"] = Napi::Function::New(env, set_debug_level);
     exports_fs["set_log_config"] = Napi::Function::New(env, set_log_config);
 
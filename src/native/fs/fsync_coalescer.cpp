@@ -0,0 +1,89 @@
+/* Copyright (C) 2016 NooBaa */
+#include "fsync_coalescer.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <unistd.h>
+
+namespace noobaa
+{
+
+int
+FsyncCoalescer::sync(int fd, dev_t dev, ino_t ino)
+{
+    const auto key = std::make_pair(dev, ino);
+    std::unique_lock<std::mutex> lock(_mutex);
+    _requests++;
+    auto& entry_ref = _entries[key];
+    if (!entry_ref) entry_ref.reset(new Entry());
+    Entry& e = *entry_ref;
+    e.users++;
+    e.next_batch++;
+
+    // a running round might have missed our changes, so we need the one after it
+    const uint64_t target = e.started + 1;
+    while (e.completed < target) {
+        if (e.running) {
+            e.cond.wait(lock);
+            continue;
+        }
+        // no round is running, so started == completed == target - 1 and we run the next one
+        e.running = true;
+        e.started++;
+        _rounds++;
+        _max_batch = std::max(_max_batch, e.next_batch);
+        e.next_batch = 0;
+        while (_hold) _hold_cond.wait(lock);
+        lock.unlock();
+        const int r = fsync(fd) ? errno : 0;
+        lock.lock();
+        e.completed = e.started;
+        e.error = r;
+        e.running = false;
+        e.cond.notify_all();
+    }
+
+    // a later round also covers our changes, so its result is ours
+    const int err = e.error;
+    if (--e.users == 0) _entries.erase(key);
+    return err;
+}
+
+uint64_t
+FsyncCoalescer::requests() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _requests;
+}
+
+uint64_t
+FsyncCoalescer::rounds() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _rounds;
+}
+
+uint64_t
+FsyncCoalescer::max_batch() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _max_batch;
+}
+
+size_t
+FsyncCoalescer::inflight() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _entries.size();
+}
+
+void
+FsyncCoalescer::hold(bool held)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _hold = held;
+    if (!held) _hold_cond.notify_all();
+}
+
+} // namespace noobaa
@@ -0,0 +1,77 @@
+/* Copyright (C) 2016 NooBaa */
+#pragma once
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace noobaa
+{
+
+/**
+ * FsyncCoalescer merges concurrent fsync calls of the same inode (dev, ino) into rounds
+ * of a single fsync, like a journal group commit.
+ *
+ * A caller needs a round that starts after it called sync, since an fsync that is already
+ * in flight might have missed its changes. So callers that arrive during a round wait for it
+ * to end, and then the first of them runs the next round on its own fd for all of them.
+ * Rounds of different inodes run in parallel.
+ *
+ * This is meant for directories that many uploads rename into at the same time,
+ * where every caller would otherwise wait for its own journal commit.
+ */
+class FsyncCoalescer
+{
+public:
+    FsyncCoalescer()
+        : _requests(0)
+        , _rounds(0)
+        , _max_batch(0)
+        , _hold(false)
+    {
+    }
+
+    // fsyncs fd, which is an open fd of the inode (dev, ino).
+    // returns 0 or the errno of the round that covered this call.
+    int sync(int fd, dev_t dev, ino_t ino);
+
+    uint64_t requests() const;
+    uint64_t rounds() const;
+    // the largest number of calls served by one round
+    uint64_t max_batch() const;
+    // the inodes that have a round running or callers waiting
+    size_t inflight() const;
+
+    // while held, rounds that start wait before their fsync, so tests can make callers arrive during a round
+    void hold(bool held);
+
+private:
+    struct Entry
+    {
+        // rounds are numbered from 1 per inode, completed <= started <= completed + 1
+        uint64_t started = 0;
+        uint64_t completed = 0;
+        int error = 0;
+        bool running = false;
+        // callers inside sync() for this inode, the entry is dropped when it is 0
+        int users = 0;
+        // callers waiting for the next round
+        uint64_t next_batch = 0;
+        std::condition_variable cond;
+    };
+
+    uint64_t _requests;
+    uint64_t _rounds;
+    uint64_t _max_batch;
+    bool _hold;
+    std::condition_variable _hold_cond;
+    std::map<std::pair<dev_t, ino_t>, std::unique_ptr<Entry>> _entries;
+    mutable std::mutex _mutex;
+};
+
+} // namespace noobaa
@@ -0,0 +1,299 @@
+/* Copyright (C) 2016 NooBaa */
+#include "lifecycle_scan.h"
+
+#include "../util/os.h"
+#include "tree_walk.h"
+
+#include <algorithm>
+#include <system_error>
+#include <thread>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+    #define ST_MTIM st_mtimespec
+#else
+    #define ST_MTIM st_mtim
+#endif
+
+namespace noobaa
+{
+
+#define LIFECYCLE_SCAN_PUSH_BATCH 64
+#define LIFECYCLE_SCAN_OUT_FLUSH_SIZE (64 * 1024)
+#define LIFECYCLE_SCAN_TAG_MAX_SIZE 256
+
+const int LifecycleScanner::MAX_CONCURRENCY;
+
+static const std::string VERSIONS_DIR_NAME = ".versions";
+
+static inline bool
+_starts_with(const std::string& s, const std::string& prefix)
+{
+    return s.size() >= prefix.size() && s.compare(0, prefix.size(), prefix) == 0;
+}
+
+static inline bool
+_starts_with(const char* s, const std::string& prefix)
+{
+    return strncmp(s, prefix.c_str(), prefix.size()) == 0;
+}
+
+static ssize_t
+_get_xattr_nofollow(const char* path, const char* name, char* value, size_t size)
+{
+#ifdef __APPLE__
+    return getxattr(path, name, value, size, 0, XATTR_NOFOLLOW);
+#else
+    return lgetxattr(path, name, value, size);
+#endif
+}
+
+LifecycleScanner::LifecycleScanner(uid_t uid, gid_t gid, const std::vector<gid_t>& groups, int concurrency)
+    : _uid(uid)
+    , _gid(gid)
+    , _groups(groups)
+    , _concurrency(std::max(1, std::min(concurrency, MAX_CONCURRENCY)))
+    , _pending(0)
+    , _stopped(false)
+    , _error(0)
+    , _files(0)
+    , _dirs(0)
+    , _skipped(0)
+{
+}
+
+int
+LifecycleScanner::run(const std::string& bucket_path)
+{
+    // keep the bucket path as given, the candidates file parser looks it up in the candidate paths
+    _bucket_path = bucket_path;
+    if (_bucket_path.empty() || _bucket_path.back() != '/') _bucket_path += '/';
+    for (size_t i = 0; i < rules.size(); ++i) {
+        _out_mutexes.emplace_back(new std::mutex());
+    }
+
+    std::vector<std::string> root{ "" };
+    _push(root);
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < _concurrency; ++i) {
+        try {
+            threads.emplace_back(&LifecycleScanner::_thread_main, this, true);
+        } catch (const std::system_error&) {
+            // continue with the threads we have
+            break;
+        }
+    }
+    // the calling thread already runs as the caller identity
+    _thread_main(false);
+    for (auto& t : threads) t.join();
+    return _error;
+}
+
+void
+LifecycleScanner::_thread_main(bool set_identity)
+{
+    std::unique_ptr<ThreadScope> tx;
+    if (set_identity) {
+        tx.reset(new ThreadScope());
+        tx->set_user(_uid, _gid, _groups);
+    }
+    std::vector<char> buf(TREE_WALK_DIRENTS_BUF_SIZE);
+    // candidate lines are buffered per thread and rule, and written in large chunks
+    std::vector<std::string> outs(rules.size());
+    std::string rel_dir;
+    while (_pop(rel_dir)) {
+        _scan_dir(rel_dir, buf, outs);
+        _dir_done();
+    }
+    for (size_t i = 0; i < outs.size(); ++i) {
+        int err = _flush(i, outs[i]);
+        if (err) _fail(err);
+    }
+}
+
+bool
+LifecycleScanner::_pop(std::string& rel_dir)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (_queue.empty() && !_stopped) _cond.wait(lock);
+    if (_stopped) return false;
+    rel_dir = std::move(_queue.back());
+    _queue.pop_back();
+    return true;
+}
+
+void
+LifecycleScanner::_push(std::vector<std::string>& rel_dirs)
+{
+    if (rel_dirs.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending += rel_dirs.size();
+        for (auto& d : rel_dirs) _queue.push_back(std::move(d));
+    }
+    if (rel_dirs.size() > 1) {
+        _cond.notify_all();
+    } else {
+        _cond.notify_one();
+    }
+    rel_dirs.clear();
+}
+
+void
+LifecycleScanner::_dir_done()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (--_pending > 0) return;
+        _stopped = true;
+    }
+    _cond.notify_all();
+}
+
+void
+LifecycleScanner::_fail(int err)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_error) _error = err;
+        _stopped = true;
+    }
+    _cond.notify_all();
+}
+
+bool
+LifecycleScanner::_should_list(const std::string& rel_dir) const
+{
+    for (const auto& rule : rules) {
+        if (_starts_with(rule->prefix, rel_dir) || _starts_with(rel_dir, rule->prefix)) return true;
+    }
+    return false;
+}
+
+bool
+LifecycleScanner::_matches(const Rule& rule, const std::string& full_path, const struct stat& st) const
+{
+    if (rule.days) {
+        const int64_t mtime_ms = int64_t(st.ST_MTIM.tv_sec) * 1000 + st.ST_MTIM.tv_nsec / 1000000;
+        const int64_t age_days = int64_t(floor(double(now_ms - mtime_ms) / (24 * 60 * 60 * 1000)));
+        if (age_days < rule.days) return false;
+    }
+    if (rule.size_greater_than && st.st_size < rule.size_greater_than) return false;
+    if (rule.size_less_than && st.st_size > rule.size_less_than) return false;
+    for (const auto& tag : rule.tags) {
+        char value[LIFECYCLE_SCAN_TAG_MAX_SIZE];
+        const std::string name = tag_xattr_prefix + tag.key;
+        ssize_t len = _get_xattr_nofollow(full_path.c_str(), name.c_str(), value, sizeof(value));
+        // ERANGE means a value longer than any tag value we accept
+        if (len < 0) return false;
+        if (size_t(len) != tag.value.size() || memcmp(value, tag.value.data(), len) != 0) return false;
+    }
+    return true;
+}
+
+int
+LifecycleScanner::_flush(size_t rule_index, std::string& out)
+{
+    if (out.empty()) return 0;
+    std::lock_guard<std::mutex> lock(*_out_mutexes[rule_index]);
+    const int fd = rules[rule_index]->fd;
+    const char* p = out.data();
+    size_t left = out.size();
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        p += n;
+        left -= n;
+    }
+    out.clear();
+    return 0;
+}
+
+void
+LifecycleScanner::_scan_dir(const std::string& rel_dir, std::vector<char>& buf, std::vector<std::string>& outs)
+{
+    const std::string dir_path = _bucket_path + rel_dir;
+    int fd = open(dir_path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        // subdirectories can be deleted or replaced during the scan, or not be accessible like in list objects
+        if (rel_dir.empty() || (errno != ENOENT && errno != ENOTDIR && errno != EACCES)) _fail(errno);
+        return;
+    }
+    _dirs++;
+
+    std::vector<std::string> subdirs;
+    std::vector<size_t> matched;
+    int err = for_each_dir_entry(fd, buf, [&](const char* name, unsigned char type) {
+        if (_stopped) return ECANCELED;
+        struct stat st;
+        bool has_stat = false;
+        if (type == DT_UNKNOWN) {
+            if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW)) return errno == ENOENT ? 0 : errno;
+            has_stat = true;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+
+        if (type == DT_DIR) {
+            if (name == VERSIONS_DIR_NAME) return 0;
+            if (rel_dir.empty() && !exclude_root_prefix.empty() && _starts_with(name, exclude_root_prefix)) return 0;
+            std::string child = rel_dir + name + "/";
+            if (_should_list(child)) {
+                subdirs.push_back(std::move(child));
+                if (subdirs.size() >= LIFECYCLE_SCAN_PUSH_BATCH) _push(subdirs);
+            }
+            return 0;
+        }
+        // symlinks and special files are not objects
+        if (type != DT_REG) return 0;
+
+        const std::string key = rel_dir + name;
+        matched.clear();
+        for (size_t i = 0; i < rules.size(); ++i) {
+            if (_starts_with(key, rules[i]->prefix)) matched.push_back(i);
+        }
+        if (matched.empty()) return 0;
+        if (!has_stat) {
+            if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW)) return errno == ENOENT ? 0 : errno;
+            if (!S_ISREG(st.st_mode)) return 0;
+        }
+        _files++;
+        if (strchr(name, '\n')) {
+            _skipped++;
+            return 0;
+        }
+
+        const std::string full_path = _bucket_path + key;
+        for (size_t i : matched) {
+            Rule& rule = *rules[i];
+            if (!_matches(rule, full_path, st)) continue;
+            std::string& out = outs[i];
+            out += std::to_string(uint64_t(st.st_ino));
+            out += " 0 0   -- ";
+            out += full_path;
+            out += '\n';
+            rule.candidates++;
+            if (out.size() >= LIFECYCLE_SCAN_OUT_FLUSH_SIZE) {
+                int r = _flush(i, out);
+                if (r) return r;
+            }
+        }
+        return 0;
+    });
+
+    close(fd);
+    _push(subdirs);
+    if (err && err != ECANCELED) _fail(err);
+}
+
+} // namespace noobaa
@@ -0,0 +1,104 @@
+/* Copyright (C) 2016 NooBaa */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+namespace noobaa
+{
+
+/**
+ * LifecycleScanner finds the expiration candidates of lifecycle rules in a posix bucket directory,
+ * which is the posix counterpart of the GPFS ILM policy scan (mmapplypolicy).
+ *
+ * The bucket tree is walked once for all the rules with a bounded number of threads, and the
+ * rule filters (prefix, age, size, tags) are evaluated during the walk:
+ * - directories that no rule prefix can match are not listed at all.
+ * - files are stat'ed only when some rule prefix matches, and xattrs are read only for tag filters.
+ * - .versions directories and the bucket internal dirs (exclude_root_prefix) are skipped,
+ *   since expiration applies to the latest versions only.
+ *
+ * Every rule streams its candidates to its own output fd in the mmapplypolicy list format
+ * ("<inode> <gen> <snapid>   -- <path>"), so the same candidates file parser serves both scans.
+ * The calling thread is one of the workers, and the extra threads take the caller identity once.
+ */
+class LifecycleScanner
+{
+public:
+    static const int MAX_CONCURRENCY = 64;
+
+    struct Tag
+    {
+        std::string key;
+        std::string value;
+    };
+
+    struct Rule
+    {
+        std::string prefix;
+        // the filters follow lifecycle_utils.build_lifecycle_filter - zero means no filter
+        int64_t days = 0;
+        int64_t size_greater_than = 0;
+        int64_t size_less_than = 0;
+        std::vector<Tag> tags;
+        int fd = -1;
+        std::atomic<uint64_t> candidates{ 0 };
+    };
+
+    LifecycleScanner(uid_t uid, gid_t gid, const std::vector<gid_t>& groups, int concurrency);
+
+    std::vector<std::unique_ptr<Rule>> rules;
+    // the walk start time, which the age filters are relative to
+    int64_t now_ms = 0;
+    // bucket root entries with this prefix are skipped (the bucket temp dirs)
+    std::string exclude_root_prefix;
+    std::string tag_xattr_prefix = "user.noobaa.tag.";
+
+    // returns 0 on success or an errno value
+    int run(const std::string& bucket_path);
+
+    uint64_t files() const { return _files; }
+    uint64_t dirs() const { return _dirs; }
+    // files that cannot be written as a candidate line (names with a newline)
+    uint64_t skipped() const { return _skipped; }
+
+private:
+    void _thread_main(bool set_identity);
+    bool _pop(std::string& rel_dir);
+    void _push(std::vector<std::string>& rel_dirs);
+    void _scan_dir(const std::string& rel_dir, std::vector<char>& buf, std::vector<std::string>& outs);
+    void _dir_done();
+    bool _should_list(const std::string& rel_dir) const;
+    bool _matches(const Rule& rule, const std::string& full_path, const struct stat& st) const;
+    int _flush(size_t rule_index, std::string& out);
+    void _fail(int err);
+
+    uid_t _uid;
+    gid_t _gid;
+    std::vector<gid_t> _groups;
+    int _concurrency;
+    std::string _bucket_path;
+
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::vector<std::string> _queue;
+    // queued and in progress directories, the scan is done when it drops to 0
+    int64_t _pending;
+    std::atomic<bool> _stopped;
+    int _error;
+    std::vector<std::unique_ptr<std::mutex>> _out_mutexes;
+
+    std::atomic<uint64_t> _files;
+    std::atomic<uint64_t> _dirs;
+    std::atomic<uint64_t> _skipped;
+};
+
+} // namespace noobaa
@@ -0,0 +1,241 @@
+/* Copyright (C) 2016 NooBaa */
+#include "remove_tree.h"
+
+#include "../util/os.h"
+#include "tree_walk.h"
+
+#include <algorithm>
+#include <system_error>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace noobaa
+{
+
+#define REMOVE_TREE_PUSH_BATCH 64
+
+const int TreeRemover::MAX_CONCURRENCY;
+const int TreeRemover::MAX_THREADS;
+const int TreeRemover::MAX_RMDIR_RETRIES;
+
+static std::atomic<int> g_remove_tree_threads(0);
+
+TreeRemover::TreeRemover(uid_t uid, gid_t gid, const std::vector<gid_t>& groups, int concurrency)
+    : _uid(uid)
+    , _gid(gid)
+    , _groups(groups)
+    , _concurrency(std::max(1, std::min(concurrency, MAX_CONCURRENCY)))
+    , _root_parent_fd(-1)
+    , _waiting(0)
+    , _starting(0)
+    , _stopped(false)
+    , _error(0)
+    , _files(0)
+    , _dirs(0)
+{
+}
+
+TreeRemover::Node::~Node()
+{
+    if (fd >= 0) close(fd);
+}
+
+int
+TreeRemover::run(const std::string& root)
+{
+    // the root is the only path that is resolved, everything below it is reached from its fd
+    const size_t end = root.find_last_not_of('/');
+    if (end == std::string::npos) return EINVAL;
+    const size_t slash = root.rfind('/', end);
+    NodeRef node = std::make_shared<Node>();
+    node->name = root.substr(slash == std::string::npos ? 0 : slash + 1, end - slash);
+    if (node->name == "." || node->name == "..") return EINVAL;
+    const std::string parent_path = slash == std::string::npos ? "." : slash == 0 ? "/" : root.substr(0, slash);
+    _root_parent_fd = open(parent_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (_root_parent_fd < 0) return errno;
+
+    // the calling thread takes the root, extra threads start once it queues subdirectories
+    _queue.push_back(node);
+    node.reset();
+    _thread_main(false);
+
+    // no thread starts once stopped, which is when the calling thread returns
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        threads.swap(_threads);
+    }
+    for (auto& t : threads) t.join();
+
+    // release the nodes (and their fds) left by an error or cancellation
+    _queue.clear();
+    close(_root_parent_fd);
+    _root_parent_fd = -1;
+    return _error;
+}
+
+void
+TreeRemover::_thread_main(bool extra)
+{
+    // the calling thread already runs as the caller identity
+    std::unique_ptr<ThreadScope> tx;
+    if (extra) {
+        tx.reset(new ThreadScope());
+        tx->set_user(_uid, _gid, _groups);
+    }
+    std::vector<char> buf(TREE_WALK_DIRENTS_BUF_SIZE);
+    bool starting = extra;
+    while (NodeRef node = _pop(starting)) {
+        starting = false;
+        _remove_dir(node, buf);
+    }
+    if (extra) g_remove_tree_threads--;
+}
+
+TreeRemover::NodeRef
+TreeRemover::_pop(bool starting)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (starting) _starting--;
+    _waiting++;
+    while (_queue.empty() && !_stopped) _cond.wait(lock);
+    _waiting--;
+    if (_stopped) return nullptr;
+    NodeRef node = std::move(_queue.back());
+    _queue.pop_back();
+    return node;
+}
+
+void
+TreeRemover::_push(std::vector<NodeRef>& nodes)
+{
+    if (nodes.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto& node : nodes) _queue.push_back(std::move(node));
+        _start_threads();
+    }
+    if (nodes.size() > 1) {
+        _cond.notify_all();
+    } else {
+        _cond.notify_one();
+    }
+    nodes.clear();
+}
+
+// called with _mutex held, starts threads for the queued nodes that no idle thread can take
+void
+TreeRemover::_start_threads()
+{
+    while (!_stopped && int(_queue.size()) > _waiting + _starting && int(_threads.size()) + 1 < _concurrency) {
+        if (g_remove_tree_threads.fetch_add(1) >= MAX_THREADS) {
+            g_remove_tree_threads--;
+            return;
+        }
+        try {
+            _threads.emplace_back(&TreeRemover::_thread_main, this, true);
+        } catch (const std::system_error&) {
+            // continue with the threads we have
+            g_remove_tree_threads--;
+            return;
+        }
+        _starting++;
+    }
+}
+
+void
+TreeRemover::_fail(int err)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_error) _error = err;
+        _stopped = true;
+    }
+    _cond.notify_all();
+}
+
+void
+TreeRemover::_done()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopped = true;
+    }
+    _cond.notify_all();
+}
+
+void
+TreeRemover::_remove_dir(NodeRef node, std::vector<char>& buf)
+{
+    const int fd = openat(_parent_fd(node), node->name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        // a subdirectory that was removed by someone else is done
+        if (errno == ENOENT && node->parent) return _finish(node);
+        return _fail(errno);
+    }
+    // published to the threads of its subdirectories by the queue lock in _push
+    node->fd = fd;
+
+    std::vector<NodeRef> subdirs;
+    int err = for_each_dir_entry(fd, buf, [&](const char* name, unsigned char type) {
+        if (_stopped) return ECANCELED;
+        if (type == DT_UNKNOWN) {
+            struct stat st;
+            if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW)) return errno == ENOENT ? 0 : errno;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : DT_REG;
+        }
+        if (type != DT_DIR) {
+            if (unlinkat(fd, name, 0) == 0) {
+                _files++;
+                return 0;
+            }
+            if (errno == ENOENT) return 0;
+            // replaced by a directory since it was listed
+            if (errno != EISDIR) return errno;
+        }
+        NodeRef child = std::make_shared<Node>();
+        child->name = name;
+        child->parent = node;
+        node->pending++;
+        subdirs.push_back(std::move(child));
+        if (subdirs.size() >= REMOVE_TREE_PUSH_BATCH) _push(subdirs);
+        return 0;
+    });
+
+    _push(subdirs);
+    if (err) return _fail(err);
+    if (on_progress && !on_progress(_files, _dirs)) return _fail(ECANCELED);
+    _finish(node);
+}
+
+void
+TreeRemover::_finish(NodeRef node)
+{
+    while (node && --node->pending == 0) {
+        // all its subdirectories are done, so no other thread uses its fd
+        if (node->fd >= 0) {
+            close(node->fd);
+            node->fd = -1;
+        }
+        if (unlinkat(_parent_fd(node), node->name.c_str(), AT_REMOVEDIR) == 0) {
+            _dirs++;
+        } else if (errno == ENOTEMPTY && node->retries < MAX_RMDIR_RETRIES) {
+            // entries were added (or missed by the listing) - open and list it again
+            node->retries++;
+            node->pending = 1;
+            std::vector<NodeRef> nodes{ node };
+            _push(nodes);
+            return;
+        } else if (errno != ENOENT || !node->parent) {
+            return _fail(errno);
+        }
+        if (!node->parent) return _done();
+        node = node->parent;
+    }
+}
+
+} // namespace noobaa
@@ -0,0 +1,102 @@
+/* Copyright (C) 2016 NooBaa */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace noobaa
+{
+
+/**
+ * TreeRemover deletes a directory tree (like rm -rf) with a bounded number of threads.
+ *
+ * Every directory is listed with getdents64 on its fd, and its entries are unlinked with unlinkat
+ * relative to that fd, so there is no path resolution and no JS object or threadpool item per entry.
+ * Subdirectories are opened with openat O_NOFOLLOW on the fd of their parent and removed with
+ * unlinkat AT_REMOVEDIR on it, so replacing a directory of the tree with a symlink during the
+ * removal cannot make it delete files outside the tree (the rm -rf race of removing by paths).
+ * Subdirectories are queued for the other threads (depth first to keep the queue short),
+ * and a directory is removed by the thread that finishes its last subdirectory.
+ * A directory keeps its fd open until it is removed, for its subdirectories to use.
+ *
+ * The calling thread is one of the workers. Extra threads are started only when subdirectories
+ * are queued and no thread is idle to take them, so removing a flat directory starts none,
+ * and they are bounded by the concurrency of the removal and by MAX_THREADS in the process.
+ * The extra threads take the caller identity (uid, gid, groups) once when they start.
+ */
+class TreeRemover
+{
+public:
+    static const int MAX_CONCURRENCY = 64;
+    // extra threads of all the removals running in the process
+    static const int MAX_THREADS = 64;
+    // directories that keep getting new entries while they are removed fail with ENOTEMPTY after these
+    static const int MAX_RMDIR_RETRIES = 3;
+
+    TreeRemover(uid_t uid, gid_t gid, const std::vector<gid_t>& groups, int concurrency);
+
+    // called from the worker threads after every directory listing,
+    // returning false cancels the removal with ECANCELED
+    std::function<bool(uint64_t files, uint64_t dirs)> on_progress;
+
+    // returns 0 on success or an errno value
+    int run(const std::string& root);
+
+    uint64_t files() const { return _files; }
+    uint64_t dirs() const { return _dirs; }
+
+private:
+    struct Node
+    {
+        // the name in the parent directory, and its fd which is opened when it is listed
+        std::string name;
+        int fd = -1;
+        std::shared_ptr<Node> parent;
+        // the subdirectories not removed yet, plus one while the node itself is being listed
+        std::atomic<int> pending{ 1 };
+        int retries = 0;
+        ~Node();
+    };
+    typedef std::shared_ptr<Node> NodeRef;
+
+    void _thread_main(bool extra);
+    NodeRef _pop(bool starting);
+    void _push(std::vector<NodeRef>& nodes);
+    void _start_threads();
+    void _remove_dir(NodeRef node, std::vector<char>& buf);
+    void _finish(NodeRef node);
+    int _parent_fd(const NodeRef& node) const { return node->parent ? node->parent->fd : _root_parent_fd; }
+    void _fail(int err);
+    void _done();
+
+    uid_t _uid;
+    gid_t _gid;
+    std::vector<gid_t> _groups;
+    int _concurrency;
+    // the directory of the root, which the root is opened and removed from
+    int _root_parent_fd;
+
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::vector<NodeRef> _queue;
+    std::vector<std::thread> _threads;
+    // threads waiting in _pop, and threads started that did not reach _pop yet
+    int _waiting;
+    int _starting;
+    std::atomic<bool> _stopped;
+    int _error;
+
+    std::atomic<uint64_t> _files;
+    std::atomic<uint64_t> _dirs;
+};
+
+} // namespace noobaa
@@ -0,0 +1,80 @@
+/* Copyright (C) 2016 NooBaa */
+#include "tree_walk.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#ifdef __linux__
+    #include <sys/syscall.h>
+#endif
+
+namespace noobaa
+{
+
+#ifdef __linux__
+// the kernel struct for getdents64, which has no header in older libc versions
+struct Linux_Dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+#endif
+
+static inline bool
+_is_dot_or_dotdot(const char* name)
+{
+    return name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0));
+}
+
+int
+for_each_dir_entry(int fd, std::vector<char>& buf, const std::function<int(const char* name, unsigned char type)>& cb)
+{
+#ifdef __linux__
+    if (buf.size() < TREE_WALK_DIRENTS_BUF_SIZE) buf.resize(TREE_WALK_DIRENTS_BUF_SIZE);
+    for (;;) {
+        long n = syscall(SYS_getdents64, fd, buf.data(), buf.size());
+        if (n < 0) return errno;
+        if (n == 0) return 0;
+        for (long pos = 0; pos < n;) {
+            const Linux_Dirent64* d = reinterpret_cast<const Linux_Dirent64*>(buf.data() + pos);
+            const char* name = buf.data() + pos + offsetof(Linux_Dirent64, d_name);
+            pos += d->d_reclen;
+            if (_is_dot_or_dotdot(name)) continue;
+            int err = cb(name, d->d_type);
+            if (err) return err;
+        }
+    }
+#else
+    // fdopendir takes ownership of the fd, so give it a dup and leave the caller fd open
+    int dir_fd = dup(fd);
+    if (dir_fd < 0) return errno;
+    DIR* dir = fdopendir(dir_fd);
+    if (!dir) {
+        int err = errno;
+        close(dir_fd);
+        return err;
+    }
+    int err = 0;
+    for (;;) {
+        errno = 0;
+        struct dirent* e = readdir(dir);
+        if (!e) {
+            err = errno;
+            break;
+        }
+        if (_is_dot_or_dotdot(e->d_name)) continue;
+        err = cb(e->d_name, e->d_type);
+        if (err) break;
+    }
+    closedir(dir);
+    return err;
+#endif
+}
+
+} // namespace noobaa
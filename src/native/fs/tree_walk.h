@@ -0,0 +1,21 @@
+/* Copyright (C) 2016 NooBaa */
+#pragma once
+
+#include <functional>
+#include <vector>
+
+namespace noobaa
+{
+
+#define TREE_WALK_DIRENTS_BUF_SIZE (64 * 1024)
+
+/**
+ * for_each_dir_entry reads the entries of an open directory fd with getdents64 (readdir on other platforms)
+ * and calls cb for every entry except . and .. with its name and d_type (which can be DT_UNKNOWN).
+ * buf is a reusable buffer of TREE_WALK_DIRENTS_BUF_SIZE for the calling thread.
+ * The callback returns 0 to continue or an errno value to stop, which is then returned.
+ * Returns 0 when all the entries were read, or the errno of the listing.
+ */
+int for_each_dir_entry(int fd, std::vector<char>& buf, const std::function<int(const char* name, unsigned char type)>& cb);
+
+} // namespace noobaa
@@ -4,12 +4,17 @@
 #include "../util/buf.h"
 #include "../util/endian.h"
 
+#include <algorithm>
+
 namespace noobaa
 {
 
 DBG_INIT(0);
 
 Nan::Persistent<v8::Function> Ntcp::_ctor;
+std::atomic<int> Ntcp::_recv_pinned_chunks(0);
+std::atomic<uint64_t> Ntcp::_recv_copied_msgs(0);
+const int Ntcp::RECV_MAX_PINNED_CHUNKS;
 
 static const int NTCP_SNDBUF_SIZE = 128 * 1024;
 static const int NTCP_RCVBUF_SIZE = 128 * 1024;
@@ -26,6 +31,7 @@ NAN_MODULE_INIT(Ntcp::setup)
     Nan::SetPrototypeMethod(tpl, "listen", Ntcp::listen);
     Nan::SetPrototypeMethod(tpl, "connect", Ntcp::connect);
     Nan::SetPrototypeMethod(tpl, "write", Ntcp::write);
+    Nan::SetMethod(tpl, "recv_stats", Ntcp::recv_stats);
     auto func = Nan::GetFunction(tpl).ToLocalChecked();
     _ctor.Reset(func);
     NAN_SET(target, name, func);
@@ -40,9 +46,13 @@ NAN_METHOD(Ntcp::new_instance)
 }
 
 Ntcp::Ntcp()
-    : _recv_payload(NULL)
-    , _recv_hdr_pos(0)
+    : _recv_chunk(NULL)
+    , _recv_start(0)
+    , _recv_end(0)
+    , _recv_payload(NULL)
+    , _recv_payload_len(0)
     , _recv_payload_pos(0)
+    , _writing(false)
     // , _send_msg_seq(1)
     , _recv_msg_seq(1)
     , _closed(false)
@@ -52,6 +62,7 @@ Ntcp::Ntcp()
     DBG2("Ntcp::Ntcp");
     NAUV_CALL(uv_tcp_init(uv_default_loop(), &_tcp_handle));
     _tcp_handle.data = this;
+    _write_req.data = this;
 }
 
 Ntcp::~Ntcp()
@@ -60,6 +71,15 @@ Ntcp::~Ntcp()
     _close();
 }
 
+NAN_METHOD(Ntcp::recv_stats)
+{
+    auto res = NAN_NEW_OBJ();
+    NAN_SET_INT(res, "pinned_chunks", _recv_pinned_chunks.load());
+    NAN_SET_NUM(res, "max_pinned_chunks", RECV_MAX_PINNED_CHUNKS);
+    NAN_SET_NUM(res, "copied_msgs", _recv_copied_msgs.load());
+    NAN_RETURN(res);
+}
+
 NAN_METHOD(Ntcp::close)
 {
     Ntcp& self = *NAN_UNWRAP_THIS(Ntcp);
@@ -78,9 +98,16 @@ Ntcp::_close()
     uv_close(reinterpret_cast<uv_handle_t*>(&_tcp_handle), NULL);
     if (_recv_payload) {
         delete[] _recv_payload;
+        _recv_payload = NULL;
+    }
+    if (_recv_chunk) {
+        _retire_recv_chunk();
+        _recv_chunk = NULL;
     }
     Nan::HandleScope scope;
     _reading_persistent.Reset();
+    // the inflight write is cancelled by uv_close and fails in _write_callback
+    _fail_writes(_send_queue, "Ntcp::write: CLOSED");
     if (*handle()) {
         v8::Local<v8::Value> argv[] = {NAN_STR("close")};
         NAN_CALLBACK(handle(), "emit", 1, argv);
@@ -215,24 +242,24 @@ NAUV_CALLBACK_STATUS(Ntcp::_connect_callback, uv_connect_t* req)
 NAN_METHOD(Ntcp::write)
 {
     Ntcp& self = *NAN_UNWRAP_THIS(Ntcp);
-    NanCallbackSharedPtr callback(new Nan::Callback(info[1].As<v8::Function>()));
+    NanCallbackSharedPtr callback;
+    if (info[1]->IsFunction()) {
+        callback.reset(new Nan::Callback(info[1].As<v8::Function>()));
+    }
     if (self._closed) {
         DBG5("Ntcp::write: closed. thats an error.");
-        v8::Local<v8::Value> argv[] = {NAN_ERR("Ntcp::write: CLOSED")};
-        Nan::Call(*callback, 1, argv);
+        if (callback) {
+            v8::Local<v8::Value> argv[] = {NAN_ERR("Ntcp::write: CLOSED")};
+            Nan::Call(*callback, 1, argv);
+        }
         return;
     }
-    // if (!self._local_port) {
-    //     DBG5("Ntcp::write: not connected. thats an error.");
-    //     v8::Local<v8::Value> argv[] = { NAN_ERR("Ntcp::write: NOT CONNECTED") };
-    //     Nan::Call(*callback, 1, argv);
-    //     return;
-    // }
-    uv_write_t* write_req = new uv_write_t;
+    v8::Local<v8::Object> buffer_or_buffers = Nan::To<v8::Object>(info[0]).ToLocalChecked();
+    if (!node::Buffer::HasInstance(buffer_or_buffers) && !buffer_or_buffers->IsArray()) {
+        return Nan::ThrowError("Ntcp::write: expected buffer or array of buffers");
+    }
     Msg* m = new Msg;
-    write_req->data = m;
     m->callback = callback;
-    v8::Local<v8::Object> buffer_or_buffers = Nan::To<v8::Object>(info[0]).ToLocalChecked();
     m->persistent.Reset(buffer_or_buffers); // keep persistent ref to the buffer
     if (node::Buffer::HasInstance(buffer_or_buffers)) {
         m->iovecs.resize(2);
@@ -241,7 +268,7 @@ NAN_METHOD(Ntcp::write)
         m->iovecs[1].base = node::Buffer::Data(buffer_or_buffers);
         m->iovecs[1].len = node::Buffer::Length(buffer_or_buffers);
         m->hdr.len = m->iovecs[1].len;
-    } else if (buffer_or_buffers->IsArray()) {
+    } else {
         int num_buffers = buffer_or_buffers.As<v8::Array>()->Length();
         m->iovecs.resize(num_buffers + 1);
         m->iovecs[0].base = reinterpret_cast<char*>(&m->hdr);
@@ -254,46 +281,108 @@ NAN_METHOD(Ntcp::write)
             m->iovecs[i + 1].len = len;
             m->hdr.len += len;
         }
-    } else {
-        return Nan::ThrowError("Ntcp::write: expected buffer or array of buffers");
     }
-    // m->hdr.seq = self._send_msg_seq++;
     DBG2(
         "Ntcp::write:"
-        //  << " seq " << m->hdr.seq
         << " len "
         << m->hdr.len
+        << " queued "
+        << self._send_queue.size()
         << " local_port "
         << self._local_port);
     m->hdr.encode();
+    self._send_queue.push_back(m);
+    if (!self._writing) {
+        self._flush_writes();
+    }
+    NAN_RETURN(Nan::Undefined());
+}
+
+/**
+ * _flush_writes submits the queued messages with a single uv_write.
+ * Messages that are written while a write is inflight stay queued until it completes,
+ * so a burst of small messages from the same tick is sent with one writev syscall.
+ */
+void
+Ntcp::_flush_writes()
+{
+    _send_iovecs.clear();
+    while (!_send_queue.empty()) {
+        Msg* m = _send_queue.front();
+        if (!_send_inflight.empty() && _send_iovecs.size() + m->iovecs.size() > SEND_MAX_IOVECS) {
+            break;
+        }
+        _send_iovecs.insert(_send_iovecs.end(), m->iovecs.begin(), m->iovecs.end());
+        _send_inflight.push_back(m);
+        _send_queue.pop_front();
+    }
+    if (_send_inflight.empty()) {
+        return;
+    }
+    DBG2(
+        "Ntcp::_flush_writes:"
+        << " msgs "
+        << _send_inflight.size()
+        << " iovecs "
+        << _send_iovecs.size()
+        << " local_port "
+        << _local_port);
+    _writing = true;
+    // _write_req is a member, so keep the object from being collected until _write_callback,
+    // which also runs for a write that was cancelled by uv_close
+    Ref();
+    // uv_write copies the iovecs array so it can be reused for the next flush
     NAUV_CALL(uv_write(
-        write_req,
-        reinterpret_cast<uv_stream_t*>(&self._tcp_handle),
-        m->iovecs.data(),
-        m->iovecs.size(),
+        &_write_req,
+        reinterpret_cast<uv_stream_t*>(&_tcp_handle),
+        _send_iovecs.data(),
+        _send_iovecs.size(),
         &Ntcp::_write_callback));
-    NAN_RETURN(Nan::Undefined());
 }
 
 NAUV_CALLBACK_STATUS(Ntcp::_write_callback, uv_write_t* req)
 {
     Nan::HandleScope scope;
-    Msg* m = reinterpret_cast<Msg*>(req->data);
-    m->hdr.decode();
+    Ntcp& self = *reinterpret_cast<Ntcp*>(req->data);
+    std::deque<Msg*> msgs;
+    msgs.swap(self._send_inflight);
+    self._writing = false;
+    DBG2(
+        "Ntcp::_write_callback:"
+        << " msgs "
+        << msgs.size()
+        << " status "
+        << status);
     if (status < 0) {
-        v8::Local<v8::Value> argv[] = {NAN_ERR("Ntcp::write: ERROR")};
-        Nan::Call(*m->callback, 1, argv);
+        self._fail_writes(msgs, "Ntcp::write: ERROR");
     } else {
-        DBG2(
-            "Ntcp::_write_callback:"
-            // << " seq " << m->hdr.seq
-            << " len "
-            << m->hdr.len);
-        v8::Local<v8::Value> args[] = {Nan::Undefined()};
-        Nan::Call(*m->callback, 1, args);
+        for (Msg* m : msgs) {
+            if (m->callback) {
+                v8::Local<v8::Value> args[] = {Nan::Undefined()};
+                Nan::Call(*m->callback, 1, args);
+            }
+            delete m;
+        }
+    }
+    // the callbacks might have already started the next write
+    if (!self._closed && !self._writing) {
+        self._flush_writes();
+    }
+    self.Unref();
+}
+
+void
+Ntcp::_fail_writes(std::deque<Msg*>& msgs, const char* err)
+{
+    std::deque<Msg*> failed;
+    failed.swap(msgs);
+    for (Msg* m : failed) {
+        if (m->callback) {
+            v8::Local<v8::Value> argv[] = {NAN_ERR(err)};
+            Nan::Call(*m->callback, 1, argv);
+        }
+        delete m;
     }
-    delete m;
-    delete req;
 }
 
 void
@@ -328,112 +417,175 @@ Ntcp::_callback_read(uv_stream_t* handle, ssize_t nread, const uv_buf_t* buf)
     self._read_data(buf, nread);
 }
 
+void
+Ntcp::_new_recv_chunk()
+{
+    RecvChunk* chunk = new RecvChunk;
+    size_t pending = 0;
+    if (_recv_chunk) {
+        // move the partial message to the new chunk
+        pending = _recv_end - _recv_start;
+        memcpy(chunk->data, _recv_chunk->data + _recv_start, pending);
+        _retire_recv_chunk();
+    }
+    _recv_chunk = chunk;
+    _recv_start = 0;
+    _recv_end = pending;
+}
+
+/**
+ * _retire_recv_chunk drops the connection reference of the current chunk.
+ * node buffers sliced from the chunk keep it alive until they are released,
+ * and it is counted as pinned meanwhile.
+ */
+void
+Ntcp::_retire_recv_chunk()
+{
+    if (--_recv_chunk->refs == 0) {
+        delete _recv_chunk;
+        return;
+    }
+    _recv_chunk->pinned = true;
+    _recv_pinned_chunks += 1;
+}
+
+void
+Ntcp::_release_recv_chunk(char* data, void* hint)
+{
+    RecvChunk* chunk = reinterpret_cast<RecvChunk*>(hint);
+    if (--chunk->refs == 0) {
+        if (chunk->pinned) _recv_pinned_chunks -= 1;
+        delete chunk;
+    }
+}
+
 void
 Ntcp::_alloc_for_read(uv_buf_t* buf, size_t suggested_size)
 {
-    if (!_recv_payload) {
-        buf->len = MSG_HDR_SIZE - _recv_hdr_pos;
-        buf->base = reinterpret_cast<char*>(&_recv_hdr) + _recv_hdr_pos;
-        DBG8(
-            "Ntcp::_alloc_for_read: allocate hdr pos " << _recv_hdr_pos << " len " << buf->len
-                                                       << " suggested "
-                                                       << suggested_size);
-    } else {
-        buf->len = _recv_hdr.len - _recv_payload_pos;
+    if (_recv_payload) {
+        buf->len = _recv_payload_len - _recv_payload_pos;
         buf->base = _recv_payload + _recv_payload_pos;
         DBG8(
             "Ntcp::_alloc_for_read: allocate payload pos " << _recv_payload_pos << " len "
                                                            << buf->len
                                                            << " suggested "
                                                            << suggested_size);
+        return;
+    }
+    if (_recv_chunk && _recv_start == _recv_end && _recv_chunk->refs == 1) {
+        // no message buffers reference the chunk so it can be reused from the start
+        _recv_start = 0;
+        _recv_end = 0;
+    }
+    if (!_recv_chunk || RECV_CHUNK_SIZE - _recv_end < RECV_CHUNK_MIN_FREE) {
+        _new_recv_chunk();
     }
+    buf->len = RECV_CHUNK_SIZE - _recv_end;
+    buf->base = _recv_chunk->data + _recv_end;
+    DBG8(
+        "Ntcp::_alloc_for_read: allocate chunk pos " << _recv_end << " len " << buf->len
+                                                     << " suggested "
+                                                     << suggested_size);
 }
 
 void
-Ntcp::_read_data(const uv_buf_t* buf, size_t nread)
+Ntcp::_read_data(const uv_buf_t* buf, ssize_t nread)
 {
     DBG3("Ntcp::_read_data: nread " << nread);
+    if (nread == 0) {
+        return; // means EGAIN/EWOULDBLOCK so we can ignore
+    }
+    if (nread < 0) {
+        DBG0("Ntcp::_read_data: " << uv_strerror(nread) << " local_port " << _local_port);
+        _close();
+        return;
+    }
     if (DBG_VISIBLE(9)) {
         Buf::hexdump(buf->base, nread > 128 ? 128 : nread, "Ntcp::_read_data");
     }
-    // if (nread < 0) {
-    //     // TODO
-    //     PANIC("Ntcp::_read_data failed");
-    //     return;
-    // }
-    if (nread == 0) {
-        return; // means EGAIN/EWOULDBLOCK so we can ignore
+
+    Nan::HandleScope scope;
+    v8::Local<v8::Array> msgs = Nan::New<v8::Array>();
+    uint32_t num_msgs = 0;
+
+    if (_recv_payload) {
+        _recv_payload_pos += nread;
+        if (_recv_payload_pos < _recv_payload_len) {
+            return;
+        }
+        // ownership on memory passed to the node buffer
+        Nan::Set(msgs, num_msgs++, Nan::NewBuffer(_recv_payload, _recv_payload_len).ToLocalChecked());
+        _recv_payload = NULL;
+    } else {
+        _recv_end += nread;
     }
-    if (!_recv_payload) {
-        _recv_hdr_pos += nread;
-        // process the header when full
-        if (_recv_hdr_pos >= MSG_HDR_SIZE) {
-            if (DBG_VISIBLE(9)) {
-                Buf::hexdump(&_recv_hdr, MSG_HDR_SIZE, "Ntcp::_read_data: (header)");
-            }
-            _recv_hdr.decode();
-            DBG3(
-                "Ntcp::_read_data: incoming message"
-                //  << " seq " << _recv_hdr.seq
+
+    // parse all the complete messages that arrived in the chunk
+    while (!_recv_payload && _recv_end - _recv_start >= (size_t)MSG_HDR_SIZE) {
+        MsgHdr hdr;
+        memcpy(&hdr, _recv_chunk->data + _recv_start, MSG_HDR_SIZE);
+        hdr.decode();
+        if (!hdr.is_valid() || hdr.len > (uint32_t)MAX_MSG_LEN) {
+            Buf::hexdump(_recv_chunk->data + _recv_start, MSG_HDR_SIZE, "Ntcp::_read_data: (header)");
+            LOG("Ntcp::_read_data: bad message, closing connection:"
                 << " len "
-                << _recv_hdr.len
+                << hdr.len
                 << " local_port "
                 << _local_port);
-            if (_recv_hdr.len > MAX_MSG_LEN) {
-                // TODO close connection instead of panic
-                LOG("Ntcp::_read_data: message too big:"
-                    // << " magic " << _recv_hdr.magic
-                    // << " seq " << _recv_hdr.seq
-                    // << " seq " << _recv_msg_seq
-                    << " len "
-                    << _recv_hdr.len);
-                _recv_hdr.len = 0;
-            }
-            _recv_payload = new char[_recv_hdr.len];
-            _recv_hdr_pos = 0;
-            _recv_payload_pos = 0;
+            _close();
+            return;
         }
-    } else {
-        _recv_payload_pos += nread;
-        // process the payload when full
-        if (_recv_payload_pos >= (int)_recv_hdr.len) {
-            if (!_recv_hdr.is_valid()
-                // || _recv_hdr.seq != _recv_msg_seq
-            ) {
-                Buf::hexdump(&_recv_hdr, MSG_HDR_SIZE, "Ntcp::_read_data: (header decoded)");
-                Buf::hexdump(
-                    _recv_payload,
-                    _recv_hdr.len > 128 ? 128 : _recv_hdr.len,
-                    "Ntcp::_read_data: (payload)");
-                // TODO close connection instead of panic
-                PANIC(
-                    "Ntcp::_read_data: bad message:"
-                    //   << " magic " << _recv_hdr.magic
-                    //   << " seq " << _recv_hdr.seq
-                    //   << " expected " << _recv_msg_seq
-                    << " len "
-                    << _recv_hdr.len);
+        size_t avail = _recv_end - _recv_start - MSG_HDR_SIZE;
+        if (hdr.len >= RECV_LARGE_MSG_LEN) {
+            // large messages get their own buffer and the rest of the payload is read directly into it
+            size_t n = std::min<size_t>(avail, hdr.len);
+            _recv_payload = new char[hdr.len];
+            _recv_payload_len = hdr.len;
+            _recv_payload_pos = n;
+            memcpy(_recv_payload, _recv_chunk->data + _recv_start + MSG_HDR_SIZE, n);
+            _recv_start += MSG_HDR_SIZE + n;
+            if (_recv_payload_pos < _recv_payload_len) {
+                break;
             }
-            _recv_msg_seq += 1;
-            // ownership on memory passed to the node buffer
-            Nan::HandleScope scope;
-            v8::Local<v8::Object> node_buf =
-                Nan::NewBuffer(_recv_payload, _recv_hdr.len).ToLocalChecked();
+            Nan::Set(msgs, num_msgs++, Nan::NewBuffer(_recv_payload, _recv_payload_len).ToLocalChecked());
             _recv_payload = NULL;
-            _recv_hdr_pos = 0;
-            _recv_payload_pos = 0;
-            // emit the message buffer
-            DBG3(
-                "Ntcp::_read_data: incoming message completed"
-                //  << " seq " << _recv_hdr.seq
-                << " len "
-                << _recv_hdr.len
-                << " local_port "
-                << _local_port);
-            v8::Local<v8::Value> argv[] = {NAN_STR("message"), node_buf};
-            NAN_CALLBACK(handle(), "emit", 2, argv);
+            continue;
+        }
+        if (avail < hdr.len) {
+            break;
         }
+        if (hdr.len && _recv_pinned_chunks < RECV_MAX_PINNED_CHUNKS) {
+            // small messages are handed out as slices of the chunk without copying
+            _recv_chunk->refs += 1;
+            Nan::Set(msgs, num_msgs++, Nan::NewBuffer(
+                _recv_chunk->data + _recv_start + MSG_HDR_SIZE,
+                hdr.len,
+                _release_recv_chunk,
+                _recv_chunk).ToLocalChecked());
+        } else if (hdr.len) {
+            // too many chunks are held by retained messages, so copy instead of pinning more chunks
+            _recv_copied_msgs += 1;
+            Nan::Set(msgs, num_msgs++, Nan::CopyBuffer(
+                _recv_chunk->data + _recv_start + MSG_HDR_SIZE,
+                hdr.len).ToLocalChecked());
+        } else {
+            Nan::Set(msgs, num_msgs++, Nan::NewBuffer(0).ToLocalChecked());
+        }
+        _recv_start += MSG_HDR_SIZE + hdr.len;
+    }
+
+    if (!num_msgs) {
+        return;
     }
+    _recv_msg_seq += num_msgs;
+    DBG3(
+        "Ntcp::_read_data: incoming messages "
+        << num_msgs
+        << " local_port "
+        << _local_port);
+    // emit all the messages of this read in a single callback
+    v8::Local<v8::Value> argv[] = {NAN_STR("messages"), msgs};
+    NAN_CALLBACK(handle(), "emit", 2, argv);
 }
 
 Ntcp::Msg::Msg()
@@ -459,6 +611,16 @@ Ntcp::MsgHdr::decode()
     // seq = be64toh(seq);
 }
 
+Ntcp::RecvChunk::RecvChunk()
+    : data(new char[RECV_CHUNK_SIZE])
+    , refs(1)
+    , pinned(false) {}
+
+Ntcp::RecvChunk::~RecvChunk()
+{
+    delete[] data;
+}
+
 const char Ntcp::MSG_HDR_MAGIC[Ntcp::MSG_MAGIC_LEN] = {'N', 't', 'c', 'p'};
 
 bool
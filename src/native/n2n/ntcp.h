@@ -3,6 +3,9 @@
 
 #include "../util/nan.h"
 
+#include <atomic>
+#include <deque>
+
 namespace noobaa
 {
 
@@ -19,12 +22,14 @@ private:
     static NAN_METHOD(listen);
     static NAN_METHOD(connect);
     static NAN_METHOD(write);
+    static NAN_METHOD(recv_stats);
 
 private:
     // uv callbacks
     static NAUV_CALLBACK_STATUS(_connection_callback, uv_stream_t* handle);
     static NAUV_CALLBACK_STATUS(_connect_callback, uv_connect_t* handle);
     static NAUV_CALLBACK_STATUS(_write_callback, uv_write_t* handle);
+    static void _release_recv_chunk(char* data, void* hint);
     static NAUV_ALLOC_CB_WRAP(_callback_alloc_wrap, _callback_alloc);
     static NAUV_READ_CB_WRAP(_callback_read_wrap, _callback_read);
     static void _callback_alloc(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf);
@@ -32,6 +37,18 @@ private:
 
 private:
     static const int MAX_MSG_LEN = 64 * 1024 * 1024;
+    // small messages are parsed from a shared receive chunk and handed out as slices of it,
+    // while messages of at least RECV_LARGE_MSG_LEN are read directly into their own buffer.
+    static const size_t RECV_CHUNK_SIZE = 256 * 1024;
+    static const size_t RECV_CHUNK_MIN_FREE = 16 * 1024;
+    static const size_t RECV_LARGE_MSG_LEN = 64 * 1024;
+    // a chunk that was replaced while message buffers still reference it stays pinned until they are released,
+    // so once this many chunks are pinned (by all connections) small messages are copied instead of sliced.
+    static const int RECV_MAX_PINNED_CHUNKS = 64;
+    static std::atomic<int> _recv_pinned_chunks;
+    static std::atomic<uint64_t> _recv_copied_msgs;
+    // limits the number of iovecs of a single coalesced uv_write
+    static const size_t SEND_MAX_IOVECS = 1024;
     static const int MSG_MAGIC_LEN = 4;
     static const char MSG_HDR_MAGIC[MSG_MAGIC_LEN];
 
@@ -67,6 +84,16 @@ private:
 
     static const int MSG_HDR_SIZE = sizeof(MsgHdr);
 
+    // the receive chunk is referenced by the connection while it reads into it,
+    // and by every node buffer that was sliced from it.
+    struct RecvChunk {
+        char* data;
+        int refs;
+        bool pinned;
+        RecvChunk();
+        ~RecvChunk();
+    };
+
 private:
     explicit Ntcp();
     ~Ntcp();
@@ -75,14 +102,26 @@ private:
     void _accept(uv_stream_t* listener);
     void _start_reading();
     void _alloc_for_read(uv_buf_t* buf, size_t suggested_size);
-    void _read_data(const uv_buf_t* buf, size_t nread);
+    void _read_data(const uv_buf_t* buf, ssize_t nread);
+    void _new_recv_chunk();
+    void _retire_recv_chunk();
+    void _flush_writes();
+    void _fail_writes(std::deque<Msg*>& msgs, const char* err);
 
 private:
     uv_tcp_t _tcp_handle;
-    MsgHdr _recv_hdr;
+    RecvChunk* _recv_chunk;
+    size_t _recv_start; // offset of the first unparsed byte in the chunk
+    size_t _recv_end;   // offset of the end of received data in the chunk
     char* _recv_payload;
-    int _recv_hdr_pos;
-    int _recv_payload_pos;
+    uint32_t _recv_payload_len;
+    uint32_t _recv_payload_pos;
+    // messages waiting for the current write to complete are coalesced to the next write
+    std::deque<Msg*> _send_queue;
+    std::deque<Msg*> _send_inflight;
+    std::vector<uv_buf_t> _send_iovecs;
+    uv_write_t _write_req;
+    bool _writing;
     // uint64_t _send_msg_seq;
     uint64_t _recv_msg_seq;
     bool _closed;
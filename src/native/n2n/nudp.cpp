@@ -1,7 +1,14 @@
 /* Copyright (C) 2016 NooBaa */
 #include "nudp.h"
 
+#include <vector>
+
 #include <zlib.h>
+#ifdef __linux__
+#include <errno.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#endif
 
 #include "../third_party/libutp/utp.h"
 #include "../util/buf.h"
@@ -18,6 +25,44 @@ static const int UTP_TARGET_DELAY_MICROS = 10000;
 static const int UTP_SNDBUF_SIZE = 128 * 1024;
 static const int UTP_RCVBUF_SIZE = 128 * 1024;
 
+// packets queued beyond this count are flushed without waiting for the loop iteration to end
+static const size_t SEND_BATCH_MAX_PACKETS = 1024;
+// max messages per sendmmsg call
+static const size_t SEND_MMSG_MAX = 64;
+// UDP_SEGMENT limits - segments per message and total bytes (the max udp payload)
+static const size_t GSO_MAX_SEGMENTS = 64;
+static const size_t GSO_MAX_BYTES = 65507;
+// recvmmsg splits the receive buffer to 64KB datagram slots, and libuv reads up to 20 at once
+static const size_t RECV_DGRAM_MAX_SIZE = 64 * 1024;
+static const size_t RECV_BUF_SIZE = 20 * RECV_DGRAM_MAX_SIZE;
+
+#if defined(__linux__) && !defined(UDP_SEGMENT)
+#define UDP_SEGMENT 103
+#endif
+
+#if UV_VERSION_HEX >= 0x012800
+// libuv >= 1.40 reads with recvmmsg and signals the end of the batch with UV_UDP_MMSG_FREE
+#define NUDP_UV_RECVMMSG 1
+#else
+#define NUDP_UV_RECVMMSG 0
+#endif
+
+struct Nudp::SendBatch {
+    struct Packet {
+        size_t offset;
+        size_t len;
+        struct sockaddr_in sin;
+    };
+    std::vector<Packet> packets;
+    std::vector<char> data;
+#ifdef __linux__
+    std::vector<struct mmsghdr> msgs;
+    std::vector<size_t> msg_packets;
+    std::vector<struct iovec> iovecs;
+    std::vector<char> cmsgs;
+#endif
+};
+
 // static std::string addrinfo2str(const struct addrinfo *ai);
 static std::string sockaddr2str(const struct sockaddr* sa);
 static bool is_stun_packet(const void* packet, int len);
@@ -44,12 +89,17 @@ NAN_METHOD(Nudp::new_instance)
 {
     NAN_MAKE_CTOR_CALL(_ctor);
     Nudp* obj = new Nudp();
+    if (info.Length() > 0 && info[0]->IsObject()) {
+        auto options = Nan::To<v8::Object>(info[0]).ToLocalChecked();
+        auto gso = NAN_GET(options, "gso");
+        if (!gso->IsUndefined()) obj->_gso_allowed = Nan::To<bool>(gso).FromJust();
+    }
     obj->Wrap(info.This());
     info.GetReturnValue().Set(info.This());
 }
 
 Nudp::Nudp()
-    : _utp_socket(NULL), _recv_payload(NULL), _recv_hdr_pos(0), _recv_payload_pos(0), _send_msg_seq(1), _recv_msg_seq(1), _closed(false), _receiving(false), _local_port(0)
+    : _utp_socket(NULL), _send_batch(new SendBatch), _recv_buf(NULL), _gso_allowed(true), _gso_enabled(false), _udp_packets_sent(0), _udp_send_calls(0), _recv_payload(NULL), _recv_hdr_pos(0), _recv_payload_pos(0), _send_msg_seq(1), _recv_msg_seq(1), _closed(false), _receiving(false), _local_port(0)
 {
     DBG2("Nudp::Nudp");
     _utp_ctx = utp_init(2); // version=2
@@ -74,7 +124,11 @@ Nudp::Nudp()
         utp_context_set_option(_utp_ctx, UTP_LOG_DEBUG, 1);
     }
 
+#if NUDP_UV_RECVMMSG
+    NAUV_CALL(uv_udp_init_ex(uv_default_loop(), &_uv_udp_handle, AF_UNSPEC | UV_UDP_RECVMMSG));
+#else
     NAUV_CALL(uv_udp_init(uv_default_loop(), &_uv_udp_handle));
+#endif
     NAUV_CALL(uv_timer_init(uv_default_loop(), &_uv_timer_handle));
     // the timer interval follows from libutp's TIMEOUT_CHECK_INTERVAL
     NAUV_CALL(uv_timer_start(&_uv_timer_handle, &Nudp::uv_callback_timer, 0, 520));
@@ -91,6 +145,9 @@ Nudp::~Nudp()
 {
     DBG2("Nudp::~Nudp");
     _close();
+    delete _send_batch;
+    // kept until destruction since close can be called while processing a received packet
+    delete[] _recv_buf;
 }
 
 NAN_METHOD(Nudp::close)
@@ -127,6 +184,8 @@ Nudp::_close()
     if (_recv_payload) {
         delete[] _recv_payload;
     }
+    _send_batch->packets.clear();
+    _send_batch->data.clear();
     while (!_messages.empty()) {
         Msg* m = _messages.front();
         v8::Local<v8::Value> argv[] = {NAN_ERR("NUDP CLOSED")};
@@ -493,6 +552,16 @@ Nudp::_bind(const char* address, int port)
         uv_recv_buffer_size(reinterpret_cast<uv_handle_t*>(&_uv_udp_handle), &udp_buffer_size));
     NAUV_CALL(uv_udp_getsockname(&_uv_udp_handle, NAUV_UDP_ADDR(&sin), &sin_len));
     _local_port = ntohs(sin.sin_port);
+#ifdef __linux__
+    // UDP_SEGMENT (linux 4.18) lets sendmmsg pass a run of equal sized packets as one message
+    uv_os_fd_t fd;
+    if (_gso_allowed && !uv_fileno(reinterpret_cast<uv_handle_t*>(&_uv_udp_handle), &fd)) {
+        int gso_size = 0;
+        socklen_t gso_size_len = sizeof(gso_size);
+        _gso_enabled = getsockopt(fd, SOL_UDP, UDP_SEGMENT, &gso_size, &gso_size_len) == 0;
+    }
+#endif
+    DBG1("Nudp::_bind: local_port " << _local_port << " gso " << _gso_enabled);
     _start_receiving();
 }
 
@@ -555,14 +624,23 @@ NAUV_CALLBACK(Nudp::uv_callback_prepare, uv_prepare_t* handle)
         return;
     }
     utp_issue_deferred_acks(self._utp_ctx);
+    // the prepare phase runs once per loop iteration before polling,
+    // so packets sent from any callback of the last iteration go out together
+    self._flush_sends();
 }
 
 void
 Nudp::uv_callback_alloc(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf)
 {
-    buf->len = suggested_size;
-    buf->base = new char[buf->len];
-    DBG9("Nudp::uv_callback_alloc: allocating " << buf->len << " suggested " << suggested_size);
+    // a single receive buffer is reused for all reads since received packets
+    // are processed synchronously by utp and stun packets are copied out.
+    Nudp& self = *reinterpret_cast<Nudp*>(handle->data);
+    if (!self._recv_buf) {
+        self._recv_buf = new char[RECV_BUF_SIZE];
+    }
+    buf->base = self._recv_buf;
+    buf->len = RECV_BUF_SIZE;
+    DBG9("Nudp::uv_callback_alloc: buffer " << buf->len << " suggested " << suggested_size);
 }
 
 void
@@ -597,8 +675,14 @@ Nudp::uv_callback_receive(
             << " buf len "
             << buf->len);
     }
+#if NUDP_UV_RECVMMSG
+    // end of a recvmmsg batch, the buffer is reused so nothing to free
+    if (flags & UV_UDP_MMSG_FREE) {
+        return;
+    }
+#endif
+    // nread 0 with no addr means nothing more to read, errors are left for utp timeouts
     if (nread <= 0) {
-        delete[] buf->base;
         return;
     }
     assert(addr);
@@ -622,17 +706,14 @@ Nudp::uv_callback_receive(
             NAN_SET_STR(rinfo, "address", name6);
             NAN_SET_INT(rinfo, "port", ntohs(sin6->sin6_port));
         }
-        // the node buffer takes ownership on the memory, so not deleting the allocation in this
-        // path
         v8::Local<v8::Value> argv[] = {
-            NAN_STR("stun"), Nan::NewBuffer(buf->base, nread).ToLocalChecked(), rinfo};
+            NAN_STR("stun"), Nan::CopyBuffer(buf->base, nread).ToLocalChecked(), rinfo};
         NAN_CALLBACK(self.handle(), "emit", 3, argv);
     } else {
         const byte* data = reinterpret_cast<const byte*>(buf->base);
         if (!utp_process_udp(self._utp_ctx, data, nread, addr, sizeof(struct sockaddr))) {
             DBG3("Nudp::uv_callback_receive: UDP packet not handled by UTP. Ignoring.");
         }
-        delete[] buf->base;
     }
 }
 
@@ -651,13 +732,6 @@ Nudp::utp_callback_sendto(utp_callback_arguments* a)
         DBG5("Nudp::utp_callback_sendto: closed. ignoring.");
         return 0;
     }
-    uv_udp_send_t* req = new uv_udp_send_t;
-    SendUtpPacketReq* data = new SendUtpPacketReq;
-    req->data = data;
-    data->buf = new char[a->len];
-    memcpy(data->buf, a->buf, a->len);
-    uv_buf_t buf = uv_buf_init(data->buf, a->len);
-    data->sin = *reinterpret_cast<const struct sockaddr_in*>(a->address);
     DBG3(
         "Nudp::utp_callback_sendto:"
         << " local_port "
@@ -669,14 +743,179 @@ Nudp::utp_callback_sendto(utp_callback_arguments* a)
     if (DBG_VISIBLE(9)) {
         Buf::hexdump(a->buf, a->len > 128 ? 128 : a->len, "Nudp::utp_callback_sendto");
     }
+    self._queue_send(a->buf, a->len, a->address);
+    return 0;
+}
+
+void
+Nudp::_queue_send(const void* buf, size_t len, const struct sockaddr* addr)
+{
+    SendBatch& b = *_send_batch;
+    SendBatch::Packet p;
+    p.offset = b.data.size();
+    p.len = len;
+    p.sin = *reinterpret_cast<const struct sockaddr_in*>(addr);
+    b.data.insert(b.data.end(), reinterpret_cast<const char*>(buf), reinterpret_cast<const char*>(buf) + len);
+    b.packets.push_back(p);
+    if (b.packets.size() >= SEND_BATCH_MAX_PACKETS) {
+        _flush_sends();
+    }
+}
+
+void
+Nudp::_flush_sends()
+{
+    SendBatch& b = *_send_batch;
+    if (b.packets.empty() || _closed) {
+        return;
+    }
+    size_t sent = 0;
+#ifdef __linux__
+    // writing directly to the socket is only safe when libuv has no queued sends,
+    // otherwise our packets would overtake them.
+    if (uv_udp_get_send_queue_count(&_uv_udp_handle) == 0) {
+        sent = _send_mmsg();
+    }
+#endif
+    // leftovers (socket buffer full or no sendmmsg) are queued to libuv
+    // which waits for the socket to become writable
+    for (size_t i = sent; i < b.packets.size(); ++i) {
+        const SendBatch::Packet& p = b.packets[i];
+        _send_uv(b.data.data() + p.offset, p.len, p.sin);
+    }
+    DBG3(
+        "Nudp::_flush_sends:"
+        << " local_port "
+        << _local_port
+        << " packets "
+        << b.packets.size()
+        << " sendmmsg "
+        << sent);
+    b.packets.clear();
+    b.data.clear();
+}
+
+#ifdef __linux__
+
+static bool
+same_sockaddr_in(const struct sockaddr_in& a, const struct sockaddr_in& b)
+{
+    return a.sin_port == b.sin_port && a.sin_addr.s_addr == b.sin_addr.s_addr;
+}
+
+/**
+ * Send the queued packets with sendmmsg and return how many were sent.
+ * With UDP_SEGMENT a run of packets to the same address where all but the last
+ * have the same size is passed as a single message that the kernel (or nic) splits.
+ */
+size_t
+Nudp::_send_mmsg()
+{
+    SendBatch& b = *_send_batch;
+    uv_os_fd_t fd;
+    if (uv_fileno(reinterpret_cast<uv_handle_t*>(&_uv_udp_handle), &fd)) {
+        return 0;
+    }
+    const size_t num_packets = b.packets.size();
+    const size_t cmsg_space = CMSG_SPACE(sizeof(uint16_t));
+    b.msgs.resize(SEND_MMSG_MAX);
+    b.msg_packets.resize(SEND_MMSG_MAX);
+    b.cmsgs.resize(SEND_MMSG_MAX * cmsg_space);
+    b.iovecs.resize(num_packets);
+    size_t pos = 0;
+    while (pos < num_packets) {
+        size_t num_msgs = 0;
+        size_t i = pos;
+        while (i < num_packets && num_msgs < SEND_MMSG_MAX) {
+            const SendBatch::Packet& first = b.packets[i];
+            size_t count = 1;
+            size_t total = first.len;
+            if (_gso_enabled) {
+                while (i + count < num_packets && count < GSO_MAX_SEGMENTS) {
+                    const SendBatch::Packet& p = b.packets[i + count];
+                    if (p.len > first.len || total + p.len > GSO_MAX_BYTES || !same_sockaddr_in(p.sin, first.sin)) {
+                        break;
+                    }
+                    total += p.len;
+                    count += 1;
+                    // a shorter segment must be the last one
+                    if (p.len < first.len) break;
+                }
+            }
+            for (size_t k = 0; k < count; ++k) {
+                const SendBatch::Packet& p = b.packets[i + k];
+                b.iovecs[i + k].iov_base = b.data.data() + p.offset;
+                b.iovecs[i + k].iov_len = p.len;
+            }
+            struct mmsghdr& m = b.msgs[num_msgs];
+            memset(&m, 0, sizeof(m));
+            m.msg_hdr.msg_name = const_cast<struct sockaddr_in*>(&first.sin);
+            m.msg_hdr.msg_namelen = sizeof(first.sin);
+            m.msg_hdr.msg_iov = &b.iovecs[i];
+            m.msg_hdr.msg_iovlen = count;
+            if (count > 1) {
+                char* control = &b.cmsgs[num_msgs * cmsg_space];
+                memset(control, 0, cmsg_space);
+                m.msg_hdr.msg_control = control;
+                m.msg_hdr.msg_controllen = cmsg_space;
+                struct cmsghdr* cm = CMSG_FIRSTHDR(&m.msg_hdr);
+                cm->cmsg_level = SOL_UDP;
+                cm->cmsg_type = UDP_SEGMENT;
+                cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t gso_size = first.len;
+                memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+            }
+            b.msg_packets[num_msgs] = count;
+            num_msgs += 1;
+            i += count;
+        }
+        int r = sendmmsg(fd, b.msgs.data(), num_msgs, 0);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            if (_gso_enabled && (errno == EIO || errno == EINVAL)) {
+                // the device cannot offload segmentation, keep sending single packets
+                LOG("Nudp::_send_mmsg: disabling gso after error " << errno << " local_port " << _local_port);
+                _gso_enabled = false;
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                DBG1("Nudp::_send_mmsg: sendmmsg error " << errno << " local_port " << _local_port);
+            }
+            return pos;
+        }
+        _udp_send_calls += 1;
+        for (int k = 0; k < r; ++k) {
+            pos += b.msg_packets[k];
+            _udp_packets_sent += b.msg_packets[k];
+        }
+        if (r < (int)num_msgs) {
+            return pos;
+        }
+    }
+    return pos;
+}
+
+#endif
+
+void
+Nudp::_send_uv(const char* buf, size_t len, const struct sockaddr_in& sin)
+{
+    uv_udp_send_t* req = new uv_udp_send_t;
+    SendUtpPacketReq* data = new SendUtpPacketReq;
+    req->data = data;
+    data->buf = new char[len];
+    memcpy(data->buf, buf, len);
+    data->sin = sin;
+    uv_buf_t uv_buf = uv_buf_init(data->buf, len);
     NAUV_CALL(uv_udp_send(
         req,
-        &self._uv_udp_handle,
-        &buf,
+        &_uv_udp_handle,
+        &uv_buf,
         1,
         NAUV_UDP_ADDR(&data->sin),
         &Nudp::uv_callback_send_utp));
-    return 0;
+    _udp_send_calls += 1;
+    _udp_packets_sent += 1;
 }
 
 void
@@ -812,6 +1051,9 @@ NAN_METHOD(Nudp::stats)
     NAN_SET_INT(obj, "retransmits", stats->rexmit);
     NAN_SET_INT(obj, "retransmits_fast", stats->fastrexmit);
     NAN_SET_INT(obj, "mtu_guess", stats->mtu_guess);
+    NAN_SET_NUM(obj, "udp_packets_sent", self._udp_packets_sent);
+    NAN_SET_NUM(obj, "udp_send_calls", self._udp_send_calls);
+    NAN_SET(obj, "udp_gso", Nan::New(self._gso_enabled));
     NAN_RETURN(obj);
 }
 
@@ -99,6 +99,9 @@ private:
 
     static const int MSG_HDR_SIZE = sizeof(MsgHdr);
 
+    // utp packets queued by utp_callback_sendto and flushed once per loop iteration
+    struct SendBatch;
+
 private:
     explicit Nudp();
     ~Nudp();
@@ -109,6 +112,10 @@ private:
     void _bind(const char* address, int port);
     void _setup_socket(utp_socket* socket);
     void _start_receiving();
+    void _queue_send(const void* buf, size_t len, const struct sockaddr* addr);
+    void _flush_sends();
+    size_t _send_mmsg();
+    void _send_uv(const char* buf, size_t len, const struct sockaddr_in& sin);
 
 private:
     utp_context* _utp_ctx;
@@ -118,6 +125,13 @@ private:
     uv_prepare_t _uv_prepare_close_handle;
     uv_udp_t _uv_udp_handle;
     std::list<Msg*> _messages;
+    SendBatch* _send_batch;
+    char* _recv_buf;
+    // gso can be disabled with the gso: false constructor option, otherwise used when the kernel supports it
+    bool _gso_allowed;
+    bool _gso_enabled;
+    uint64_t _udp_packets_sent;
+    uint64_t _udp_send_calls;
     MsgHdr _recv_hdr;
     char* _recv_payload;
     int _recv_hdr_pos;
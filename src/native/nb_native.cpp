@@ -9,11 +9,17 @@ void ssl_napi(Napi::Env env, Napi::Object exports);
 void syslog_napi(Napi::Env env, Napi::Object exports);
 void splitter_napi(Napi::Env env, Napi::Object exports);
 void chunk_coder_napi(napi_env env, napi_value exports);
+void chunk_ingest_napi(Napi::Env env, Napi::Object exports);
 void fs_napi(Napi::Env env, Napi::Object exports);
 void crypto_napi(Napi::Env env, Napi::Object exports);
 void cuobj_server_napi(Napi::Env env, Napi::Object exports);
 void cuobj_client_napi(Napi::Env env, Napi::Object exports);
 void cuda_napi(Napi::Env env, Napi::Object exports);
+void block_container_napi(Napi::Env env, Napi::Object exports);
+void block_scrubber_napi(Napi::Env env, Napi::Object exports);
+void rpc_codec_napi(Napi::Env env, Napi::Object exports);
+void aws_chunked_napi(Napi::Env env, Napi::Object exports);
+void sigv4_napi(Napi::Env env, Napi::Object exports);
 
 #if BUILD_S3SELECT
 void s3select_napi(Napi::Env env, Napi::Object exports);
@@ -27,11 +33,17 @@ nb_native_napi(Napi::Env env, Napi::Object exports)
     syslog_napi(env, exports);
     splitter_napi(env, exports);
     chunk_coder_napi(env, exports);
+    chunk_ingest_napi(env, exports);
     fs_napi(env, exports);
     crypto_napi(env, exports);
     cuobj_server_napi(env, exports);
     cuobj_client_napi(env, exports);
     cuda_napi(env, exports);
+    block_container_napi(env, exports);
+    block_scrubber_napi(env, exports);
+    rpc_codec_napi(env, exports);
+    aws_chunked_napi(env, exports);
+    sigv4_napi(env, exports);
 
 #if BUILD_S3SELECT
     s3select_napi(env, exports);
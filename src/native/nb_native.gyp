@@ -29,6 +29,10 @@
                 'dependencies': ['s3select/s3select.gyp:s3select'],
                 'defines': ['BUILD_S3SELECT=1']
             }],
+            [ 'OS=="linux" and (node_arch=="x64" or node_arch=="arm64")', {
+                'dependencies': ['third_party/isa-l.gyp:isa-l-aes'],
+                'defines': ['USE_ISAL_AES_GCM=1']
+            }],
         ],
         'include_dirs': [
             '<@(napi_include_dirs)',
@@ -41,7 +45,9 @@
             'third_party/isa-l.gyp:isa-l-ec',
             'third_party/isa-l.gyp:isa-l-md5',
             'third_party/isa-l.gyp:isa-l-sha1',
-            'third_party/isa-l.gyp:isa-l-crc'
+            'third_party/isa-l.gyp:isa-l-sha256',
+            'third_party/isa-l.gyp:isa-l-crc',
+            'third_party/isa-l.gyp:isa-l-igzip'
         ],
         'sources': [
             # module
@@ -53,15 +59,24 @@
             'chunk/splitter_napi.cpp',
             'chunk/splitter.h',
             'chunk/splitter.cpp',
+            'chunk/ingest_napi.cpp',
+            'chunk/ingest.h',
+            'chunk/ingest.cpp',
             # tools
             'tools/b64_napi.cpp',
             'tools/ssl_napi.cpp',
+            'tools/async_log.h',
+            'tools/async_log.cpp',
             'tools/syslog_napi.cpp',
             'tools/crypto_napi.cpp',
             # util
             'util/b64.h',
             'util/b64.cpp',
             'util/backtrace.h',
+            'util/buf_pool.h',
+            'util/buf_pool.cpp',
+            'util/checksum.h',
+            'util/checksum.cpp',
             'util/struct_buf.h',
             'util/struct_buf.cpp',
             'util/common.h',
@@ -80,6 +95,32 @@
             'util/zlib.cpp',
             # fs
             'fs/fs_napi.cpp',
+            'fs/dir_cache.h',
+            'fs/dir_cache.cpp',
+            'fs/fsync_coalescer.h',
+            'fs/fsync_coalescer.cpp',
+            'fs/lifecycle_scan.h',
+            'fs/lifecycle_scan.cpp',
+            'fs/remove_tree.h',
+            'fs/remove_tree.cpp',
+            'fs/tree_walk.h',
+            'fs/tree_walk.cpp',
+            # agent
+            'agent/block_container.h',
+            'agent/block_container.cpp',
+            'agent/block_container_napi.cpp',
+            'agent/block_scrubber.h',
+            'agent/block_scrubber.cpp',
+            'agent/block_scrubber_napi.cpp',
+            # rpc
+            'rpc/rpc_codec_napi.cpp',
+            # s3
+            's3/aws_chunked.h',
+            's3/aws_chunked.cpp',
+            's3/aws_chunked_napi.cpp',
+            's3/sigv4.h',
+            's3/sigv4.cpp',
+            's3/sigv4_napi.cpp',
             # cuobj/cuda
             'cuobj/cuobj_server_napi.cpp',
             'cuobj/cuobj_client_napi.cpp',
@@ -0,0 +1,518 @@
+/* Copyright (C) 2016 NooBaa */
+#include "../util/common.h"
+#include "../util/endian.h"
+#include "../util/napi.h"
+
+#include <cmath>
+#include <unordered_map>
+
+namespace noobaa
+{
+
+/**
+ * RpcCodec encodes rpc message bodies to a compact binary form.
+ *
+ * The codec is created with a list of strings (collected from the api schemas)
+ * that both sides agree on, and object keys or string values from that list
+ * are encoded as a varint index instead of the string itself.
+ *
+ * decode(encode(body)) is meant to give the same result as JSON.parse(JSON.stringify(body)):
+ * - toJSON() is called when defined (Date, ObjectId, Buffer)
+ * - undefined/function/symbol properties are skipped, and written as null in arrays
+ * - non finite numbers are written as null
+ * - 24 char lowercase hex strings (object ids) are written as 12 raw bytes
+ *   and decoded back to the same string.
+ *
+ * Every value starts with a tag byte followed by:
+ * - UINT/NINT - varint of the absolute value (integers up to 2^53)
+ * - DOUBLE - 8 bytes little endian
+ * - STR - varint length + utf8 bytes
+ * - ISTR - varint index to the strings list
+ * - OID - 12 bytes
+ * - ARRAY - varint count + values
+ * - OBJECT - (key + value)* + varint 0, where the key is a varint:
+ *   odd - (index << 1) | 1 to the strings list, even - (len + 1) << 1 followed by utf8 bytes.
+ */
+enum RpcCodecTag : uint8_t
+{
+    TAG_NULL = 0,
+    TAG_FALSE,
+    TAG_TRUE,
+    TAG_UINT,
+    TAG_NINT,
+    TAG_DOUBLE,
+    TAG_STR,
+    TAG_ISTR,
+    TAG_OID,
+    TAG_ARRAY,
+    TAG_OBJECT,
+};
+
+static const int RPC_CODEC_MAX_DEPTH = 256;
+static const size_t RPC_CODEC_MAX_ISTR_LEN = 128;
+static const size_t RPC_CODEC_OID_LEN = 12;
+static const double RPC_CODEC_MAX_SAFE_INT = 9007199254740991.0;
+
+static const char HEX_CHARS[] = "0123456789abcdef";
+
+static inline int
+hex_value(uint8_t c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+struct RpcCodecWrap : public Napi::ObjectWrap<RpcCodecWrap>
+{
+    std::unordered_map<std::string, uint32_t> _index;
+    Napi::Reference<Napi::Array> _strings;
+
+    static Napi::FunctionReference constructor;
+    static void init(Napi::Env env)
+    {
+        constructor = Napi::Persistent(DefineClass(
+            env,
+            "RpcCodec",
+            {
+                InstanceMethod("encode", &RpcCodecWrap::encode),
+                InstanceMethod("decode", &RpcCodecWrap::decode),
+            }));
+        constructor.SuppressDestruct();
+    }
+    RpcCodecWrap(const Napi::CallbackInfo& info)
+        : Napi::ObjectWrap<RpcCodecWrap>(info)
+    {
+        if (!info[0].IsArray()) {
+            throw Napi::TypeError::New(info.Env(), "RpcCodec: expected array of strings");
+        }
+        auto list = info[0].As<Napi::Array>();
+        auto strings = Napi::Array::New(info.Env(), list.Length());
+        for (uint32_t i = 0; i < list.Length(); ++i) {
+            auto s = list.Get(i).As<Napi::String>();
+            strings[i] = s;
+            _index.emplace(s.Utf8Value(), i);
+        }
+        _strings = Napi::Persistent(strings);
+    }
+    Napi::Value encode(const Napi::CallbackInfo& info);
+    Napi::Value decode(const Napi::CallbackInfo& info);
+};
+
+Napi::FunctionReference RpcCodecWrap::constructor;
+
+class RpcEncoder
+{
+public:
+    RpcEncoder(RpcCodecWrap& codec, Napi::Env env, size_t header_len)
+        : _codec(codec)
+        , _env(env)
+        , _to_json(Napi::String::New(env, "toJSON"))
+        , _empty(Napi::String::New(env, ""))
+        , _data(0)
+        , _len(0)
+        , _cap(0)
+    {
+        _reserve(header_len + 256);
+        memset(_data, 0, header_len);
+        _len = header_len;
+    }
+
+    ~RpcEncoder()
+    {
+        free(_data);
+    }
+
+    void encode(Napi::Value v)
+    {
+        if (!_value(v, 0)) _put(TAG_NULL);
+    }
+
+    Napi::Buffer<uint8_t> release()
+    {
+        uint8_t* data = _data;
+        _data = 0;
+        return Napi::Buffer<uint8_t>::New(_env, data, _len, [](Napi::Env, uint8_t* p) { free(p); });
+    }
+
+private:
+    RpcCodecWrap& _codec;
+    Napi::Env _env;
+    Napi::String _to_json;
+    Napi::String _empty;
+    uint8_t* _data;
+    size_t _len;
+    size_t _cap;
+
+    void _reserve(size_t n)
+    {
+        if (_len + n <= _cap) return;
+        size_t cap = std::max(_cap * 2, _len + n);
+        uint8_t* data = (uint8_t*)realloc(_data, cap);
+        if (!data) throw Napi::Error::New(_env, "RpcCodec::encode: out of memory");
+        _data = data;
+        _cap = cap;
+    }
+
+    void _put(uint8_t b)
+    {
+        _reserve(1);
+        _data[_len++] = b;
+    }
+
+    void _put_varint(uint64_t n)
+    {
+        _reserve(10);
+        while (n >= 0x80) {
+            _data[_len++] = uint8_t(n) | 0x80;
+            n >>= 7;
+        }
+        _data[_len++] = uint8_t(n);
+    }
+
+    void _number(double d)
+    {
+        if (!std::isfinite(d)) {
+            _put(TAG_NULL);
+        } else if (d <= RPC_CODEC_MAX_SAFE_INT && d >= -RPC_CODEC_MAX_SAFE_INT && d == std::trunc(d)) {
+            if (d >= 0) {
+                _put(TAG_UINT);
+                _put_varint(uint64_t(d));
+            } else {
+                _put(TAG_NINT);
+                _put_varint(uint64_t(-d));
+            }
+        } else {
+            uint64_t bits;
+            memcpy(&bits, &d, sizeof(bits));
+            bits = htole64(bits);
+            _put(TAG_DOUBLE);
+            _reserve(sizeof(bits));
+            memcpy(_data + _len, &bits, sizeof(bits));
+            _len += sizeof(bits);
+        }
+    }
+
+    // writes the utf8 bytes of the string after a length prefix and returns its offset
+    size_t _utf8(napi_value s, size_t* out_len)
+    {
+        size_t len = 0;
+        napi_status status = napi_get_value_string_utf8(_env, s, 0, 0, &len);
+        if (status != napi_ok) throw Napi::Error::New(_env);
+        _put_varint(len);
+        _reserve(len + 1);
+        size_t pos = _len;
+        status = napi_get_value_string_utf8(_env, s, (char*)_data + pos, len + 1, &len);
+        if (status != napi_ok) throw Napi::Error::New(_env);
+        _len += len;
+        *out_len = len;
+        return pos;
+    }
+
+    void _string(napi_value s)
+    {
+        const size_t tag_pos = _len;
+        _put(TAG_STR);
+        size_t len = 0;
+        const size_t pos = _utf8(s, &len);
+        const uint8_t* p = _data + pos;
+        if (len == RPC_CODEC_OID_LEN * 2) {
+            uint8_t oid[RPC_CODEC_OID_LEN];
+            size_t i = 0;
+            for (; i < RPC_CODEC_OID_LEN; ++i) {
+                int hi = hex_value(p[i * 2]);
+                int lo = hex_value(p[(i * 2) + 1]);
+                if (hi < 0 || lo < 0) break;
+                oid[i] = uint8_t((hi << 4) | lo);
+            }
+            if (i == RPC_CODEC_OID_LEN) {
+                _len = tag_pos;
+                _put(TAG_OID);
+                memcpy(_data + _len, oid, RPC_CODEC_OID_LEN); // reserved by the string
+                _len += RPC_CODEC_OID_LEN;
+                return;
+            }
+        }
+        if (len <= RPC_CODEC_MAX_ISTR_LEN) {
+            auto it = _codec._index.find(std::string((const char*)p, len));
+            if (it != _codec._index.end()) {
+                _len = tag_pos;
+                _put(TAG_ISTR);
+                _put_varint(it->second);
+            }
+        }
+    }
+
+    void _key(napi_value k)
+    {
+        size_t len = 0;
+        napi_status status = napi_get_value_string_utf8(_env, k, 0, 0, &len);
+        if (status != napi_ok) throw Napi::Error::New(_env);
+        _reserve(10 + len + 1);
+        // write the bytes after room for the longest varint, then move them if not interned
+        const size_t key_pos = _len;
+        char* p = (char*)_data + key_pos + 10;
+        status = napi_get_value_string_utf8(_env, k, p, len + 1, &len);
+        if (status != napi_ok) throw Napi::Error::New(_env);
+        if (len <= RPC_CODEC_MAX_ISTR_LEN) {
+            auto it = _codec._index.find(std::string(p, len));
+            if (it != _codec._index.end()) {
+                _put_varint((uint64_t(it->second) << 1) | 1);
+                return;
+            }
+        }
+        _put_varint(uint64_t(len + 1) << 1);
+        memmove(_data + _len, _data + key_pos + 10, len);
+        _len += len;
+    }
+
+    // returns false when the value should be skipped like JSON.stringify does
+    bool _value(Napi::Value v, int depth)
+    {
+        switch (v.Type()) {
+        case napi_undefined:
+        case napi_function:
+        case napi_symbol:
+            return false;
+        case napi_null:
+            _put(TAG_NULL);
+            return true;
+        case napi_boolean:
+            _put(v.As<Napi::Boolean>().Value() ? TAG_TRUE : TAG_FALSE);
+            return true;
+        case napi_number:
+            _number(v.As<Napi::Number>().DoubleValue());
+            return true;
+        case napi_string:
+            _string(v);
+            return true;
+        case napi_bigint:
+            throw Napi::TypeError::New(_env, "RpcCodec::encode: BigInt value can't be serialized");
+        default:
+            break;
+        }
+
+        if (depth >= RPC_CODEC_MAX_DEPTH) {
+            throw Napi::TypeError::New(_env, "RpcCodec::encode: max depth exceeded (circular structure?)");
+        }
+        auto obj = v.As<Napi::Object>();
+
+        auto to_json = obj.Get(_to_json);
+        if (to_json.IsFunction()) {
+            return _value(to_json.As<Napi::Function>().Call(obj, { _empty }), depth + 1);
+        }
+
+        if (obj.IsArray()) {
+            auto arr = obj.As<Napi::Array>();
+            const uint32_t count = arr.Length();
+            _put(TAG_ARRAY);
+            _put_varint(count);
+            for (uint32_t i = 0; i < count; ++i) {
+                if (!_value(arr.Get(i), depth + 1)) _put(TAG_NULL);
+            }
+            return true;
+        }
+
+        napi_value keys_value;
+        napi_status status = napi_get_all_property_names(
+            _env,
+            obj,
+            napi_key_own_only,
+            static_cast<napi_key_filter>(napi_key_enumerable | napi_key_skip_symbols),
+            napi_key_numbers_to_strings,
+            &keys_value);
+        if (status != napi_ok) throw Napi::Error::New(_env);
+        auto keys = Napi::Array(_env, keys_value);
+        const uint32_t count = keys.Length();
+        _put(TAG_OBJECT);
+        for (uint32_t i = 0; i < count; ++i) {
+            Napi::Value key = keys.Get(i);
+            const size_t pos = _len;
+            _key(key);
+            // rollback the key when the value is skipped
+            if (!_value(obj.Get(key), depth + 1)) _len = pos;
+        }
+        _put_varint(0);
+        return true;
+    }
+};
+
+class RpcDecoder
+{
+public:
+    RpcDecoder(RpcCodecWrap& codec, Napi::Env env, const uint8_t* data, size_t len)
+        : _env(env)
+        , _strings(codec._strings.Value())
+        , _num_strings(_strings.Length())
+        , _proto_key("__proto__")
+        , _p(data)
+        , _end(data + len)
+    {
+    }
+
+    Napi::Value decode()
+    {
+        Napi::Value v = _value(0);
+        if (_p != _end) _fail("trailing bytes");
+        return v;
+    }
+
+private:
+    Napi::Env _env;
+    Napi::Array _strings;
+    uint32_t _num_strings;
+    const std::string _proto_key;
+    const uint8_t* _p;
+    const uint8_t* _end;
+
+    [[noreturn]] void _fail(const char* reason)
+    {
+        throw Napi::Error::New(_env, XSTR() << "RpcCodec::decode: " << reason);
+    }
+
+    void _need(size_t n)
+    {
+        if (size_t(_end - _p) < n) _fail("truncated");
+    }
+
+    uint64_t _varint()
+    {
+        uint64_t n = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            _need(1);
+            uint8_t b = *_p++;
+            n |= uint64_t(b & 0x7f) << shift;
+            if (!(b & 0x80)) return n;
+        }
+        _fail("bad varint");
+    }
+
+    Napi::Value _istr(uint64_t index)
+    {
+        if (index >= _num_strings) _fail("bad string index");
+        return _strings.Get(uint32_t(index));
+    }
+
+    Napi::String _str(size_t len)
+    {
+        _need(len);
+        auto s = Napi::String::New(_env, (const char*)_p, len);
+        _p += len;
+        return s;
+    }
+
+    Napi::Value _value(int depth)
+    {
+        if (depth >= RPC_CODEC_MAX_DEPTH) _fail("max depth exceeded");
+        _need(1);
+        const uint8_t tag = *_p++;
+        switch (tag) {
+        case TAG_NULL:
+            return _env.Null();
+        case TAG_FALSE:
+            return Napi::Boolean::New(_env, false);
+        case TAG_TRUE:
+            return Napi::Boolean::New(_env, true);
+        case TAG_UINT:
+            return Napi::Number::New(_env, double(_varint()));
+        case TAG_NINT:
+            return Napi::Number::New(_env, -double(_varint()));
+        case TAG_DOUBLE: {
+            uint64_t bits;
+            double d;
+            _need(sizeof(bits));
+            memcpy(&bits, _p, sizeof(bits));
+            _p += sizeof(bits);
+            bits = le64toh(bits);
+            memcpy(&d, &bits, sizeof(d));
+            return Napi::Number::New(_env, d);
+        }
+        case TAG_STR:
+            return _str(_varint());
+        case TAG_ISTR:
+            return _istr(_varint());
+        case TAG_OID: {
+            char hex[RPC_CODEC_OID_LEN * 2];
+            _need(RPC_CODEC_OID_LEN);
+            for (size_t i = 0; i < RPC_CODEC_OID_LEN; ++i) {
+                hex[i * 2] = HEX_CHARS[_p[i] >> 4];
+                hex[(i * 2) + 1] = HEX_CHARS[_p[i] & 0xf];
+            }
+            _p += RPC_CODEC_OID_LEN;
+            return Napi::String::New(_env, hex, sizeof(hex));
+        }
+        case TAG_ARRAY: {
+            const uint64_t count = _varint();
+            // every value takes at least one byte
+            _need(count);
+            auto arr = Napi::Array::New(_env, count);
+            for (uint32_t i = 0; i < count; ++i) {
+                arr[i] = _value(depth + 1);
+            }
+            return arr;
+        }
+        case TAG_OBJECT: {
+            auto obj = Napi::Object::New(_env);
+            for (;;) {
+                const uint64_t k = _varint();
+                if (!k) break;
+                if (k & 1) {
+                    Napi::Value key = _istr(k >> 1);
+                    obj.Set(key, _value(depth + 1));
+                    continue;
+                }
+                const size_t len = (k >> 1) - 1;
+                _need(len);
+                if (len == _proto_key.size() && !memcmp(_p, _proto_key.data(), len)) {
+                    // JSON.parse defines an own property rather than setting the prototype
+                    _p += len;
+                    Napi::Value val = _value(depth + 1);
+                    obj.DefineProperty(Napi::PropertyDescriptor::Value(
+                        _proto_key,
+                        val,
+                        static_cast<napi_property_attributes>(napi_writable | napi_enumerable | napi_configurable)));
+                    continue;
+                }
+                Napi::String key = _str(len);
+                obj.Set(key, _value(depth + 1));
+            }
+            return obj;
+        }
+        default:
+            _fail("bad tag");
+        }
+    }
+};
+
+/**
+ * encode(body, header_len) returns a buffer with header_len zero bytes
+ * reserved at the start for the caller's message header.
+ */
+Napi::Value
+RpcCodecWrap::encode(const Napi::CallbackInfo& info)
+{
+    size_t header_len = info[1].IsNumber() ? napi_get_u32(info[1]) : 0;
+    RpcEncoder encoder(*this, info.Env(), header_len);
+    encoder.encode(info[0]);
+    return encoder.release();
+}
+
+Napi::Value
+RpcCodecWrap::decode(const Napi::CallbackInfo& info)
+{
+    if (!info[0].IsBuffer()) {
+        throw Napi::TypeError::New(info.Env(), "RpcCodec::decode: expected buffer");
+    }
+    auto buf = info[0].As<Napi::Buffer<uint8_t>>();
+    RpcDecoder decoder(*this, info.Env(), buf.Data(), buf.Length());
+    return decoder.decode();
+}
+
+void
+rpc_codec_napi(Napi::Env env, Napi::Object exports)
+{
+    RpcCodecWrap::init(env);
+    exports["RpcCodec"] = RpcCodecWrap::constructor.Value();
+}
+
+} // namespace noobaa
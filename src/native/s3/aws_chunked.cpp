@@ -0,0 +1,438 @@
+/* Copyright (C) 2016 NooBaa */
+#include "aws_chunked.h"
+
+#include "../third_party/isa-l/include/crc.h"
+#include "../util/b64.h"
+
+#include <algorithm>
+
+#include <openssl/crypto.h>
+#include <openssl/hmac.h>
+#include <string.h>
+
+namespace noobaa
+{
+
+static const char HEX_CHARS[] = "0123456789abcdef";
+static const char EMPTY_SHA256_HEX[] = "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+static const char CHUNK_SIGNATURE[] = "chunk-signature";
+static const char TRAILER_SIGNATURE[] = "x-amz-trailer-signature";
+static const size_t SIGNATURE_HEX_LEN = 64;
+
+static std::string
+to_hex(const uint8_t* data, size_t len)
+{
+    std::string out(len * 2, '\0');
+    for (size_t i = 0; i < len; ++i) {
+        out[i * 2] = HEX_CHARS[data[i] >> 4];
+        out[i * 2 + 1] = HEX_CHARS[data[i] & 0xf];
+    }
+    return out;
+}
+
+static int
+hex_val(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static std::string
+to_lower(const std::string& s)
+{
+    std::string out(s);
+    for (char& c : out) {
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+    }
+    return out;
+}
+
+static std::string
+to_b64(const uint8_t* data, int len)
+{
+    std::string out(b64_encode_len(len), '\0');
+    int n = b64_encode(data, len, (uint8_t*)&out[0]);
+    out.resize(n);
+    return out;
+}
+
+// compare signatures in constant time to not leak how many leading chars matched
+static bool
+signature_equals(const std::string& a, const std::string& b)
+{
+    return a.size() == b.size() && CRYPTO_memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+AwsChunked::AwsChunked()
+    : _state(READ_CHUNK_HEADER)
+    , _chunk_size(0)
+    , _last_chunk(false)
+    , _error_index(0)
+    , _signing(false)
+    , _signed_trailer(false)
+    , _chunk_sha256(0)
+    , _checksum(CHECKSUM_NONE)
+    , _crc(0)
+    , _checksum_ctx(0)
+{
+    memset(_signing_key, 0, sizeof(_signing_key));
+}
+
+AwsChunked::~AwsChunked()
+{
+    OPENSSL_cleanse(_signing_key, sizeof(_signing_key));
+    if (_chunk_sha256) EVP_MD_CTX_free(_chunk_sha256);
+    if (_checksum_ctx) EVP_MD_CTX_free(_checksum_ctx);
+}
+
+void
+AwsChunked::set_signing(
+    const uint8_t* signing_key,
+    const std::string& timestamp,
+    const std::string& scope,
+    const std::string& seed_signature,
+    bool signed_trailer)
+{
+    _signing = true;
+    _signed_trailer = signed_trailer;
+    memcpy(_signing_key, signing_key, sizeof(_signing_key));
+    _sign_prefix = timestamp + "\n" + scope + "\n";
+    _prev_signature = seed_signature;
+    if (!_chunk_sha256) _chunk_sha256 = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(_chunk_sha256, EVP_sha256(), NULL);
+}
+
+bool
+AwsChunked::set_checksum(const std::string& trailer_name)
+{
+    const std::string name = to_lower(trailer_name);
+    const EVP_MD* md = 0;
+    if (name == "x-amz-checksum-crc32") {
+        _checksum = CHECKSUM_CRC32;
+        _crc = 0;
+    } else if (name == "x-amz-checksum-crc32c") {
+        _checksum = CHECKSUM_CRC32C;
+        _crc = 0xffffffff;
+    } else if (name == "x-amz-checksum-sha1") {
+        _checksum = CHECKSUM_SHA1;
+        md = EVP_sha1();
+    } else if (name == "x-amz-checksum-sha256") {
+        _checksum = CHECKSUM_SHA256;
+        md = EVP_sha256();
+    } else {
+        return false;
+    }
+    _checksum_trailer = name;
+    if (md) {
+        if (!_checksum_ctx) _checksum_ctx = EVP_MD_CTX_new();
+        EVP_DigestInit_ex(_checksum_ctx, md, NULL);
+    }
+    return true;
+}
+
+bool
+AwsChunked::update(const uint8_t* buf, size_t len, std::vector<Slice>& slices)
+{
+    size_t i = 0;
+    while (i < len) {
+        switch (_state) {
+
+        //---------------//
+        // header states //
+        //---------------//
+
+        case READ_CHUNK_HEADER: {
+            const uint8_t* cr = (const uint8_t*)memchr(buf + i, '\r', len - i);
+            const size_t end = cr ? cr - buf : len;
+            if (_chunk_header.size() + (end - i) > MAX_CHUNK_HEADER_SIZE) {
+                return _fail(end, "chunk_header exceeded MAX_CHUNK_HEADER_SIZE 1024");
+            }
+            _chunk_header.append((const char*)buf + i, end - i);
+            i = end;
+            if (cr) {
+                if (!_parse_chunk_header(i)) return false;
+                _state = WAIT_NL_HEADER;
+                ++i;
+            }
+            break;
+        }
+
+        case WAIT_NL_HEADER:
+            if (buf[i] != '\n') return _fail(i, "expect NL");
+            _state = _last_chunk ? READ_TRAILER : SEND_DATA;
+            ++i;
+            break;
+
+        //-------------//
+        // data states //
+        //-------------//
+
+        case SEND_DATA: {
+            const size_t n = size_t(std::min<uint64_t>(_chunk_size, len - i));
+            slices.push_back(Slice{ i, i + n });
+            if (_signing) EVP_DigestUpdate(_chunk_sha256, buf + i, n);
+            switch (_checksum) {
+            case CHECKSUM_CRC32:
+                _crc = crc32_gzip_refl(_crc, (uint8_t*)buf + i, n);
+                break;
+            case CHECKSUM_CRC32C:
+                _crc = crc32_iscsi((uint8_t*)buf + i, int(n), _crc);
+                break;
+            case CHECKSUM_SHA1:
+            case CHECKSUM_SHA256:
+                EVP_DigestUpdate(_checksum_ctx, buf + i, n);
+                break;
+            case CHECKSUM_NONE:
+                break;
+            }
+            _chunk_size -= n;
+            i += n;
+            if (!_chunk_size) {
+                if (_signing && !_verify_chunk(i)) return false;
+                _state = WAIT_CR_DATA;
+            }
+            break;
+        }
+
+        case WAIT_CR_DATA:
+            if (buf[i] != '\r') return _fail(i, "expect CR");
+            _state = WAIT_NL_DATA;
+            ++i;
+            break;
+
+        case WAIT_NL_DATA:
+            if (buf[i] != '\n') return _fail(i, "expect NL");
+            _state = READ_CHUNK_HEADER;
+            ++i;
+            break;
+
+        //----------------//
+        // trailer states //
+        //----------------//
+
+        case READ_TRAILER: {
+            const uint8_t* cr = (const uint8_t*)memchr(buf + i, '\r', len - i);
+            const size_t end = cr ? cr - buf : len;
+            if (_trailer.size() + (end - i) > MAX_TRAILER_SIZE) {
+                return _fail(end, "trailer exceeded MAX_TRAILER_SIZE 1024");
+            }
+            _trailer.append((const char*)buf + i, end - i);
+            i = end;
+            if (cr) {
+                if (_trailer.empty()) {
+                    _state = WAIT_NL_END; // got last empty trailer
+                } else {
+                    if (_trailers.size() >= MAX_TRAILERS) {
+                        return _fail(i, "number of trailers exceeded the MAX_TRAILERS 20");
+                    }
+                    _trailers.push_back(_trailer);
+                    _trailer.clear();
+                    _state = WAIT_NL_TRAILER; // next trailer
+                }
+                ++i;
+            }
+            break;
+        }
+
+        case WAIT_NL_TRAILER:
+            if (buf[i] != '\n') return _fail(i, "expect NL");
+            _state = READ_TRAILER;
+            ++i;
+            break;
+
+        //------------//
+        // end states //
+        //------------//
+
+        case WAIT_NL_END:
+            if (buf[i] != '\n') return _fail(i, "expect NL");
+            if (!_verify_trailers(i)) return false;
+            _state = CONTENT_END;
+            ++i;
+            break;
+
+        default:
+            return _fail(i, "State machine in an invalid state");
+        }
+    }
+    return true;
+}
+
+/**
+ * Chunk header is a hex size followed by optional extensions separated by ';'
+ * Example: 1ff;chunk-signature=1a2b3c4d
+ */
+bool
+AwsChunked::_parse_chunk_header(size_t index)
+{
+    const size_t semi = _chunk_header.find(';');
+    const size_t hex_len = semi == std::string::npos ? _chunk_header.size() : semi;
+    uint64_t size = 0;
+    bool valid = hex_len > 0 && hex_len <= 16;
+    for (size_t k = 0; valid && k < hex_len; ++k) {
+        const int v = hex_val(_chunk_header[k]);
+        if (v < 0) {
+            valid = false;
+        } else {
+            size = (size << 4) | v;
+        }
+    }
+    if (!valid || size > MAX_CHUNK_SIZE) {
+        return _fail(index, "chunk_size has invalid value " + _chunk_header.substr(0, hex_len));
+    }
+
+    _chunk_signature.clear();
+    size_t pos = semi;
+    while (pos != std::string::npos) {
+        const size_t start = pos + 1;
+        pos = _chunk_header.find(';', start);
+        const size_t end = pos == std::string::npos ? _chunk_header.size() : pos;
+        const size_t eq = _chunk_header.find('=', start);
+        if (eq < end &&
+            eq - start == sizeof(CHUNK_SIGNATURE) - 1 &&
+            _chunk_header.compare(start, eq - start, CHUNK_SIGNATURE) == 0) {
+            _chunk_signature = _chunk_header.substr(eq + 1, end - eq - 1);
+        }
+    }
+    if (_signing && _chunk_signature.size() != SIGNATURE_HEX_LEN) {
+        return _fail(index, "missing chunk-signature");
+    }
+
+    _chunk_size = size;
+    _last_chunk = size == 0;
+    _chunk_header.clear();
+    // the last chunk is signed with the hash of empty data
+    if (_last_chunk && _signing && !_verify_chunk(index)) return false;
+    return true;
+}
+
+bool
+AwsChunked::_verify_chunk(size_t index)
+{
+    uint8_t sha256[32];
+    EVP_DigestFinal_ex(_chunk_sha256, sha256, NULL);
+    EVP_DigestInit_ex(_chunk_sha256, EVP_sha256(), NULL);
+    const std::string signature = _sign("AWS4-HMAC-SHA256-PAYLOAD", sha256);
+    if (!signature_equals(signature, _chunk_signature)) {
+        return _fail(index, "chunk-signature mismatch");
+    }
+    _prev_signature = signature;
+    return true;
+}
+
+bool
+AwsChunked::_verify_trailers(size_t index)
+{
+    std::string canonical;
+    std::string trailer_signature;
+    std::string checksum_value;
+    for (const std::string& trailer : _trailers) {
+        const size_t colon = trailer.find(':');
+        const std::string name = to_lower(trailer.substr(0, colon));
+        const std::string value = colon == std::string::npos ? std::string() : trailer.substr(colon + 1);
+        if (name == TRAILER_SIGNATURE) {
+            trailer_signature = value;
+            continue;
+        }
+        if (!_checksum_trailer.empty() && name == _checksum_trailer) checksum_value = value;
+        canonical += name + ":" + value + "\n";
+    }
+
+    if (_signing && (_signed_trailer || !_trailers.empty())) {
+        if (_signed_trailer && trailer_signature.empty()) {
+            return _fail(index, std::string("missing ") + TRAILER_SIGNATURE);
+        }
+        uint8_t sha256[32];
+        unsigned int sha256_len = 0;
+        EVP_Digest(canonical.data(), canonical.size(), sha256, &sha256_len, EVP_sha256(), NULL);
+        if (!signature_equals(_sign("AWS4-HMAC-SHA256-TRAILER", sha256), trailer_signature)) {
+            return _fail(index, "trailer signature mismatch");
+        }
+    }
+
+    if (_checksum != CHECKSUM_NONE) {
+        if (checksum_value.empty()) return _fail(index, "missing trailer " + _checksum_trailer);
+        uint8_t digest[EVP_MAX_MD_SIZE];
+        unsigned int digest_len = 0;
+        if (_checksum == CHECKSUM_CRC32 || _checksum == CHECKSUM_CRC32C) {
+            const uint32_t crc = _checksum == CHECKSUM_CRC32C ? ~_crc : _crc;
+            // the crc checksums are sent as base64 of the big endian value
+            digest[0] = crc >> 24;
+            digest[1] = crc >> 16;
+            digest[2] = crc >> 8;
+            digest[3] = crc;
+            digest_len = 4;
+        } else {
+            EVP_DigestFinal_ex(_checksum_ctx, digest, &digest_len);
+        }
+        if (to_b64(digest, digest_len) != checksum_value) {
+            return _fail(index, "checksum mismatch on trailer " + _checksum_trailer);
+        }
+    }
+    return true;
+}
+
+// string to sign of sigv4 streaming payload and trailer:
+// <algorithm>\n<timestamp>\n<scope>\n<previous signature>\n[<empty sha256>\n]<sha256 of chunk or trailers>
+std::string
+AwsChunked::_sign(const char* algorithm, const uint8_t* sha256)
+{
+    std::string string_to_sign;
+    string_to_sign.reserve(256);
+    string_to_sign += algorithm;
+    string_to_sign += "\n";
+    string_to_sign += _sign_prefix;
+    string_to_sign += _prev_signature;
+    string_to_sign += "\n";
+    if (strcmp(algorithm, "AWS4-HMAC-SHA256-PAYLOAD") == 0) {
+        string_to_sign += EMPTY_SHA256_HEX;
+        string_to_sign += "\n";
+    }
+    string_to_sign += to_hex(sha256, 32);
+    uint8_t mac[32];
+    unsigned int mac_len = sizeof(mac);
+    HMAC(EVP_sha256(), _signing_key, sizeof(_signing_key),
+        (const uint8_t*)string_to_sign.data(), string_to_sign.size(), mac, &mac_len);
+    return to_hex(mac, mac_len);
+}
+
+bool
+AwsChunked::_fail(size_t index, const std::string& reason)
+{
+    _state = ERROR;
+    _error = reason;
+    _error_index = index;
+    return false;
+}
+
+const char*
+AwsChunked::state_name() const
+{
+    switch (_state) {
+    case READ_CHUNK_HEADER:
+        return "STATE_READ_CHUNK_HEADER";
+    case WAIT_NL_HEADER:
+        return "STATE_WAIT_NL_HEADER";
+    case SEND_DATA:
+        return "STATE_SEND_DATA";
+    case WAIT_CR_DATA:
+        return "STATE_WAIT_CR_DATA";
+    case WAIT_NL_DATA:
+        return "STATE_WAIT_NL_DATA";
+    case READ_TRAILER:
+        return "STATE_READ_TRAILER";
+    case WAIT_NL_TRAILER:
+        return "STATE_WAIT_NL_TRAILER";
+    case WAIT_NL_END:
+        return "STATE_WAIT_NL_END";
+    case CONTENT_END:
+        return "STATE_CONTENT_END";
+    case ERROR:
+        return "STATE_ERROR";
+    }
+    return "STATE_UNKNOWN";
+}
+
+} // namespace noobaa
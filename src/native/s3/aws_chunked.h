@@ -0,0 +1,124 @@
+/* Copyright (C) 2016 NooBaa */
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <openssl/evp.h>
+#include <stdint.h>
+
+namespace noobaa
+{
+
+/**
+ * AwsChunked decodes an aws-chunked payload (see ChunkedContentDecoder in JS)
+ * without copying - update() returns the payload as [start, end) slices of the input.
+ *
+ * - Chunk headers and trailers are located with memchr instead of a per-byte loop.
+ * - When a signing key is set, every chunk-signature is verified with the sigv4
+ *   streaming chain (seed signature -> chunk signatures -> trailer signature).
+ *   With a signed trailer the trailer signature is required, otherwise it is verified when sent.
+ * - When a checksum trailer is set, the checksum of the decoded payload is
+ *   computed on the fly and compared to the trailer value at the end.
+ *
+ * Errors keep the index in the current buffer so that the caller can report
+ * the exact stream position like the JS decoder does.
+ */
+class AwsChunked
+{
+public:
+    enum State
+    {
+        READ_CHUNK_HEADER,
+        WAIT_NL_HEADER,
+        SEND_DATA,
+        WAIT_CR_DATA,
+        WAIT_NL_DATA,
+        READ_TRAILER,
+        WAIT_NL_TRAILER,
+        WAIT_NL_END,
+        CONTENT_END,
+        ERROR,
+    };
+
+    enum Checksum
+    {
+        CHECKSUM_NONE,
+        CHECKSUM_CRC32,
+        CHECKSUM_CRC32C,
+        CHECKSUM_SHA1,
+        CHECKSUM_SHA256,
+    };
+
+    struct Slice
+    {
+        size_t start;
+        size_t end;
+    };
+
+    static const uint64_t MAX_CHUNK_SIZE = 1ULL << 40;
+    static const size_t MAX_CHUNK_HEADER_SIZE = 1024;
+    static const size_t MAX_TRAILER_SIZE = 1024;
+    static const size_t MAX_TRAILERS = 20;
+
+    AwsChunked();
+    ~AwsChunked();
+
+    // signing_key is the 32 bytes sigv4 key derived from the secret, date, region and service,
+    // scope is "<date>/<region>/<service>/aws4_request" and seed_signature the request signature.
+    // signed_trailer is set for STREAMING-AWS4-HMAC-SHA256-PAYLOAD-TRAILER, where x-amz-trailer-signature is required.
+    void set_signing(
+        const uint8_t* signing_key,
+        const std::string& timestamp,
+        const std::string& scope,
+        const std::string& seed_signature,
+        bool signed_trailer);
+
+    // trailer_name is the value of the x-amz-trailer header, e.g. x-amz-checksum-crc32c.
+    // returns false when the checksum algorithm is not supported.
+    bool set_checksum(const std::string& trailer_name);
+
+    // returns false on error, the slices of the buffer that were decoded before the error are kept.
+    bool update(const uint8_t* buf, size_t len, std::vector<Slice>& slices);
+
+    State state() const { return _state; }
+    const char* state_name() const;
+    const std::string& error() const { return _error; }
+    size_t error_index() const { return _error_index; }
+    const std::string& chunk_header() const { return _chunk_header; }
+    uint64_t chunk_size() const { return _chunk_size; }
+    bool last_chunk() const { return _last_chunk; }
+    const std::string& trailer() const { return _trailer; }
+    const std::vector<std::string>& trailers() const { return _trailers; }
+
+private:
+    State _state;
+    std::string _chunk_header;
+    uint64_t _chunk_size;
+    bool _last_chunk;
+    std::string _trailer;
+    std::vector<std::string> _trailers;
+    std::string _error;
+    size_t _error_index;
+
+    bool _signing;
+    bool _signed_trailer;
+    uint8_t _signing_key[32];
+    std::string _sign_prefix; // timestamp and scope lines of the string to sign
+    std::string _prev_signature;
+    std::string _chunk_signature;
+    EVP_MD_CTX* _chunk_sha256;
+
+    Checksum _checksum;
+    std::string _checksum_trailer;
+    uint32_t _crc;
+    EVP_MD_CTX* _checksum_ctx;
+
+    bool _parse_chunk_header(size_t index);
+    bool _verify_chunk(size_t index);
+    bool _verify_trailers(size_t index);
+    bool _fail(size_t index, const std::string& reason);
+    std::string _sign(const char* algorithm, const uint8_t* sha256);
+};
+
+} // namespace noobaa
@@ -0,0 +1,110 @@
+/* Copyright (C) 2016 NooBaa */
+#include "../util/napi.h"
+#include "aws_chunked.h"
+
+namespace noobaa
+{
+
+/**
+ * AwsChunkedDecoderWrap exposes AwsChunked to JS (see chunked_content_decoder.js).
+ *
+ * update(buf) is synchronous and returns a flat array of [start, end, start, end, ...]
+ * offsets of the decoded payload in buf, so that the caller can push subarrays without copying.
+ * On parse or verification errors it throws an Error with the buffer index of the failure.
+ */
+struct AwsChunkedDecoderWrap : public Napi::ObjectWrap<AwsChunkedDecoderWrap>
+{
+    AwsChunked _decoder;
+    std::vector<AwsChunked::Slice> _slices;
+
+    static Napi::FunctionReference constructor;
+    static void init(Napi::Env env)
+    {
+        constructor = Napi::Persistent(DefineClass(
+            env,
+            "AwsChunkedDecoder",
+            {
+                InstanceMethod("update", &AwsChunkedDecoderWrap::update),
+                InstanceMethod("info", &AwsChunkedDecoderWrap::get_info),
+            }));
+        constructor.SuppressDestruct();
+    }
+    AwsChunkedDecoderWrap(const Napi::CallbackInfo& info)
+        : Napi::ObjectWrap<AwsChunkedDecoderWrap>(info)
+    {
+        if (!info[0].IsObject()) return;
+        auto params = info[0].As<Napi::Object>();
+        Napi::Value signing_key = params.Get("signing_key");
+        if (signing_key.IsBuffer()) {
+            auto key = signing_key.As<Napi::Buffer<uint8_t>>();
+            if (key.Length() != 32) {
+                throw Napi::TypeError::New(info.Env(), "AwsChunkedDecoder: signing_key should be 32 bytes");
+            }
+            _decoder.set_signing(
+                key.Data(),
+                napi_get_str(params, "timestamp"),
+                napi_get_str(params, "scope"),
+                napi_get_str(params, "seed_signature"),
+                params.Get("signed_trailer").ToBoolean());
+        }
+        Napi::Value checksum_trailer = params.Get("checksum_trailer");
+        if (checksum_trailer.IsString()) {
+            // unsupported algorithms (crc64nvme) are left unverified like before
+            _decoder.set_checksum(napi_get_str(checksum_trailer));
+        }
+    }
+    Napi::Value update(const Napi::CallbackInfo& info);
+    Napi::Value get_info(const Napi::CallbackInfo& info);
+};
+
+Napi::FunctionReference AwsChunkedDecoderWrap::constructor;
+
+Napi::Value
+AwsChunkedDecoderWrap::update(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (!info[0].IsBuffer()) {
+        throw Napi::TypeError::New(env, "AwsChunkedDecoder.update: expected buffer");
+    }
+    auto buf = info[0].As<Napi::Buffer<uint8_t>>();
+    _slices.clear();
+    if (!_decoder.update(buf.Data(), buf.Length(), _slices)) {
+        auto err = Napi::Error::New(env, _decoder.error());
+        err.Value().Set("index", Napi::Number::New(env, _decoder.error_index()));
+        throw err;
+    }
+    auto arr = Napi::Array::New(env, _slices.size() * 2);
+    for (uint32_t i = 0; i < _slices.size(); ++i) {
+        arr[i * 2] = Napi::Number::New(env, _slices[i].start);
+        arr[i * 2 + 1] = Napi::Number::New(env, _slices[i].end);
+    }
+    return arr;
+}
+
+Napi::Value
+AwsChunkedDecoderWrap::get_info(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    auto res = Napi::Object::New(env);
+    res["state"] = Napi::String::New(env, _decoder.state_name());
+    res["chunk_header"] = Napi::String::New(env, _decoder.chunk_header());
+    res["chunk_size"] = Napi::Number::New(env, _decoder.chunk_size());
+    res["last_chunk"] = Napi::Boolean::New(env, _decoder.last_chunk());
+    res["trailer"] = Napi::String::New(env, _decoder.trailer());
+    const std::vector<std::string>& trailers = _decoder.trailers();
+    auto arr = Napi::Array::New(env, trailers.size());
+    for (uint32_t i = 0; i < trailers.size(); ++i) {
+        arr[i] = Napi::String::New(env, trailers[i]);
+    }
+    res["trailers"] = arr;
+    return res;
+}
+
+void
+aws_chunked_napi(Napi::Env env, Napi::Object exports)
+{
+    AwsChunkedDecoderWrap::init(env);
+    exports["AwsChunkedDecoder"] = AwsChunkedDecoderWrap::constructor.Value();
+}
+
+} // namespace noobaa
@@ -0,0 +1,133 @@
+/* Copyright (C) 2016 NooBaa */
+#include "sigv4.h"
+
+#include <openssl/crypto.h>
+#include <openssl/hmac.h>
+#include <openssl/sha.h>
+#include <string.h>
+
+namespace noobaa
+{
+
+const size_t SigV4::KEY_LEN;
+
+static const char HEX_CHARS[] = "0123456789abcdef";
+
+static void
+hmac_sha256(const uint8_t* key, size_t key_len, const std::string& data, uint8_t* out)
+{
+    unsigned int out_len = SigV4::KEY_LEN;
+    HMAC(EVP_sha256(), key, key_len, (const uint8_t*)data.data(), data.size(), out, &out_len);
+}
+
+SigV4::~SigV4()
+{
+    for (auto& it : _items) {
+        OPENSSL_cleanse(it.second.key, KEY_LEN);
+    }
+}
+
+void
+SigV4::signing_key(
+    const std::string& access_key,
+    const std::string& secret,
+    const std::string& date,
+    const std::string& region,
+    const std::string& service,
+    uint8_t* key)
+{
+    uint8_t secret_sha256[KEY_LEN];
+    SHA256((const uint8_t*)secret.data(), secret.size(), secret_sha256);
+    // the parts cannot contain '/' (they are split from the credential by it)
+    std::string scope = access_key + "/" + date + "/" + region + "/" + service;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _items.find(scope);
+        if (it != _items.end() && CRYPTO_memcmp(it->second.secret_sha256, secret_sha256, KEY_LEN) == 0) {
+            _hits++;
+            _lru.splice(_lru.begin(), _lru, it->second.lru_it);
+            memcpy(key, it->second.key, KEY_LEN);
+            return;
+        }
+        _misses++;
+    }
+
+    const std::string k_secret = "AWS4" + secret;
+    uint8_t k[KEY_LEN];
+    hmac_sha256((const uint8_t*)k_secret.data(), k_secret.size(), date, k);
+    hmac_sha256(k, KEY_LEN, region, k);
+    hmac_sha256(k, KEY_LEN, service, k);
+    hmac_sha256(k, KEY_LEN, "aws4_request", key);
+    OPENSSL_cleanse(k, KEY_LEN);
+
+    if (!_max_count) return;
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _items.find(scope);
+    if (it == _items.end()) {
+        while (_items.size() >= _max_count) {
+            auto last = _items.find(_lru.back());
+            OPENSSL_cleanse(last->second.key, KEY_LEN);
+            _items.erase(last);
+            _lru.pop_back();
+        }
+        _lru.push_front(scope);
+        it = _items.emplace(std::move(scope), Item()).first;
+        it->second.lru_it = _lru.begin();
+    } else {
+        _lru.splice(_lru.begin(), _lru, it->second.lru_it);
+    }
+    memcpy(it->second.key, key, KEY_LEN);
+    memcpy(it->second.secret_sha256, secret_sha256, KEY_LEN);
+}
+
+std::string
+SigV4::signature(
+    const std::string& access_key,
+    const std::string& secret,
+    const std::string& xamzdate,
+    const std::string& region,
+    const std::string& service,
+    const std::string& string_to_sign)
+{
+    uint8_t key[KEY_LEN];
+    uint8_t sig[KEY_LEN];
+    signing_key(access_key, secret, xamzdate.substr(0, 8), region, service, key);
+    hmac_sha256(key, KEY_LEN, string_to_sign, sig);
+    OPENSSL_cleanse(key, KEY_LEN);
+    std::string out(KEY_LEN * 2, '\0');
+    for (size_t i = 0; i < KEY_LEN; ++i) {
+        out[i * 2] = HEX_CHARS[sig[i] >> 4];
+        out[i * 2 + 1] = HEX_CHARS[sig[i] & 0xf];
+    }
+    return out;
+}
+
+bool
+SigV4::signature_equals(const std::string& a, const std::string& b)
+{
+    return a.size() == b.size() && CRYPTO_memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+size_t
+SigV4::count() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _items.size();
+}
+
+uint64_t
+SigV4::hits() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _hits;
+}
+
+uint64_t
+SigV4::misses() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _misses;
+}
+
+} // namespace noobaa
@@ -0,0 +1,78 @@
+/* Copyright (C) 2016 NooBaa */
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <stdint.h>
+
+namespace noobaa
+{
+
+/**
+ * SigV4 computes aws sigv4 signatures (AWS4-HMAC-SHA256) of a string to sign.
+ *
+ * The signing key of a (access key, date, region, service) scope takes four hmac rounds
+ * from the secret, and it is the same for all the requests of a client in a day,
+ * so derived keys are kept in an LRU cache of max_count scopes.
+ * Every cached key remembers a sha256 of the secret it was derived from,
+ * so a changed secret of the same access key derives a new key instead of using a stale one.
+ */
+class SigV4
+{
+public:
+    static const size_t KEY_LEN = 32;
+
+    explicit SigV4(size_t max_count)
+        : _max_count(max_count)
+        , _hits(0)
+        , _misses(0)
+    {
+    }
+    ~SigV4();
+
+    // date is the yyyymmdd of the credential scope
+    void signing_key(
+        const std::string& access_key,
+        const std::string& secret,
+        const std::string& date,
+        const std::string& region,
+        const std::string& service,
+        uint8_t* key);
+
+    // returns the hex signature, the date of the scope is the first 8 chars of xamzdate
+    std::string signature(
+        const std::string& access_key,
+        const std::string& secret,
+        const std::string& xamzdate,
+        const std::string& region,
+        const std::string& service,
+        const std::string& string_to_sign);
+
+    // compares in constant time to not leak how many leading chars matched
+    static bool signature_equals(const std::string& a, const std::string& b);
+
+    size_t count() const;
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+private:
+    struct Item
+    {
+        uint8_t key[KEY_LEN];
+        uint8_t secret_sha256[KEY_LEN];
+        std::list<std::string>::iterator lru_it;
+    };
+
+    const size_t _max_count;
+    uint64_t _hits;
+    uint64_t _misses;
+    std::unordered_map<std::string, Item> _items;
+    // most recently used at the front
+    std::list<std::string> _lru;
+    mutable std::mutex _mutex;
+};
+
+} // namespace noobaa
@@ -0,0 +1,101 @@
+/* Copyright (C) 2016 NooBaa */
+#include "../util/napi.h"
+#include "sigv4.h"
+
+namespace noobaa
+{
+
+// signing keys of recent (access key, date, region, service) scopes, shared by all the requests
+const size_t SIGV4_KEY_CACHE_MAX_COUNT = 4096;
+static SigV4 g_sigv4(SIGV4_KEY_CACHE_MAX_COUNT);
+
+/**
+ * The sigv4 functions are synchronous, since with a cached signing key a signature
+ * is a single hmac of a short string, which is cheaper than passing it to a worker thread.
+ * The canonical request and string to sign are built by signature_utils.js.
+ */
+
+static void
+_check_string_args(const Napi::CallbackInfo& info, size_t count, const char* name)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (!info[i].IsString()) {
+            throw Napi::TypeError::New(info.Env(), std::string("sigv4.") + name + ": expected string arguments");
+        }
+    }
+}
+
+/**
+ * signature(access_key, secret, xamzdate, region, service, string_to_sign) returns the hex signature
+ */
+static Napi::Value
+sigv4_signature(const Napi::CallbackInfo& info)
+{
+    _check_string_args(info, 6, "signature");
+    const std::string sig = g_sigv4.signature(
+        napi_get_str(info[0]),
+        napi_get_str(info[1]),
+        napi_get_str(info[2]),
+        napi_get_str(info[3]),
+        napi_get_str(info[4]),
+        napi_get_str(info[5]));
+    return Napi::String::New(info.Env(), sig);
+}
+
+/**
+ * verify(access_key, secret, xamzdate, region, service, string_to_sign, signature) returns a boolean
+ */
+static Napi::Value
+sigv4_verify(const Napi::CallbackInfo& info)
+{
+    _check_string_args(info, 7, "verify");
+    const std::string sig = g_sigv4.signature(
+        napi_get_str(info[0]),
+        napi_get_str(info[1]),
+        napi_get_str(info[2]),
+        napi_get_str(info[3]),
+        napi_get_str(info[4]),
+        napi_get_str(info[5]));
+    return Napi::Boolean::New(info.Env(), SigV4::signature_equals(sig, napi_get_str(info[6])));
+}
+
+/**
+ * signing_key(access_key, secret, date, region, service) returns the 32 bytes key buffer
+ */
+static Napi::Value
+sigv4_signing_key(const Napi::CallbackInfo& info)
+{
+    _check_string_args(info, 5, "signing_key");
+    auto buf = Napi::Buffer<uint8_t>::New(info.Env(), SigV4::KEY_LEN);
+    g_sigv4.signing_key(
+        napi_get_str(info[0]),
+        napi_get_str(info[1]),
+        napi_get_str(info[2]),
+        napi_get_str(info[3]),
+        napi_get_str(info[4]),
+        buf.Data());
+    return buf;
+}
+
+static Napi::Value
+sigv4_cache_stats(const Napi::CallbackInfo& info)
+{
+    auto res = Napi::Object::New(info.Env());
+    res["count"] = Napi::Number::New(info.Env(), g_sigv4.count());
+    res["hits"] = Napi::Number::New(info.Env(), g_sigv4.hits());
+    res["misses"] = Napi::Number::New(info.Env(), g_sigv4.misses());
+    return res;
+}
+
+void
+sigv4_napi(Napi::Env env, Napi::Object exports)
+{
+    auto exports_sigv4 = Napi::Object::New(env);
+    exports_sigv4["signature"] = Napi::Function::New(env, sigv4_signature);
+    exports_sigv4["verify"] = Napi::Function::New(env, sigv4_verify);
+    exports_sigv4["signing_key"] = Napi::Function::New(env, sigv4_signing_key);
+    exports_sigv4["cache_stats"] = Napi::Function::New(env, sigv4_cache_stats);
+    exports["sigv4"] = exports_sigv4;
+}
+
+} // namespace noobaa
@@ -163,6 +163,76 @@
                      ]}
             ]],
         },
+        {
+            'target_name': 'isa-l-igzip',
+            'type': 'static_library',
+            'includes': ['../asm.gypi'],
+            'include_dirs': [
+                'isa-l/include/',
+                'isa-l/igzip/',
+            ],
+            'dependencies': [
+                'isa-l-crc',
+            ],
+            'sources': [
+                'isa-l/igzip/igzip.c',
+                'isa-l/igzip/hufftables_c.c',
+                'isa-l/igzip/igzip_base.c',
+                'isa-l/igzip/igzip_icf_base.c',
+                'isa-l/igzip/adler32_base.c',
+                'isa-l/igzip/flatten_ll.c',
+                'isa-l/igzip/encode_df.c',
+                'isa-l/igzip/igzip_icf_body.c',
+                'isa-l/igzip/huff_codes.c',
+                'isa-l/igzip/igzip_inflate.c',
+            ],
+            'conditions': [
+                ['node_arch=="x64"', {
+                    'sources': [
+                        'isa-l/igzip/igzip_body.asm',
+                        'isa-l/igzip/igzip_finish.asm',
+                        'isa-l/igzip/igzip_icf_body_h1_gr_bt.asm',
+                        'isa-l/igzip/igzip_icf_finish.asm',
+                        'isa-l/igzip/rfc1951_lookup.asm',
+                        'isa-l/igzip/adler32_sse.asm',
+                        'isa-l/igzip/adler32_avx2_4.asm',
+                        'isa-l/igzip/igzip_multibinary.asm',
+                        'isa-l/igzip/igzip_update_histogram_01.asm',
+                        'isa-l/igzip/igzip_update_histogram_04.asm',
+                        'isa-l/igzip/igzip_decode_block_stateless_01.asm',
+                        'isa-l/igzip/igzip_decode_block_stateless_04.asm',
+                        'isa-l/igzip/igzip_inflate_multibinary.asm',
+                        'isa-l/igzip/encode_df_04.asm',
+                        'isa-l/igzip/encode_df_06.asm',
+                        'isa-l/igzip/proc_heap.asm',
+                        'isa-l/igzip/igzip_deflate_hash.asm',
+                        'isa-l/igzip/igzip_gen_icf_map_lh1_06.asm',
+                        'isa-l/igzip/igzip_gen_icf_map_lh1_04.asm',
+                        'isa-l/igzip/igzip_set_long_icf_fg_04.asm',
+                        'isa-l/igzip/igzip_set_long_icf_fg_06.asm',
+                    ]
+                }],
+                ['node_arch=="arm64" and OS=="linux"', {
+                    'sources': [
+                        'isa-l/igzip/aarch64/igzip_inflate_multibinary_arm64.S',
+                        'isa-l/igzip/aarch64/igzip_multibinary_arm64.S',
+                        'isa-l/igzip/aarch64/igzip_isal_adler32_neon.S',
+                        'isa-l/igzip/aarch64/igzip_multibinary_aarch64_dispatcher.c',
+                        'isa-l/igzip/aarch64/igzip_deflate_body_aarch64.S',
+                        'isa-l/igzip/aarch64/igzip_deflate_finish_aarch64.S',
+                        'isa-l/igzip/aarch64/isal_deflate_icf_body_hash_hist.S',
+                        'isa-l/igzip/aarch64/isal_deflate_icf_finish_hash_hist.S',
+                        'isa-l/igzip/aarch64/igzip_set_long_icf_fg.S',
+                        'isa-l/igzip/aarch64/encode_df.S',
+                        'isa-l/igzip/aarch64/isal_update_histogram.S',
+                        'isa-l/igzip/aarch64/gen_icf_map.S',
+                        'isa-l/igzip/aarch64/igzip_deflate_hash_aarch64.S',
+                        'isa-l/igzip/aarch64/igzip_decode_huffman_code_block_aarch64.S',
+                        'isa-l/igzip/proc_heap_base.c',
+                    ]
+                }],
+            ],
+        },
         {
             'target_name': 'isa-l-rolling-hash',
             'type': 'static_library',
@@ -353,6 +423,53 @@
                 'isa-l_crypto/sha256_mb/aarch64/sha256_mb_x4_ce.S',
             ]}]],
         },
+        {
+            # no base implementation - requires aes-ni/pclmul on x64 and the crypto extension on arm64
+            'target_name': 'isa-l-aes',
+            'type': 'static_library',
+            'includes': ['../asm.gypi'],
+            'include_dirs': [
+                'isa-l_crypto/include/',
+                'isa-l_crypto/aes/',
+            ],
+            'sources': [
+                'isa-l_crypto/aes/gcm_pre.c',
+            ],
+            'conditions': [['node_arch=="x64"', {'sources': [
+                'isa-l_crypto/aes/gcm_multibinary.asm',
+                'isa-l_crypto/aes/gcm128_sse.asm',
+                'isa-l_crypto/aes/gcm128_avx_gen2.asm',
+                'isa-l_crypto/aes/gcm128_avx_gen4.asm',
+                'isa-l_crypto/aes/gcm128_vaes_avx512.asm',
+                'isa-l_crypto/aes/gcm256_sse.asm',
+                'isa-l_crypto/aes/gcm256_avx_gen2.asm',
+                'isa-l_crypto/aes/gcm256_avx_gen4.asm',
+                'isa-l_crypto/aes/gcm256_vaes_avx512.asm',
+                'isa-l_crypto/aes/keyexp_multibinary.asm',
+                'isa-l_crypto/aes/keyexp_128.asm',
+                'isa-l_crypto/aes/keyexp_192.asm',
+                'isa-l_crypto/aes/keyexp_256.asm',
+            ]}],
+            ['node_arch=="arm64" and OS=="linux"', {'sources': [
+                'isa-l_crypto/aes/aarch64/gcm_multibinary_aarch64.S',
+                'isa-l_crypto/aes/aarch64/gcm_aarch64_dispatcher.c',
+                'isa-l_crypto/aes/aarch64/keyexp_multibinary_aarch64.S',
+                'isa-l_crypto/aes/aarch64/keyexp_aarch64_dispatcher.c',
+                'isa-l_crypto/aes/aarch64/keyexp_128_aarch64_aes.S',
+                'isa-l_crypto/aes/aarch64/keyexp_192_aarch64_aes.S',
+                'isa-l_crypto/aes/aarch64/keyexp_256_aarch64_aes.S',
+                'isa-l_crypto/aes/aarch64/aes_gcm_aes_init.S',
+                'isa-l_crypto/aes/aarch64/aes_gcm_consts.S',
+                'isa-l_crypto/aes/aarch64/aes_gcm_precomp_128.S',
+                'isa-l_crypto/aes/aarch64/aes_gcm_enc_dec_128.S',
+                'isa-l_crypto/aes/aarch64/aes_gcm_update_128.S',
+                'isa-l_crypto/aes/aarch64/aes_gcm_aes_finalize_128.S',
+                'isa-l_crypto/aes/aarch64/aes_gcm_precomp_256.S',
+                'isa-l_crypto/aes/aarch64/aes_gcm_enc_dec_256.S',
+                'isa-l_crypto/aes/aarch64/aes_gcm_update_256.S',
+                'isa-l_crypto/aes/aarch64/aes_gcm_aes_finalize_256.S',
+            ]}]],
+        },
         {
             'target_name': 'isa-l-sha512',
             'type': 'static_library',
@@ -0,0 +1,237 @@
+/* Copyright (C) 2016 NooBaa */
+#include "async_log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <unistd.h>
+
+#ifndef WIN32
+#include <syslog.h>
+#endif
+
+namespace noobaa
+{
+
+const size_t AsyncLog::MAX_BATCH;
+
+// how long the writer sleeps when idle, producers wake it up earlier when it is waiting
+static const auto ASYNC_LOG_IDLE_WAIT = std::chrono::milliseconds(100);
+// how long to wait for a blocked stderr pipe before trying again
+static const int ASYNC_LOG_POLL_TIMEOUT_MS = 1000;
+
+static size_t
+_round_up_pow2(size_t n)
+{
+    size_t p = 2;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+AsyncLog::AsyncLog(size_t capacity)
+    : _mask(_round_up_pow2(capacity) - 1)
+    , _cells(new Cell[_mask + 1])
+    , _enqueue_pos(0)
+    , _dequeue_pos(0)
+    , _done_pos(0)
+    , _pushed(0)
+    , _written(0)
+    , _dropped(0)
+    , _batches(0)
+    , _reported_dropped(0)
+    , _waiting(false)
+    , _hold(false)
+    , _stopped(false)
+{
+    for (size_t i = 0; i <= _mask; ++i) {
+        _cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+    _writer = std::thread(&AsyncLog::_writer_main, this);
+}
+
+AsyncLog::~AsyncLog()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopped = true;
+    }
+    _cond.notify_one();
+    _writer.join();
+}
+
+bool
+AsyncLog::push(std::string&& stderr_line, std::string&& syslog_line, int priority)
+{
+    size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+        cell = &_cells[pos & _mask];
+        const size_t seq = cell->seq.load(std::memory_order_acquire);
+        const intptr_t diff = intptr_t(seq) - intptr_t(pos);
+        if (diff == 0) {
+            if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            // the writer did not free this cell yet - the ring is full
+            _dropped++;
+            return false;
+        } else {
+            pos = _enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    cell->rec.stderr_line = std::move(stderr_line);
+    cell->rec.syslog_line = std::move(syslog_line);
+    cell->rec.priority = priority;
+    cell->seq.store(pos + 1, std::memory_order_release);
+    _pushed++;
+
+    // pairs with the fence in _writer_main so that either the writer sees the line or we see it waiting
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_waiting.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _cond.notify_one();
+    }
+    return true;
+}
+
+bool
+AsyncLog::flush(int timeout_ms)
+{
+    const size_t target = _enqueue_pos.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cond.notify_one();
+    return _done_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] {
+        return _done_pos.load(std::memory_order_acquire) >= target;
+    });
+}
+
+void
+AsyncLog::hold(bool held)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _hold = held;
+    _cond.notify_one();
+}
+
+bool
+AsyncLog::_has_ready() const
+{
+    return _cells[_dequeue_pos & _mask].seq.load(std::memory_order_acquire) == _dequeue_pos + 1;
+}
+
+size_t
+AsyncLog::_pop_batch(Record* batch)
+{
+    size_t n = 0;
+    while (n < MAX_BATCH && _has_ready()) {
+        Cell& cell = _cells[_dequeue_pos & _mask];
+        batch[n++] = std::move(cell.rec);
+        cell.seq.store(_dequeue_pos + _mask + 1, std::memory_order_release);
+        _dequeue_pos++;
+    }
+    return n;
+}
+
+void
+AsyncLog::_writer_main()
+{
+    std::vector<Record> batch(MAX_BATCH + 1);
+    for (;;) {
+        const size_t popped = _hold ? 0 : _pop_batch(batch.data());
+        size_t n = popped;
+        if (n) {
+            const uint64_t dropped = _dropped;
+            if (dropped != _reported_dropped) {
+                // reported on the sinks of the last line
+                const Record& last = batch[n - 1];
+                const std::string msg = "AsyncLog: dropped " + std::to_string(dropped - _reported_dropped) +
+                    " log lines (ring of " + std::to_string(capacity()) + " lines was full)";
+                batch[n].stderr_line = last.stderr_line.empty() ? "" : msg;
+                batch[n].syslog_line = last.syslog_line.empty() ? "" : msg;
+                batch[n].priority = last.priority;
+                _reported_dropped = dropped;
+                n++;
+            }
+            _write_batch(batch.data(), n);
+            // the dropped report was not pushed, so it is not counted as written
+            _written += popped;
+            _done_pos.store(_dequeue_pos, std::memory_order_release);
+            {
+                // taking the lock orders the notify after a flush checked _done_pos and started waiting
+                std::lock_guard<std::mutex> lock(_mutex);
+            }
+            _done_cond.notify_all();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_stopped) break;
+        _waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_hold || !_has_ready()) _cond.wait_for(lock, ASYNC_LOG_IDLE_WAIT);
+        _waiting.store(false, std::memory_order_relaxed);
+    }
+}
+
+void
+AsyncLog::_write_batch(Record* batch, size_t count)
+{
+    static char NEWLINE[] = "\n";
+    struct iovec iov[MAX_BATCH * 2 + 2];
+    int iovcnt = 0;
+    for (size_t i = 0; i < count; ++i) {
+        std::string& line = batch[i].stderr_line;
+        if (line.empty()) continue;
+        iov[iovcnt].iov_base = &line[0];
+        iov[iovcnt].iov_len = line.size();
+        iov[iovcnt + 1].iov_base = NEWLINE;
+        iov[iovcnt + 1].iov_len = 1;
+        iovcnt += 2;
+    }
+    if (iovcnt) _write_stderr(iov, iovcnt);
+
+#ifndef WIN32
+    for (size_t i = 0; i < count; ++i) {
+        const std::string& line = batch[i].syslog_line;
+        if (!line.empty()) ::syslog(batch[i].priority, "%s", line.c_str());
+    }
+#endif
+
+    for (size_t i = 0; i < count; ++i) {
+        batch[i].stderr_line.clear();
+        batch[i].syslog_line.clear();
+    }
+    _batches++;
+}
+
+void
+AsyncLog::_write_stderr(struct iovec* iov, int iovcnt)
+{
+    while (iovcnt > 0) {
+        ssize_t n = writev(STDERR_FILENO, iov, std::min(iovcnt, IOV_MAX));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // node can make stderr non blocking, so wait for the pipe to drain
+                struct pollfd pfd = { STDERR_FILENO, POLLOUT, 0 };
+                poll(&pfd, 1, ASYNC_LOG_POLL_TIMEOUT_MS);
+                continue;
+            }
+            // nowhere to report it - the lines are lost
+            return;
+        }
+        while (iovcnt > 0 && size_t(n) >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+}
+
+} // namespace noobaa
@@ -0,0 +1,99 @@
+/* Copyright (C) 2016 NooBaa */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+namespace noobaa
+{
+
+/**
+ * AsyncLog writes preformatted log lines to stderr and syslog from a background thread,
+ * so that logging never blocks the event loop on a slow pipe, disk or syslog daemon.
+ *
+ * Lines are passed through a bounded lock-free MPSC ring (any thread or worker can log,
+ * a single writer thread drains it). The writer takes up to a batch of lines at a time,
+ * writes the stderr lines with one writev, and sends the syslog lines with ::syslog.
+ *
+ * When the ring is full the new line is dropped (the caller is never blocked) and counted,
+ * and the writer logs how many lines were dropped once it catches up.
+ * flush() waits until the lines that were pushed before it are written, with a timeout,
+ * which is used before the process exits.
+ */
+class AsyncLog
+{
+public:
+    static const size_t MAX_BATCH = 256;
+
+    // capacity is rounded up to a power of 2
+    explicit AsyncLog(size_t capacity);
+    ~AsyncLog();
+
+    // an empty line is not written to its sink, priority includes the syslog facility.
+    // returns false when the line was dropped because the ring is full.
+    bool push(std::string&& stderr_line, std::string&& syslog_line, int priority);
+
+    // returns true if everything pushed before the call was written within the timeout
+    bool flush(int timeout_ms);
+
+    // while held the writer takes no more lines after its current batch, so tests can fill the ring
+    void hold(bool held);
+
+    size_t capacity() const { return _mask + 1; }
+    uint64_t pushed() const { return _pushed; }
+    // counts the pushed lines that were written, without the dropped lines reports
+    uint64_t written() const { return _written; }
+    uint64_t dropped() const { return _dropped; }
+    uint64_t batches() const { return _batches; }
+
+private:
+    struct Record
+    {
+        std::string stderr_line;
+        std::string syslog_line;
+        int priority = 0;
+    };
+
+    struct Cell
+    {
+        std::atomic<size_t> seq;
+        Record rec;
+    };
+
+    void _writer_main();
+    size_t _pop_batch(Record* batch);
+    void _write_batch(Record* batch, size_t count);
+    void _write_stderr(struct iovec* iov, int iovcnt);
+    bool _has_ready() const;
+
+    const size_t _mask;
+    std::unique_ptr<Cell[]> _cells;
+    // producers claim positions with cas on _enqueue_pos, only the writer moves _dequeue_pos
+    alignas(64) std::atomic<size_t> _enqueue_pos;
+    alignas(64) size_t _dequeue_pos;
+    // the ring positions that were written, flush waits for it to pass its enqueue position
+    std::atomic<size_t> _done_pos;
+
+    std::atomic<uint64_t> _pushed;
+    std::atomic<uint64_t> _written;
+    std::atomic<uint64_t> _dropped;
+    std::atomic<uint64_t> _batches;
+    uint64_t _reported_dropped;
+
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::condition_variable _done_cond;
+    std::atomic<bool> _waiting;
+    std::atomic<bool> _hold;
+    std::atomic<bool> _stopped;
+    std::thread _writer;
+};
+
+} // namespace noobaa
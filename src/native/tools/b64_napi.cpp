@@ -3,17 +3,28 @@
 #include "../util/common.h"
 #include "../util/napi.h"
 
+#include <vector>
+
 namespace noobaa
 {
 
 static Napi::Value _b64_encode(const Napi::CallbackInfo& info);
 static Napi::Value _b64_decode(const Napi::CallbackInfo& info);
+static Napi::Value _b64_encode_bulk(const Napi::CallbackInfo& info);
+static Napi::Value _b64_decode_bulk(const Napi::CallbackInfo& info);
+static Napi::Value _hex_encode_bulk(const Napi::CallbackInfo& info);
+static Napi::Value _hex_decode_bulk(const Napi::CallbackInfo& info);
 
 void
 b64_napi(Napi::Env env, Napi::Object exports)
 {
     exports["b64_encode"] = Napi::Function::New(env, _b64_encode);
     exports["b64_decode"] = Napi::Function::New(env, _b64_decode);
+    exports["b64_encode_bulk"] = Napi::Function::New(env, _b64_encode_bulk);
+    exports["b64_decode_bulk"] = Napi::Function::New(env, _b64_decode_bulk);
+    exports["hex_encode_bulk"] = Napi::Function::New(env, _hex_encode_bulk);
+    exports["hex_decode_bulk"] = Napi::Function::New(env, _hex_decode_bulk);
+    exports["b64_simd"] = Napi::String::New(env, b64_simd_name());
 }
 
 static Napi::Value
@@ -79,4 +90,108 @@ _b64_decode(const Napi::CallbackInfo& info)
 
     return Napi::Buffer<uint8_t>::New(info.Env(), output.release(), r);
 }
+
+typedef int (*CodecFunc)(const uint8_t* in, int len, uint8_t* out);
+typedef int (*CodecLenFunc)(int len);
+
+/**
+ * The bulk functions convert an array of small items (digests, keys, etags)
+ * in a single call, to save the per item call overhead which dominates for such sizes,
+ * and reuse one scratch buffer for all the items.
+ */
+static Napi::Value
+_encode_bulk(const Napi::CallbackInfo& info, const char* name, CodecFunc encode, CodecLenFunc encode_len)
+{
+    Napi::Env env = info.Env();
+    if (!info[0].IsArray()) {
+        throw Napi::TypeError::New(env, XSTR() << name << ": 1st argument should be Buffer[]");
+    }
+    auto arr = info[0].As<Napi::Array>();
+    const uint32_t n = arr.Length();
+    auto res = Napi::Array::New(env, n);
+    std::vector<uint8_t> output;
+    for (uint32_t i = 0; i < n; ++i) {
+        Napi::Value item = arr[i];
+        if (!item.IsBuffer()) {
+            throw Napi::TypeError::New(env, XSTR() << name << ": item " << i << " should be Buffer");
+        }
+        auto buf = item.As<Napi::Buffer<uint8_t>>();
+        const int input_len = buf.Length();
+        output.resize(encode_len(input_len));
+        const int r = encode(buf.Data(), input_len, output.data());
+        if (r < 0) {
+            throw Napi::Error::New(env, XSTR() << name << ": failed " << r << " item " << i);
+        }
+        napi_value v = 0;
+        // the output is ascii so latin1 is the cheapest string to create
+        napi_create_string_latin1(env, reinterpret_cast<char*>(output.data()), r, &v);
+        res[i] = Napi::Value(env, v);
+    }
+    return res;
+}
+
+static Napi::Value
+_decode_bulk(const Napi::CallbackInfo& info, const char* name, CodecFunc decode, CodecLenFunc decode_len)
+{
+    Napi::Env env = info.Env();
+    if (!info[0].IsArray()) {
+        throw Napi::TypeError::New(env, XSTR() << name << ": 1st argument should be Array<String|Buffer>");
+    }
+    auto arr = info[0].As<Napi::Array>();
+    const uint32_t n = arr.Length();
+    auto res = Napi::Array::New(env, n);
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> output;
+    for (uint32_t i = 0; i < n; ++i) {
+        Napi::Value item = arr[i];
+        const uint8_t* in = 0;
+        int input_len = 0;
+        if (item.IsBuffer()) {
+            auto buf = item.As<Napi::Buffer<uint8_t>>();
+            in = buf.Data();
+            input_len = buf.Length();
+        } else if (item.IsString()) {
+            // utf8 and not latin1, so that non ascii chars stay invalid instead of truncated to a byte
+            size_t len = 0;
+            napi_get_value_string_utf8(env, item, 0, 0, &len);
+            input.resize(len + 1);
+            napi_get_value_string_utf8(env, item, reinterpret_cast<char*>(input.data()), input.size(), &len);
+            in = input.data();
+            input_len = len;
+        } else {
+            throw Napi::TypeError::New(env, XSTR() << name << ": item " << i << " should be String|Buffer");
+        }
+        output.resize(decode_len(input_len));
+        const int r = decode(in, input_len, output.data());
+        if (r < 0) {
+            throw Napi::Error::New(env, XSTR() << name << ": failed " << r << " item " << i);
+        }
+        res[i] = Napi::Buffer<uint8_t>::Copy(env, output.data(), r);
+    }
+    return res;
+}
+
+static Napi::Value
+_b64_encode_bulk(const Napi::CallbackInfo& info)
+{
+    return _encode_bulk(info, "b64_encode_bulk", b64_encode, b64_encode_len);
+}
+
+static Napi::Value
+_b64_decode_bulk(const Napi::CallbackInfo& info)
+{
+    return _decode_bulk(info, "b64_decode_bulk", b64_decode, b64_decode_len);
+}
+
+static Napi::Value
+_hex_encode_bulk(const Napi::CallbackInfo& info)
+{
+    return _encode_bulk(info, "hex_encode_bulk", hex_encode, hex_encode_len);
+}
+
+static Napi::Value
+_hex_decode_bulk(const Napi::CallbackInfo& info)
+{
+    return _decode_bulk(info, "hex_decode_bulk", hex_decode, hex_decode_len);
+}
 }
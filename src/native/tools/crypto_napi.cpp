@@ -1,7 +1,9 @@
 /* Copyright (C) 2016 NooBaa */
+#include <memory>
 #include <string.h>
 #include <vector>
 #include "../third_party/isa-l_crypto/include/md5_mb.h"
+#include "../util/checksum.h"
 #include "../util/common.h"
 #include "../util/endian.h"
 #include "../util/napi.h"
@@ -108,6 +110,144 @@ MD5Wrap::digest(const Napi::CallbackInfo& info)
     return await_worker<MD5Digest>(info);
 }
 
+/**
+ * ChecksumWrap computes a set of S3 flexible checksums (CRC32, CRC32C, CRC64NVME, SHA1, SHA256)
+ * in a single pass over the data, on the worker threads like MD5Async.
+ * new ChecksumAsync(['CRC32C', 'SHA256'])
+ * update(buffer or buffers) and digest() resolves to { CRC32C: Buffer, SHA256: Buffer }
+ */
+struct ChecksumWrap : public Napi::ObjectWrap<ChecksumWrap>
+{
+    std::unique_ptr<MultiChecksum> _checksum;
+
+    static Napi::FunctionReference constructor;
+    static void init(Napi::Env env)
+    {
+        constructor = Napi::Persistent(DefineClass(
+            env,
+            "Checksum",
+            {
+                InstanceMethod("update", &ChecksumWrap::update),
+                InstanceMethod("digest", &ChecksumWrap::digest),
+            }));
+        constructor.SuppressDestruct();
+    }
+    ChecksumWrap(const Napi::CallbackInfo& info)
+        : Napi::ObjectWrap<ChecksumWrap>(info)
+    {
+        if (!info[0].IsArray()) {
+            throw Napi::TypeError::New(info.Env(), "ChecksumAsync: expected array of algorithms");
+        }
+        auto arr = info[0].As<Napi::Array>();
+        uint32_t algos = 0;
+        for (uint32_t i = 0; i < arr.Length(); ++i) {
+            const std::string name = napi_get_str(arr.Get(i));
+            const int algo = checksum_algo_parse(name);
+            if (algo < 0) {
+                throw Napi::TypeError::New(info.Env(), "ChecksumAsync: unsupported algorithm " + name);
+            }
+            algos |= 1u << algo;
+        }
+        _checksum.reset(new MultiChecksum(algos));
+    }
+    Napi::Value update(const Napi::CallbackInfo& info);
+    Napi::Value digest(const Napi::CallbackInfo& info);
+};
+
+Napi::FunctionReference ChecksumWrap::constructor;
+
+struct ChecksumUpdate : public ObjectWrapWorker<ChecksumWrap>
+{
+    std::vector<std::pair<const uint8_t*, size_t>> _bufs;
+    ChecksumUpdate(const Napi::CallbackInfo& info)
+        : ObjectWrapWorker<ChecksumWrap>(info)
+    {
+        // accept a single buffer or an array of buffers to save a worker per buffer
+        if (info[0].IsArray()) {
+            auto arr = info[0].As<Napi::Array>();
+            _bufs.reserve(arr.Length());
+            for (uint32_t i = 0; i < arr.Length(); ++i) {
+                auto buf = arr.Get(i).As<Napi::Buffer<uint8_t>>();
+                _bufs.emplace_back(buf.Data(), buf.Length());
+            }
+        } else {
+            auto buf = info[0].As<Napi::Buffer<uint8_t>>();
+            _bufs.emplace_back(buf.Data(), buf.Length());
+        }
+    }
+    virtual void Execute()
+    {
+        for (const auto& it : _bufs) {
+            _wrap->_checksum->update(it.first, it.second);
+        }
+    }
+};
+
+struct ChecksumDigest : public ObjectWrapWorker<ChecksumWrap>
+{
+    uint8_t _digests[CHECKSUM_ALGOS][32];
+    ChecksumDigest(const Napi::CallbackInfo& info)
+        : ObjectWrapWorker<ChecksumWrap>(info)
+    {
+    }
+    virtual void Execute()
+    {
+        for (int algo = 0; algo < CHECKSUM_ALGOS; ++algo) {
+            if (_wrap->_checksum->has(algo)) _wrap->_checksum->digest(algo, _digests[algo]);
+        }
+    }
+    virtual void OnOK()
+    {
+        Napi::Env env = Env();
+        auto res = Napi::Object::New(env);
+        for (int algo = 0; algo < CHECKSUM_ALGOS; ++algo) {
+            if (!_wrap->_checksum->has(algo)) continue;
+            res[checksum_algo_name(algo)] = Napi::Buffer<uint8_t>::Copy(env, _digests[algo], checksum_len(algo));
+        }
+        _promise.Resolve(res);
+    }
+};
+
+Napi::Value
+ChecksumWrap::update(const Napi::CallbackInfo& info)
+{
+    return await_worker<ChecksumUpdate>(info);
+}
+
+Napi::Value
+ChecksumWrap::digest(const Napi::CallbackInfo& info)
+{
+    return await_worker<ChecksumDigest>(info);
+}
+
+/**
+ * checksum_combine(algorithm, crc1, crc2, len2) returns the crc of the concatenation
+ * of two parts given the crc buffers of both and the length of the second part.
+ * Used to compute FULL_OBJECT multipart checksums from the part checksums.
+ */
+static Napi::Value
+checksum_combine(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    const std::string name = napi_get_str(info[0]);
+    const int algo = checksum_algo_parse(name);
+    if (algo < 0 || !checksum_is_crc(algo)) {
+        throw Napi::TypeError::New(env, "checksum_combine: unsupported algorithm " + name);
+    }
+    const size_t len = checksum_len(algo);
+    if (!info[1].IsBuffer() || !info[2].IsBuffer() ||
+        info[1].As<Napi::Buffer<uint8_t>>().Length() != len ||
+        info[2].As<Napi::Buffer<uint8_t>>().Length() != len) {
+        throw Napi::TypeError::New(env, "checksum_combine: expected crc buffers of " + std::to_string(len) + " bytes");
+    }
+    const uint64_t crc1 = checksum_crc_from_bytes(algo, info[1].As<Napi::Buffer<uint8_t>>().Data());
+    const uint64_t crc2 = checksum_crc_from_bytes(algo, info[2].As<Napi::Buffer<uint8_t>>().Data());
+    const uint64_t len2 = info[3].As<Napi::Number>().Int64Value();
+    uint8_t out[8];
+    checksum_crc_to_bytes(algo, crc_combine(algo, crc1, crc2, len2), out);
+    return Napi::Buffer<uint8_t>::Copy(env, out, len);
+}
+
 void
 crypto_napi(Napi::Env env, Napi::Object exports)
 {
@@ -116,6 +256,10 @@ crypto_napi(Napi::Env env, Napi::Object exports)
     MD5Wrap::init(env);
     exports_crypto_async["MD5Async"] = MD5Wrap::constructor.Value();
 
+    ChecksumWrap::init(env);
+    exports_crypto_async["ChecksumAsync"] = ChecksumWrap::constructor.Value();
+    exports_crypto_async["checksum_combine"] = Napi::Function::New(env, checksum_combine);
+
     exports["crypto"] = exports_crypto_async;
 }
 
@@ -1,6 +1,10 @@
 /* Copyright (C) 2016 NooBaa */
 #include "../util/napi.h"
 #include "../util/common.h"
+#include "async_log.h"
+
+#include <stdlib.h>
+#include <system_error>
 
 #ifndef WIN32
 #include <syslog.h>
@@ -12,18 +16,46 @@ namespace noobaa
 static void _syslog(const Napi::CallbackInfo& info);
 static void _openlog(const Napi::CallbackInfo& info);
 static void _closelog(const Napi::CallbackInfo& info);
+static void _log_async_init(const Napi::CallbackInfo& info);
+static Napi::Value _log_async(const Napi::CallbackInfo& info);
+static Napi::Value _log_async_flush(const Napi::CallbackInfo& info);
+static Napi::Value _log_async_stats(const Napi::CallbackInfo& info);
+static void _log_async_hold(const Napi::CallbackInfo& info);
 
 // openlog requires ident to remain allocated until closelog is called.
 // since we pass the string data() to openlog we must not modify this string
 // in any way otherwise that pointer might be invalidated.
 static std::string _syslog_ident;
 
+// created once by log_async_init and never deleted, so that lines logged by
+// other threads during process exit do not race with its destruction
+static std::atomic<AsyncLog*> _async_log(nullptr);
+static std::mutex _async_log_mutex;
+static const int ASYNC_LOG_CLEANUP_FLUSH_MS = 1000;
+
+static void
+_async_log_cleanup(void*)
+{
+    AsyncLog* async_log = _async_log.load();
+    if (async_log) async_log->flush(ASYNC_LOG_CLEANUP_FLUSH_MS);
+}
+
 void
 syslog_napi(Napi::Env env, Napi::Object exports)
 {
     exports["syslog"] = Napi::Function::New(env, _syslog);
     exports["openlog"] = Napi::Function::New(env, _openlog);
     exports["closelog"] = Napi::Function::New(env, _closelog);
+    exports["log_async_init"] = Napi::Function::New(env, _log_async_init);
+    exports["log_async"] = Napi::Function::New(env, _log_async);
+    exports["log_async_flush"] = Napi::Function::New(env, _log_async_flush);
+    exports["log_async_stats"] = Napi::Function::New(env, _log_async_stats);
+    // test hooks are exported only to processes that set NOOBAA_NATIVE_TEST_HOOKS (the unit tests)
+    if (std::getenv("NOOBAA_NATIVE_TEST_HOOKS")) {
+        exports["log_async_hold"] = Napi::Function::New(env, _log_async_hold);
+    }
+    // flush the lines of this env (main or worker thread) when it is torn down
+    napi_add_env_cleanup_hook(env, _async_log_cleanup, nullptr);
 }
 
 static void
@@ -63,4 +95,85 @@ _closelog(const Napi::CallbackInfo& info)
     _syslog_ident.clear();
 #endif
 }
+
+/**
+ * log_async_init(capacity) starts the shared AsyncLog, later calls are ignored
+ */
+static void
+_log_async_init(const Napi::CallbackInfo& info)
+{
+    std::lock_guard<std::mutex> lock(_async_log_mutex);
+    if (_async_log.load()) return;
+    const int64_t capacity = info[0].IsNumber() ? info[0].As<Napi::Number>().Int64Value() : 0;
+    if (capacity < 2 || capacity > (1 << 24)) {
+        throw Napi::TypeError::New(info.Env(), "log_async_init: capacity should be between 2 and 16M lines");
+    }
+    try {
+        _async_log.store(new AsyncLog(capacity));
+    } catch (const std::system_error& err) {
+        throw Napi::Error::New(info.Env(), std::string("log_async_init: ") + err.what());
+    }
+}
+
+/**
+ * log_async(stderr_line, syslog_line, priority, facility) queues a line to the AsyncLog
+ * for stderr and/or syslog (a missing line skips that sink).
+ * returns false when the line was dropped because the queue is full.
+ */
+static Napi::Value
+_log_async(const Napi::CallbackInfo& info)
+{
+    AsyncLog* async_log = _async_log.load();
+    if (!async_log) throw Napi::Error::New(info.Env(), "log_async: not initialized, call log_async_init first");
+    std::string stderr_line = info[0].IsString() ? info[0].As<Napi::String>().Utf8Value() : std::string();
+    std::string syslog_line;
+    int priority = 0;
+    if (info[1].IsString()) {
+        syslog_line = info[1].As<Napi::String>().Utf8Value();
+        priority = info[2].As<Napi::Number>().Int32Value();
+#ifndef WIN32
+        priority |= info[3].IsString() ? _convert_facility(info[3].As<Napi::String>().Utf8Value()) : LOG_LOCAL0;
+#endif
+    }
+    const bool queued = async_log->push(std::move(stderr_line), std::move(syslog_line), priority);
+    return Napi::Boolean::New(info.Env(), queued);
+}
+
+/**
+ * log_async_flush(timeout_ms) waits for the queued lines to be written,
+ * returns false if the timeout expired first
+ */
+static Napi::Value
+_log_async_flush(const Napi::CallbackInfo& info)
+{
+    AsyncLog* async_log = _async_log.load();
+    const int timeout_ms = info[0].IsNumber() ? info[0].As<Napi::Number>().Int32Value() : ASYNC_LOG_CLEANUP_FLUSH_MS;
+    return Napi::Boolean::New(info.Env(), !async_log || async_log->flush(timeout_ms));
+}
+
+static Napi::Value
+_log_async_stats(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    AsyncLog* async_log = _async_log.load();
+    if (!async_log) return env.Undefined();
+    auto res = Napi::Object::New(env);
+    res["capacity"] = Napi::Number::New(env, async_log->capacity());
+    res["pushed"] = Napi::Number::New(env, async_log->pushed());
+    res["written"] = Napi::Number::New(env, async_log->written());
+    res["dropped"] = Napi::Number::New(env, async_log->dropped());
+    res["batches"] = Napi::Number::New(env, async_log->batches());
+    return res;
+}
+
+/**
+ * log_async_hold(held) stops the AsyncLog writer from taking lines until it is released (test hook)
+ */
+static void
+_log_async_hold(const Napi::CallbackInfo& info)
+{
+    AsyncLog* async_log = _async_log.load();
+    if (!async_log) throw Napi::Error::New(info.Env(), "log_async_hold: not initialized, call log_async_init first");
+    async_log->hold(info[0].As<Napi::Boolean>());
+}
 }
@@ -3,6 +3,14 @@
 #include <stdio.h>
 #include <string.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#define B64_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define B64_NEON 1
+#include <arm_neon.h>
+#endif
+
 namespace noobaa
 {
 
@@ -36,6 +44,537 @@ const uint8_t B64_DECODE[256] = {
 };
 /* clang-format on */
 
+static const char HEX_ENCODE[17] = "0123456789abcdef";
+
+static inline int
+_hex_value(uint8_t c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+/**
+ * The simd kernels convert whole blocks from the start of the input and return the number
+ * of input bytes they consumed, and the number of output bytes in *out_len.
+ * They stop early on the first block with an invalid char, and leave the rest
+ * (including the base64 padding) to the scalar code which also reports the errors.
+ * Kernels may store a few bytes past their output, but only where the output of
+ * the input that remains after them will be written anyway.
+ */
+typedef int (*Kernel)(const uint8_t* in, int len, uint8_t* out, int* out_len);
+
+struct Kernels
+{
+    const char* name;
+    Kernel b64_encode;
+    Kernel b64_decode;
+    Kernel hex_encode;
+    Kernel hex_decode;
+};
+
+#if B64_X86
+
+#define SSSE3 __attribute__((target("ssse3")))
+#define AVX2 __attribute__((target("avx2")))
+
+// maps 6 bit values to base64 chars by adding the offset of the range of each value
+SSSE3 static inline __m128i
+_b64_lookup_ssse3(__m128i v)
+{
+    // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+    __m128i r = _mm_subs_epu8(v, _mm_set1_epi8(51));
+    const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), v);
+    r = _mm_or_si128(r, _mm_and_si128(less, _mm_set1_epi8(13)));
+    const __m128i offsets = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    return _mm_add_epi8(v, _mm_shuffle_epi8(offsets, r));
+}
+
+// splits every 3 bytes to 4 bytes of 6 bits each
+SSSE3 static inline __m128i
+_b64_unpack_ssse3(__m128i v)
+{
+    v = _mm_shuffle_epi8(v, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    const __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    const __m128i t1 = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t0, t1);
+}
+
+SSSE3 static inline __m128i
+_in_range_ssse3(__m128i c, char lo, char hi)
+{
+    const __m128i d = _mm_sub_epi8(c, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(hi - lo)), d);
+}
+
+// maps base64 chars to 6 bit values, and fills *valid with a mask of the valid chars
+SSSE3 static inline __m128i
+_b64_values_ssse3(__m128i c, __m128i* valid)
+{
+    const __m128i upper = _in_range_ssse3(c, 'A', 'Z');
+    const __m128i lower = _in_range_ssse3(c, 'a', 'z');
+    const __m128i digit = _in_range_ssse3(c, '0', '9');
+    const __m128i plus = _mm_cmpeq_epi8(c, _mm_set1_epi8('+'));
+    const __m128i slash = _mm_cmpeq_epi8(c, _mm_set1_epi8('/'));
+    *valid = _mm_or_si128(_mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, plus)), slash);
+    __m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+    shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+    shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+    shift = _mm_or_si128(shift, _mm_and_si128(plus, _mm_set1_epi8(62 - '+')));
+    shift = _mm_or_si128(shift, _mm_and_si128(slash, _mm_set1_epi8(63 - '/')));
+    return _mm_add_epi8(c, shift);
+}
+
+// packs every 4 values of 6 bits to 3 bytes in each 4 bytes
+SSSE3 static inline __m128i
+_b64_pack_ssse3(__m128i v)
+{
+    v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+    v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+// maps hex chars to nibbles, and fills *valid with a mask of the valid chars
+SSSE3 static inline __m128i
+_hex_values_ssse3(__m128i c, __m128i* valid)
+{
+    const __m128i digit = _in_range_ssse3(c, '0', '9');
+    const __m128i lc = _mm_or_si128(c, _mm_set1_epi8(0x20));
+    const __m128i alpha = _in_range_ssse3(lc, 'a', 'f');
+    *valid = _mm_or_si128(digit, alpha);
+    return _mm_or_si128(
+        _mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+        _mm_and_si128(alpha, _mm_sub_epi8(lc, _mm_set1_epi8('a' - 10))));
+}
+
+SSSE3 static int
+_b64_encode_ssse3(const uint8_t* in, int len, uint8_t* out, int* out_len)
+{
+    int i = 0, o = 0;
+    // loads 16 bytes to encode 12
+    for (; i + 16 <= len; i += 12, o += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+        _mm_storeu_si128((__m128i*)(out + o), _b64_lookup_ssse3(_b64_unpack_ssse3(v)));
+    }
+    *out_len = o;
+    return i;
+}
+
+SSSE3 static int
+_b64_decode_ssse3(const uint8_t* in, int len, uint8_t* out, int* out_len)
+{
+    int i = 0, o = 0;
+    // stores 16 bytes of which 12 are decoded, so keep 8 chars (6 bytes) after the block
+    for (; i + 16 + 8 <= len; i += 16, o += 12) {
+        __m128i valid;
+        const __m128i v = _b64_values_ssse3(_mm_loadu_si128((const __m128i*)(in + i)), &valid);
+        if (_mm_movemask_epi8(valid) != 0xffff) break;
+        _mm_storeu_si128((__m128i*)(out + o), _b64_pack_ssse3(v));
+    }
+    *out_len = o;
+    return i;
+}
+
+SSSE3 static int
+_hex_encode_ssse3(const uint8_t* in, int len, uint8_t* out, int* out_len)
+{
+    const __m128i lut = _mm_loadu_si128((const __m128i*)HEX_ENCODE);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+        const __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        const __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, mask));
+        _mm_storeu_si128((__m128i*)(out + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i*)(out + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    *out_len = 2 * i;
+    return i;
+}
+
+SSSE3 static int
+_hex_decode_ssse3(const uint8_t* in, int len, uint8_t* out, int* out_len)
+{
+    int i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m128i valid0, valid1;
+        const __m128i v0 = _hex_values_ssse3(_mm_loadu_si128((const __m128i*)(in + i)), &valid0);
+        const __m128i v1 = _hex_values_ssse3(_mm_loadu_si128((const __m128i*)(in + i + 16)), &valid1);
+        if (_mm_movemask_epi8(_mm_and_si128(valid0, valid1)) != 0xffff) break;
+        // high nibble * 16 + low nibble for every pair of chars
+        const __m128i p0 = _mm_maddubs_epi16(v0, _mm_set1_epi16(0x0110));
+        const __m128i p1 = _mm_maddubs_epi16(v1, _mm_set1_epi16(0x0110));
+        _mm_storeu_si128((__m128i*)(out + i / 2), _mm_packus_epi16(p0, p1));
+    }
+    *out_len = i / 2;
+    return i;
+}
+
+// the avx2 kernels are the ssse3 kernels on both 128 bit lanes
+
+AVX2 static inline __m256i
+_b64_lookup_avx2(__m256i v)
+{
+    __m256i r = _mm256_subs_epu8(v, _mm256_set1_epi8(51));
+    const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), v);
+    r = _mm256_or_si256(r, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+    const __m256i offsets = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    return _mm256_add_epi8(v, _mm256_shuffle_epi8(offsets, r));
+}
+
+AVX2 static inline __m256i
+_b64_unpack_avx2(__m256i v)
+{
+    v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    const __m256i t0 = _mm256_mulhi_epu16(
+        _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+    const __m256i t1 = _mm256_mullo_epi16(
+        _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+    return _mm256_or_si256(t0, t1);
+}
+
+AVX2 static inline __m256i
+_in_range_avx2(__m256i c, char lo, char hi)
+{
+    const __m256i d = _mm256_sub_epi8(c, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(hi - lo)), d);
+}
+
+AVX2 static inline __m256i
+_b64_values_avx2(__m256i c, __m256i* valid)
+{
+    const __m256i upper = _in_range_avx2(c, 'A', 'Z');
+    const __m256i lower = _in_range_avx2(c, 'a', 'z');
+    const __m256i digit = _in_range_avx2(c, '0', '9');
+    const __m256i plus = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('+'));
+    const __m256i slash = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('/'));
+    *valid = _mm256_or_si256(
+        _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, plus)), slash);
+    __m256i shift = _mm256_and_si256(upper, _mm256_set1_epi8(-'A'));
+    shift = _mm256_or_si256(shift, _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a')));
+    shift = _mm256_or_si256(shift, _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')));
+    shift = _mm256_or_si256(shift, _mm256_and_si256(plus, _mm256_set1_epi8(62 - '+')));
+    shift = _mm256_or_si256(shift, _mm256_and_si256(slash, _mm256_set1_epi8(63 - '/')));
+    return _mm256_add_epi8(c, shift);
+}
+
+AVX2 static inline __m256i
+_b64_pack_avx2(__m256i v)
+{
+    v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+    v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+    v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    // join the 12 bytes of each lane
+    return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+}
+
+AVX2 static inline __m256i
+_hex_values_avx2(__m256i c, __m256i* valid)
+{
+    const __m256i digit = _in_range_avx2(c, '0', '9');
+    const __m256i lc = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+    const __m256i alpha = _in_range_avx2(lc, 'a', 'f');
+    *valid = _mm256_or_si256(digit, alpha);
+    return _mm256_or_si256(
+        _mm256_and_si256(digit, _mm256_sub_epi8(c, _mm256_set1_epi8('0'))),
+        _mm256_and_si256(alpha, _mm256_sub_epi8(lc, _mm256_set1_epi8('a' - 10))));
+}
+
+AVX2 static int
+_b64_encode_avx2(const uint8_t* in, int len, uint8_t* out, int* out_len)
+{
+    int i = 0, o = 0;
+    // loads 12 bytes to each lane from 16 bytes loads, so reads 28 bytes to encode 24
+    for (; i + 28 <= len; i += 24, o += 32) {
+        const __m256i v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(in + i))),
+            _mm_loadu_si128((const __m128i*)(in + i + 12)),
+            1);
+        _mm256_storeu_si256((__m256i*)(out + o), _b64_lookup_avx2(_b64_unpack_avx2(v)));
+    }
+    int n = 0;
+    i += _b64_encode_ssse3(in + i, len - i, out + o, &n);
+    *out_len = o + n;
+    return i;
+}
+
+AVX2 static int
+_b64_decode_avx2(const uint8_t* in, int len, uint8_t* out, int* out_len)
+{
+    int i = 0, o = 0;
+    // stores 32 bytes of which 24 are decoded, so keep 16 chars (12 bytes) after the block
+    for (; i + 32 + 16 <= len; i += 32, o += 24) {
+        __m256i valid;
+        const __m256i v = _b64_values_avx2(_mm256_loadu_si256((const __m256i*)(in + i)), &valid);
+        if (_mm256_movemask_epi8(valid) != -1) {
+            *out_len = o;
+            return i;
+        }
+        _mm256_storeu_si256((__m256i*)(out + o), _b64_pack_avx2(v));
+    }
+    int n = 0;
+    i += _b64_decode_ssse3(in + i, len - i, out + o, &n);
+    *out_len = o + n;
+    return i;
+}
+
+AVX2 static int
+_hex_encode_avx2(const uint8_t* in, int len, uint8_t* out, int* out_len)
+{
+    const __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)HEX_ENCODE));
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    int i = 0;
+    for (; i + 32 <= len; i += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i*)(in + i));
+        const __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+        const __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask));
+        // unpack interleaves within lanes, so put the lanes back in order
+        const __m256i a = _mm256_unpacklo_epi8(hi, lo);
+        const __m256i b = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i*)(out + 2 * i), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i*)(out + 2 * i + 32), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+    int n = 0;
+    i += _hex_encode_ssse3(in + i, len - i, out + 2 * i, &n);
+    *out_len = 2 * i;
+    return i;
+}
+
+AVX2 static int
+_hex_decode_avx2(const uint8_t* in, int len, uint8_t* out, int* out_len)
+{
+    int i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m256i valid0, valid1;
+        const __m256i v0 = _hex_values_avx2(_mm256_loadu_si256((const __m256i*)(in + i)), &valid0);
+        const __m256i v1 = _hex_values_avx2(_mm256_loadu_si256((const __m256i*)(in + i + 32)), &valid1);
+        if (_mm256_movemask_epi8(_mm256_and_si256(valid0, valid1)) != -1) {
+            *out_len = i / 2;
+            return i;
+        }
+        const __m256i p0 = _mm256_maddubs_epi16(v0, _mm256_set1_epi16(0x0110));
+        const __m256i p1 = _mm256_maddubs_epi16(v1, _mm256_set1_epi16(0x0110));
+        // pack works within lanes, so put the 64 bit quarters back in order
+        const __m256i p = _mm256_permute4x64_epi64(_mm256_packus_epi16(p0, p1), 0xd8);
+        _mm256_storeu_si256((__m256i*)(out + i / 2), p);
+    }
+    int n = 0;
+    i += _hex_decode_ssse3(in + i, len - i, out + i / 2, &n);
+    *out_len = i / 2;
+    return i;
+}
+
+#endif // B64_X86
+
+#if B64_NEON
+
+static inline uint8x16_t
+_b64_values_neon(uint8x16_t c, uint8x16_t* valid)
+{
+    const uint8x16_t upper = vcleq_u8(vsubq_u8(c, vdupq_n_u8('A')), vdupq_n_u8(25));
+    const uint8x16_t lower = vcleq_u8(vsubq_u8(c, vdupq_n_u8('a')), vdupq_n_u8(25));
+    const uint8x16_t digit = vcleq_u8(vsubq_u8(c, vdupq_n_u8('0')), vdupq_n_u8(9));
+    const uint8x16_t plus = vceqq_u8(c, vdupq_n_u8('+'));
+    const uint8x16_t slash = vceqq_u8(c, vdupq_n_u8('/'));
+    *valid = vandq_u8(*valid, vorrq_u8(vorrq_u8(vorrq_u8(upper, lower), vorrq_u8(digit, plus)), slash));
+    uint8x16_t shift = vandq_u8(upper, vdupq_n_u8((uint8_t)-'A'));
+    shift = vorrq_u8(shift, vandq_u8(lower, vdupq_n_u8((uint8_t)(26 - 'a'))));
+    shift = vorrq_u8(shift, vandq_u8(digit, vdupq_n_u8((uint8_t)(52 - '0'))));
+    shift = vorrq_u8(shift, vandq_u8(plus, vdupq_n_u8((uint8_t)(62 - '+'))));
+    shift = vorrq_u8(shift, vandq_u8(slash, vdupq_n_u8((uint8_t)(63 - '/'))));
+    return vaddq_u8(c, shift);
+}
+
+static inline uint8x16_t
+_hex_values_neon(uint8x16_t c, uint8x16_t* valid)
+{
+    const uint8x16_t digit = vcleq_u8(vsubq_u8(c, vdupq_n_u8('0')), vdupq_n_u8(9));
+    const uint8x16_t lc = vorrq_u8(c, vdupq_n_u8(0x20));
+    const uint8x16_t alpha = vcleq_u8(vsubq_u8(lc, vdupq_n_u8('a')), vdupq_n_u8(5));
+    *valid = vandq_u8(*valid, vorrq_u8(digit, alpha));
+    return vorrq_u8(
+        vandq_u8(digit, vsubq_u8(c, vdupq_n_u8('0'))),
+        vandq_u8(alpha, vsubq_u8(lc, vdupq_n_u8('a' - 10))));
+}
+
+static int
+_b64_encode_neon(const uint8_t* in, int len, uint8_t* out, int* out_len)
+{
+    const uint8_t* enc = (const uint8_t*)B64_ENCODE;
+    uint8x16x4_t lut;
+    lut.val[0] = vld1q_u8(enc);
+    lut.val[1] = vld1q_u8(enc + 16);
+    lut.val[2] = vld1q_u8(enc + 32);
+    lut.val[3] = vld1q_u8(enc + 48);
+    int i = 0, o = 0;
+    for (; i + 48 <= len; i += 48, o += 64) {
+        const uint8x16x3_t v = vld3q_u8(in + i);
+        uint8x16x4_t r;
+        r.val[0] = vshrq_n_u8(v.val[0], 2);
+        r.val[1] = vorrq_u8(vshlq_n_u8(vandq_u8(v.val[0], vdupq_n_u8(3)), 4), vshrq_n_u8(v.val[1], 4));
+        r.val[2] = vorrq_u8(vshlq_n_u8(vandq_u8(v.val[1], vdupq_n_u8(15)), 2), vshrq_n_u8(v.val[2], 6));
+        r.val[3] = vandq_u8(v.val[2], vdupq_n_u8(63));
+        r.val[0] = vqtbl4q_u8(lut, r.val[0]);
+        r.val[1] = vqtbl4q_u8(lut, r.val[1]);
+        r.val[2] = vqtbl4q_u8(lut, r.val[2]);
+        r.val[3] = vqtbl4q_u8(lut, r.val[3]);
+        vst4q_u8(out + o, r);
+    }
+    *out_len = o;
+    return i;
+}
+
+static int
+_b64_decode_neon(const uint8_t* in, int len, uint8_t* out, int* out_len)
+{
+    int i = 0, o = 0;
+    // keep the last chars with the padding to the scalar code
+    for (; i + 64 + 4 <= len; i += 64, o += 48) {
+        const uint8x16x4_t c = vld4q_u8(in + i);
+        uint8x16_t valid = vdupq_n_u8(0xff);
+        const uint8x16_t a = _b64_values_neon(c.val[0], &valid);
+        const uint8x16_t b = _b64_values_neon(c.val[1], &valid);
+        const uint8x16_t d = _b64_values_neon(c.val[2], &valid);
+        const uint8x16_t e = _b64_values_neon(c.val[3], &valid);
+        if (vminvq_u8(valid) != 0xff) break;
+        uint8x16x3_t r;
+        r.val[0] = vorrq_u8(vshlq_n_u8(a, 2), vshrq_n_u8(b, 4));
+        r.val[1] = vorrq_u8(vshlq_n_u8(b, 4), vshrq_n_u8(d, 2));
+        r.val[2] = vorrq_u8(vshlq_n_u8(d, 6), e);
+        vst3q_u8(out + o, r);
+    }
+    *out_len = o;
+    return i;
+}
+
+static int
+_hex_encode_neon(const uint8_t* in, int len, uint8_t* out, int* out_len)
+{
+    const uint8x16_t lut = vld1q_u8((const uint8_t*)HEX_ENCODE);
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        const uint8x16_t v = vld1q_u8(in + i);
+        uint8x16x2_t r;
+        r.val[0] = vqtbl1q_u8(lut, vshrq_n_u8(v, 4));
+        r.val[1] = vqtbl1q_u8(lut, vandq_u8(v, vdupq_n_u8(0x0f)));
+        vst2q_u8(out + 2 * i, r);
+    }
+    *out_len = 2 * i;
+    return i;
+}
+
+static int
+_hex_decode_neon(const uint8_t* in, int len, uint8_t* out, int* out_len)
+{
+    int i = 0;
+    for (; i + 32 <= len; i += 32) {
+        const uint8x16x2_t c = vld2q_u8(in + i);
+        uint8x16_t valid = vdupq_n_u8(0xff);
+        const uint8x16_t hi = _hex_values_neon(c.val[0], &valid);
+        const uint8x16_t lo = _hex_values_neon(c.val[1], &valid);
+        if (vminvq_u8(valid) != 0xff) break;
+        vst1q_u8(out + i / 2, vorrq_u8(vshlq_n_u8(hi, 4), lo));
+    }
+    *out_len = i / 2;
+    return i;
+}
+
+#endif // B64_NEON
+
+static Kernels
+_select_kernels()
+{
+#if B64_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return Kernels{ "avx2", _b64_encode_avx2, _b64_decode_avx2, _hex_encode_avx2, _hex_decode_avx2 };
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return Kernels{ "ssse3", _b64_encode_ssse3, _b64_decode_ssse3, _hex_encode_ssse3, _hex_decode_ssse3 };
+    }
+#elif B64_NEON
+    return Kernels{ "neon", _b64_encode_neon, _b64_decode_neon, _hex_encode_neon, _hex_decode_neon };
+#endif
+    return Kernels{ "none", 0, 0, 0, 0 };
+}
+
+static const Kernels&
+_kernels()
+{
+    static const Kernels kernels = _select_kernels();
+    return kernels;
+}
+
+const char*
+b64_simd_name()
+{
+    return _kernels().name;
+}
+
+int
+b64_encode(const uint8_t* in, int len, uint8_t* out)
+{
+    int n = 0;
+    int w = 0;
+    Kernel k = _kernels().b64_encode;
+    if (k && len > 0) n = k(in, len, out, &w);
+    const int r = b64_encode_scalar(in + n, len - n, out + w);
+    return r < 0 ? r : w + r;
+}
+
+int
+b64_decode(const uint8_t* in, int len, uint8_t* out)
+{
+    int n = 0;
+    int w = 0;
+    Kernel k = _kernels().b64_decode;
+    if (k && len > 0) n = k(in, len, out, &w);
+    const int r = b64_decode_scalar(in + n, len - n, out + w);
+    // keep the scalar error values which count the bytes decoded before the error
+    return r < 0 ? r - w : w + r;
+}
+
+int
+hex_encode(const uint8_t* in, int len, uint8_t* out)
+{
+    int n = 0;
+    int w = 0;
+    Kernel k = _kernels().hex_encode;
+    if (k && len > 0) n = k(in, len, out, &w);
+    for (int i = n; i < len; ++i) {
+        out[2 * i] = HEX_ENCODE[in[i] >> 4];
+        out[2 * i + 1] = HEX_ENCODE[in[i] & 0xf];
+    }
+    return 2 * len;
+}
+
+int
+hex_decode(const uint8_t* in, int len, uint8_t* out)
+{
+    if (len < 0 || len % 2) return -1;
+    int n = 0;
+    int w = 0;
+    Kernel k = _kernels().hex_decode;
+    if (k && len > 0) n = k(in, len, out, &w);
+    for (int i = n; i < len; i += 2) {
+        const int hi = _hex_value(in[i]);
+        const int lo = _hex_value(in[i + 1]);
+        if (hi < 0 || lo < 0) return -1;
+        out[i / 2] = (hi << 4) | lo;
+    }
+    return len / 2;
+}
+
 int
 b64_main(int ac, char** av)
 {
@@ -95,7 +95,7 @@ _b64_decode_tail(const uint8_t* in, uint8_t* out)
 }
 
 static inline int
-b64_encode(const uint8_t* in, int len, uint8_t* out)
+b64_encode_scalar(const uint8_t* in, int len, uint8_t* out)
 {
     const int align = len % 3;
     const uint8_t* base = out;
@@ -119,7 +119,7 @@ b64_encode(const uint8_t* in, int len, uint8_t* out)
 }
 
 static inline int
-b64_decode(const uint8_t* in, int len, uint8_t* out)
+b64_decode_scalar(const uint8_t* in, int len, uint8_t* out)
 {
     int r;
     const uint8_t* base = out;
@@ -141,4 +141,34 @@ b64_decode(const uint8_t* in, int len, uint8_t* out)
     if (r < 0) return -total + r; // negative
     return total + r;
 }
+
+/**
+ * b64_encode() and b64_decode() run the widest SIMD kernel the cpu supports
+ * (avx2 or ssse3 on x86, neon on aarch64) over the bulk of the input,
+ * and the scalar code above over the rest. Results are identical to the scalar code,
+ * including the negative error values of b64_decode() for invalid input.
+ */
+int b64_encode(const uint8_t* in, int len, uint8_t* out);
+int b64_decode(const uint8_t* in, int len, uint8_t* out);
+
+static inline int
+hex_encode_len(int len)
+{
+    return len * 2;
+}
+
+static inline int
+hex_decode_len(int len)
+{
+    return len / 2;
+}
+
+// hex_encode writes lowercase hex and returns the output length
+int hex_encode(const uint8_t* in, int len, uint8_t* out);
+
+// hex_decode accepts upper and lower case and returns -1 for odd length or invalid chars
+int hex_decode(const uint8_t* in, int len, uint8_t* out);
+
+// the simd kernel selected for this cpu - "avx2", "ssse3", "neon" or "none"
+const char* b64_simd_name();
 }
@@ -0,0 +1,298 @@
+/* Copyright (C) 2016 NooBaa */
+#include "buf_pool.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <mutex>
+#include <stdlib.h>
+
+namespace noobaa
+{
+
+// the cached bytes per size class are bounded both per thread and in the depot,
+// with a minimum number of blocks so that large classes still get reused.
+#define POOL_THREAD_CACHE_BYTES (4 * 1024 * 1024)
+#define POOL_THREAD_CACHE_MIN_BLOCKS 2
+#define POOL_THREAD_CACHE_MAX_BLOCKS 256
+#define POOL_DEPOT_FACTOR 4
+// the bytes of all the cached blocks (thread caches and depot) are also capped globally,
+// since the per class limits add up over the classes and the threads.
+// frees beyond the cap release the block to the system allocator.
+#define POOL_MAX_CACHED_BYTES (128LL * 1024 * 1024)
+
+// address sanitizer cannot detect use after free of cached blocks
+#if defined(__SANITIZE_ADDRESS__)
+#define POOL_CACHE_ENABLED 0
+#else
+#define POOL_CACHE_ENABLED 1
+#endif
+
+static const uint32_t POOL_MAGIC_LEASED = 0x6e62706c;
+static const uint32_t POOL_MAGIC_FREE = 0x6e627066;
+
+struct Pool_Block {
+    uint32_t magic;
+    int32_t cls; // -1 for sizes outside the size classes
+    int64_t size; // usable size after the header
+    Pool_Block* next;
+};
+
+static_assert(sizeof(Pool_Block) <= NB_POOL_ALIGN, "Pool_Block must fit in the alignment padding");
+
+struct Pool_List {
+    Pool_Block* head = nullptr;
+    int count = 0;
+};
+
+struct Pool_Counters {
+    std::atomic<uint64_t> allocs{ 0 };
+    std::atomic<uint64_t> frees{ 0 };
+    std::atomic<uint64_t> thread_hits{ 0 };
+    std::atomic<uint64_t> depot_hits{ 0 };
+    std::atomic<uint64_t> sys_allocs{ 0 };
+    std::atomic<uint64_t> sys_frees{ 0 };
+    std::atomic<uint64_t> cap_frees{ 0 };
+    std::atomic<int64_t> bytes_in_use{ 0 };
+    std::atomic<int64_t> bytes_cached{ 0 };
+};
+
+struct Pool_Depot {
+    std::mutex mutex;
+    Pool_List lists[NB_POOL_NUM_CLASSES];
+};
+
+struct Pool_Thread_Cache {
+    Pool_List lists[NB_POOL_NUM_CLASSES];
+    ~Pool_Thread_Cache();
+};
+
+static Pool_Counters g_pool_counters;
+
+// never destructed so that threads exiting after the static destructors can still return blocks
+static Pool_Depot&
+_depot()
+{
+    static Pool_Depot* depot = new Pool_Depot;
+    return *depot;
+}
+
+// trivially destructible flag, so it can be checked during the thread exit destructors
+static thread_local bool _thread_cache_dead = false;
+static thread_local Pool_Thread_Cache _thread_cache_instance;
+
+static Pool_Thread_Cache*
+_thread_cache()
+{
+    return _thread_cache_dead ? nullptr : &_thread_cache_instance;
+}
+
+static inline int
+_class_of(int len)
+{
+    if (len <= (1 << NB_POOL_MIN_CLASS_SHIFT)) return 0;
+    const int shift = 64 - __builtin_clzll((uint64_t)len - 1);
+    return shift > NB_POOL_MAX_CLASS_SHIFT ? -1 : shift - NB_POOL_MIN_CLASS_SHIFT;
+}
+
+static inline int64_t
+_class_size(int cls)
+{
+    return int64_t(1) << (cls + NB_POOL_MIN_CLASS_SHIFT);
+}
+
+static inline int
+_thread_limit(int cls)
+{
+    const int64_t n = POOL_THREAD_CACHE_BYTES / _class_size(cls);
+    if (n < POOL_THREAD_CACHE_MIN_BLOCKS) return POOL_THREAD_CACHE_MIN_BLOCKS;
+    if (n > POOL_THREAD_CACHE_MAX_BLOCKS) return POOL_THREAD_CACHE_MAX_BLOCKS;
+    return (int)n;
+}
+
+static inline void
+_list_push(Pool_List& list, Pool_Block* b)
+{
+    b->next = list.head;
+    list.head = b;
+    list.count++;
+}
+
+static inline Pool_Block*
+_list_pop(Pool_List& list)
+{
+    Pool_Block* b = list.head;
+    list.head = b->next;
+    list.count--;
+    return b;
+}
+
+// moves up to n blocks from the head of one list to another
+static void
+_list_move(Pool_List& from, Pool_List& to, int n)
+{
+    while (n-- > 0 && from.head) {
+        _list_push(to, _list_pop(from));
+    }
+}
+
+static Pool_Block*
+_sys_alloc(int cls, int len)
+{
+    const int64_t size = cls >= 0
+        ? _class_size(cls)
+        : (int64_t(len) + NB_POOL_ALIGN - 1) & ~int64_t(NB_POOL_ALIGN - 1);
+    Pool_Block* b = (Pool_Block*)aligned_alloc(NB_POOL_ALIGN, NB_POOL_ALIGN + size);
+    if (!b) return nullptr;
+    b->cls = cls;
+    b->size = size;
+    b->next = nullptr;
+    g_pool_counters.sys_allocs++;
+    return b;
+}
+
+static void
+_sys_free(Pool_Block* b)
+{
+    b->magic = 0;
+    free(b);
+    g_pool_counters.sys_frees++;
+}
+
+static void
+_sys_free_list(Pool_List& list)
+{
+    while (list.head) {
+        Pool_Block* b = _list_pop(list);
+        g_pool_counters.bytes_cached -= b->size;
+        _sys_free(b);
+    }
+}
+
+// spills a batch of free blocks to the depot, and releases what the depot cannot hold
+static void
+_depot_put(int cls, Pool_List& list, int n)
+{
+    Pool_List overflow;
+    {
+        Pool_Depot& depot = _depot();
+        std::lock_guard<std::mutex> lock(depot.mutex);
+        Pool_List& dl = depot.lists[cls];
+        const int room = std::max(0, (_thread_limit(cls) * POOL_DEPOT_FACTOR) - dl.count);
+        _list_move(list, dl, std::min(n, room));
+        if (room < n) _list_move(list, overflow, n - room);
+    }
+    _sys_free_list(overflow);
+}
+
+static bool
+_depot_take(int cls, Pool_List& list, int n)
+{
+    Pool_Depot& depot = _depot();
+    std::lock_guard<std::mutex> lock(depot.mutex);
+    Pool_List& dl = depot.lists[cls];
+    if (!dl.head) return false;
+    _list_move(dl, list, n);
+    return true;
+}
+
+Pool_Thread_Cache::~Pool_Thread_Cache()
+{
+    _thread_cache_dead = true;
+    for (int cls = 0; cls < NB_POOL_NUM_CLASSES; ++cls) {
+        _depot_put(cls, lists[cls], lists[cls].count);
+    }
+}
+
+uint8_t*
+nb_pool_alloc(int len)
+{
+    const int cls = _class_of(len);
+    Pool_Block* b = nullptr;
+    g_pool_counters.allocs++;
+
+    if (POOL_CACHE_ENABLED && cls >= 0) {
+        Pool_Thread_Cache* tc = _thread_cache();
+        Pool_List local;
+        Pool_List& list = tc ? tc->lists[cls] : local;
+        if (list.head) {
+            g_pool_counters.thread_hits++;
+        } else if (_depot_take(cls, list, tc ? _thread_limit(cls) / 2 : 1)) {
+            g_pool_counters.depot_hits++;
+        }
+        if (list.head) {
+            b = _list_pop(list);
+            g_pool_counters.bytes_cached -= b->size;
+        }
+    }
+
+    if (!b) {
+        b = _sys_alloc(cls, len);
+        if (!b) return nullptr;
+    }
+
+    assert(b->size >= len);
+    b->magic = POOL_MAGIC_LEASED;
+    g_pool_counters.bytes_in_use += b->size;
+    return (uint8_t*)b + NB_POOL_ALIGN;
+}
+
+void
+nb_pool_free(void* data)
+{
+    if (!data) return;
+    Pool_Block* b = (Pool_Block*)((uint8_t*)data - NB_POOL_ALIGN);
+    assert(b->magic == POOL_MAGIC_LEASED);
+    g_pool_counters.frees++;
+    g_pool_counters.bytes_in_use -= b->size;
+
+    const int cls = b->cls;
+    if (!POOL_CACHE_ENABLED || cls < 0) {
+        _sys_free(b);
+        return;
+    }
+
+    if (g_pool_counters.bytes_cached.fetch_add(b->size) + b->size > POOL_MAX_CACHED_BYTES) {
+        g_pool_counters.bytes_cached -= b->size;
+        g_pool_counters.cap_frees++;
+        _sys_free(b);
+        return;
+    }
+    b->magic = POOL_MAGIC_FREE;
+    Pool_Thread_Cache* tc = _thread_cache();
+    if (!tc) {
+        Pool_List local;
+        _list_push(local, b);
+        _depot_put(cls, local, 1);
+        return;
+    }
+    Pool_List& list = tc->lists[cls];
+    _list_push(list, b);
+    const int limit = _thread_limit(cls);
+    if (list.count > limit) {
+        _depot_put(cls, list, list.count - (limit / 2));
+    }
+}
+
+void
+nb_pool_stats(struct NB_Pool_Stats* stats)
+{
+    stats->allocs = g_pool_counters.allocs;
+    stats->frees = g_pool_counters.frees;
+    stats->thread_hits = g_pool_counters.thread_hits;
+    stats->depot_hits = g_pool_counters.depot_hits;
+    stats->sys_allocs = g_pool_counters.sys_allocs;
+    stats->sys_frees = g_pool_counters.sys_frees;
+    stats->cap_frees = g_pool_counters.cap_frees;
+    stats->bytes_in_use = g_pool_counters.bytes_in_use;
+    stats->bytes_cached = g_pool_counters.bytes_cached;
+    stats->max_cached_bytes = POOL_MAX_CACHED_BYTES;
+}
+
+void
+nb_buf_pool_deleter(void* arg, const char* data, size_t len)
+{
+    nb_pool_free((void*)data);
+}
+
+} // namespace noobaa
@@ -0,0 +1,48 @@
+/* Copyright (C) 2016 NooBaa */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace noobaa
+{
+
+/**
+ * Buffer pool for the NB_Bufs memory of the chunk coder (frags, parity, compression output).
+ *
+ * Allocations are 64 bytes aligned and rounded up to power of 2 size classes.
+ * Every thread keeps a small cache of free blocks per size class, and spills to
+ * (or refills from) a shared depot in batches, so the common case takes no lock.
+ * The cached bytes are capped in total, beyond that freed blocks go back to the system.
+ * This matters because the blocks are allocated on the worker threads but mostly
+ * released on the event loop thread, when the js buffers that wrap them are collected.
+ *
+ * A block is a lease that must be returned with nb_pool_free() (or nb_buf_pool_deleter)
+ * and never with free(). Sizes outside the size classes bypass the caches.
+ */
+
+#define NB_POOL_ALIGN 64
+#define NB_POOL_MIN_CLASS_SHIFT 8 // 256 bytes
+#define NB_POOL_MAX_CLASS_SHIFT 22 // 4 MB
+#define NB_POOL_NUM_CLASSES (NB_POOL_MAX_CLASS_SHIFT - NB_POOL_MIN_CLASS_SHIFT + 1)
+
+struct NB_Pool_Stats {
+    uint64_t allocs; // total nb_pool_alloc calls
+    uint64_t frees; // total nb_pool_free calls
+    uint64_t thread_hits; // allocs served from the thread cache
+    uint64_t depot_hits; // allocs served from the shared depot
+    uint64_t sys_allocs; // allocs that went to the system allocator
+    uint64_t sys_frees; // blocks released to the system allocator
+    uint64_t cap_frees; // of sys_frees, blocks released because the caches were full
+    int64_t bytes_in_use; // bytes of blocks leased and not yet returned
+    int64_t bytes_cached; // bytes of free blocks held by the thread caches and the depot
+    int64_t max_cached_bytes; // cap of bytes_cached
+};
+
+uint8_t* nb_pool_alloc(int len);
+void nb_pool_free(void* data);
+void nb_pool_stats(struct NB_Pool_Stats* stats);
+
+// NB_Buf_Deleter for blocks from nb_pool_alloc (see nb_bufs_push_pooled)
+void nb_buf_pool_deleter(void* arg, const char* data, size_t len);
+} // namespace noobaa
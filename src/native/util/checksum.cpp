@@ -0,0 +1,280 @@
+/* Copyright (C) 2016 NooBaa */
+#include "checksum.h"
+
+#include "../third_party/isa-l/include/crc.h"
+#include "endian.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include <string.h>
+#include <strings.h>
+
+namespace noobaa
+{
+
+// reflected polynomials
+static const uint32_t CRC32_POLY = 0xedb88320;
+static const uint32_t CRC32C_POLY = 0x82f63b78;
+static const uint64_t CRC64NVME_POLY = 0x9a6c9329ac4bc9b5ULL;
+
+// crc32_iscsi and the multi-buffer managers take 32 bit lengths
+static const size_t MAX_SUBMIT_LEN = 1 << 30;
+
+static const char* CHECKSUM_NAMES[CHECKSUM_ALGOS] = { "CRC32", "CRC32C", "CRC64NVME", "SHA1", "SHA256" };
+static const int CHECKSUM_LENS[CHECKSUM_ALGOS] = { 4, 4, 8, 20, 32 };
+
+const char*
+checksum_algo_name(int algo)
+{
+    return algo >= 0 && algo < CHECKSUM_ALGOS ? CHECKSUM_NAMES[algo] : "UNKNOWN";
+}
+
+int
+checksum_algo_parse(const std::string& name)
+{
+    for (int algo = 0; algo < CHECKSUM_ALGOS; ++algo) {
+        if (strcasecmp(name.c_str(), CHECKSUM_NAMES[algo]) == 0) return algo;
+    }
+    return -1;
+}
+
+int
+checksum_len(int algo)
+{
+    return algo >= 0 && algo < CHECKSUM_ALGOS ? CHECKSUM_LENS[algo] : 0;
+}
+
+uint32_t
+crc32_update(uint32_t crc, const uint8_t* data, size_t len)
+{
+    return crc32_gzip_refl(crc, (uint8_t*)data, len);
+}
+
+uint32_t
+crc32c_update(uint32_t crc, const uint8_t* data, size_t len)
+{
+    // crc32_iscsi does not invert the crc before and after like zlib
+    crc = ~crc;
+    while (len > 0) {
+        const int n = len > MAX_SUBMIT_LEN ? int(MAX_SUBMIT_LEN) : int(len);
+        crc = crc32_iscsi((uint8_t*)data, n, crc);
+        data += n;
+        len -= n;
+    }
+    return ~crc;
+}
+
+// slice by 8 tables for crc64nvme
+static uint64_t CRC64NVME_TABLE[8][256];
+static std::once_flag CRC64NVME_TABLE_ONCE;
+
+static void
+crc64nvme_init_table()
+{
+    for (int i = 0; i < 256; ++i) {
+        uint64_t crc = i;
+        for (int k = 0; k < 8; ++k) {
+            crc = crc & 1 ? (crc >> 1) ^ CRC64NVME_POLY : crc >> 1;
+        }
+        CRC64NVME_TABLE[0][i] = crc;
+    }
+    for (int i = 0; i < 256; ++i) {
+        uint64_t crc = CRC64NVME_TABLE[0][i];
+        for (int t = 1; t < 8; ++t) {
+            crc = CRC64NVME_TABLE[0][crc & 0xff] ^ (crc >> 8);
+            CRC64NVME_TABLE[t][i] = crc;
+        }
+    }
+}
+
+uint64_t
+crc64nvme_update(uint64_t crc, const uint8_t* data, size_t len)
+{
+    std::call_once(CRC64NVME_TABLE_ONCE, crc64nvme_init_table);
+    const uint64_t(*T)[256] = CRC64NVME_TABLE;
+    crc = ~crc;
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        crc ^= le64toh(word);
+        crc = T[7][crc & 0xff] ^
+            T[6][(crc >> 8) & 0xff] ^
+            T[5][(crc >> 16) & 0xff] ^
+            T[4][(crc >> 24) & 0xff] ^
+            T[3][(crc >> 32) & 0xff] ^
+            T[2][(crc >> 40) & 0xff] ^
+            T[1][(crc >> 48) & 0xff] ^
+            T[0][crc >> 56];
+        data += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = T[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/**
+ * GF(2) polynomial math for combining reflected crcs, generalized from zlib crc32_combine.
+ * Values are reflected - the top bit (1 << (BITS - 1)) is x^0.
+ */
+template <typename T>
+static T
+crc_multmodp(T a, T b, T poly)
+{
+    const int BITS = sizeof(T) * 8;
+    T m = T(1) << (BITS - 1);
+    T p = 0;
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) break;
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ poly : b >> 1;
+    }
+    return p;
+}
+
+// x^(n * 2^k) mod p(x)
+template <typename T>
+static T
+crc_x2nmodp(uint64_t n, int k, T poly)
+{
+    const int BITS = sizeof(T) * 8;
+    T p = T(1) << (BITS - 1); // x^0
+    T x2k = T(1) << (BITS - 2); // x^1
+    for (int i = 0; i < k; ++i) {
+        x2k = crc_multmodp<T>(x2k, x2k, poly);
+    }
+    while (n) {
+        if (n & 1) p = crc_multmodp<T>(x2k, p, poly);
+        n >>= 1;
+        x2k = crc_multmodp<T>(x2k, x2k, poly);
+    }
+    return p;
+}
+
+template <typename T>
+static T
+crc_combine_poly(T crc1, T crc2, uint64_t len2, T poly)
+{
+    // shift crc1 by len2 bytes (x^(8*len2)) and add crc2
+    return crc_multmodp<T>(crc_x2nmodp<T>(len2, 3, poly), crc1, poly) ^ crc2;
+}
+
+uint64_t
+crc_combine(int algo, uint64_t crc1, uint64_t crc2, uint64_t len2)
+{
+    switch (algo) {
+    case CHECKSUM_CRC32:
+        return crc_combine_poly<uint32_t>(uint32_t(crc1), uint32_t(crc2), len2, CRC32_POLY);
+    case CHECKSUM_CRC32C:
+        return crc_combine_poly<uint32_t>(uint32_t(crc1), uint32_t(crc2), len2, CRC32C_POLY);
+    case CHECKSUM_CRC64NVME:
+        return crc_combine_poly<uint64_t>(crc1, crc2, len2, CRC64NVME_POLY);
+    }
+    return 0;
+}
+
+void
+checksum_crc_to_bytes(int algo, uint64_t crc, uint8_t* out)
+{
+    if (algo == CHECKSUM_CRC64NVME) {
+        const uint64_t be = htobe64(crc);
+        memcpy(out, &be, 8);
+    } else {
+        const uint32_t be = htobe32(uint32_t(crc));
+        memcpy(out, &be, 4);
+    }
+}
+
+uint64_t
+checksum_crc_from_bytes(int algo, const uint8_t* in)
+{
+    if (algo == CHECKSUM_CRC64NVME) {
+        uint64_t be;
+        memcpy(&be, in, 8);
+        return be64toh(be);
+    } else {
+        uint32_t be;
+        memcpy(&be, in, 4);
+        return be32toh(be);
+    }
+}
+
+MultiChecksum::MultiChecksum(uint32_t algos_mask)
+    : _algos(algos_mask & ((1u << CHECKSUM_ALGOS) - 1))
+    , _crc32(0)
+    , _crc32c(0)
+    , _crc64nvme(0)
+{
+    if (has(CHECKSUM_SHA1)) {
+        sha1_ctx_mgr_init(&_sha1_mgr);
+        hash_ctx_init(&_sha1_ctx);
+        sha1_ctx_mgr_submit(&_sha1_mgr, &_sha1_ctx, 0, 0, HASH_FIRST);
+        while (hash_ctx_processing(&_sha1_ctx)) sha1_ctx_mgr_flush(&_sha1_mgr);
+    }
+    if (has(CHECKSUM_SHA256)) {
+        sha256_ctx_mgr_init(&_sha256_mgr);
+        hash_ctx_init(&_sha256_ctx);
+        sha256_ctx_mgr_submit(&_sha256_mgr, &_sha256_ctx, 0, 0, HASH_FIRST);
+        while (hash_ctx_processing(&_sha256_ctx)) sha256_ctx_mgr_flush(&_sha256_mgr);
+    }
+}
+
+void
+MultiChecksum::update(const uint8_t* data, size_t len)
+{
+    if (has(CHECKSUM_CRC32)) _crc32 = crc32_update(_crc32, data, len);
+    if (has(CHECKSUM_CRC32C)) _crc32c = crc32c_update(_crc32c, data, len);
+    if (has(CHECKSUM_CRC64NVME)) _crc64nvme = crc64nvme_update(_crc64nvme, data, len);
+    for (size_t pos = 0; pos < len; pos += MAX_SUBMIT_LEN) {
+        const uint32_t n = uint32_t(std::min(len - pos, MAX_SUBMIT_LEN));
+        if (has(CHECKSUM_SHA1)) sha1_ctx_mgr_submit(&_sha1_mgr, &_sha1_ctx, data + pos, n, HASH_UPDATE);
+        if (has(CHECKSUM_SHA256)) sha256_ctx_mgr_submit(&_sha256_mgr, &_sha256_ctx, data + pos, n, HASH_UPDATE);
+        if (has(CHECKSUM_SHA1)) {
+            while (hash_ctx_processing(&_sha1_ctx)) sha1_ctx_mgr_flush(&_sha1_mgr);
+        }
+        if (has(CHECKSUM_SHA256)) {
+            while (hash_ctx_processing(&_sha256_ctx)) sha256_ctx_mgr_flush(&_sha256_mgr);
+        }
+    }
+}
+
+void
+MultiChecksum::digest(int algo, uint8_t* out)
+{
+    switch (algo) {
+    case CHECKSUM_CRC32:
+        checksum_crc_to_bytes(algo, _crc32, out);
+        break;
+    case CHECKSUM_CRC32C:
+        checksum_crc_to_bytes(algo, _crc32c, out);
+        break;
+    case CHECKSUM_CRC64NVME:
+        checksum_crc_to_bytes(algo, _crc64nvme, out);
+        break;
+    case CHECKSUM_SHA1: {
+        sha1_ctx_mgr_submit(&_sha1_mgr, &_sha1_ctx, 0, 0, HASH_LAST);
+        while (hash_ctx_processing(&_sha1_ctx)) sha1_ctx_mgr_flush(&_sha1_mgr);
+        for (int i = 0; i < SHA1_DIGEST_NWORDS; ++i) {
+            const uint32_t be = htobe32(hash_ctx_digest(&_sha1_ctx)[i]);
+            memcpy(out + i * 4, &be, 4);
+        }
+        break;
+    }
+    case CHECKSUM_SHA256: {
+        sha256_ctx_mgr_submit(&_sha256_mgr, &_sha256_ctx, 0, 0, HASH_LAST);
+        while (hash_ctx_processing(&_sha256_ctx)) sha256_ctx_mgr_flush(&_sha256_mgr);
+        for (int i = 0; i < SHA256_DIGEST_NWORDS; ++i) {
+            const uint32_t be = htobe32(hash_ctx_digest(&_sha256_ctx)[i]);
+            memcpy(out + i * 4, &be, 4);
+        }
+        break;
+    }
+    }
+}
+
+} // namespace noobaa
@@ -0,0 +1,82 @@
+/* Copyright (C) 2016 NooBaa */
+#pragma once
+
+#include <string>
+
+#include <stdint.h>
+
+#include "../third_party/isa-l_crypto/include/sha1_mb.h"
+#include "../third_party/isa-l_crypto/include/sha256_mb.h"
+
+namespace noobaa
+{
+
+/**
+ * S3 flexible checksum algorithms.
+ * All the crc variants are reflected with init and xorout of all ones,
+ * so the values can be chained (crc(a+b) = crc(b, crc(a))) and combined (see crc_combine).
+ */
+enum ChecksumAlgo
+{
+    CHECKSUM_CRC32 = 0,
+    CHECKSUM_CRC32C,
+    CHECKSUM_CRC64NVME,
+    CHECKSUM_SHA1,
+    CHECKSUM_SHA256,
+    CHECKSUM_ALGOS,
+};
+
+// S3 names - CRC32, CRC32C, CRC64NVME, SHA1, SHA256
+const char* checksum_algo_name(int algo);
+// returns -1 for unknown names, case insensitive
+int checksum_algo_parse(const std::string& name);
+// digest length in bytes
+int checksum_len(int algo);
+static inline bool
+checksum_is_crc(int algo)
+{
+    return algo == CHECKSUM_CRC32 || algo == CHECKSUM_CRC32C || algo == CHECKSUM_CRC64NVME;
+}
+
+// zlib style - start with crc=0 and pass the previous result to continue
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t len);
+uint32_t crc32c_update(uint32_t crc, const uint8_t* data, size_t len);
+uint64_t crc64nvme_update(uint64_t crc, const uint8_t* data, size_t len);
+
+// returns the crc of a+b given crc(a), crc(b) and len(b), without the data.
+uint64_t crc_combine(int algo, uint64_t crc1, uint64_t crc2, uint64_t len2);
+
+/**
+ * MultiChecksum computes any set of the algorithms in a single pass over the data.
+ * The crcs use the isa-l kernels (crc64nvme is table driven - isa-l has no nvme polynomial),
+ * and the sha digests use the isa-l_crypto multi-buffer managers like MD5Wrap.
+ */
+class MultiChecksum
+{
+public:
+    explicit MultiChecksum(uint32_t algos_mask);
+
+    uint32_t algos() const { return _algos; }
+    bool has(int algo) const { return _algos & (1u << algo); }
+
+    void update(const uint8_t* data, size_t len);
+
+    // writes checksum_len(algo) big endian bytes, can be called once per algorithm
+    void digest(int algo, uint8_t* out);
+
+private:
+    uint32_t _algos;
+    uint32_t _crc32;
+    uint32_t _crc32c;
+    uint64_t _crc64nvme;
+    DECLARE_ALIGNED(SHA1_HASH_CTX_MGR _sha1_mgr, 16);
+    DECLARE_ALIGNED(SHA1_HASH_CTX _sha1_ctx, 16);
+    DECLARE_ALIGNED(SHA256_HASH_CTX_MGR _sha256_mgr, 16);
+    DECLARE_ALIGNED(SHA256_HASH_CTX _sha256_ctx, 16);
+};
+
+// put a crc value in its big endian checksum bytes and back
+void checksum_crc_to_bytes(int algo, uint64_t crc, uint8_t* out);
+uint64_t checksum_crc_from_bytes(int algo, const uint8_t* in);
+
+} // namespace noobaa
@@ -1,6 +1,7 @@
 /* Copyright (C) 2016 NooBaa */
 #include "napi.h"
 #include "b64.h"
+#include "buf_pool.h"
 
 #include <uv.h>
 
@@ -160,13 +161,13 @@ nb_napi_set_bufs(napi_env env, napi_value obj, const char* name, struct NB_Bufs*
     napi_value v = 0;
     struct NB_Buf b;
     nb_bufs_detach(bufs, &b);
-    napi_create_external_buffer(env, b.len, b.data, nb_napi_finalize_free_data, 0, &v);
+    napi_create_external_buffer(env, b.len, b.data, nb_napi_finalize_pool_data, 0, &v);
     napi_set_named_property(env, obj, name, v);
 }
 
 void
-nb_napi_finalize_free_data(napi_env env, void* data, void* hint)
+nb_napi_finalize_pool_data(napi_env env, void* data, void* hint)
 {
-    nb_free(data);
+    nb_pool_free(data);
 }
 }
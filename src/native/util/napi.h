@@ -150,5 +150,5 @@ void nb_napi_get_buf_b64(napi_env env, napi_value obj, const char* name, struct
 void nb_napi_set_buf_b64(napi_env env, napi_value obj, const char* name, struct NB_Buf* b);
 void nb_napi_get_bufs(napi_env env, napi_value obj, const char* name, struct NB_Bufs* bufs);
 void nb_napi_set_bufs(napi_env env, napi_value obj, const char* name, struct NB_Bufs* bufs);
-void nb_napi_finalize_free_data(napi_env env, void* data, void* hint);
+void nb_napi_finalize_pool_data(napi_env env, void* data, void* hint);
 } // namespace noobaa
@@ -1,12 +1,12 @@
 /* Copyright (C) 2016 NooBaa */
 #include "struct_buf.h"
+#include "b64.h"
+#include "buf_pool.h"
 #include <stdio.h>
 
 namespace noobaa
 {
 
-static uint8_t _from_hex(char c);
-
 void
 nb_buf_init(struct NB_Buf* buf)
 {
@@ -41,14 +41,20 @@ nb_buf_init_copy(struct NB_Buf* buf, uint8_t* data, int len)
     memcpy(buf->data, data, len);
 }
 
-uint8_t*
-nb_buf_init_alloc(struct NB_Buf* buf, int len)
+void
+nb_buf_init_pooled(struct NB_Buf* buf, uint8_t* data, int len)
 {
-    uint8_t* data = nb_new_mem(len);
     buf->data = data;
     buf->len = len;
-    buf->deleter = nb_buf_default_deleter;
+    buf->deleter = nb_buf_pool_deleter;
     buf->deleter_arg = 0;
+}
+
+uint8_t*
+nb_buf_init_alloc(struct NB_Buf* buf, int len)
+{
+    uint8_t* data = nb_pool_alloc(len);
+    nb_buf_init_pooled(buf, data, len);
     return data;
 }
 
@@ -76,22 +82,18 @@ nb_buf_init_zeros(struct NB_Buf* buf, int len)
 void
 nb_buf_init_hex_str(struct NB_Buf* buf, struct NB_Buf* source)
 {
-    nb_buf_init_alloc(buf, 2 * source->len + 1);
-    const char* HEX = "0123456789abcdef";
-    for (int i = 0; i < source->len; ++i) {
-        buf->data[2 * i] = HEX[source->data[i] >> 4];
-        buf->data[2 * i + 1] = HEX[source->data[i] & 0xf];
-    }
-    buf->data[2 * source->len] = 0;
+    nb_buf_init_alloc(buf, hex_encode_len(source->len) + 1);
+    hex_encode(source->data, source->len, buf->data);
+    buf->data[hex_encode_len(source->len)] = 0;
 }
 
 void
 nb_buf_init_from_hex(struct NB_Buf* buf, struct NB_Buf* source_hex)
 {
-    nb_buf_init_alloc(buf, source_hex->len / 2);
-    for (int i = 0; i < buf->len; ++i) {
-        buf->data[i] =
-            _from_hex(source_hex->data[2 * i] << 4) | _from_hex(source_hex->data[2 * i + 1]);
+    nb_buf_init_alloc(buf, hex_decode_len(source_hex->len));
+    if (hex_decode(source_hex->data, source_hex->len, buf->data) < 0) {
+        nb_buf_free(buf);
+        nb_buf_init(buf);
     }
 }
 
@@ -156,6 +158,16 @@ nb_bufs_push_owned(struct NB_Bufs* bufs, uint8_t* data, int len)
     return b;
 }
 
+struct NB_Buf*
+nb_bufs_push_pooled(struct NB_Bufs* bufs, uint8_t* data, int len)
+{
+    struct NB_Buf* b;
+    nb_pre_list_get_push_ptr(bufs, struct NB_Buf, b);
+    nb_buf_init_pooled(b, data, len);
+    bufs->len += len;
+    return b;
+}
+
 struct NB_Buf*
 nb_bufs_push_copy(struct NB_Bufs* bufs, uint8_t* data, int len)
 {
@@ -228,8 +240,9 @@ nb_bufs_detach(struct NB_Bufs* bufs, struct NB_Buf* b)
         if (b) nb_buf_init(b);
         return 0;
     }
+    // the detached buffer is always pool memory, see nb_napi_finalize_pool_data
     struct NB_Buf* b0 = nb_pre_list_at(bufs, 0);
-    if (bufs->count == 1 && b0->deleter == nb_buf_default_deleter) {
+    if (bufs->count == 1 && b0->deleter == nb_buf_pool_deleter) {
         if (b) *b = *b0;
         nb_bufs_init(bufs);
     } else {
@@ -296,51 +309,4 @@ nb_bufs_push_vprintf(struct NB_Bufs* bufs, int alloc, const char* fmt, va_list v
     bufs->len -= trunc;
     b->len -= trunc;
 }
-
-static uint8_t
-_from_hex(char c)
-{
-    switch (c) {
-    case '0':
-        return 0;
-    case '1':
-        return 1;
-    case '2':
-        return 2;
-    case '3':
-        return 3;
-    case '4':
-        return 4;
-    case '5':
-        return 5;
-    case '6':
-        return 6;
-    case '7':
-        return 7;
-    case '8':
-        return 8;
-    case '9':
-        return 9;
-    case 'a':
-    case 'A':
-        return 10;
-    case 'b':
-    case 'B':
-        return 11;
-    case 'c':
-    case 'C':
-        return 12;
-    case 'd':
-    case 'D':
-        return 13;
-    case 'e':
-    case 'E':
-        return 14;
-    case 'f':
-    case 'F':
-        return 15;
-    default:
-        return 0;
-    }
-}
 }
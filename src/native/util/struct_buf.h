@@ -141,6 +141,7 @@ struct NB_Bufs {
 void nb_buf_init(struct NB_Buf* buf);
 void nb_buf_init_shared(struct NB_Buf* buf, uint8_t* data, int len);
 void nb_buf_init_owned(struct NB_Buf* buf, uint8_t* data, int len);
+void nb_buf_init_pooled(struct NB_Buf* buf, uint8_t* data, int len);
 void nb_buf_init_copy(struct NB_Buf* buf, uint8_t* data, int len);
 uint8_t* nb_buf_init_alloc(struct NB_Buf* buf, int len);
 void nb_buf_init_zeros(struct NB_Buf* buf, int len);
@@ -154,6 +155,7 @@ void nb_bufs_free(struct NB_Bufs* bufs);
 struct NB_Buf* nb_bufs_push(struct NB_Bufs* bufs, struct NB_Buf* buf);
 struct NB_Buf* nb_bufs_push_shared(struct NB_Bufs* bufs, uint8_t* data, int len);
 struct NB_Buf* nb_bufs_push_owned(struct NB_Bufs* bufs, uint8_t* data, int len);
+struct NB_Buf* nb_bufs_push_pooled(struct NB_Bufs* bufs, uint8_t* data, int len);
 struct NB_Buf* nb_bufs_push_copy(struct NB_Bufs* bufs, uint8_t* data, int len);
 struct NB_Buf* nb_bufs_push_alloc(struct NB_Bufs* bufs, int len);
 struct NB_Buf* nb_bufs_push_zeros(struct NB_Bufs* bufs, int len);
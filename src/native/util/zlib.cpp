@@ -5,8 +5,12 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+#include <memory>
+#include <vector>
+
 #include <zlib.h>
 
+#include "../third_party/isa-l/include/igzip_lib.h"
 #include "../util/common.h"
 
 namespace noobaa
@@ -213,4 +217,136 @@ nb_zlib_uncompress(struct NB_Bufs* bufs, int uncompressed_len, struct NB_Bufs* e
     nb_bufs_init(&out);
     return 0;
 }
+
+// igzip level buffers are large (up to ~300KB for level 3) so keep one per worker thread
+static uint8_t*
+_igzip_level_buf(int level, uint32_t* size)
+{
+    static const uint32_t LEVEL_BUF_SIZES[ISAL_DEF_MAX_LEVEL + 1] = {
+        ISAL_DEF_LVL0_DEFAULT,
+        ISAL_DEF_LVL1_DEFAULT,
+        ISAL_DEF_LVL2_DEFAULT,
+        ISAL_DEF_LVL3_DEFAULT,
+    };
+    thread_local std::vector<uint8_t> level_buf;
+    *size = LEVEL_BUF_SIZES[level];
+    if (level_buf.size() < *size) level_buf.resize(*size);
+    return *size ? level_buf.data() : 0;
+}
+
+int
+nb_igzip_compress(struct NB_Bufs* bufs, int level, struct NB_Bufs* errors)
+{
+    int res;
+    struct isal_zstream strm;
+    struct NB_Bufs out;
+
+    if (level < 0 || level > ISAL_DEF_MAX_LEVEL) {
+        nb_bufs_push_printf(errors, 256, "nb_igzip_compress: invalid level %i", level);
+        return -1;
+    }
+
+    nb_bufs_init(&out);
+    StackCleaner cleaner([&] { nb_bufs_free(&out); });
+
+    isal_deflate_init(&strm);
+    strm.level = level;
+    strm.level_buf = _igzip_level_buf(level, &strm.level_buf_size);
+    strm.gzip_flag = IGZIP_ZLIB;
+    strm.flush = NO_FLUSH;
+    strm.end_of_stream = 0;
+    strm.next_out = 0;
+    strm.avail_out = 0;
+
+    // feed all the buffers and then an empty end of stream input to flush the rest
+    for (int i = 0; i <= bufs->count; ++i) {
+        if (i < bufs->count) {
+            struct NB_Buf* b = nb_bufs_get(bufs, i);
+            strm.next_in = b->data;
+            strm.avail_in = b->len;
+        } else {
+            strm.next_in = 0;
+            strm.avail_in = 0;
+            strm.end_of_stream = 1;
+        }
+        while (strm.avail_in || (strm.end_of_stream && strm.internal_state.state != ZSTATE_END)) {
+            if (!strm.avail_out) {
+                struct NB_Buf* o = nb_bufs_push_alloc(&out, 16 * NB_BUF_PAGE_SIZE);
+                strm.next_out = o->data;
+                strm.avail_out = o->len;
+            }
+            res = isal_deflate(&strm);
+            if (res != COMP_OK) {
+                nb_bufs_push_printf(
+                    errors,
+                    256,
+                    "nb_igzip_compress: isal_deflate() error %i avail_in %u avail_out %u",
+                    res,
+                    strm.avail_in,
+                    strm.avail_out);
+                return -1;
+            }
+        }
+    }
+
+    assert(out.len >= (int)strm.total_out);
+    nb_bufs_truncate(&out, strm.total_out);
+    out.len = strm.total_out;
+
+    DBG1("nb_igzip_compress: " << DVAL(level) << DVAL(bufs->len) << DVAL(bufs->count) << DVAL(out.len) << DVAL(out.count));
+
+    nb_bufs_free(bufs);
+    *bufs = out;
+    nb_bufs_init(&out);
+    return 0;
+}
+
+int
+nb_igzip_uncompress(struct NB_Bufs* bufs, int uncompressed_len, struct NB_Bufs* errors)
+{
+    int res;
+    struct NB_Bufs out;
+
+    // the inflate state holds the decode tables and history (~40KB) so avoid the stack
+    std::unique_ptr<struct inflate_state> state(new struct inflate_state);
+
+    nb_bufs_init(&out);
+    StackCleaner cleaner([&] { nb_bufs_free(&out); });
+
+    // the uncompressed length is known so decompress directly into a single buffer
+    struct NB_Buf* o = nb_bufs_push_alloc(&out, uncompressed_len);
+
+    isal_inflate_init(state.get());
+    state->crc_flag = ISAL_ZLIB;
+    state->next_out = o->data;
+    state->avail_out = o->len;
+
+    for (int i = 0; i < bufs->count && state->block_state != ISAL_BLOCK_FINISH; ++i) {
+        struct NB_Buf* b = nb_bufs_get(bufs, i);
+        state->next_in = b->data;
+        state->avail_in = b->len;
+        res = isal_inflate(state.get());
+        if (res < 0) {
+            nb_bufs_push_printf(errors, 256, "nb_igzip_uncompress: isal_inflate() error %i", res);
+            return -1;
+        }
+    }
+
+    if (state->block_state != ISAL_BLOCK_FINISH || (int)state->total_out != uncompressed_len) {
+        nb_bufs_push_printf(
+            errors,
+            256,
+            "nb_igzip_uncompress: incomplete stream total_out %u expected %i",
+            state->total_out,
+            uncompressed_len);
+        return -1;
+    }
+
+    DBG1("nb_igzip_uncompress: " << DVAL(bufs->len) << DVAL(bufs->count) << DVAL(out.len) << DVAL(out.count));
+
+    nb_bufs_free(bufs);
+    *bufs = out;
+    nb_bufs_init(&out);
+    return 0;
+}
 }
@@ -8,4 +8,12 @@ namespace noobaa
 
 int nb_zlib_compress(struct NB_Bufs* bufs, struct NB_Bufs* errors);
 int nb_zlib_uncompress(struct NB_Bufs* bufs, int uncompressed_len, struct NB_Bufs* errors);
+
+/**
+ * isa-l igzip variants - produce and consume the same zlib (RFC 1950) streams as the zlib
+ * functions above, so chunks compressed by either can be decompressed by the other.
+ * level is the igzip level (0-3).
+ */
+int nb_igzip_compress(struct NB_Bufs* bufs, int level, struct NB_Bufs* errors);
+int nb_igzip_uncompress(struct NB_Bufs* bufs, int uncompressed_len, struct NB_Bufs* errors);
 }
@@ -22,6 +22,7 @@ const RpcError = require('./rpc_error');
 const url_utils = require('../util/url_utils');
 const RpcRequest = require('./rpc_request');
 const RpcMessage = require('./rpc_message');
+const { RpcCodec } = require('./rpc_codec');
 const RpcWsServer = require('./rpc_ws_server');
 const RpcN2NAgent = require('./rpc_n2n_agent');
 const RpcTcpServer = require('./rpc_tcp_server');
@@ -565,6 +566,7 @@ class RPC extends EventEmitter {
         }
         conn._sent_requests = new Map();
         conn._received_requests = new Map();
+        if (!conn.transient) conn.codec = RpcCodec.for_schema(this.schema);
         conn.once('connect', () => {
             if (this.routing_hint) {
                 dbg.log0('RPC ROUTING REQ SEND', this.routing_hint, conn.connid, conn.url.href);
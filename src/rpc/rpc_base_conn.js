@@ -56,6 +56,13 @@ class RpcBaseConnection extends events.EventEmitter {
         /** @type {Set<string>} */
         this._ping_reqid_set = undefined;
 
+        // binary body codec set by rpc for persistent connections (see RpcCodec),
+        // used for sending only after the peer announced the same codec.
+        /** @type {import('./rpc_codec').RpcCodec} */
+        this.codec = null;
+        this._peer_codec = false;
+        this._codec_announced = false;
+
         /** @type {ReturnType<setTimeout>} */
         this._reconnect_timeout = undefined;
         this._no_reconnect = false;
@@ -182,7 +189,13 @@ class RpcBaseConnection extends events.EventEmitter {
      * @returns {Buffer[]}
      */
     _encode_message(msg) {
-        return msg.encode();
+        if (!this.codec) return msg.encode();
+        if (this._peer_codec) return msg.encode(this.codec);
+        // the codec is announced once, on the first message sent on the connection,
+        // so peers that do not know it (older versions) keep getting plain json bodies.
+        if (this._codec_announced) return msg.encode();
+        this._codec_announced = true;
+        return msg.encode(null, this.codec.id);
     }
 
     /**
@@ -190,7 +203,12 @@ class RpcBaseConnection extends events.EventEmitter {
      * @returns {RpcMessage}
      */
     _decode_message(encoded_message) {
-        return RpcMessage.decode(encoded_message);
+        const msg = RpcMessage.decode(encoded_message, this.codec);
+        if (this.codec && !this._peer_codec && msg.codec_id === this.codec.id) {
+            dbg.log1('RPC CONN CODEC', this.codec.id, this.connid);
+            this._peer_codec = true;
+        }
+        return msg;
     }
 
     _alloc_reqid() {
@@ -0,0 +1,120 @@
+/* Copyright (C) 2016 NooBaa */
+'use strict';
+
+/** @typedef {import('./rpc_schema')} RpcSchema */
+
+const _ = require('lodash');
+const crypto = require('crypto');
+
+const dbg = require('../util/debug_module')(__filename);
+const config = require('../../config');
+
+const RPC_CODEC_VERSION = 'nb1';
+
+// strings that rpc itself puts in message bodies around the api params/reply
+const RPC_BODY_STRINGS = [
+    'op', 'reqid', 'api', 'method', 'params', 'auth_token', 'buffers', 'name', 'len',
+    'took', 'error', 'reply', 'message', 'rpc_code', 'rpc_data', 'routing_hint',
+    'req', 'res', 'ping', 'pong', 'routing_req', 'routing_res',
+];
+
+/** @type {WeakMap<RpcSchema, RpcCodec>} */
+const codec_by_schema = new WeakMap();
+
+/**
+ * RpcCodec is the binary encoding of rpc message bodies done by the native RpcCodec.
+ * Object keys and enum values from the api schemas are interned so both sides have
+ * to be built from the same schemas - the id includes a hash of the interned strings
+ * and connections only switch to the binary encoding once the peer announced the same id
+ * (see RpcBaseConnection._encode_message).
+ */
+class RpcCodec {
+
+    /**
+     * @param {RpcSchema} schema
+     * @returns {RpcCodec|null} null when disabled or the native module is not available
+     */
+    static for_schema(schema) {
+        if (!config.RPC_NATIVE_CODEC_ENABLED || !schema) return null;
+        let codec = codec_by_schema.get(schema);
+        if (codec === undefined) {
+            try {
+                const nb_native = require('../util/nb_native');
+                codec = new RpcCodec(collect_schema_strings(schema), nb_native().RpcCodec);
+            } catch (err) {
+                dbg.warn('RpcCodec: native codec not available, using json', err.message);
+                codec = null;
+            }
+            codec_by_schema.set(schema, codec);
+        }
+        return codec;
+    }
+
+    /**
+     * @param {string[]} strings
+     * @param {nb.RpcCodecConstructor} NativeRpcCodec
+     */
+    constructor(strings, NativeRpcCodec) {
+        const hash = crypto.createHash('sha1').update(strings.join('\n')).digest('hex');
+        this.id = `${RPC_CODEC_VERSION}:${hash.slice(0, 16)}`;
+        this.num_strings = strings.length;
+        this._native = new NativeRpcCodec(strings);
+    }
+
+    /**
+     * @param {object} body
+     * @param {number} header_len bytes to reserve at the start of the buffer
+     * @returns {Buffer}
+     */
+    encode(body, header_len) {
+        return this._native.encode(body, header_len);
+    }
+
+    /**
+     * @param {Buffer} buffer
+     * @returns {object}
+     */
+    decode(buffer) {
+        return this._native.decode(buffer);
+    }
+}
+
+/**
+ * collect property names, enum values, api and method names from all the registered apis.
+ * sorted so that the result does not depend on the api registration order.
+ * @param {RpcSchema} schema
+ * @returns {string[]}
+ */
+function collect_schema_strings(schema) {
+    const strings = new Set(RPC_BODY_STRINGS);
+    const visit = node => {
+        if (Array.isArray(node)) {
+            for (const item of node) visit(item);
+            return;
+        }
+        if (!_.isPlainObject(node)) return;
+        if (_.isPlainObject(node.properties)) {
+            for (const key of Object.keys(node.properties)) strings.add(key);
+        }
+        if (Array.isArray(node.enum)) {
+            for (const value of node.enum) {
+                if (typeof value === 'string') strings.add(value);
+            }
+        }
+        _.forOwn(node, visit);
+    };
+    _.forOwn(schema, api => {
+        if (!api || !api.$id || api.$id[0] === '_') return;
+        strings.add(api.$id);
+        _.forOwn(api.methods, (method_api, method_name) => {
+            strings.add(method_name);
+            visit(method_api.params);
+            visit(method_api.reply);
+        });
+        visit(api.definitions);
+    });
+    return Array.from(strings).sort();
+}
+
+exports.RpcCodec = RpcCodec;
+exports.collect_schema_strings = collect_schema_strings;
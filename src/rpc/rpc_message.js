@@ -1,6 +1,8 @@
 /* Copyright (C) 2016 NooBaa */
 'use strict';
 
+/** @typedef {import('./rpc_codec').RpcCodec} RpcCodec */
+
 const _ = require('lodash');
 const buffer_utils = require('../util/buffer_utils');
 const schema_utils = require('../util/schema_utils');
@@ -16,6 +18,12 @@ const RPC_VERSION_NUMBER = Buffer.from([
     RPC_VERSION_FLAGS,
 ]).readUInt32BE(0);
 
+// flags bit for bodies encoded with RpcCodec instead of json,
+// only sent to peers that announced the codec so older versions never see it.
+const RPC_FLAG_CODEC = 0x01;
+const RPC_VERSION_NUMBER_CODEC = (RPC_VERSION_NUMBER | RPC_FLAG_CODEC) >>> 0;
+const RPC_META_SIZE = 8;
+
 // Encoding and decoding of rpc messages is a non-symmetric operation
 // when using cloning we need to replicate this non symmetry as much as
 // possible in order to ensure complaince on both sides of the RPC call.
@@ -54,6 +62,9 @@ class RpcMessage {
     constructor(body, buffers) {
         this.body = body;
         this.buffers = buffers || [];
+        // codec id announced by (or used by) the sender of a decoded message
+        /** @type {string} */
+        this.codec_id = undefined;
     }
 
     /**
@@ -68,12 +79,21 @@ class RpcMessage {
     }
 
     /**
+     * @param {RpcCodec} [codec] encode the body with the codec instead of json
+     * @param {string} [announce_codec] codec id to add to a json body to let the peer know we can decode it
      * @returns {Buffer[]}
      */
-    encode() {
+    encode(codec, announce_codec) {
         const { body, buffers = [] } = this;
-        const meta_buffer = Buffer.allocUnsafe(8);
-        const body_buffer = Buffer.from(JSON.stringify(body));
+        if (codec) {
+            // the codec reserves room for the meta header to avoid another buffer
+            const body_buffer = codec.encode(body, RPC_META_SIZE);
+            body_buffer.writeUInt32BE(RPC_VERSION_NUMBER_CODEC, 0);
+            body_buffer.writeUInt32BE(body_buffer.length - RPC_META_SIZE, 4);
+            return [body_buffer, ...buffers];
+        }
+        const meta_buffer = Buffer.allocUnsafe(RPC_META_SIZE);
+        const body_buffer = Buffer.from(JSON.stringify(announce_codec ? { ...body, codec: announce_codec } : body));
         meta_buffer.writeUInt32BE(RPC_VERSION_NUMBER, 0);
         meta_buffer.writeUInt32BE(body_buffer.length, 4);
         const msg_buffers = [
@@ -86,12 +106,14 @@ class RpcMessage {
 
     /**
      * @param {Buffer[]} msg_buffers
+     * @param {RpcCodec} [codec] codec to decode binary bodies with
      * @returns {RpcMessage}
      */
-    static decode(msg_buffers) {
-        const meta_buffer = buffer_utils.extract_join(msg_buffers, 8);
+    static decode(msg_buffers, codec) {
+        const meta_buffer = buffer_utils.extract_join(msg_buffers, RPC_META_SIZE);
         const version = meta_buffer.readUInt32BE(0);
-        if (version !== RPC_VERSION_NUMBER) {
+        const use_codec = Boolean(codec) && version === RPC_VERSION_NUMBER_CODEC;
+        if (version !== RPC_VERSION_NUMBER && !use_codec) {
             const magic = meta_buffer.readUInt8(0);
             const major = meta_buffer.readUInt8(1);
             const minor = meta_buffer.readUInt8(2);
@@ -99,13 +121,24 @@ class RpcMessage {
             if (magic !== RPC_VERSION_MAGIC) throw new Error('RPC VERSION MAGIC MISMATCH');
             if (major !== RPC_VERSION_MAJOR) throw new Error('RPC VERSION MAJOR MISMATCH');
             if (minor !== RPC_VERSION_MINOR) throw new Error('RPC VERSION MINOR MISMATCH');
+            if (flags === RPC_FLAG_CODEC) throw new Error('RPC CODEC NOT SUPPORTED');
             if (flags !== RPC_VERSION_FLAGS) throw new Error('RPC VERSION FLAGS MISMATCH');
             throw new Error('RPC VERSION MISMATCH');
         }
         const body_length = meta_buffer.readUInt32BE(4);
-        const body = JSON.parse(buffer_utils.extract_join(msg_buffers, body_length).toString());
-
-        return new RpcMessage(body, msg_buffers);
+        const body_buffer = buffer_utils.extract_join(msg_buffers, body_length);
+        if (use_codec) {
+            const msg = new RpcMessage(codec.decode(body_buffer), msg_buffers);
+            msg.codec_id = codec.id;
+            return msg;
+        }
+        const body = JSON.parse(body_buffer.toString());
+        const msg = new RpcMessage(body, msg_buffers);
+        if (body && body.codec) {
+            msg.codec_id = body.codec;
+            delete body.codec;
+        }
+        return msg;
     }
 }
 
@@ -58,7 +58,10 @@ class RpcNtcpConnection extends RpcBaseConnection {
             this.emit('error', closed_err);
         });
         ntcp.on('error', err => this.emit('error', err));
-        ntcp.on('message', msg => this.emit('message', [msg]));
+        // ntcp delivers all the messages parsed from a single socket read together
+        ntcp.on('messages', msgs => {
+            for (const msg of msgs) this.emit('message', [msg]);
+        });
     }
 
 }
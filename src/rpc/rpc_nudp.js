@@ -3,6 +3,7 @@
 
 // const _ = require('lodash');
 const P = require('../util/promise');
+const config = require('../../config');
 // const url = require('url');
 const RpcBaseConnection = require('./rpc_base_conn');
 const nb_native = require('../util/nb_native');
@@ -21,7 +22,7 @@ class RpcNudpConnection extends RpcBaseConnection {
 
     _connect() {
         const Nudp = nb_native().Nudp;
-        this.nudp = new Nudp();
+        this.nudp = new Nudp({ gso: config.N2N_UDP_GSO });
         this._init_nudp();
         return P.ninvoke(this.nudp, 'bind', 0, '0.0.0.0')
             .then(port => P.ninvoke(this.nudp, 'connect', this.url.port, this.url.hostname))
@@ -43,7 +44,7 @@ class RpcNudpConnection extends RpcBaseConnection {
 
     accept(port) {
         const Nudp = nb_native().Nudp;
-        this.nudp = new Nudp();
+        this.nudp = new Nudp({ gso: config.N2N_UDP_GSO });
         this._init_nudp();
         return P.ninvoke(this.nudp, 'bind', port, '0.0.0.0')
             // TODO emit event from native code?
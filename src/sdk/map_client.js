@@ -64,6 +64,57 @@ const chunk_read_cache = new LRUCache({
     },
 });
 
+/**
+ * LatencySampler keeps the latest latency samples in a ring
+ * and answers percentiles from a sorted copy that is refreshed
+ * only after a tenth of the samples were replaced.
+ */
+class LatencySampler {
+
+    /**
+     * @param {number} size
+     */
+    constructor(size) {
+        this.size = size;
+        /** @type {number[]} */
+        this.samples = [];
+        this.next = 0;
+        /** @type {number[]} */
+        this.sorted = undefined;
+        this.added_since_sort = 0;
+    }
+
+    /**
+     * @param {number} ms
+     */
+    add(ms) {
+        if (this.samples.length < this.size) {
+            this.samples.push(ms);
+        } else {
+            this.samples[this.next] = ms;
+            this.next = (this.next + 1) % this.size;
+        }
+        this.added_since_sort += 1;
+    }
+
+    /**
+     * @param {number} percent
+     * @returns {number|undefined} undefined until there are enough samples
+     */
+    percentile(percent) {
+        const len = this.samples.length;
+        if (len < Math.min(100, this.size)) return;
+        if (!this.sorted || this.added_since_sort * 10 >= this.size) {
+            this.sorted = this.samples.slice().sort((a, b) => a - b);
+            this.added_since_sort = 0;
+        }
+        return this.sorted[Math.min(len - 1, Math.floor(len * percent / 100))];
+    }
+}
+
+// latencies of recent block reads, used to decide when a chunk read should be hedged
+const block_read_latency = new LatencySampler(config.IO_READ_HEDGE_SAMPLES);
+
 
 /**
  * @param {nb.Chunk[]} res_chunks
@@ -450,6 +501,11 @@ class MapClient {
     async read_chunk_data(chunk) {
         const all_frags = chunk.frags;
         const data_frags = all_frags.filter(frag => frag.data_index >= 0);
+        const parity_frags = all_frags.filter(frag => frag.parity_index >= 0);
+
+        if (config.IO_READ_HEDGE_ENABLED && !this.verification_mode && parity_frags.length) {
+            return this.read_chunk_data_hedged(chunk, data_frags, parity_frags);
+        }
 
         // start by reading from the data fragments of the chunk
         // because this is most effective and does not require decoding
@@ -475,7 +531,6 @@ class MapClient {
             const saved_data = chunk.data;
             chunk.data = undefined;
             for (const frag of data_frags) frag.data = undefined;
-            const parity_frags = all_frags.filter(frag => frag.parity_index >= 0);
             const verify_frags = parity_frags.concat(data_frags.slice(0, data_frags.length - parity_frags.length));
             await Promise.all(verify_frags.map(frag => this.read_frag(frag, chunk)));
             await this.decode_chunk(chunk);
@@ -483,6 +538,83 @@ class MapClient {
         }
     }
 
+    /**
+     * Reads the data frags of an erasure coded chunk, and hedges with reads of parity frags
+     * when the data frags are slower than the IO_READ_HEDGE_PERCENTILE of recent block reads,
+     * or as soon as a data frag fails to read.
+     * The chunk is decoded as soon as any data_frags of its frags arrived,
+     * so a single slow or dead node does not hold the read of the chunk.
+     * Reads that are still running after the decode are left to complete in the background.
+     * @param {nb.Chunk} chunk
+     * @param {nb.Frag[]} data_frags
+     * @param {nb.Frag[]} parity_frags
+     */
+    async read_chunk_data_hedged(chunk, data_frags, parity_frags) {
+        const k = chunk.chunk_coder_config.data_frags;
+        const spare_frags = parity_frags.slice();
+        const pending_frags = new Set();
+        let wakeup = _.noop;
+
+        const start_read = frag => {
+            pending_frags.add(frag);
+            this.read_frag(frag, chunk)
+                .catch(err => dbg.warn('READ read_chunk_data_hedged: read frag failed', err))
+                .then(() => {
+                    pending_frags.delete(frag);
+                    // a frag that failed to read is replaced right away
+                    if (!frag.data) start_spare_read();
+                    wakeup();
+                });
+        };
+        const start_spare_read = () => {
+            const frag = spare_frags.shift();
+            if (frag) start_read(frag);
+        };
+
+        for (const frag of data_frags) start_read(frag);
+
+        const hedge_delay = Math.max(
+            config.IO_READ_HEDGE_MIN_DELAY_MS,
+            block_read_latency.percentile(config.IO_READ_HEDGE_PERCENTILE) ?? config.IO_READ_HEDGE_INITIAL_DELAY_MS,
+        );
+        const hedge_timer = setTimeout(() => {
+            for (const frag of data_frags) {
+                if (pending_frags.has(frag)) start_spare_read();
+            }
+        }, hedge_delay);
+
+        try {
+            let last_err;
+            let num_decoded_frags = 0;
+            for (;;) {
+                const num_frags = chunk.frags.reduce((n, frag) => (frag.data ? n + 1 : n), 0);
+                if (num_frags >= k && num_frags > num_decoded_frags) {
+                    num_decoded_frags = num_frags;
+                    try {
+                        await this.decode_chunk(chunk);
+                        return;
+                    } catch (err) {
+                        // some frag was corrupted, so read another one and decode again
+                        last_err = err;
+                        dbg.warn('READ read_chunk_data_hedged: failed to decode from', num_frags, 'frags',
+                            err.stack || err,
+                            'err.chunks', util.inspect(err.chunks, true, null, true)
+                        );
+                        start_spare_read();
+                        // frags that arrived during the decode are counted again before giving up
+                        continue;
+                    }
+                }
+                if (!pending_frags.size) {
+                    throw last_err || new Error(`READ read_chunk_data_hedged: not enough frags ${num_frags}/${k}`);
+                }
+                await new Promise(resolve => { wakeup = resolve; });
+            }
+        } finally {
+            clearTimeout(hedge_timer);
+        }
+    }
+
     async decode_chunk(chunk) {
         await new Promise((resolve, reject) =>
             nb_native().chunk_coder('dec', chunk, err => (err ? reject(err) : resolve()))
@@ -548,6 +680,7 @@ class MapClient {
                 if (!block.address) throw new Error('No block address for node ' + block.node);
                 this._error_injection_on_read();
 
+                const start_time = Date.now();
                 const res = await block_store_client.read_block(this.rpc_client, {
                     block_md,
                 }, {
@@ -558,6 +691,7 @@ class MapClient {
 
                 /** @type {Buffer} */
                 const data = res[RPC_BUFFERS].data;
+                block_read_latency.add(Date.now() - start_time);
 
                 // verification mode checks here the block digest.
                 // this detects tampering which the agent did not report which means the agent is hacked.
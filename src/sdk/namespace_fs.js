@@ -86,6 +86,9 @@ const XATTR_TAG = XATTR_NOOBAA_INTERNAL_PREFIX + 'tag.';
 const XATTR_LEGAL_HOLD = XATTR_NOOBAA_INTERNAL_PREFIX + 'legal_hold';
 const XATTR_RETENTION_MODE = XATTR_NOOBAA_INTERNAL_PREFIX + 'retention_mode';
 const XATTR_RETENTION_DATE = XATTR_NOOBAA_INTERNAL_PREFIX + 'retention_date';
+// S3 flexible checksum - base64 value per algorithm, e.g user.noobaa.checksum_crc32c
+const XATTR_CHECKSUM_PREFIX = XATTR_NOOBAA_INTERNAL_PREFIX + 'checksum_';
+const XATTR_CHECKSUM_TYPE = XATTR_NOOBAA_INTERNAL_PREFIX + 'checksum_type';
 const HIDDEN_VERSIONS_PATH = '.versions';
 const NULL_VERSION_ID = 'null';
 const NULL_VERSION_SUFFIX = '_' + NULL_VERSION_ID;
@@ -335,38 +338,26 @@ function get_random_delay(base, min, max) {
 }
 
 /**
- * @typedef {{
- *  time: number,
- *  stat: nb.NativeFSStats,
- *  usage: number,
- *  sorted_entries?: fs.Dirent[],
- * }} ReaddirCacheItem
- * @type {LRUCache<object, string, ReaddirCacheItem>}
+ * The listing cache of regular (non versions) list objects is kept in native memory -
+ * a sorted arena of names per directory that is searched and paged from here
+ * without holding a JS object per entry.
+ * It is created lazily so that config overrides are loaded by then.
+ * @type {nb.NativeDirCache}
  */
-const dir_cache = new LRUCache({
-    name: 'nsfs-dir-cache',
-    make_key: ({ dir_path }) => dir_path,
-    load: async ({ dir_path, fs_context }) => {
-        const time = Date.now();
-        const stat = await nb_native().fs.stat(fs_context, dir_path);
-        let sorted_entries;
-        let usage = config.NSFS_DIR_CACHE_MIN_DIR_SIZE;
-        if (stat.size <= config.NSFS_DIR_CACHE_MAX_DIR_SIZE) {
-            sorted_entries = await nb_native().fs.readdir(fs_context, dir_path);
-            sorted_entries.sort(sort_entries_by_name);
-            for (const ent of sorted_entries) {
-                usage += ent.name.length + 4;
-            }
-        }
-        return { time, stat, sorted_entries, usage };
-    },
-    validate: async ({ stat }, { dir_path, fs_context }) => {
-        const new_stat = await nb_native().fs.stat(fs_context, dir_path);
-        return (new_stat.ino === stat.ino && new_stat.mtimeNsBigint === stat.mtimeNsBigint);
-    },
-    item_usage: ({ usage }, dir_path) => usage,
-    max_usage: config.NSFS_DIR_CACHE_MAX_TOTAL_SIZE,
-});
+let dir_cache;
+
+/**
+ * @returns {nb.NativeDirCache}
+ */
+function get_dir_cache() {
+    if (!dir_cache) {
+        dir_cache = new (nb_native().fs.DirCache)({
+            max_total_size: config.NSFS_DIR_CACHE_MAX_TOTAL_SIZE,
+            max_dir_size: config.NSFS_DIR_CACHE_MAX_DIR_SIZE,
+        });
+    }
+    return dir_cache;
+}
 
 /**
  * @typedef {{
@@ -709,7 +700,7 @@ class NamespaceFS {
                 }
                 // /** @type {fs.Dir} */
                 let dir_handle;
-                /** @type {ReaddirCacheItem} */
+                /** @type {{ stat: nb.NativeFSStats, sorted_entries?: fs.Dirent[], listing?: nb.NativeDirListing }} */
                 let cached_dir;
                 const dir_path = path.join(this.bucket_path, dir_key);
                 const prefix_dir = prefix.slice(0, dir_key.length);
@@ -818,7 +809,7 @@ class NamespaceFS {
                     if (list_versions) {
                         cached_dir = await versions_dir_cache.get_with_cache({ dir_path, fs_context });
                     } else {
-                        cached_dir = await dir_cache.get_with_cache({ dir_path, fs_context });
+                        cached_dir = await get_dir_cache().load(fs_context, dir_path);
                     }
                 } catch (err) {
                     if (['ENOENT', 'ENOTDIR'].includes(err.code)) {
@@ -840,6 +831,48 @@ class NamespaceFS {
                     await insert_entry_to_results_arr(r);
                 }
 
+                // handling a scenario in which key_marker points to an object inside a directory
+                // since there can be entries inside the directory that will need to be pushed
+                // to results array
+                const process_prev_dir = async prev_dir => {
+                    const prev_dir_name = prev_dir.name;
+                    if (marker_curr.startsWith(prev_dir_name) && dir_key !== prev_dir.name) {
+                        if (!delimiter) {
+                            const isDir = await is_directory_or_symlink_to_directory(
+                                prev_dir, fs_context, path.join(dir_path, prev_dir_name, '/'));
+                            if (isDir) {
+                                await process_dir(path.join(dir_key, prev_dir_name, '/'));
+                            }
+                        }
+                    }
+                };
+
+                if (cached_dir.listing) {
+                    const listing = cached_dir.listing;
+                    const marker_index = listing.upper_bound(marker_curr);
+                    if (marker_index) {
+                        await process_prev_dir(listing.entries(marker_index - 1, { limit: 1 })[0]);
+                    }
+                    // entries are sorted by name so the prefix entries are a contiguous range,
+                    // which we page over until it ends or enough keys are collected.
+                    let index = Math.max(marker_index, listing.lower_bound(prefix_ent));
+                    while (!is_truncated) {
+                        const entries = listing.entries(index, { prefix: prefix_ent, limit: config.NSFS_DIR_CACHE_PAGE_SIZE });
+                        if (!entries.length) break;
+                        index += entries.length;
+                        for (const ent of entries) {
+                            // when entry is NSFS_FOLDER_OBJECT_NAME=.folder file,
+                            // and the dir key marker is the name of the curr directory - skip on adding it
+                            if (ent.name === config.NSFS_FOLDER_OBJECT_NAME && dir_key === marker_dir) {
+                                continue;
+                            }
+                            await process_entry(ent, is_disabled_dir_content);
+                            if (is_truncated) break;
+                        }
+                    }
+                    return;
+                }
+
                 if (cached_dir.sorted_entries) {
                     const sorted_entries = cached_dir.sorted_entries;
                     let marker_index;
@@ -865,21 +898,8 @@ class NamespaceFS {
                         );
                     }
 
-                    // handling a scenario in which key_marker points to an object inside a directory
-                    // since there can be entries inside the directory that will need to be pushed
-                    // to results array
                     if (marker_index) {
-                        const prev_dir = sorted_entries[marker_index - 1];
-                        const prev_dir_name = prev_dir.name;
-                        if (marker_curr.startsWith(prev_dir_name) && dir_key !== prev_dir.name) {
-                            if (!delimiter) {
-                                const isDir = await is_directory_or_symlink_to_directory(
-                                    prev_dir, fs_context, path.join(dir_path, prev_dir_name, '/'));
-                                if (isDir) {
-                                    await process_dir(path.join(dir_key, prev_dir_name, '/'));
-                                }
-                            }
-                        }
+                        await process_prev_dir(sorted_entries[marker_index - 1]);
                     }
                     for (let i = marker_index; i < sorted_entries.length; ++i) {
                         const ent = sorted_entries[i];
@@ -1261,6 +1281,7 @@ class NamespaceFS {
                 upload_res = await bp.sem.surround_count(
                     bp.buf_size, async () => this._upload_stream(upload_params));
                 upload_params.digest = upload_res.digest;
+                upload_params.checksums = upload_res.checksums;
             }
 
             const upload_info = await this._finish_upload(upload_params);
@@ -1381,7 +1402,7 @@ class NamespaceFS {
     // xattr_copy = false implies on non server side copy fallback copy (copy status = FALLBACK)
     // target file can be undefined when it's a folder created and size is 0
     async _finish_upload({ fs_context, params, open_mode, target_file, upload_path, file_path, digest = undefined,
-        copy_res = undefined, offset, object_sdk }) {
+        checksums = undefined, checksum_type = undefined, copy_res = undefined, offset, object_sdk }) {
         const part_upload = file_path === upload_path;
         const same_inode = params.copy_source && copy_res === COPY_STATUS_ENUM.SAME_INODE;
         const should_replace_xattr = params.copy_source ? copy_res === COPY_STATUS_ENUM.FALLBACK : true;
@@ -1412,6 +1433,15 @@ class NamespaceFS {
             }
             fs_xattr = this._assign_md5_to_fs_xattr(digest, fs_xattr);
         }
+        if (checksums) {
+            const { key, bucket, upload_id } = params;
+            const { algorithm, value_b64 } = params.checksum || {};
+            if (value_b64 && value_b64 !== checksums[algorithm]) {
+                dbg.warn('_finish_upload: checksum mismatch', { key, bucket, upload_id, algorithm, value_b64, checksums });
+                throw new S3Error(S3Error.BadDigest);
+            }
+            fs_xattr = this._assign_checksum_to_fs_xattr(checksums, part_upload ? undefined : (checksum_type || 'FULL_OBJECT'), fs_xattr);
+        }
         if (part_upload) {
             fs_xattr = this._assign_part_props_to_fs_xattr(params.size, digest, offset, fs_xattr);
         } else {
@@ -1436,11 +1466,16 @@ class NamespaceFS {
                 });
             }
         }
-        if (fs_xattr && !is_disabled_dir_content && should_replace_xattr) {
+        const replace_xattr = Boolean(fs_xattr && !is_disabled_dir_content && should_replace_xattr);
+        if (replace_xattr) {
             await target_file.replacexattr(fs_context, fs_xattr);
         }
         // fsync
-        if (config.NSFS_TRIGGER_FSYNC) await target_file.fsync(fs_context);
+        if (config.NSFS_TRIGGER_FSYNC) {
+            const datasync = config.NSFS_FDATASYNC_NO_XATTR_FILES && !replace_xattr && !copy_xattr &&
+                this._is_versioning_disabled();
+            await target_file.fsync(fs_context, { datasync });
+        }
         dbg.log1('NamespaceFS._finish_upload:', open_mode, file_path, upload_path, fs_xattr);
 
         if (!same_inode && !part_upload) {
@@ -1501,7 +1536,9 @@ class NamespaceFS {
                 } else {
                     await this._move_to_dest_version(fs_context, source_path, dest_path, target_file, key, open_mode);
                 }
-                if (config.NSFS_TRIGGER_FSYNC) await nb_native().fs.fsync(fs_context, path.dirname(dest_path));
+                if (config.NSFS_TRIGGER_FSYNC) {
+                    await nb_native().fs.fsync(fs_context, path.dirname(dest_path), { coalesce: config.NSFS_FSYNC_COALESCE_DIRS });
+                }
                 break;
             } catch (err) {
                 retries -= 1;
@@ -1682,6 +1719,7 @@ class NamespaceFS {
      * 
      * @returns {Promise<{
      *  digest: string,
+     *  checksums?: Record<string, string>,
      *  total_bytes: number,
      *  rdma_reply?: nb.RdmaReply,
      * }>}
@@ -1692,11 +1730,17 @@ class NamespaceFS {
         try {
             let rdma_reply;
             const md5_enabled = this._is_force_md5_enabled(object_sdk);
+            // the signed x-amz-content-sha256 of a request body (not of copy sources)
+            const payload_sha256 = Boolean(config.S3_VERIFY_PAYLOAD_SHA256 && params.sha256_b64 &&
+                !copy_source && !params.source_params && !params.rdma_info);
             const file_writer = new FileWriter({
                 target_file,
                 fs_context,
                 offset,
+                expected_size: params.size,
                 md5_enabled,
+                checksum_algorithms: params.checksum ? [params.checksum.algorithm] : undefined,
+                payload_sha256,
                 stats: this.stats,
                 bucket: params.bucket,
                 namespace_resource_id: this.namespace_resource_id,
@@ -1719,7 +1763,17 @@ class NamespaceFS {
             } else {
                 await file_writer.write_entire_stream(params.source_stream, { signal });
             }
-            return { digest: file_writer.digest, total_bytes: file_writer.total_bytes, rdma_reply };
+            if (payload_sha256 && file_writer.payload_sha256_b64 !== params.sha256_b64) {
+                dbg.warn('_upload_stream: x-amz-content-sha256 mismatch', params.bucket, params.key,
+                    params.sha256_b64, file_writer.payload_sha256_b64);
+                throw new S3Error(S3Error.XAmzContentSHA256Mismatch);
+            }
+            return {
+                digest: file_writer.digest,
+                checksums: file_writer.checksums,
+                total_bytes: file_writer.total_bytes,
+                rdma_reply,
+            };
         } catch (error) {
             dbg.error('_upload_stream had error: ', error);
             throw error;
@@ -1877,7 +1931,7 @@ class NamespaceFS {
                 await native_fs_utils.copy_bytes(multi_buffer_pool, fs_context, part_md_file, target_file, params.size, offset, 0);
             }
 
-            md_upload_params = { ...md_upload_params, offset, digest: upload_res.digest };
+            md_upload_params = { ...md_upload_params, offset, digest: upload_res.digest, checksums: upload_res.checksums };
             const upload_info = await this._finish_upload(md_upload_params);
             return { ...upload_info, rdma_reply: upload_res.rdma_reply };
         } catch (err) {
@@ -1971,6 +2025,7 @@ class NamespaceFS {
             let total_size = 0;
             const last_multipart_num = multiparts[multiparts.length - 1]?.num || 0;
             const is_non_continuous_upload = last_multipart_num !== multiparts.length;
+            const part_checksums = [];
             for (const { num, etag } of multiparts) {
                 const md_part_path = this._get_part_md_path({ ...params, num });
                 const md_part_stat = await nb_native().fs.stat(fs_context, md_part_path);
@@ -1980,6 +2035,7 @@ class NamespaceFS {
                     throw new Error('mismatch part etag: ' + util.inspect({ num, etag, md_part_path, md_part_stat, params }));
                 }
                 if (MD5Async) await MD5Async.update(Buffer.from(etag, 'hex'));
+                part_checksums.push({ num, size: part_size, xattr: md_part_stat.xattr });
 
                 const data_part_path = this._get_part_data_path({ ...params, size: part_size });
                 if (part_size_to_fd_map.has(part_size)) {
@@ -2035,6 +2091,15 @@ class NamespaceFS {
             upload_params.params.content_type = create_params_parsed.content_type;
             upload_params.params.content_encoding = create_params_parsed.content_encoding;
             upload_params.params.lock_settings = create_params_parsed.lock_settings;
+            if (create_params_parsed.checksum) {
+                const { algorithm, type } = create_params_parsed.checksum;
+                const checksum_type = type || s3_utils.default_multipart_checksum_type(algorithm);
+                const value_b64 = await this._combine_part_checksums(algorithm, checksum_type, part_checksums);
+                if (value_b64) {
+                    upload_params.checksums = { [algorithm]: value_b64 };
+                    upload_params.checksum_type = checksum_type;
+                }
+            }
             if (upload_params.params.lock_settings?.retention?.retain_until_date) {
                 upload_params.params.lock_settings.retention.retain_until_date =
                     new Date(upload_params.params.lock_settings.retention.retain_until_date);
@@ -2719,6 +2784,73 @@ class NamespaceFS {
         return fs_xattr;
     }
 
+    /**
+     * _assign_checksum_to_fs_xattr assigns the S3 flexible checksums xattrs
+     * @param {Record<string, string>} checksums base64 values by algorithm
+     * @param {nb.ChecksumType} [checksum_type] undefined for parts
+     * @param {nb.NativeFSXattr} fs_xattr
+     * @returns {nb.NativeFSXattr}
+     */
+    _assign_checksum_to_fs_xattr(checksums, checksum_type, fs_xattr) {
+        fs_xattr = fs_xattr || {};
+        for (const [algorithm, value_b64] of Object.entries(checksums)) {
+            fs_xattr[XATTR_CHECKSUM_PREFIX + algorithm.toLowerCase()] = value_b64;
+        }
+        if (checksum_type) fs_xattr[XATTR_CHECKSUM_TYPE] = checksum_type;
+        return fs_xattr;
+    }
+
+    /**
+     * _get_checksum_info returns the stored checksum in the shape of the S3 Checksum element
+     * @param {nb.NativeFSXattr} fs_xattr
+     * @returns {nb.Checksum}
+     */
+    _get_checksum_info(fs_xattr) {
+        let checksum;
+        for (const algorithm of s3_utils.CHECKSUM_ALGORITHMS) {
+            const value_b64 = fs_xattr?.[XATTR_CHECKSUM_PREFIX + algorithm.toLowerCase()];
+            if (value_b64) {
+                checksum = checksum || {};
+                checksum['Checksum' + algorithm] = value_b64;
+            }
+        }
+        if (checksum && fs_xattr[XATTR_CHECKSUM_TYPE]) checksum.ChecksumType = fs_xattr[XATTR_CHECKSUM_TYPE];
+        return checksum;
+    }
+
+    /**
+     * _combine_part_checksums computes the multipart checksum from the part checksums
+     * stored on the part md files, without reading the data again -
+     * COMPOSITE - checksum of the concatenated part checksums with a -<parts> suffix
+     * FULL_OBJECT - crc combine of the part crcs with the part sizes
+     * Returns undefined when one of the parts was uploaded without the checksum.
+     * @param {nb.ChecksumAlgorithm} algorithm
+     * @param {nb.ChecksumType} checksum_type
+     * @param {Array<{ num: number, size: number, xattr: nb.NativeFSXattr }>} parts
+     * @returns {Promise<string>}
+     */
+    async _combine_part_checksums(algorithm, checksum_type, parts) {
+        const xattr_key = XATTR_CHECKSUM_PREFIX + algorithm.toLowerCase();
+        const missing = parts.find(part => !part.xattr[xattr_key]);
+        if (missing) {
+            dbg.warn('_combine_part_checksums: part without checksum, skipping', algorithm, missing.num);
+            return;
+        }
+        const values = parts.map(part => Buffer.from(part.xattr[xattr_key], 'base64'));
+        if (checksum_type === 'FULL_OBJECT') {
+            const { checksum_combine } = nb_native().crypto;
+            let crc = values[0];
+            for (let i = 1; i < values.length; ++i) {
+                crc = checksum_combine(algorithm, crc, values[i], parts[i].size);
+            }
+            return crc.toString('base64');
+        }
+        const checksum = new (nb_native().crypto.ChecksumAsync)([algorithm]);
+        await checksum.update(values);
+        const digest = await checksum.digest();
+        return digest[algorithm].toString('base64') + '-' + parts.length;
+    }
+
     _assign_part_props_to_fs_xattr(size, digest, offset, fs_xattr) {
         fs_xattr = Object.assign(fs_xattr || {}, {
             [XATTR_PART_SIZE]: size,
@@ -2859,8 +2991,13 @@ class NamespaceFS {
      */
     async _is_disabled_content_dir(fs_context, file_path, key) {
         if (this._is_directory_content(file_path, key)) {
-            const stat = await native_fs_utils.stat_ignore_enoent(fs_context, path.dirname(file_path));
-            return Boolean(stat?.xattr[XATTR_DIR_CONTENT]);
+            // only the dir content xattr is read, the open still checks the read access like stat did
+            const stat = await native_fs_utils.statx_ignore_enoent(fs_context, path.dirname(file_path), {
+                mask: nb_native().fs.statx_mask.type,
+                read_xattr: true,
+                xattr_get_keys: [XATTR_DIR_CONTENT],
+            });
+            return Boolean(stat?.xattr?.[XATTR_DIR_CONTENT]);
         }
         return false;
     }
@@ -2966,6 +3103,7 @@ class NamespaceFS {
         const nc_noncurrent_time = (stat.xattr?.[XATTR_NON_CURRENT_TIMESTASMP] && Number(stat.xattr[XATTR_NON_CURRENT_TIMESTASMP])) ||
             stat.ctime.getTime();
         const lock_settings = this._lock_settings_from_fs_xattr(stat.xattr);
+        const checksum = this._get_checksum_info(stat.xattr);
 
         return {
             obj_id: etag,
@@ -2987,6 +3125,7 @@ class NamespaceFS {
             tagging: get_tags_from_xattr(stat.xattr),
             nc_noncurrent_time,
             lock_settings,
+            checksum,
 
             // temp:
             md5_b64: undefined,
@@ -3008,10 +3147,12 @@ class NamespaceFS {
     _get_upload_info(stat, version_id) {
         const etag = this._get_etag(stat);
         const encryption = this._get_encryption_info(stat);
+        const checksum = this._get_checksum_info(stat.xattr);
         return {
             etag,
             encryption,
             version_id,
+            checksum,
             size: stat.size
         };
     }
@@ -3103,8 +3244,11 @@ class NamespaceFS {
             let should_check_dir_path_is_content_dir = !deleted_file_is_dir && !deleted_file_is_dir_object;
             while (dir_path !== this.bucket_path) {
                 if (should_check_dir_path_is_content_dir) {
-                    const dir_stat = await nb_native().fs.stat(fs_context, dir_path);
-                    const file_is_disabled_dir_content = dir_stat.xattr && dir_stat.xattr[XATTR_DIR_CONTENT] !== undefined;
+                    const file_is_disabled_dir_content = await native_fs_utils.with_statx(fs_context, dir_path, {
+                        mask: nb_native().fs.statx_mask.type,
+                        read_xattr: true,
+                        xattr_get_keys: [XATTR_DIR_CONTENT],
+                    }, (out, ix, xattr) => xattr?.[XATTR_DIR_CONTENT] !== undefined);
                     if (file_is_disabled_dir_content) break;
                 }
                 await nb_native().fs.rmdir(fs_context, dir_path);
@@ -3179,7 +3323,7 @@ class NamespaceFS {
             }
             if (err.code === 'ENOENT' && !is_bucket_dir) {
                 // invalidate if dir
-                dir_cache.invalidate({ dir_path, fs_context });
+                get_dir_cache().invalidate(dir_path);
                 return false;
             }
             throw err;
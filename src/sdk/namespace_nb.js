@@ -127,7 +127,8 @@ class NamespaceNB {
 
     create_object_upload(params, object_sdk) {
         if (this.target_bucket) params = _.defaults({ bucket: this.target_bucket }, params);
-        return object_sdk.rpc_client.object.create_object_upload(params);
+        // flexible checksums are kept only by namespace fs
+        return object_sdk.rpc_client.object.create_object_upload(_.omit(params, 'checksum'));
     }
 
     upload_multipart(params, object_sdk) {
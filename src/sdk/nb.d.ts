@@ -1041,9 +1041,16 @@ interface AccountSpace {
 interface Native {
     chunk_splitter(state: ChunkSplitterState, buffers?: Buffer[], callback?: NodeCallback<number[]>);
     chunk_coder(coder: 'enc' | 'dec', chunk: Chunk, callback?: NodeCallback);
+    ChunkIngest: { new(options: ChunkIngestOptions): ChunkIngest };
+    buf_pool_stats(): BufPoolStats;
 
     b64_encode(input: Buffer): string;
     b64_decode(input_b64: string): Buffer;
+    b64_encode_bulk(inputs: Buffer[]): string[];
+    b64_decode_bulk(inputs_b64: (string | Buffer)[]): Buffer[];
+    hex_encode_bulk(inputs: Buffer[]): string[];
+    hex_decode_bulk(inputs_hex: (string | Buffer)[]): Buffer[];
+    b64_simd: 'avx2' | 'ssse3' | 'neon' | 'none';
 
     rand_seed(buffer: Buffer): void;
     set_fips_mode(is_fips_mode: boolean): void;
@@ -1054,13 +1061,25 @@ interface Native {
     syslog(level: number, message: string, facility?: 'LOG_LOCAL0' | 'LOG_LOCAL1' | 'LOG_LOCAL2');
     openlog(ident: string);
     closelog(): void;
-
-    Nudp: { new(): Nudp };
-    Ntcp: { new(): Ntcp };
+    // the async logger writes the queued lines from a native thread, log_async returns false when the line was dropped
+    log_async_init(capacity: number): void;
+    log_async(stderr_line: string | undefined, syslog_line: string | undefined,
+        level?: number, facility?: 'LOG_LOCAL0' | 'LOG_LOCAL1' | 'LOG_LOCAL2'): boolean;
+    log_async_flush(timeout_ms?: number): boolean;
+    log_async_stats(): { capacity: number, pushed: number, written: number, dropped: number, batches: number } | undefined;
+    // the writer takes no lines while held, exported only when NOOBAA_NATIVE_TEST_HOOKS is set (used by tests)
+    log_async_hold?(held: boolean): void;
+
+    Nudp: { new(options?: { gso?: boolean }): Nudp };
+    Ntcp: { new(): Ntcp; recv_stats(): NtcpRecvStats };
 
     MD5_MB: { new(): HasherSync };
     SHA1_MB: { new(): HasherSync };
-    crypto: { MD5Async: { new(): HasherAsync } };
+    crypto: {
+        MD5Async: { new(): HasherAsync };
+        ChecksumAsync: { new(algorithms: ChecksumAlgorithm[]): ChecksumAsync };
+        checksum_combine(algorithm: ChecksumAlgorithm, crc1: Buffer, crc2: Buffer, len2: number): Buffer;
+    };
 
     fs: NativeFS;
 
@@ -1070,11 +1089,21 @@ interface Native {
     CuObjServerNapi: { new(params: CuObjServerNapiParams): CuObjServerNapi };
     CuObjClientNapi: { new(): CuObjClientNapi };
     CudaMemory: { new(size: number): CudaMemory };
+
+    BlockContainer: { new(options: BlockContainerOptions): BlockContainer };
+    BlockScrubber: { new(options: BlockScrubberOptions): BlockScrubber };
+
+    RpcCodec: RpcCodecConstructor;
+
+    AwsChunkedDecoder: { new(options?: AwsChunkedDecoderOptions): AwsChunkedDecoder };
+    sigv4: NativeSigV4;
 }
 
 interface NativeFS {
     open(fs_context: NativeFSContext, path: string, flags?: string, mode?: number): Promise<NativeFile>;
     opendir(fs_context: NativeFSContext, path: string, flags?: string, mode?: number): Promise<NativeDir>;
+    open_bucket_root(fs_context: NativeFSContext, path: string): Promise<NativeBucketRoot>;
+    DirCache: { new(options?: { max_total_size?: number; max_dir_size?: number }): NativeDirCache };
 
     stat(
         fs_context: NativeFSContext,
@@ -1085,6 +1114,25 @@ interface NativeFS {
             xattr_get_keys?: string[];
         },
     ): Promise<NativeFSStats>;
+    // fills out by statx_index, and resolves to the xattr only with read_xattr (see native_fs_utils.statx)
+    statx(
+        fs_context: NativeFSContext,
+        path: string,
+        out: Float64Array,
+        options?: {
+            mask?: number;
+            use_lstat?: boolean;
+            dont_sync?: boolean;
+            read_xattr?: boolean;
+            skip_user_xattr?: boolean;
+            xattr_get_keys?: string[];
+        },
+    ): Promise<NativeFSXattr | undefined>;
+    statx_index: Record<'mask' | 'mode' | 'nlink' | 'uid' | 'gid' | 'ino' | 'size' | 'blocks' | 'dev' |
+        'atime_sec' | 'atime_nsec' | 'mtime_sec' | 'mtime_nsec' | 'ctime_sec' | 'ctime_nsec' |
+        'btime_sec' | 'btime_nsec' | 'count', number>;
+    statx_mask: Record<'type' | 'mode' | 'nlink' | 'uid' | 'gid' | 'atime' | 'mtime' | 'ctime' |
+        'ino' | 'size' | 'blocks' | 'basic' | 'btime', number>;
     statfs(fs_context: NativeFSContext, path: string): Promise<Record<string, number>>;
     realpath(fs_context: NativeFSContext, path: string): Promise<string>;
     checkAccess(fs_context: NativeFSContext, path: string): Promise<void>;
@@ -1112,7 +1160,8 @@ interface NativeFS {
         xattr_need_fsync?: boolean;
         xattr_clear_prefix?: string;
     }): Promise<void>;
-    fsync(fs_context: NativeFSContext, path: string): Promise<void>;
+    // with coalesce, concurrent fsyncs of the same inode share one fsync call
+    fsync(fs_context: NativeFSContext, path: string, options?: { coalesce?: boolean }): Promise<void>;
     fcntlgetlock(fs_context: NativeFSContext, path: string): Promise<LockType>;
 
     rename(fs_context: NativeFSContext, from_path: string, to_path: string): Promise<void>;
@@ -1122,11 +1171,35 @@ interface NativeFS {
     unlinkat(fs_context: NativeFSContext, path: string): Promise<void>;
     safe_link(fs_context: NativeFSContext, from_path: string, to_path: string, expect_mtime: bigint, expect_ino: number): Promise<void>;
     safe_unlink(fs_context: NativeFSContext, from_path: string, to_path: string, expect_mtime: bigint, expect_ino: number): Promise<void>;
+    // rename with RENAME_NOREPLACE, falls back to safe_link + safe_unlink (under tmp_dir/lost+found) when unsupported
+    safe_move(fs_context: NativeFSContext, from_path: string, to_path: string, expect_mtime: bigint, expect_ino: number, tmp_dir?: string): Promise<void>;
+    // rename with RENAME_EXCHANGE, fails with EINVAL when unsupported by the filesystem
+    safe_exchange(fs_context: NativeFSContext, path_a: string, path_b: string,
+        expect_a_mtime: bigint, expect_a_ino: number, expect_b_mtime: bigint, expect_b_ino: number): Promise<void>;
     symlink(fs_context: NativeFSContext, target: string, linkpath: string): Promise<void>;
 
     readdir(fs_context: NativeFSContext, path: string): Promise<fs.Dirent[]>;
     mkdir(fs_context: NativeFSContext, path: string, mode?: number): Promise<void>;
+    // resolves to the number of dirs created
+    mkdirp(fs_context: NativeFSContext, path: string, mode?: number, options?: { fsync?: boolean, use_cache?: boolean }): Promise<number>;
+    mkdirp_cache_stats(): { count: number, hits: number, misses: number };
+    fsync_coalescer_stats(): { requests: number, rounds: number, max_batch: number, inflight: number };
+    // rounds that start while held wait for the release before their fsync,
+    // exported only when NOOBAA_NATIVE_TEST_HOOKS is set (used by tests)
+    fsync_coalescer_hold?(held: boolean): void;
     rmdir(fs_context: NativeFSContext, path: string): Promise<void>;
+    // deletes the tree with up to concurrency threads, progress is a Float64Array indexed by remove_tree_index
+    remove_tree(fs_context: NativeFSContext, path: string,
+        options?: { concurrency?: number, progress?: Float64Array }): Promise<{ files: number, dirs: number }>;
+    remove_tree_index: Record<'files' | 'dirs' | 'cancel' | 'count', number>;
+    // writes the expiration candidates of every rule to its candidates_path in the mmapplypolicy list format
+    lifecycle_scan(fs_context: NativeFSContext, bucket_path: string,
+        rules: {
+            candidates_path: string, prefix?: string, days?: number,
+            size_greater_than?: number, size_less_than?: number, tags?: { key: string, value: string }[],
+        }[],
+        options?: { concurrency?: number, now?: number, mode?: number, exclude_root_prefix?: string },
+    ): Promise<{ files: number, dirs: number, skipped: number, candidates: number[] }>;
 
     dio_buffer_alloc(size: number): Buffer;
     set_debug_level(level: number);
@@ -1151,11 +1224,20 @@ interface NativeFile {
     close(fs_context: NativeFSContext): Promise<void>;
     stat(fs_context: NativeFSContext, options?: { skip_user_xattr?: boolean, xattr_get_keys?: string[] }): Promise<NativeFSStats>;
     read(fs_context: NativeFSContext, buffer: Buffer, offset: number, length: number, pos: number): Promise<number>;
+    read_lines(fs_context: NativeFSContext, buffer: Buffer, offset: number, length: number, pos: number): Promise<{ read: number, lines: Int32Array }>;
     write(fs_context: NativeFSContext, buffer: Buffer, len: number, offset?: number): Promise<void>;
     writev(fs_context: NativeFSContext, buffers: Buffer[], offset?: number): Promise<void>;
     replacexattr(fs_context: NativeFSContext, xattr: NativeFSXattr, clear_prefix?: string): Promise<void>;
     linkfileat(fs_context: NativeFSContext, path: string, fd?: number, should_not_override?: boolean): Promise<void>;
-    fsync(fs_context: NativeFSContext): Promise<void>;
+    // datasync uses fdatasync, which does not flush the attributes that are not needed to read the data
+    fsync(fs_context: NativeFSContext, options?: { datasync?: boolean }): Promise<void>;
+    // allocates the blocks of a range without changing the file size
+    fallocate(fs_context: NativeFSContext, offset: number, len: number): Promise<void>;
+    truncate(fs_context: NativeFSContext, len: number): Promise<void>;
+    // 'write' starts the writeback of the range, 'wait' also waits for it to complete
+    sync_range(fs_context: NativeFSContext, offset: number, len: number, mode?: 'write' | 'wait'): Promise<void>;
+    fadvise(fs_context: NativeFSContext, offset: number, len: number,
+        advice: 'normal' | 'sequential' | 'random' | 'willneed' | 'dontneed' | 'noreuse'): Promise<void>;
     fd: number;
     flock(fs_context: NativeFSContext, operation: "EXCLUSIVE" | "SHARED" | "UNLOCK"): Promise<void>;
     fcntllock(fs_context: NativeFSContext, operation: "EXCLUSIVE" | "SHARED" | "UNLOCK"): Promise<void>;
@@ -1195,6 +1277,43 @@ interface NativeDir {
     // TODO
 }
 
+/**
+ * The path ops of NativeFS on paths relative to a bucket root dir,
+ * failing with EXDEV on paths (or symlinks) that resolve outside of it.
+ */
+interface NativeBucketRoot extends Pick<NativeFS,
+    'open' | 'opendir' | 'stat' | 'statx' | 'checkAccess' | 'readFile' | 'writeFile' | 'fsync' |
+    'rename' | 'unlink' | 'readdir' | 'mkdir' | 'mkdirp' | 'rmdir'> {
+    // closes the root once the ops in flight complete, ops called after it reject with EBADF
+    close(fs_context: NativeFSContext): Promise<void>;
+    readonly fd: number;
+    readonly path: string;
+    // false when openat2 is not available and only lexical checks are done on the paths
+    readonly resolve_beneath: boolean;
+}
+
+interface NativeDirCache {
+    load(
+        fs_context: NativeFSContext,
+        path: string,
+        options?: { xattr_get_keys?: string[] },
+    ): Promise<{
+        stat: NativeFSStats;
+        cached: boolean;
+        // missing when the dir is larger than max_dir_size
+        listing?: NativeDirListing;
+    }>;
+    invalidate(path: string): void;
+    stats(): { count: number; total_size: number };
+}
+
+interface NativeDirListing {
+    readonly length: number;
+    upper_bound(marker: string): number;
+    lower_bound(prefix: string): number;
+    entries(start: number, options?: { prefix?: string; limit?: number }): { name: string; type: number }[];
+}
+
 interface NativeFSContext {
     uid?: number;
     gid?: number;
@@ -1220,6 +1339,30 @@ type NativeFSStats = fs.Stats & {
     xattr?: NativeFSXattr;
 };
 
+// the fields of native_fs_utils.statx() - only the fields in mask are set
+type NativeFSStatx = {
+    mask: number;
+    dev: number;
+    mode?: number;
+    nlink?: number;
+    uid?: number;
+    gid?: number;
+    ino?: number;
+    size?: number;
+    blocks?: number;
+    atimeMs?: number;
+    mtimeMs?: number;
+    ctimeMs?: number;
+    birthtimeMs?: number;
+    mtime?: Date;
+    ctime?: Date;
+    atimeNsBigint?: bigint;
+    mtimeNsBigint?: bigint;
+    ctimeNsBigint?: bigint;
+    birthtimeNsBigint?: bigint;
+    xattr?: NativeFSXattr;
+};
+
 type NativeFSUserObject = {
     uid: number;
     gid: number;
@@ -1236,16 +1379,77 @@ interface HasherAsync {
     digest(): Promise<Buffer>;
 }
 
+type ChecksumAlgorithm = 'CRC32' | 'CRC32C' | 'CRC64NVME' | 'SHA1' | 'SHA256';
+type ChecksumType = 'COMPOSITE' | 'FULL_OBJECT';
+
+interface ChecksumAsync {
+    update(buffers: Buffer | Buffer[]): Promise<void>;
+    digest(): Promise<{ [algorithm in ChecksumAlgorithm]?: Buffer }>;
+}
+
+/**
+ * S3 flexible checksum requested on upload - value_b64 is the client provided value
+ * to verify (base64 of the big endian checksum bytes) when sent as a header.
+ */
+interface ChecksumParams {
+    algorithm: ChecksumAlgorithm;
+    type?: ChecksumType;
+    value_b64?: string;
+}
+
+/**
+ * S3 flexible checksum of an object or part, in the shape of the S3 Checksum element.
+ * Composite multipart values have a -<parts> suffix.
+ */
+interface Checksum {
+    ChecksumCRC32?: string;
+    ChecksumCRC32C?: string;
+    ChecksumCRC64NVME?: string;
+    ChecksumSHA1?: string;
+    ChecksumSHA256?: string;
+    ChecksumType?: ChecksumType;
+}
+
 interface Nudp extends EventEmitter {
     close(): void;
     bind(port: number, address: string, callback: NodeCallback): void;
+    connect(port: number, address: string, callback: NodeCallback): void;
     send(msg: Buffer, callback: NodeCallback): void;
+    stats(): NudpStats | undefined;
+}
+
+interface NudpStats {
+    bytes_sent: number;
+    bytes_received: number;
+    packets_sent: number;
+    packets_received: number;
+    packets_received_dup: number;
+    retransmits: number;
+    retransmits_fast: number;
+    mtu_guess: number;
+    // udp packets and the send syscalls used for them (sendmmsg batches several packets)
+    udp_packets_sent: number;
+    udp_send_calls: number;
+    udp_gso: boolean;
+}
+
+interface NtcpRecvStats {
+    // receive chunks held only by message buffers that were not released yet
+    pinned_chunks: number;
+    max_pinned_chunks: number;
+    // small messages that were copied out since too many chunks were pinned
+    copied_msgs: number;
 }
 
 interface Ntcp extends EventEmitter {
     close(): void;
-    bind(port: number, address: string, callback: NodeCallback): void;
-    send(msg: Buffer, callback: NodeCallback): void;
+    bind(port: number, address: string): number;
+    listen(port: number, address: string): number;
+    connect(port: number, address: string, callback: NodeCallback<number>): number;
+    // writes queued while a previous write is inflight are coalesced to a single writev
+    write(msg: Buffer | Buffer[], callback?: NodeCallback): void;
+    on(event: 'messages', listener: (msgs: Buffer[]) => void): this;
+    on(event: string, listener: (...args: any[]) => void): this;
 }
 
 interface ChunkSplitterState {
@@ -1256,6 +1460,30 @@ interface ChunkSplitterState {
     calc_sha256: boolean;
 }
 
+interface ChunkIngestOptions extends ChunkSplitterState {
+    chunk_coder_config: ChunkCoderConfig;
+    cipher_key_b64?: string;
+}
+
+interface ChunkIngest {
+    // resolves to the chunks completed by these buffers, already encoded
+    push(buffers: Buffer | Buffer[]): Promise<ChunkInfo[]>;
+    finish(buffers?: Buffer | Buffer[]): Promise<{ chunks: ChunkInfo[], md5?: Buffer, sha256?: Buffer }>;
+}
+
+interface BufPoolStats {
+    allocs: number;
+    frees: number;
+    thread_hits: number;
+    depot_hits: number;
+    sys_allocs: number;
+    sys_frees: number;
+    cap_frees: number;
+    bytes_in_use: number;
+    bytes_cached: number;
+    max_cached_bytes: number;
+}
+
 interface X509Cert {
     key: string;
     cert: string;
@@ -1371,6 +1599,123 @@ interface CudaMemory {
     copy_from_host(buffer: Buffer, start?: number, end?: number): number;
 }
 
+/////////////////////
+// BLOCK CONTAINER //
+/////////////////////
+
+interface BlockContainerOptions {
+    dir: string;
+    segment_size?: number;
+    sync_bytes?: number;
+}
+
+interface BlockContainerStats {
+    count: number;
+    data_bytes: number;
+    total_bytes: number;
+    dead_bytes: number;
+    segments: number;
+    syncs: number;
+    compacted_segments: number;
+    compacted_bytes: number;
+    corrupt_bytes: number;
+    corrupt_segments: number;
+}
+
+interface BlockContainer {
+    open(): Promise<void>;
+    close(): Promise<void>;
+    // resolves to the data length of the overwritten block or -1
+    write(id: string, md: string, data: Buffer): Promise<number>;
+    read(id: string): Promise<{ md: string, data: Buffer } | null>;
+    // resolves to the data length of the deleted block or -1 if not found
+    delete(id: string): Promise<number>;
+    sync(checkpoint?: boolean): Promise<void>;
+    // resolves to the number of compacted segments
+    compact(min_dead_ratio?: number): Promise<number>;
+    stats(): BlockContainerStats;
+}
+
+interface BlockScrubberOptions {
+    md_xattr?: string;
+    io_bytes_per_sec?: number;
+    cpu_percent?: number;
+}
+
+interface BlockScrubberFailure {
+    path: string;
+    status: 'CORRUPT' | 'NO_MD' | 'SKIPPED' | 'FAILED';
+    size: number;
+    code?: string;
+}
+
+interface BlockScrubber {
+    // buffers should be allocated with fs.dio_buffer_alloc() to allow direct io
+    verify(paths: string[], buffers: Buffer[]): Promise<{
+        scanned: number;
+        bytes: number;
+        throttle_ms: number;
+        failures: BlockScrubberFailure[];
+    }>;
+    stats(): {
+        blocks: number;
+        bytes: number;
+        corrupt: number;
+        no_md: number;
+        skipped: number;
+        failed: number;
+        wall_usec: number;
+        cpu_usec: number;
+    };
+}
+
+interface RpcCodecConstructor {
+    // strings are interned - object keys and string values in the list are encoded by index
+    new(strings: string[]): NativeRpcCodec;
+}
+
+interface NativeRpcCodec {
+    // header_len bytes are reserved (zeroed) at the start of the returned buffer
+    encode(body: any, header_len?: number): Buffer;
+    decode(buffer: Buffer): any;
+}
+
+interface ChunkSigningParams {
+    signing_key: Buffer;
+    timestamp: string; // x-amz-date
+    scope: string; // <date>/<region>/<service>/aws4_request
+    seed_signature: string;
+    signed_trailer: boolean; // STREAMING-AWS4-HMAC-SHA256-PAYLOAD-TRAILER requires x-amz-trailer-signature
+}
+
+// sigv4 signatures with a cache of the derived signing keys per (access key, date, region, service)
+interface NativeSigV4 {
+    signature(access_key: string, secret: string, xamzdate: string, region: string, service: string,
+        string_to_sign: string): string;
+    verify(access_key: string, secret: string, xamzdate: string, region: string, service: string,
+        string_to_sign: string, signature: string): boolean;
+    signing_key(access_key: string, secret: string, date: string, region: string, service: string): Buffer;
+    cache_stats(): { count: number, hits: number, misses: number };
+}
+
+interface AwsChunkedDecoderOptions extends Partial<ChunkSigningParams> {
+    checksum_trailer?: string; // x-amz-trailer header
+}
+
+interface AwsChunkedDecoder {
+    // returns [start, end, start, end, ...] offsets of the decoded payload in buf,
+    // throws on parse or verification error with err.index set to the failing buffer index.
+    update(buf: Buffer): number[];
+    info(): {
+        state: string;
+        chunk_header: string;
+        chunk_size: number;
+        last_chunk: boolean;
+        trailer: string;
+        trailers: string[];
+    };
+}
+
 type NodeCallback<T = void> = (err: Error | null, res?: T) => void;
 
 type RestoreState = 'CAN_RESTORE' | 'ONGOING' | 'RESTORED';
@@ -9,6 +9,7 @@ const dbg = require('../util/debug_module')(__filename);
 const config = require('../../config');
 const semaphore = require('../util/semaphore');
 const ChunkCoder = require('../util/chunk_coder');
+const ChunkIngest = require('../util/chunk_ingest');
 const range_utils = require('../util/range_utils');
 const buffer_utils = require('../util/buffer_utils');
 const stream_utils = require('../util/stream_utils');
@@ -374,26 +375,42 @@ class ObjectIO {
         complete_params.size = 0;
         complete_params.num_parts = 0;
 
+        const calc_md5 = Boolean(config.IO_CALC_MD5_ENABLED);
+        const calc_sha256 = Boolean(config.IO_CALC_SHA256_ENABLED && params.sha256_b64);
+        // TODO: Load the key from KMS as well
+        const cipher_key_b64 = params.encryption && params.encryption.key_b64;
+
+        // The ingest transformer does the splitter + coder work below in a single native stage
+        const ingest = config.IO_NATIVE_INGEST_ENABLED ? new ChunkIngest({
+            watermark: 50,
+            concurrency: 20,
+            calc_md5,
+            calc_sha256,
+            chunk_split_config: params.chunk_split_config,
+            chunk_coder_config: params.chunk_coder_config,
+            cipher_key_b64,
+        }) : null;
+        if (ingest) ingest.on('error', err1 => dbg.error('object_io._upload_stream_internal: error occured on stream ChunkIngest: ', err1));
+
         // The splitter transformer is responsible for splitting the stream into chunks
         // and also calculating the md5/sha256 of the entire stream as needed for the protocol.
-        const splitter = new ChunkSplitter({
+        const splitter = ingest ? null : new ChunkSplitter({
             watermark: 50,
-            calc_md5: Boolean(config.IO_CALC_MD5_ENABLED),
-            calc_sha256: Boolean(config.IO_CALC_SHA256_ENABLED && params.sha256_b64),
+            calc_md5,
+            calc_sha256,
             chunk_split_config: params.chunk_split_config,
         });
-        splitter.on('error', err1 => dbg.error('object_io._upload_stream_internal: error occured on stream Splitter: ', err1));
+        if (splitter) splitter.on('error', err1 => dbg.error('object_io._upload_stream_internal: error occured on stream Splitter: ', err1));
 
         // The coder transformer is responsible for digest & compress & encrypt & erasure coding
-        const coder = new ChunkCoder({
+        const coder = ingest ? null : new ChunkCoder({
             watermark: 50,
             concurrency: 20,
             coder: 'enc',
             chunk_coder_config: params.chunk_coder_config,
-            // TODO: Load the key from KMS as well
-            cipher_key_b64: params.encryption && params.encryption.key_b64
+            cipher_key_b64,
         });
-        coder.on('error', err1 => dbg.error('object_io._upload_stream_internal: error occured on stream ChunkCoder: ', err1));
+        if (coder) coder.on('error', err1 => dbg.error('object_io._upload_stream_internal: error occured on stream ChunkCoder: ', err1));
 
         const coalescer = new CoalesceStream({
             objectMode: true,
@@ -414,8 +431,7 @@ class ObjectIO {
         uploader.on('error', err1 => dbg.error('object_io._upload_stream_internal: error occured on stream Uploader: ', err1));
 
         const transforms = [params.source_stream,
-            splitter,
-            coder,
+            ...(ingest ? [ingest] : [splitter, coder]),
             coalescer,
             uploader,
         ];
@@ -424,8 +440,9 @@ class ObjectIO {
         // Explicitly wait for finish as a defensive measure although pipeline should do it
         await stream.promises.finished(uploader);
 
-        if (splitter.md5) complete_params.md5_b64 = splitter.md5.toString('base64');
-        if (splitter.sha256) complete_params.sha256_b64 = splitter.sha256.toString('base64');
+        const digester = ingest || splitter;
+        if (digester.md5) complete_params.md5_b64 = digester.md5.toString('base64');
+        if (digester.sha256) complete_params.sha256_b64 = digester.sha256.toString('base64');
     }
 
 
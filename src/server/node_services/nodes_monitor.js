@@ -949,11 +949,50 @@ class NodesMonitor extends EventEmitter {
             }
 
         }
+        if (info.corrupt_block_ids && info.corrupt_block_ids.length) {
+            // rebuild in background
+            this._rebuild_corrupt_blocks(item, info.corrupt_block_ids);
+        }
         const updates = _.pick(info, AGENT_INFO_FIELDS);
         updates.heartbeat = Date.now();
         return updates;
     }
 
+    /**
+     * _rebuild_corrupt_blocks handles blocks that the agent found corrupt.
+     * The blocks are marked deleted and their chunks are rebuilt, so the lost frags
+     * are recreated from the healthy blocks, and the agent blocks reclaimer removes
+     * the corrupt blocks from the node (which also stops the agent from reporting them).
+     * @param {Object} item
+     * @param {string[]} corrupt_block_ids
+     */
+    async _rebuild_corrupt_blocks(item, corrupt_block_ids) {
+        if (item.rebuilding_corrupt_blocks) return;
+        item.rebuilding_corrupt_blocks = true;
+        try {
+            const block_ids = corrupt_block_ids
+                .filter(id => MDStore.instance().is_valid_md_id(id))
+                .map(id => MDStore.instance().make_md_id(id));
+            const blocks = await MDStore.instance().find_node_blocks_by_ids(item.node._id, block_ids);
+            if (!blocks.length) return;
+            dbg.warn('_rebuild_corrupt_blocks: node', item.node.name,
+                'reported corrupt blocks', blocks.length, 'of', corrupt_block_ids.length);
+            await MDStore.instance().delete_blocks_by_ids(blocks.map(block => block._id));
+            await this.client.scrubber.build_chunks({
+                chunk_ids: _.uniqBy(blocks.map(block => block.chunk), String),
+            }, {
+                auth_token: auth_server.make_auth_token({
+                    system_id: String(item.node.system),
+                    role: 'admin'
+                })
+            });
+        } catch (err) {
+            dbg.error('_rebuild_corrupt_blocks: failed for node', item.node.name, err);
+        } finally {
+            item.rebuilding_corrupt_blocks = false;
+        }
+    }
+
     _handle_agent_response(item, info) {
         const updates = this._handle_agent_metrics(item, info);
         // node name is set once before the node is created in nodes_store
@@ -2401,6 +2401,22 @@ class MDStore {
         return db_client.instance().uniq_ids(blocks, 'chunk');
     }
 
+    /**
+     * @param {nb.ID} node_id
+     * @param {nb.ID[]} block_ids
+     * @returns {Promise<nb.BlockSchemaDB[]>}
+     */
+    async find_node_blocks_by_ids(node_id, block_ids) {
+        if (!block_ids || !block_ids.length) return [];
+        return this._blocks.find({
+            _id: { $in: block_ids },
+            node: { $eq: node_id, $exists: true },
+            deleted: null,
+        }, {
+            projection: { _id: 1, chunk: 1 },
+        });
+    }
+
     /**
      * @param {nb.ID[]} node_ids
      * @returns {Promise<number>}
@@ -2,6 +2,8 @@
 'use strict';
 
 const _ = require('lodash');
+const v8 = require('v8');
+const vm = require('vm');
 const mocha = require('mocha');
 const stream = require('stream');
 const crypto = require('crypto');
@@ -12,6 +14,7 @@ const config = require('../../../../config');
 const nb_native = require('../../../util/nb_native');
 const RandStream = require('../../../util/rand_stream');
 const ChunkCoder = require('../../../util/chunk_coder');
+const ChunkIngest = require('../../../util/chunk_ingest');
 const ChunkEraser = require('../../../util/chunk_eraser');
 const Speedometer = require('../../../util/speedometer');
 const stream_utils = require('../../../util/stream_utils');
@@ -52,6 +55,8 @@ const FRAG_DIGEST_TYPES = [
 const COMPRESS_TYPES = [
     'snappy',
     'zlib',
+    'igzip-l1',
+    'igzip-l3',
     undefined,
 ];
 const CIPHER_TYPES = [
@@ -148,11 +153,99 @@ mocha.describe('nb_native chunk_coder', function() {
                         chunk_coder_config,
                     });
                 });
+
+                mocha.it(desc + 'ingest/', function() {
+                    return test_stream({
+                        ingest: true,
+                        erase: true,
+                        decode: true,
+                        generator: 'fake',
+                        input_size: chunk_split_config.input,
+                        chunk_split_config,
+                        chunk_coder_config,
+                    });
+                });
             }));
+
+        mocha.it('ingest-same-as-splitter-and-coder', async function() {
+            const chunk_split_config = {
+                avg_chunk: config.CHUNK_SPLIT_AVG_CHUNK,
+                delta_chunk: config.CHUNK_SPLIT_DELTA_CHUNK,
+            };
+            // no cipher so that the frags are deterministic
+            const chunk_coder_config = {
+                digest_type: 'sha384',
+                frag_digest_type: 'sha1',
+                compress_type: 'snappy',
+                data_frags: 4,
+                parity_frags: 2,
+                parity_type: 'isa-c1',
+            };
+            const data = crypto.randomBytes(Math.floor(config.CHUNK_SPLIT_AVG_CHUNK * 5.3));
+            const buffers = [];
+            for (let pos = 0; pos < data.length;) {
+                const len = chance.integer({ min: 1, max: 512 * 1024 });
+                buffers.push(data.subarray(pos, pos + len));
+                pos += len;
+            }
+            const collect = async transforms => {
+                const chunks = [];
+                await stream_utils.pipeline([
+                    stream.Readable.from(buffers),
+                    ...transforms,
+                    new stream.Writable({
+                        objectMode: true,
+                        write(chunk, encoding, callback) {
+                            chunks.push({
+                                ..._.pick(chunk, 'pos', 'size', 'frag_size', 'compress_size', 'digest_b64'),
+                                frags: chunk.frags.map(frag => _.pick(frag, 'data', 'digest_b64')),
+                            });
+                            callback();
+                        }
+                    }),
+                ]);
+                return chunks;
+            };
+            const splitter = new ChunkSplitter({ watermark: 100, calc_md5: true, calc_sha256: true, chunk_split_config });
+            const expected = await collect([
+                splitter,
+                new ChunkCoder({ watermark: 20, concurrency: 20, coder: 'enc', chunk_coder_config }),
+            ]);
+            const ingest = new ChunkIngest({ watermark: 20, concurrency: 20, calc_md5: true, calc_sha256: true, chunk_split_config, chunk_coder_config });
+            const actual = await collect([ingest]);
+            assert.deepStrictEqual(actual, expected);
+            assert.deepStrictEqual(ingest.md5, splitter.md5);
+            assert.deepStrictEqual(ingest.sha256, splitter.sha256);
+        });
     });
 
     mocha.describe('coding', function() {
 
+        mocha.it('leases-frags-from-buf-pool', async function() {
+            const gc = expose_gc();
+            const before = nb_native().buf_pool_stats();
+            let chunks = _.times(10, () => prepare_chunk(CHUNK_CODER_CONFIGS[0]));
+            for (const chunk of chunks) call_chunk_coder_must_succeed('dec', chunk);
+            const leased = nb_native().buf_pool_stats();
+            // every frag and the decoded data are pool buffers,
+            // returned only when the js buffers are collected
+            assert(leased.allocs - before.allocs >= (chunks[0].frags.length + 1) * chunks.length);
+            assert(leased.frees <= leased.allocs);
+
+            chunks = null;
+            const released = await collect_pool_buffers(gc, leased.frees);
+            assert(released.frees > leased.frees, 'collected js buffers should return their leases');
+            assert(released.bytes_cached > 0);
+            assert(released.bytes_cached <= released.max_cached_bytes);
+
+            // the next leases of this thread are served from the blocks that were returned
+            const chunk = prepare_chunk(CHUNK_CODER_CONFIGS[0]);
+            call_chunk_coder_must_succeed('dec', chunk);
+            const reused = nb_native().buf_pool_stats();
+            const hits = (reused.thread_hits + reused.depot_hits) - (released.thread_hits + released.depot_hits);
+            assert(hits >= chunk.frags.length + 1, `expected reused leases, got ${hits} hits`);
+        });
+
         CHUNK_CODER_CONFIGS.forEach(chunk_coder_config => {
             const desc = `/${chunk_coder_config.digest_type}` +
                 `/${chunk_coder_config.frag_digest_type}` +
@@ -187,6 +280,25 @@ mocha.describe('nb_native chunk_coder', function() {
                     });
                 }
 
+                if (chunk_coder_config.parity_frags) {
+                    mocha.it('decodes-from-first-k-frags-that-arrive', function() {
+                        const chunk = prepare_chunk(chunk_coder_config);
+                        // frags arrive in random order, like hedged reads do,
+                        // and decoding succeeds once any data_frags of them are available
+                        const frags = chance.shuffle(chunk.frags);
+                        const frags_data = frags.map(f => f.data);
+                        for (const f of frags) f.data = undefined;
+                        for (let i = 0; i < frags.length; ++i) {
+                            frags[i].data = frags_data[i];
+                            if (i + 1 < chunk_coder_config.data_frags) {
+                                call_chunk_coder_must_fail('dec', chunk);
+                            } else {
+                                call_chunk_coder_must_succeed('dec', chunk);
+                            }
+                        }
+                    });
+                }
+
                 if (chunk_coder_config.digest_type) {
                     mocha.it('detects-mismatch-chunk-digest', function() {
                         const chunk = prepare_chunk(chunk_coder_config);
@@ -203,12 +315,42 @@ mocha.describe('nb_native chunk_coder', function() {
                         call_chunk_coder_must_fail('dec', chunk);
                         if (!chunk_coder_config.compress_type) {
                             assert(chunk.errors[0].startsWith('Chunk Decoder: chunk digest mismatch') ||
-                                chunk.errors[0].startsWith('Chunk Decoder: cipher decrypt final failed'),
+                                chunk.errors[0].startsWith('Chunk Decoder: cipher auth tag mismatch'),
                                 'expected error: chunk digest mismatch. got: ' + chunk.errors[0]);
                         }
                     });
                 }
 
+                if (chunk_coder_config.cipher_type) {
+                    mocha.it('detects-mismatch-cipher-auth-tag', function() {
+                        const chunk = prepare_chunk(chunk_coder_config);
+                        assert.strictEqual(Buffer.from(chunk.cipher_auth_tag_b64, 'base64').length, 16);
+                        call_chunk_coder_must_succeed('dec', chunk);
+                        const tag = Buffer.from(chunk.cipher_auth_tag_b64, 'base64');
+                        tag.writeUInt8((tag.readUInt8(0) + 1) % 256, 0);
+                        chunk.cipher_auth_tag_b64 = tag.toString('base64');
+                        call_chunk_coder_must_fail('dec', chunk);
+                        assert(chunk.errors[0].startsWith('Chunk Decoder: cipher auth tag mismatch'),
+                            'expected error: cipher auth tag mismatch. got: ' + chunk.errors[0]);
+                    });
+
+                    mocha.it('rejects-truncated-cipher-auth-tag', function() {
+                        // a prefix of the right tag would authenticate the chunk with only a few guessed bytes
+                        const chunk = prepare_chunk(chunk_coder_config);
+                        chunk.cipher_auth_tag_b64 = Buffer.from(chunk.cipher_auth_tag_b64, 'base64').subarray(0, 1).toString('base64');
+                        call_chunk_coder_must_fail('dec', chunk);
+                        assert(chunk.errors[0].startsWith('Chunk Decoder: cipher auth tag length 1 is invalid'),
+                            'expected error: cipher auth tag length 1 is invalid. got: ' + chunk.errors[0]);
+                    });
+
+                    mocha.it('decodes-chunks-without-cipher-auth-tag', function() {
+                        // chunks written before the tag was stored are verified by the chunk digest
+                        const chunk = prepare_chunk(chunk_coder_config);
+                        delete chunk.cipher_auth_tag_b64;
+                        call_chunk_coder_must_succeed('dec', chunk);
+                    });
+                }
+
                 mocha.it('detects-mismatch-frag-size', function() {
                     const chunk = prepare_chunk(chunk_coder_config);
                     // change size of up to parity_frags of the fragments, but fix the digest
@@ -252,7 +394,7 @@ mocha.describe('nb_native chunk_coder', function() {
     });
 });
 
-async function test_stream({ erase, decode, generator, input_size, chunk_split_config, chunk_coder_config }) {
+async function test_stream({ ingest, erase, decode, generator, input_size, chunk_split_config, chunk_coder_config }) {
     try {
         const speedometer = new Speedometer({ name: 'Chunk Coder Speed' });
 
@@ -307,10 +449,20 @@ async function test_stream({ erase, decode, generator, input_size, chunk_split_c
         });
 
         /** @type {(stream.Readable | stream.Transform | stream.Writable)[]} */
-        const transforms = [input,
-            splitter,
-            coder,
-        ];
+        const transforms = [input];
+        if (ingest) {
+            transforms.push(new ChunkIngest({
+                watermark: 20,
+                concurrency: 20,
+                calc_md5: true,
+                calc_sha256: false,
+                chunk_split_config,
+                chunk_coder_config,
+            }));
+        } else {
+            transforms.push(splitter);
+            transforms.push(coder);
+        }
         if (erase) transforms.push(eraser);
         if (decode) {
             transforms.push(decoder);
@@ -323,6 +475,22 @@ async function test_stream({ erase, decode, generator, input_size, chunk_split_c
     }
 }
 
+function expose_gc() {
+    v8.setFlagsFromString('--expose-gc');
+    return vm.runInNewContext('gc');
+}
+
+// pool buffers are returned by the finalizers of the js buffers, which can run after the gc call
+async function collect_pool_buffers(gc, frees) {
+    for (let i = 0; i < 10; ++i) {
+        gc();
+        await new Promise(resolve => setImmediate(resolve));
+        const stats = nb_native().buf_pool_stats();
+        if (stats.frees > frees) return stats;
+    }
+    return nb_native().buf_pool_stats();
+}
+
 function call_chunk_coder_must_succeed(coder, chunk) {
     try {
         nb_native().chunk_coder(coder, chunk);
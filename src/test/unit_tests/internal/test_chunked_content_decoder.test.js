@@ -3,6 +3,7 @@
 
 const stream = require('stream');
 const assert = require('assert');
+const crypto = require('crypto');
 const ChunkedContentDecoder = require('../../../util/chunked_content_decoder');
 const buffer_utils = require('../../../util/buffer_utils');
 
@@ -29,6 +30,16 @@ describe('ChunkedContentDecoder', function() {
     const NUMBER_OF_ITERATIONS_IMPORTANT_CASE = 100;
     const NUMBER_OF_ITERATIONS_DEFAULT = 2;
 
+    const hmac = (key, data) => crypto.createHmac('sha256', key).update(data).digest();
+    const sha256 = data => crypto.createHash('sha256').update(data).digest('hex');
+    const SIGNING = {
+        signing_key: hmac(hmac(hmac(hmac('AWS4secret', '20250101'), 'us-east-1'), 's3'), 'aws4_request'),
+        timestamp: '20250101T000000Z',
+        scope: '20250101/us-east-1/s3/aws4_request',
+        seed_signature: sha256('seed'),
+        signed_trailer: true,
+    };
+
     describe('expected to parse the input', function() {
         test_parse_output({
             name: 'one_chunk',
@@ -154,6 +165,25 @@ describe('ChunkedContentDecoder', function() {
             iterations: NUMBER_OF_ITERATIONS_IMPORTANT_CASE,
         });
 
+        test_parse_output({
+            name: 'signed_trailer',
+            input: create_signed_input('foo', ['x-trailer-1:value'], true),
+            params: { signing: SIGNING },
+            output: 'foo',
+        });
+
+        test_parse_error({
+            name: 'signed_trailer_without_signature',
+            input: create_signed_input('foo', ['x-trailer-1:value'], false),
+            params: { signing: SIGNING },
+        });
+
+        test_parse_error({
+            name: 'signed_trailer_without_trailers',
+            input: create_signed_input('foo', [], false),
+            params: { signing: SIGNING },
+        });
+
         test_parse_error({
             name: 'too_many_trailers', // according to MAX_CHUNK_HEADER_SIZE
             input:
@@ -174,13 +204,14 @@ describe('ChunkedContentDecoder', function() {
      *      input: string,
      *      output: string,
      *      iterations?: number
+     *      params?: object,
      *      check?: (decoder: ChunkedContentDecoder) => void,
      * }} params
      */
-    function test_parse_output({ name, input, output, check, iterations = NUMBER_OF_ITERATIONS_DEFAULT}) {
+    function test_parse_output({ name, input, output, check, params, iterations = NUMBER_OF_ITERATIONS_DEFAULT}) {
         it(name, async function() {
             for (let i = 0; i < iterations; ++i) {
-                const decoder = new ChunkedContentDecoder();
+                const decoder = new ChunkedContentDecoder(params);
                 console.log(`test_parse_output(${name}): decoder input`, input, decoder.get_debug_info());
                 const readable = new stream.Readable({
                     read() {
@@ -207,12 +238,13 @@ describe('ChunkedContentDecoder', function() {
      *      input: string,
      *      error_pos?: number,
      *      iterations?: number
+     *      params?: object,
      * }} params
      */
-    function test_parse_error({ name, input, error_pos, iterations = NUMBER_OF_ITERATIONS_DEFAULT }) {
+    function test_parse_error({ name, input, error_pos, params, iterations = NUMBER_OF_ITERATIONS_DEFAULT }) {
         it(name, async function() {
             for (let i = 0; i < iterations; ++i) {
-                const decoder = new ChunkedContentDecoder();
+                const decoder = new ChunkedContentDecoder(params);
                 console.log(`test_parse_error(${name}): decoder input`, input, decoder.get_debug_info());
                 console.log(name, 'decode', decoder);
                 try {
@@ -256,4 +288,31 @@ describe('ChunkedContentDecoder', function() {
         return trailers.join('');
     }
 
+    /**
+     * create_signed_input will return a streaming sigv4 payload of a single chunk signed with SIGNING
+     * @param {string} data
+     * @param {string[]} trailers
+     * @param {boolean} trailer_signature add x-amz-trailer-signature after the trailers
+     * @returns string
+     */
+    function create_signed_input(data, trailers, trailer_signature) {
+        const EMPTY_SHA256 = sha256('');
+        let prev = SIGNING.seed_signature;
+        const sign = (algorithm, ...hashes) => {
+            prev = hmac(SIGNING.signing_key, [algorithm, SIGNING.timestamp, SIGNING.scope, prev, ...hashes].join('\n'))
+                .toString('hex');
+            return prev;
+        };
+        const chunk_signature = sign('AWS4-HMAC-SHA256-PAYLOAD', EMPTY_SHA256, sha256(data));
+        const last_chunk_signature = sign('AWS4-HMAC-SHA256-PAYLOAD', EMPTY_SHA256, EMPTY_SHA256);
+        let input = `${data.length.toString(16)};chunk-signature=${chunk_signature}\r\n${data}\r\n` +
+            `0;chunk-signature=${last_chunk_signature}\r\n`;
+        for (const trailer of trailers) input += `${trailer}\r\n`;
+        if (trailer_signature) {
+            const canonical = trailers.map(trailer => trailer + '\n').join('');
+            input += `x-amz-trailer-signature:${sign('AWS4-HMAC-SHA256-TRAILER', sha256(canonical))}\r\n`;
+        }
+        return input + '\r\n';
+    }
+
 });
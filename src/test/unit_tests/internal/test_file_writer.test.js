@@ -4,6 +4,8 @@
 const config = require('../../../../config');
 const file_writer_hashing = require('../../../tools/file_writer_hashing');
 const orig_iov_max = config.NSFS_DEFAULT_IOV_MAX;
+const orig_preallocate_min_size = config.NSFS_WRITE_PREALLOCATE_MIN_SIZE;
+const orig_write_behind_size = config.NSFS_WRITE_BEHIND_SIZE;
 
 // CI-friendly scale: enough concurrency to exercise FileWriter without multi-minute runs.
 const default_num_parts = 50;
@@ -18,6 +20,8 @@ describe('FileWriter', () => {
 
     afterEach(() => {
         config.NSFS_DEFAULT_IOV_MAX = orig_iov_max;
+        config.NSFS_WRITE_PREALLOCATE_MIN_SIZE = orig_preallocate_min_size;
+        config.NSFS_WRITE_BEHIND_SIZE = orig_write_behind_size;
     });
 
     it('Concurrent FileWriter with hash target', async () => {
@@ -28,6 +32,12 @@ describe('FileWriter', () => {
         await file_writer_hashing.file_target(undefined, default_num_parts, undefined, default_part_size);
     }, RUN_TIMEOUT);
 
+    it('Concurrent FileWriter with file target - preallocate and write behind', async () => {
+        config.NSFS_WRITE_PREALLOCATE_MIN_SIZE = 1024 * 1024;
+        config.NSFS_WRITE_BEHIND_SIZE = 256 * 1024;
+        await file_writer_hashing.file_target(undefined, small_iov_num_parts, undefined, default_part_size);
+    }, RUN_TIMEOUT);
+
     it('Concurrent FileWriter with hash target - iov_max=1', async () => {
         await file_writer_hashing.hash_target(undefined, small_iov_num_parts, 1, default_part_size);
     }, RUN_TIMEOUT);
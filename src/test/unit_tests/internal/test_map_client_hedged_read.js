@@ -0,0 +1,113 @@
+/* Copyright (C) 2016 NooBaa */
+'use strict';
+
+const mocha = require('mocha');
+const assert = require('assert');
+
+const config = require('../../../../config');
+const { MapClient } = require('../../../sdk/map_client');
+
+const GOOD = Buffer.from('good');
+const CORRUPT = Buffer.from('corrupt');
+
+/**
+ * Returns a map client that reads frags from a table of scripted reads instead of blocks,
+ * and decodes a chunk only when all its data frags arrived uncorrupted.
+ */
+function new_scripted_map_client(reads, on_decode) {
+    const stats = { num_decodes: 0, reads: [] };
+    class ScriptedMapClient extends MapClient {
+        async read_frag(frag, chunk) {
+            stats.reads.push(frag.frag_name);
+            frag.data = await reads[frag.frag_name]();
+        }
+        async decode_chunk(chunk) {
+            stats.num_decodes += 1;
+            // decodes the frags that arrived before the decode started
+            const data = chunk.frags.filter(frag => frag.data_index >= 0).map(frag => frag.data);
+            if (on_decode) await on_decode(stats.num_decodes);
+            if (!data.every(d => d === GOOD)) throw new Error('scripted decode error');
+            chunk.data = Buffer.concat(data);
+        }
+    }
+    return { mc: new ScriptedMapClient({}), stats };
+}
+
+function defer() {
+    let resolve;
+    const promise = new Promise(r => { resolve = r; });
+    return { promise, resolve };
+}
+
+function new_chunk(data_frags, parity_frags) {
+    const frags = [];
+    for (let i = 0; i < data_frags; ++i) frags.push({ frag_name: `d${i}`, data_index: i });
+    for (let i = 0; i < parity_frags; ++i) frags.push({ frag_name: `p${i}`, parity_index: i });
+    return {
+        chunk_coder_config: { data_frags, parity_frags },
+        frags,
+        data_frags: frags.slice(0, data_frags),
+        parity_frags: frags.slice(data_frags),
+    };
+}
+
+mocha.describe('map_client hedged read', function() {
+
+    const saved_initial_delay = config.IO_READ_HEDGE_INITIAL_DELAY_MS;
+
+    mocha.before(function() {
+        config.IO_READ_HEDGE_INITIAL_DELAY_MS = config.IO_READ_HEDGE_MIN_DELAY_MS;
+    });
+
+    mocha.after(function() {
+        config.IO_READ_HEDGE_INITIAL_DELAY_MS = saved_initial_delay;
+    });
+
+    mocha.it('decodes from the data frags when they arrive', async function() {
+        const chunk = new_chunk(2, 1);
+        const { mc, stats } = new_scripted_map_client({
+            d0: async () => GOOD,
+            d1: async () => GOOD,
+            p0: async () => GOOD,
+        });
+        await mc.read_chunk_data_hedged(chunk, chunk.data_frags, chunk.parity_frags);
+        assert(chunk.data.equals(Buffer.concat([GOOD, GOOD])));
+        assert.strictEqual(stats.num_decodes, 1);
+        assert.deepStrictEqual(stats.reads, ['d0', 'd1']);
+    });
+
+    mocha.it('decodes again with a late good frag that arrived during a failed decode', async function() {
+        const chunk = new_chunk(2, 1);
+        const late_d1 = defer();
+        // d1 is slow so the hedge reads the corrupt p0, and d1 arrives while decoding d0+p0 fails,
+        // which leaves no pending reads and no spare frags once the decode error is handled.
+        const { mc, stats } = new_scripted_map_client({
+            d0: async () => GOOD,
+            d1: () => late_d1.promise,
+            p0: async () => CORRUPT,
+        }, async num_decodes => {
+            if (num_decodes !== 1) return;
+            late_d1.resolve(GOOD);
+            await new Promise(resolve => setImmediate(resolve));
+        });
+        await mc.read_chunk_data_hedged(chunk, chunk.data_frags, chunk.parity_frags);
+        assert(chunk.data.equals(Buffer.concat([GOOD, GOOD])));
+        assert.strictEqual(stats.num_decodes, 2);
+        assert.deepStrictEqual(stats.reads, ['d0', 'd1', 'p0']);
+    });
+
+    mocha.it('fails when no more frags can arrive', async function() {
+        const chunk = new_chunk(2, 1);
+        const { mc, stats } = new_scripted_map_client({
+            d0: async () => GOOD,
+            d1: async () => CORRUPT,
+            p0: async () => CORRUPT,
+        });
+        await assert.rejects(
+            mc.read_chunk_data_hedged(chunk, chunk.data_frags, chunk.parity_frags),
+            /scripted decode error/
+        );
+        assert.strictEqual(stats.num_decodes, 2);
+    });
+
+});
@@ -1,6 +1,10 @@
 /* Copyright (C) 2024 NooBaa */
 'use strict';
 
+const os = require('os');
+const fs = require('fs');
+const path = require('path');
+const nb_native = require('../../../util/nb_native');
 const { NewlineReader } = require("../../../util/file_reader");
 
 /**
@@ -21,6 +25,25 @@ function mocked_file_handler(fs_buf) {
 	};
 }
 
+/**
+ * mocked_lines_file_handler mocks the native read_lines which returns
+ * the buffer offsets of the newlines along with the number of bytes read
+ * @param {Buffer} fs_buf 
+ * @returns {nb.NativeFile}
+ */
+function mocked_lines_file_handler(fs_buf) {
+	const fh = mocked_file_handler(fs_buf);
+	fh.read_lines = async (fs_ctx, buf, offset, len, pos) => {
+		const read = await fh.read(fs_ctx, buf, offset, len, pos);
+		const lines = [];
+		for (let i = offset; i < offset + read; ++i) {
+			if (buf[i] === NewlineReader.NL_CODE) lines.push(i);
+		}
+		return { read, lines: Int32Array.from(lines) };
+	};
+	return fh;
+}
+
 describe('newline_reader', () => {
 	describe('nextline', () => {
 		const UTF8DATA_ARR = [
@@ -168,5 +191,149 @@ describe('newline_reader', () => {
 			const expected_cur_next_line_file_offset = UTF8DATA_BUF.length;
 			expect(reader.next_line_file_offset).toBe(expected_cur_next_line_file_offset);
 		});
+
+		it('read_lines - can process utf8 characters when termination with newline character', async () => {
+			const UTF8DATA_BUF = Buffer.from(UTF8DATA_ARR.join('\n') + '\n', 'utf8');
+
+			const reader = new NewlineReader({}, '', { skip_leftover_line: true, read_file_offset: 0 });
+			// @ts-ignore
+			reader.fh = mocked_lines_file_handler(UTF8DATA_BUF);
+
+			const result = [];
+			let expected_cur_next_line_file_offset = 0;
+			const [processed] = await reader.forEach(async entry => {
+				result.push(entry);
+				expected_cur_next_line_file_offset += Buffer.byteLength(entry, 'utf8') + 1;
+				expect(reader.next_line_file_offset).toBe(expected_cur_next_line_file_offset);
+				return true;
+			});
+
+			expect(processed).toBe(UTF8DATA_ARR.length);
+			expect(result).toStrictEqual(UTF8DATA_ARR);
+		});
+
+		it('read_lines - can process utf8 characters when termination not with new line character [bufsize = 256]', async () => {
+			const expected = "abc";
+			const UTF8DATA_ARR_TEMP = [ ...UTF8DATA_ARR, expected ];
+			const UTF8DATA_BUF = Buffer.from(UTF8DATA_ARR_TEMP.join('\n'), 'utf8');
+
+			const reader = new NewlineReader({}, '', { bufsize: 256, skip_overflow_lines: true });
+			// @ts-ignore
+			reader.fh = mocked_lines_file_handler(UTF8DATA_BUF);
+
+			const result = [];
+			const [processed] = await reader.forEach(async entry => {
+				result.push(entry);
+				return true;
+			});
+
+			expect(processed).toBe(1);
+			expect(result).toStrictEqual([expected]);
+		});
+	});
+
+	describe('native read_lines', () => {
+		const fs_context = {};
+		// lines of different lengths so that they cross the 16 bytes buffer boundary at different places
+		const LINES = ['a', '', 'bcdefgh', 'ijklmnopqrstu', 'v', 'wxyz0123456789', '', '€uro', 'çava'];
+		let tmp_dir;
+
+		beforeAll(() => {
+			tmp_dir = fs.mkdtempSync(path.join(os.tmpdir(), 'test_newline_reader_'));
+		});
+
+		afterAll(() => {
+			fs.rmSync(tmp_dir, { recursive: true, force: true });
+		});
+
+		/**
+		 * @param {string} name
+		 * @param {string} data
+		 * @returns {string}
+		 */
+		function write_tmp_file(name, data) {
+			const file_path = path.join(tmp_dir, name);
+			fs.writeFileSync(file_path, data);
+			return file_path;
+		}
+
+		it('read_lines returns the buffer offsets of the newlines that were read', async () => {
+			const data = LINES.join('\n') + '\n';
+			const file_path = write_tmp_file('offsets', data);
+			const fh = await nb_native().fs.open(fs_context, file_path, 'r');
+			try {
+				const buf = Buffer.alloc(64);
+				const offset = 5;
+				const pos = 3;
+				const { read, lines } = await fh.read_lines(fs_context, buf, offset, 20, pos);
+				expect(read).toBe(20);
+				const expected = [];
+				for (let i = offset; i < offset + read; ++i) {
+					if (buf[i] === NewlineReader.NL_CODE) expected.push(i);
+				}
+				expect(expected.length).toBeGreaterThan(0);
+				expect(Array.from(lines)).toStrictEqual(expected);
+				expect(buf.subarray(offset, offset + read)).toStrictEqual(Buffer.from(data).subarray(pos, pos + read));
+
+				const eof = await fh.read_lines(fs_context, buf, 0, buf.length, Buffer.byteLength(data));
+				expect(eof.read).toBe(0);
+				expect(eof.lines.length).toBe(0);
+			} finally {
+				await fh.close(fs_context);
+			}
+		});
+
+		it('reads lines across buffer boundaries [bufsize = 16]', async () => {
+			const file_path = write_tmp_file('boundaries', LINES.join('\n') + '\n');
+			const reader = new NewlineReader(fs_context, file_path, { bufsize: 16 });
+			try {
+				const result = [];
+				let expected_cur_next_line_file_offset = 0;
+				const [processed] = await reader.forEach(async entry => {
+					result.push(entry);
+					expected_cur_next_line_file_offset += Buffer.byteLength(entry, 'utf8') + 1;
+					expect(reader.next_line_file_offset).toBe(expected_cur_next_line_file_offset);
+					return true;
+				});
+				expect(typeof reader.fh.read_lines).toBe('function');
+				expect(processed).toBe(LINES.length);
+				expect(result).toStrictEqual(LINES);
+			} finally {
+				await reader.close();
+			}
+		});
+
+		it('returns the leftover line at eof [bufsize = 16]', async () => {
+			const leftover = 'leftover';
+			const file_path = write_tmp_file('leftover', LINES.join('\n') + '\n' + leftover);
+			const reader = new NewlineReader(fs_context, file_path, { bufsize: 16 });
+			try {
+				const result = [];
+				const [processed] = await reader.forEach(async entry => {
+					result.push(entry);
+					return true;
+				});
+				expect(processed).toBe(LINES.length + 1);
+				expect(result).toStrictEqual([...LINES, leftover]);
+				expect(reader.next_line_file_offset).toBe(fs.statSync(file_path).size);
+			} finally {
+				await reader.close();
+			}
+		});
+
+		it('skips the leftover line at eof when skip_leftover_line [bufsize = 16]', async () => {
+			const file_path = write_tmp_file('skip_leftover', LINES.join('\n') + '\nleftover');
+			const reader = new NewlineReader(fs_context, file_path, { bufsize: 16, skip_leftover_line: true });
+			try {
+				const result = [];
+				await reader.forEach(async entry => {
+					result.push(entry);
+					return true;
+				});
+				expect(result).toStrictEqual(LINES);
+			} finally {
+				await reader.close();
+			}
+		});
 	});
 });
@@ -0,0 +1,41 @@
+/* Copyright (C) 2016 NooBaa */
+'use strict';
+
+const mocha = require('mocha');
+const assert = require('assert');
+const nb_native = require('../../../util/nb_native');
+
+mocha.describe('nb_native async log', function() {
+
+    mocha.it('drops the lines pushed to a full ring and writes the rest', function() {
+        const native = nb_native();
+        // exported only when NOOBAA_NATIVE_TEST_HOOKS was set before nb_native was loaded (see coretest)
+        if (!native.log_async_hold) this.skip(); // eslint-disable-line no-invalid-this
+        // ignored when debug_module already started the async log, so the capacity is taken from the stats
+        native.log_async_init(1024);
+        assert.strictEqual(native.log_async_flush(5000), true);
+        const before = native.log_async_stats();
+        const count = before.capacity * 2;
+        let queued = 0;
+        native.log_async_hold(true);
+        try {
+            // lines without a stderr or syslog line are counted but not written anywhere
+            for (let i = 0; i < count; ++i) {
+                if (native.log_async(undefined, undefined)) queued += 1;
+            }
+        } finally {
+            native.log_async_hold(false);
+        }
+        assert.strictEqual(native.log_async_flush(5000), true);
+        const after = native.log_async_stats();
+        const pushed = after.pushed - before.pushed;
+        const dropped = after.dropped - before.dropped;
+        assert.strictEqual(pushed, queued);
+        assert.strictEqual(pushed + dropped, count);
+        assert.ok(pushed >= before.capacity, `pushed ${pushed}`);
+        assert.ok(dropped > 0, `dropped ${dropped}`);
+        // the line that reports the dropped lines is written but not counted
+        assert.strictEqual(after.written - before.written, pushed);
+    });
+
+});
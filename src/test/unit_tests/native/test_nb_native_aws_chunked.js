@@ -0,0 +1,104 @@
+/* Copyright (C) 2016 NooBaa */
+'use strict';
+
+const zlib = require('zlib');
+const mocha = require('mocha');
+const assert = require('assert');
+const crypto = require('crypto');
+const nb_native = require('../../../util/nb_native');
+
+mocha.describe('nb_native AwsChunkedDecoder', function() {
+
+    const EMPTY_SHA256 = crypto.createHash('sha256').digest('hex');
+    const hmac = (key, data) => crypto.createHmac('sha256', key).update(data).digest();
+    const sha256 = data => crypto.createHash('sha256').update(data).digest('hex');
+    const signing = {
+        signing_key: hmac(hmac(hmac(hmac('AWS4secret', '20250101'), 'us-east-1'), 's3'), 'aws4_request'),
+        timestamp: '20250101T000000Z',
+        scope: '20250101/us-east-1/s3/aws4_request',
+        seed_signature: sha256('seed'),
+    };
+
+    // encode data like a streaming sigv4 upload with a signed crc32 trailer
+    function encode(data, chunk_size) {
+        let prev = signing.seed_signature;
+        const sign = (...lines) => {
+            prev = hmac(signing.signing_key, [lines[0], signing.timestamp, signing.scope, prev, ...lines.slice(1)]
+                .join('\n')).toString('hex');
+            return prev;
+        };
+        const parts = [];
+        for (let pos = 0; pos < data.length; pos += chunk_size) {
+            const chunk = data.subarray(pos, pos + chunk_size);
+            const sig = sign('AWS4-HMAC-SHA256-PAYLOAD', EMPTY_SHA256, sha256(chunk));
+            parts.push(Buffer.from(`${chunk.length.toString(16)};chunk-signature=${sig}\r\n`), chunk, Buffer.from('\r\n'));
+        }
+        parts.push(Buffer.from(`0;chunk-signature=${sign('AWS4-HMAC-SHA256-PAYLOAD', EMPTY_SHA256, EMPTY_SHA256)}\r\n`));
+        const crc = Buffer.alloc(4);
+        crc.writeUInt32BE(zlib.crc32(data));
+        const trailer = `x-amz-checksum-crc32:${crc.toString('base64')}`;
+        const trailer_sig = sign('AWS4-HMAC-SHA256-TRAILER', sha256(trailer + '\n'));
+        parts.push(Buffer.from(`${trailer}\r\nx-amz-trailer-signature:${trailer_sig}\r\n\r\n`));
+        return Buffer.concat(parts);
+    }
+
+    function decode(input, options, split) {
+        const decoder = new (nb_native().AwsChunkedDecoder)(options);
+        const out = [];
+        for (let pos = 0; pos < input.length; pos += split) {
+            const buf = input.subarray(pos, pos + split);
+            const offsets = decoder.update(buf);
+            for (let i = 0; i < offsets.length; i += 2) out.push(buf.subarray(offsets[i], offsets[i + 1]));
+        }
+        assert.strictEqual(decoder.info().state, 'STATE_CONTENT_END');
+        return Buffer.concat(out);
+    }
+
+    mocha.it('decodes and verifies signatures and checksum', function() {
+        const data = crypto.randomBytes(300000);
+        const input = encode(data, 64 * 1024);
+        const options = { ...signing, checksum_trailer: 'x-amz-checksum-crc32' };
+        for (const split of [1, 7, 1000, 65536, input.length]) {
+            assert.deepStrictEqual(decode(input, options, split), data);
+        }
+        // without signing the signatures are ignored
+        assert.deepStrictEqual(decode(input, {}, 4096), data);
+    });
+
+    mocha.it('rejects bad signatures and checksums', function() {
+        const data = crypto.randomBytes(100000);
+        const input = encode(data, 32 * 1024);
+        const options = { ...signing, checksum_trailer: 'x-amz-checksum-crc32' };
+
+        const bad_data = Buffer.from(input);
+        bad_data[50000] ^= 1;
+        assert.throws(() => decode(bad_data, options, 8192), /chunk-signature mismatch/);
+        assert.throws(() => decode(bad_data, { checksum_trailer: 'x-amz-checksum-crc32' }, 8192), /checksum mismatch/);
+
+        const bad_seed = { ...options, seed_signature: sha256('other') };
+        assert.throws(() => decode(input, bad_seed, 8192), err => err.index > 0 && /chunk-signature mismatch/.test(err.message));
+
+        const bad_trailer = Buffer.from(input);
+        bad_trailer[bad_trailer.length - 10] ^= 1;
+        assert.throws(() => decode(bad_trailer, options, 8192), /trailer signature mismatch/);
+
+        assert.throws(() => decode(Buffer.from('3\r\nfoo\r\n0\r\n\r\n'), signing, 10), /missing chunk-signature/);
+        assert.throws(() => decode(Buffer.from('xyz\r\n'), {}, 10), /chunk_size has invalid value/);
+    });
+
+    mocha.it('requires the trailer signature of a signed trailer', function() {
+        const data = crypto.randomBytes(1000);
+        const input = encode(data, 512);
+        const options = { ...signing, signed_trailer: true };
+        assert.deepStrictEqual(decode(input, options, 100), data);
+
+        const text = input.toString('latin1');
+        const no_signature = Buffer.from(text.replace(/x-amz-trailer-signature:[0-9a-f]+\r\n/, ''), 'latin1');
+        assert.throws(() => decode(no_signature, options, 100), /missing x-amz-trailer-signature/);
+        const no_trailers = Buffer.from(text.slice(0, text.indexOf('x-amz-checksum-crc32:')) + '\r\n', 'latin1');
+        assert.throws(() => decode(no_trailers, options, 100), /missing x-amz-trailer-signature/);
+        // the trailer is optional when it is not signed
+        assert.deepStrictEqual(decode(no_trailers, signing, 100), data);
+    });
+
+});
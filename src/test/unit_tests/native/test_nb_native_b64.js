@@ -51,4 +51,39 @@ mocha.describe('nb_native b64', function() {
         });
     }
 
+    mocha.describe('bulk', function() {
+
+        const inputs = [];
+        for (let i = 0; i < 300; ++i) inputs.push(crypto.randomBytes(i));
+        for (let i = 0; i < 100; ++i) inputs.push(crypto.randomBytes(Math.floor(Math.random() * 10000)));
+
+        mocha.it(`b64 - simd ${nb_native().b64_simd}`, function() {
+            const encoded = nb_native().b64_encode_bulk(inputs);
+            assert.deepStrictEqual(encoded, inputs.map(b => b.toString('base64')));
+            const decoded = nb_native().b64_decode_bulk(encoded);
+            assert.deepStrictEqual(decoded, inputs);
+            assert.deepStrictEqual(nb_native().b64_decode_bulk(encoded.map(s => Buffer.from(s))), inputs);
+        });
+
+        mocha.it('hex', function() {
+            const encoded = nb_native().hex_encode_bulk(inputs);
+            assert.deepStrictEqual(encoded, inputs.map(b => b.toString('hex')));
+            assert.deepStrictEqual(nb_native().hex_decode_bulk(encoded), inputs);
+            assert.deepStrictEqual(nb_native().hex_decode_bulk(encoded.map(s => s.toUpperCase())), inputs);
+        });
+
+        mocha.it('rejects invalid input', function() {
+            const valid = crypto.randomBytes(100).toString('base64');
+            for (const bad of ['!', '-', '_', ' ', '\u0141', '\u00c1']) {
+                const pos = Math.floor(Math.random() * 80);
+                const input = valid.slice(0, pos) + bad + valid.slice(pos + 1);
+                assert.throws(() => nb_native().b64_decode_bulk([valid, input]), /b64_decode_bulk: failed .* item 1/);
+            }
+            const hex = crypto.randomBytes(100).toString('hex');
+            assert.throws(() => nb_native().hex_decode_bulk([hex.slice(1)]), /hex_decode_bulk: failed/);
+            assert.throws(() => nb_native().hex_decode_bulk([hex.slice(0, 70) + 'g' + hex.slice(71)]), /hex_decode_bulk: failed/);
+            assert.throws(() => nb_native().b64_encode_bulk(['not a buffer']), /should be Buffer/);
+        });
+    });
+
 });
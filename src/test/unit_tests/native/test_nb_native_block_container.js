@@ -0,0 +1,123 @@
+/* Copyright (C) 2016 NooBaa */
+'use strict';
+
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const mocha = require('mocha');
+const assert = require('assert');
+const crypto = require('crypto');
+const nb_native = require('../../../util/nb_native');
+
+mocha.describe('nb_native BlockContainer', function() {
+
+    const dir = path.join(os.tmpdir(), `test_block_container_${process.pid}`);
+    const options = { dir, segment_size: 64 * 1024, sync_bytes: 16 * 1024 };
+
+    function new_container() {
+        return new (nb_native().BlockContainer)(options);
+    }
+
+    mocha.after(async function() {
+        await fs.promises.rm(dir, { recursive: true, force: true });
+    });
+
+    mocha.it('write read overwrite delete', async function() {
+        const c = new_container();
+        await c.open();
+        const data = crypto.randomBytes(1000);
+        assert.strictEqual(await c.write('block1', '{"id":"block1"}', data), -1);
+        const res = await c.read('block1');
+        assert.strictEqual(res.md, '{"id":"block1"}');
+        assert(res.data.equals(data));
+
+        assert.strictEqual(await c.write('block1', 'md2', Buffer.from('small')), 1000);
+        assert.strictEqual((await c.read('block1')).data.toString(), 'small');
+
+        assert.strictEqual(await c.read('missing'), null);
+        assert.strictEqual(await c.delete('block1'), 5);
+        assert.strictEqual(await c.delete('block1'), -1);
+        assert.strictEqual(await c.read('block1'), null);
+        await c.close();
+    });
+
+    mocha.it('reopen and compact', async function() {
+        const blocks = new Map();
+        let c = new_container();
+        await c.open();
+        for (let i = 0; i < 200; ++i) {
+            const data = crypto.randomBytes(1024);
+            blocks.set(`b${i}`, data);
+            await c.write(`b${i}`, `md${i}`, data);
+        }
+        for (let i = 0; i < 150; ++i) {
+            await c.delete(`b${i}`);
+            blocks.delete(`b${i}`);
+        }
+        assert(c.stats().segments > 1);
+        await c.close();
+
+        // reopen without a checkpoint to force scanning the segments
+        await fs.promises.unlink(path.join(dir, 'index'));
+        c = new_container();
+        await c.open();
+        assert.strictEqual(c.stats().count, blocks.size);
+
+        const compacted = await c.compact(0.5);
+        assert(compacted > 0);
+        const stats = c.stats();
+        assert.strictEqual(stats.count, blocks.size);
+        assert.strictEqual(stats.compacted_segments, compacted);
+        for (const [id, data] of blocks) {
+            assert((await c.read(id)).data.equals(data));
+        }
+        await c.close();
+
+        c = new_container();
+        await c.open();
+        assert.strictEqual(c.stats().count, blocks.size);
+        for (const [id, data] of blocks) {
+            assert((await c.read(id)).data.equals(data));
+        }
+        await c.close();
+    });
+
+    mocha.it('skips corrupt records of a sealed segment', async function() {
+        await fs.promises.rm(dir, { recursive: true, force: true });
+        let c = new_container();
+        await c.open();
+        const data = crypto.randomBytes(1000);
+        for (let i = 0; i < 200; ++i) {
+            await c.write(`x${i}`, 'md', data);
+        }
+        assert(c.stats().segments > 1);
+        await c.close();
+
+        // record length is header 24 + id 2 + md 2 + data 1000, so corrupt the header of x1
+        const rec_len = 24 + 2 + 2 + 1000;
+        const fh = await fs.promises.open(path.join(dir, '00000001.seg'), 'r+');
+        await fh.write(Buffer.from([0xff]), 0, 1, rec_len + 10);
+        await fh.close();
+        await fs.promises.unlink(path.join(dir, 'index'));
+
+        c = new_container();
+        await c.open();
+        const stats = c.stats();
+        assert.strictEqual(stats.count, 199);
+        assert.strictEqual(stats.corrupt_bytes, rec_len);
+        assert.strictEqual(stats.corrupt_segments, 1);
+        assert.strictEqual(await c.read('x1'), null);
+        assert((await c.read('x0')).data.equals(data));
+        assert((await c.read('x2')).data.equals(data));
+        assert((await c.read('x199')).data.equals(data));
+
+        // the corrupt segment is not compacted even when all its records are dead
+        for (let i = 0; i < 200; ++i) {
+            await c.delete(`x${i}`);
+        }
+        await c.compact(0.5);
+        assert.strictEqual(c.stats().corrupt_segments, 1);
+        await c.close();
+    });
+
+});
@@ -0,0 +1,88 @@
+/* Copyright (C) 2016 NooBaa */
+'use strict';
+
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const mocha = require('mocha');
+const assert = require('assert');
+const crypto = require('crypto');
+const nb_native = require('../../../util/nb_native');
+
+mocha.describe('nb_native BlockScrubber', function() {
+
+    const dir = path.join(os.tmpdir(), `test_block_scrubber_${process.pid}`);
+
+    mocha.before(async function() {
+        await fs.promises.mkdir(dir, { recursive: true });
+    });
+
+    mocha.after(async function() {
+        await fs.promises.rm(dir, { recursive: true, force: true });
+    });
+
+    async function write_block(id, size, digest_type, corrupt) {
+        const data = crypto.randomBytes(size);
+        const digest_b64 = crypto.createHash(digest_type).update(data).digest('base64');
+        if (corrupt) data[size >> 1] ^= 1;
+        const block_path = path.join(dir, id + '.data');
+        await fs.promises.writeFile(block_path, data);
+        await fs.promises.writeFile(path.join(dir, id + '.meta'), JSON.stringify({ id, digest_type, digest_b64 }));
+        return block_path;
+    }
+
+    mocha.it('verify reports corrupt blocks', async function() {
+        const paths = [];
+        for (let i = 0; i < 20; ++i) {
+            paths.push(await write_block(`block${i}`, 1000 + (i * 777), i % 4 ? 'sha1' : 'sha256', i === 7 || i === 12));
+        }
+        paths.push(path.join(dir, 'missing.data'));
+        const buffers = [1, 2, 3].map(() => nb_native().fs.dio_buffer_alloc(64 * 1024));
+        const scrubber = new (nb_native().BlockScrubber)({});
+        const res = await scrubber.verify(paths, buffers);
+        assert.strictEqual(res.scanned, paths.length);
+        const corrupt = res.failures.filter(f => f.status === 'CORRUPT').map(f => path.basename(f.path));
+        assert.deepStrictEqual(corrupt, ['block7.data', 'block12.data']);
+        const failed = res.failures.filter(f => f.status === 'FAILED');
+        assert.strictEqual(failed.length, 1);
+        assert.strictEqual(failed[0].code, 'ENOENT');
+        assert.strictEqual(scrubber.stats().corrupt, 2);
+    });
+
+    // the delay is checked against the elapsed times that the call measured (reported in stats)
+    // rather than the wall clock of the test, which is not reliable on a loaded machine
+    mocha.it('verify returns io throttle delay', async function() {
+        const size = 256 * 1024;
+        const io_bytes_per_sec = 1024 * 1024;
+        const block_path = await write_block('throttled', size, 'sha1', false);
+        const buffers = [nb_native().fs.dio_buffer_alloc(1024 * 1024)];
+        const scrubber = new (nb_native().BlockScrubber)({ io_bytes_per_sec });
+        const res = await scrubber.verify([block_path], buffers);
+        assert.strictEqual(res.failures.length, 0);
+        assert.strictEqual(res.bytes, size);
+        const { wall_usec } = scrubber.stats();
+        const io_usec = Math.floor(size * 1000000 / io_bytes_per_sec);
+        assert.strictEqual(res.throttle_ms, Math.floor(Math.max(0, io_usec - wall_usec) / 1000));
+    });
+
+    mocha.it('verify returns cpu throttle delay', async function() {
+        const cpu_percent = 10;
+        const block_path = await write_block('cpu_throttled', 1024 * 1024, 'sha256', false);
+        const buffers = [nb_native().fs.dio_buffer_alloc(1024 * 1024)];
+        const scrubber = new (nb_native().BlockScrubber)({ cpu_percent });
+        const res = await scrubber.verify([block_path], buffers);
+        assert.strictEqual(res.failures.length, 0);
+        const { wall_usec, cpu_usec } = scrubber.stats();
+        const budget_usec = Math.floor(cpu_usec * 100 / cpu_percent);
+        assert.strictEqual(res.throttle_ms, Math.floor(Math.max(0, budget_usec - wall_usec) / 1000));
+    });
+
+    mocha.it('verify returns no throttle delay when unlimited', async function() {
+        const block_path = await write_block('unlimited', 256 * 1024, 'sha1', false);
+        const buffers = [nb_native().fs.dio_buffer_alloc(1024 * 1024)];
+        const scrubber = new (nb_native().BlockScrubber)({});
+        const res = await scrubber.verify([block_path], buffers);
+        assert.strictEqual(res.throttle_ms, 0);
+    });
+
+});
@@ -0,0 +1,64 @@
+/* Copyright (C) 2016 NooBaa */
+'use strict';
+
+const mocha = require('mocha');
+const assert = require('assert');
+const crypto = require('crypto');
+const nb_native = require('../../../util/nb_native');
+
+mocha.describe('nb_native crypto.ChecksumAsync', function() {
+
+    const ALL = ['CRC32', 'CRC32C', 'CRC64NVME', 'SHA1', 'SHA256'];
+
+    async function checksum(algorithms, buffers) {
+        const c = new (nb_native().crypto.ChecksumAsync)(algorithms);
+        await c.update(buffers);
+        return c.digest();
+    }
+
+    mocha.it('computes the standard check values', async function() {
+        const data = Buffer.from('123456789');
+        const res = await checksum(ALL, data);
+        assert.deepStrictEqual(Object.keys(res).sort(), [...ALL].sort());
+        assert.strictEqual(res.CRC32.toString('hex'), 'cbf43926');
+        assert.strictEqual(res.CRC32C.toString('hex'), 'e3069283');
+        assert.strictEqual(res.CRC64NVME.toString('hex'), 'ae8b14860a799888');
+        assert.deepStrictEqual(res.SHA1, crypto.createHash('sha1').update(data).digest());
+        assert.deepStrictEqual(res.SHA256, crypto.createHash('sha256').update(data).digest());
+    });
+
+    mocha.it('does not depend on the buffers split', async function() {
+        const data = crypto.randomBytes(1024 * 1024 + 7);
+        const whole = await checksum(ALL, data);
+        const buffers = [];
+        for (let pos = 0; pos < data.length;) {
+            const len = Math.floor(Math.random() * 100000);
+            buffers.push(data.subarray(pos, pos + len));
+            pos += len;
+        }
+        const c = new (nb_native().crypto.ChecksumAsync)(ALL);
+        await c.update(buffers.slice(0, 3));
+        for (const buf of buffers.slice(3)) await c.update(buf);
+        assert.deepStrictEqual(await c.digest(), whole);
+    });
+
+    mocha.it('combines crcs without the data', async function() {
+        const data = crypto.randomBytes(300000);
+        const parts = [data.subarray(0, 100000), data.subarray(100000, 100001), data.subarray(100001)];
+        for (const algorithm of ['CRC32', 'CRC32C', 'CRC64NVME']) {
+            const whole = await checksum([algorithm], data);
+            let crc = (await checksum([algorithm], parts[0]))[algorithm];
+            for (const part of parts.slice(1)) {
+                const part_crc = (await checksum([algorithm], part))[algorithm];
+                crc = nb_native().crypto.checksum_combine(algorithm, crc, part_crc, part.length);
+            }
+            assert.deepStrictEqual(crc, whole[algorithm], algorithm);
+        }
+    });
+
+    mocha.it('rejects unsupported algorithms', function() {
+        assert.throws(() => new (nb_native().crypto.ChecksumAsync)(['MD5']), TypeError);
+        assert.throws(() => nb_native().crypto.checksum_combine('SHA1', Buffer.alloc(20), Buffer.alloc(20), 1), TypeError);
+    });
+
+});
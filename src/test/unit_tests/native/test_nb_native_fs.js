@@ -4,12 +4,15 @@
 
 const _ = require('lodash');
 const fs = require('fs');
+const path = require('path');
 const mocha = require('mocha');
 const assert = require('assert');
+const P = require('../../../util/promise');
 const fs_utils = require('../../../util/fs_utils');
 const os_utils = require('../../../util/os_utils');
 const nb_native = require('../../../util/nb_native');
-const { get_process_fs_context } = require('../../../util/native_fs_utils');
+const native_fs_utils = require('../../../util/native_fs_utils');
+const { get_process_fs_context } = native_fs_utils;
 
 const DEFAULT_FS_CONFIG = get_process_fs_context();
 
@@ -53,6 +56,55 @@ mocha.describe('nb_native fs', async function() {
         });
     });
 
+    mocha.describe('statx', async function() {
+        mocha.it('matches stat', async function() {
+            const path = 'package.json';
+            const res = await native_fs_utils.statx(DEFAULT_FS_CONFIG, path);
+            const res2 = await nb_native().fs.stat(DEFAULT_FS_CONFIG, path);
+            const fields = ['mode', 'nlink', 'uid', 'gid', 'ino', 'size', 'blocks', 'dev', 'mtimeMs', 'ctimeMs',
+                'mtime', 'ctime', 'mtimeNsBigint', 'ctimeNsBigint', 'atimeNsBigint'];
+            assert.deepStrictEqual(_.pick(res, fields), _.pick(res2, fields));
+            assert.strictEqual(res.xattr, undefined);
+        });
+
+        mocha.it('reads only the requested xattr', async function() {
+            const PATH = `/tmp/statx${Date.now()}`;
+            const file = await nb_native().fs.open(DEFAULT_FS_CONFIG, PATH, 'w');
+            await file.replacexattr(DEFAULT_FS_CONFIG, { 'user.a': '1', 'user.b': '2' });
+            await file.close(DEFAULT_FS_CONFIG);
+            const { statx_mask } = nb_native().fs;
+            const res = await native_fs_utils.statx(DEFAULT_FS_CONFIG, PATH, {
+                // eslint-disable-next-line no-bitwise
+                mask: statx_mask.size | statx_mask.mtime,
+                dont_sync: true,
+                read_xattr: true,
+                xattr_get_keys: ['user.b'],
+            });
+            await fs.promises.unlink(PATH);
+            assert.strictEqual(res.size, 0);
+            assert.deepStrictEqual(res.xattr, { 'user.b': '2' });
+            await assert.rejects(native_fs_utils.statx(DEFAULT_FS_CONFIG, PATH), { code: 'ENOENT' });
+            assert.strictEqual(await native_fs_utils.statx_ignore_enoent(DEFAULT_FS_CONFIG, PATH), undefined);
+        });
+
+        mocha.it('converts only the requested fields', async function() {
+            const path = 'package.json';
+            const { statx_mask } = nb_native().fs;
+            const res = await native_fs_utils.statx(DEFAULT_FS_CONFIG, path, { mask: statx_mask.size });
+            const res2 = await nb_native().fs.stat(DEFAULT_FS_CONFIG, path);
+            assert.strictEqual(res.size, res2.size);
+            assert.strictEqual(res.mtime, undefined);
+            assert.strictEqual(res.mtimeNsBigint, undefined);
+            assert.strictEqual(res.ctimeNsBigint, undefined);
+            const [size, mtime_sec] = await native_fs_utils.with_statx(DEFAULT_FS_CONFIG, path,
+                // eslint-disable-next-line no-bitwise
+                { mask: statx_mask.size | statx_mask.mtime },
+                (out, ix) => [out[ix.size], out[ix.mtime_sec]]);
+            assert.strictEqual(size, res2.size);
+            assert.strictEqual(mtime_sec, Math.floor(res2.mtimeMs / 1000));
+        });
+    });
+
     mocha.describe('lstat', async function() {
         const link_name = 'link.json';
         const file_name = 'file.json';
@@ -227,6 +279,161 @@ mocha.describe('nb_native fs', async function() {
         });
     });
 
+    mocha.describe('DirCache', async function() {
+        const DIR_PATH = `/tmp/dir_cache${Date.now()}`;
+        const NAMES = ['b', 'a', 'ab', 'a\uffff', 'a\u{1f600}', 'c.txt', 'A'];
+
+        mocha.before(async function() {
+            await fs_utils.create_path(DIR_PATH);
+            for (const name of NAMES) await create_file(`${DIR_PATH}/${name}`);
+        });
+
+        mocha.after(async function() {
+            await fs_utils.folder_delete(DIR_PATH);
+        });
+
+        mocha.it('lists in js order and caches until the dir changes', async function() {
+            const cache = new (nb_native().fs.DirCache)();
+            const res = await cache.load(DEFAULT_FS_CONFIG, DIR_PATH);
+            assert.strictEqual(res.cached, false);
+            assert.strictEqual(res.stat.ino, (await fs.promises.stat(DIR_PATH)).ino);
+            const sorted = [...NAMES].sort();
+            assert.deepStrictEqual(res.listing.entries(0).map(e => e.name), sorted);
+            assert.strictEqual(res.listing.length, NAMES.length);
+            assert.strictEqual(res.listing.upper_bound('a'), sorted.indexOf('a') + 1);
+            assert.strictEqual(res.listing.lower_bound('a'), sorted.indexOf('a'));
+            assert.deepStrictEqual(
+                res.listing.entries(res.listing.lower_bound('a'), { prefix: 'a', limit: 3 }).map(e => e.name),
+                sorted.filter(name => name.startsWith('a')).slice(0, 3));
+
+            const res2 = await cache.load(DEFAULT_FS_CONFIG, DIR_PATH);
+            assert.strictEqual(res2.cached, true);
+            assert.strictEqual(cache.stats().count, 1);
+
+            await create_file(`${DIR_PATH}/d`);
+            const res3 = await cache.load(DEFAULT_FS_CONFIG, DIR_PATH);
+            assert.strictEqual(res3.cached, false);
+            assert.deepStrictEqual(res3.listing.entries(0).map(e => e.name), [...sorted, 'd'].sort());
+
+            cache.invalidate(DIR_PATH);
+            assert.deepStrictEqual(cache.stats(), { count: 0, total_size: 0 });
+        });
+
+        mocha.it('does not list dirs over max_dir_size', async function() {
+            const cache = new (nb_native().fs.DirCache)({ max_dir_size: 0 });
+            const res = await cache.load(DEFAULT_FS_CONFIG, DIR_PATH);
+            assert.strictEqual(res.listing, undefined);
+            assert.strictEqual(cache.stats().count, 0);
+        });
+    });
+
+    mocha.describe('mkdirp', async function() {
+        const DIR_PATH = `/tmp/mkdirp${Date.now()}`;
+
+        mocha.after(async function() {
+            await fs_utils.folder_delete(DIR_PATH);
+        });
+
+        mocha.it('creates missing parents and caches verified dirs', async function() {
+            const { mkdirp, mkdirp_cache_stats, rmdir } = nb_native().fs;
+            const leaf = `${DIR_PATH}/a/b/c`;
+            assert.strictEqual(await mkdirp(DEFAULT_FS_CONFIG, leaf, 0o770, { fsync: true, use_cache: true }), 4);
+            assert((await fs.promises.stat(leaf)).isDirectory());
+
+            const stats = mkdirp_cache_stats();
+            assert.strictEqual(await mkdirp(DEFAULT_FS_CONFIG, leaf, 0o770, { use_cache: true }), 0);
+            assert.strictEqual(mkdirp_cache_stats().hits, stats.hits + 1);
+            assert.strictEqual(await mkdirp(DEFAULT_FS_CONFIG, `${DIR_PATH}/a/b/d`, 0o770, { use_cache: true }), 1);
+
+            // rmdir drops the cached dir so the next mkdirp creates it again
+            await rmdir(DEFAULT_FS_CONFIG, leaf);
+            assert.strictEqual(await mkdirp(DEFAULT_FS_CONFIG, leaf, 0o770, { use_cache: true }), 1);
+
+            // removed behind the cache's back - found missing only without the cache
+            await fs.promises.rm(`${DIR_PATH}/a`, { recursive: true });
+            assert.strictEqual(await mkdirp(DEFAULT_FS_CONFIG, leaf, 0o770, { use_cache: true }), 0);
+            assert.strictEqual(await mkdirp(DEFAULT_FS_CONFIG, leaf, 0o770, { use_cache: false }), 3);
+        });
+
+        mocha.it('fails on a file in the path', async function() {
+            const { mkdirp } = nb_native().fs;
+            await fs.promises.mkdir(DIR_PATH, { recursive: true });
+            await create_file(`${DIR_PATH}/file`);
+            await assert.rejects(mkdirp(DEFAULT_FS_CONFIG, `${DIR_PATH}/file`, 0o770, { use_cache: true }), { code: 'ENOTDIR' });
+            await assert.rejects(mkdirp(DEFAULT_FS_CONFIG, `${DIR_PATH}/file/x/y`, 0o770), { code: 'ENOTDIR' });
+        });
+    });
+
+    mocha.describe('BucketRoot', async function() {
+        const ROOT_PATH = `/tmp/bucket_root${Date.now()}`;
+        const OUTSIDE_PATH = `${ROOT_PATH}_outside`;
+        let root;
+
+        mocha.before(async function() {
+            await fs.promises.mkdir(ROOT_PATH, { recursive: true });
+            await fs.promises.mkdir(OUTSIDE_PATH, { recursive: true });
+            await create_file(`${OUTSIDE_PATH}/secret`);
+            await fs.promises.symlink(OUTSIDE_PATH, `${ROOT_PATH}/escape`);
+            root = await nb_native().fs.open_bucket_root(DEFAULT_FS_CONFIG, ROOT_PATH);
+        });
+
+        mocha.after(async function() {
+            if (root) await root.close(DEFAULT_FS_CONFIG);
+            await fs_utils.folder_delete(ROOT_PATH);
+            await fs_utils.folder_delete(OUTSIDE_PATH);
+        });
+
+        mocha.it('runs path ops relative to the root', async function() {
+            assert.strictEqual(root.path, ROOT_PATH);
+            assert.strictEqual(await root.mkdirp(DEFAULT_FS_CONFIG, 'a/b', 0o770, { fsync: true }), 2);
+            await root.writeFile(DEFAULT_FS_CONFIG, 'a/b/obj', Buffer.from('data'));
+            const { data } = await root.readFile(DEFAULT_FS_CONFIG, 'a/b/obj');
+            assert.strictEqual(data.toString(), 'data');
+            await root.rename(DEFAULT_FS_CONFIG, 'a/b/obj', 'a/obj');
+            const stat = await root.stat(DEFAULT_FS_CONFIG, 'a/obj');
+            assert.strictEqual(stat.size, 4);
+            assert.deepStrictEqual((await root.readdir(DEFAULT_FS_CONFIG, 'a')).map(e => e.name).sort(), ['b', 'obj']);
+            const file = await root.open(DEFAULT_FS_CONFIG, 'a/obj', 'r');
+            assert.strictEqual((await file.stat(DEFAULT_FS_CONFIG)).ino, stat.ino);
+            await file.close(DEFAULT_FS_CONFIG);
+            await root.unlink(DEFAULT_FS_CONFIG, 'a/obj');
+            await root.rmdir(DEFAULT_FS_CONFIG, 'a/b');
+            await assert.rejects(fs.promises.stat(`${ROOT_PATH}/a/b`), { code: 'ENOENT' });
+        });
+
+        mocha.it('rejects paths outside the root', async function() {
+            await assert.rejects(root.stat(DEFAULT_FS_CONFIG, '../x'), { code: 'EXDEV' });
+            await assert.rejects(root.stat(DEFAULT_FS_CONFIG, OUTSIDE_PATH), { code: 'EXDEV' });
+            await assert.rejects(root.mkdir(DEFAULT_FS_CONFIG, 'a/../../x'), { code: 'EXDEV' });
+            // symlinks are contained only by openat2
+            if (root.resolve_beneath) {
+                await assert.rejects(root.readFile(DEFAULT_FS_CONFIG, 'escape/secret'), { code: 'EXDEV' });
+                await assert.rejects(root.unlink(DEFAULT_FS_CONFIG, 'escape/secret'), { code: 'EXDEV' });
+            }
+            assert(fs.existsSync(`${OUTSIDE_PATH}/secret`));
+        });
+
+        mocha.it('closes after the ops in flight and rejects new ops', async function() {
+            const closing_root = await nb_native().fs.open_bucket_root(DEFAULT_FS_CONFIG, ROOT_PATH);
+            await closing_root.mkdirp(DEFAULT_FS_CONFIG, 'c', 0o770);
+            const ops = [];
+            for (let i = 0; i < 100; ++i) {
+                ops.push(closing_root.writeFile(DEFAULT_FS_CONFIG, `c/obj${i}`, Buffer.from('data')));
+                ops.push(closing_root.stat(DEFAULT_FS_CONFIG, 'c'));
+            }
+            const closed = closing_root.close(DEFAULT_FS_CONFIG);
+            // the op completions did not run yet, so the fd is still held open for them
+            assert(closing_root.fd >= 0);
+            await assert.rejects(closing_root.stat(DEFAULT_FS_CONFIG, 'c'), { code: 'EBADF' });
+            // every op that started before the close completes with the root fd still open
+            await Promise.all(ops);
+            await closed;
+            assert.strictEqual(closing_root.fd, -1);
+            assert.strictEqual((await fs.promises.readdir(`${ROOT_PATH}/c`)).length, 100);
+            await assert.rejects(closing_root.readdir(DEFAULT_FS_CONFIG, 'c'), { code: 'EBADF' });
+        });
+    });
+
     // mocha.describe('Errors', function() {
     //     mocha.it('works', async function() {
     //         const { stat } = nb_native().fs;
@@ -373,6 +580,121 @@ mocha.describe('nb_native fs', async function() {
     });
 
 
+    mocha.describe('remove_tree', async function() {
+        const ROOT_PATH = `/tmp/remove_tree${Date.now()}`;
+
+        async function create_tree(dir) {
+            for (let i = 0; i < 5; ++i) {
+                const sub = path.join(dir, `dir${i}`, 'nested');
+                await fs_utils.create_path(sub);
+                for (let j = 0; j < 10; ++j) {
+                    await create_file(path.join(dir, `dir${i}`, `file${j}`));
+                    await create_file(path.join(sub, `file${j}`));
+                }
+            }
+            await fs.promises.symlink('/tmp', path.join(dir, 'dir0', 'link'));
+        }
+
+        mocha.after(async () => fs_utils.folder_delete(ROOT_PATH));
+
+        mocha.it('removes the tree and reports progress', async function() {
+            const { remove_tree, remove_tree_index } = nb_native().fs;
+            await create_tree(ROOT_PATH);
+            const progress = new Float64Array(remove_tree_index.count);
+            const res = await remove_tree(DEFAULT_FS_CONFIG, ROOT_PATH, { concurrency: 4, progress });
+            assert.deepStrictEqual(res, { files: 101, dirs: 11 });
+            assert.strictEqual(progress[remove_tree_index.files], 101);
+            assert.strictEqual(progress[remove_tree_index.dirs], 11);
+            await fs_utils.file_must_not_exist(ROOT_PATH);
+            // the symlink was removed and not followed
+            await fs_utils.file_must_exist('/tmp');
+        });
+
+        mocha.it('fails on a missing path', async function() {
+            const { remove_tree } = nb_native().fs;
+            await assert.rejects(remove_tree(DEFAULT_FS_CONFIG, ROOT_PATH + '_missing'), { code: 'ENOENT' });
+        });
+
+        mocha.it('can be canceled', async function() {
+            const { remove_tree, remove_tree_index } = nb_native().fs;
+            await create_tree(ROOT_PATH);
+            const progress = new Float64Array(remove_tree_index.count);
+            progress[remove_tree_index.cancel] = 1;
+            await assert.rejects(remove_tree(DEFAULT_FS_CONFIG, ROOT_PATH, { progress }), { code: 'ECANCELED' });
+            await fs_utils.file_must_exist(ROOT_PATH);
+        });
+    });
+
+    mocha.describe('lifecycle_scan', async function() {
+        const BUCKET_PATH = `/tmp/lifecycle_scan${Date.now()}/`;
+        const CANDIDATES_PATH = `/tmp/lifecycle_scan_candidates${Date.now()}`;
+
+        mocha.before(async () => {
+            for (const key of ['a/1', 'a/2', 'a/b/3', 'c/4', '5', '.versions/6', '.noobaa-nsfs_tmp/7']) {
+                await fs_utils.create_path(path.dirname(path.join(BUCKET_PATH, key)));
+                await create_file(path.join(BUCKET_PATH, key));
+            }
+        });
+
+        mocha.after(async () => {
+            await fs_utils.folder_delete(BUCKET_PATH);
+            await fs_utils.file_delete(CANDIDATES_PATH + '_0');
+            await fs_utils.file_delete(CANDIDATES_PATH + '_1');
+        });
+
+        mocha.it('writes the candidates of every rule', async function() {
+            const { lifecycle_scan } = nb_native().fs;
+            const res = await lifecycle_scan(DEFAULT_FS_CONFIG, BUCKET_PATH, [
+                { candidates_path: CANDIDATES_PATH + '_0', prefix: 'a/' },
+                { candidates_path: CANDIDATES_PATH + '_1', prefix: '', days: 1 },
+            ], { concurrency: 4, now: Date.now(), exclude_root_prefix: '.noobaa-nsfs' });
+            assert.deepStrictEqual(res.candidates, [3, 0]);
+            assert.strictEqual(res.files, 5);
+            const lines = (await fs.promises.readFile(CANDIDATES_PATH + '_0', 'utf8')).split('\n').filter(Boolean);
+            const paths = lines.map(line => line.slice(line.indexOf(' -- ') + 4)).sort();
+            assert.deepStrictEqual(paths, ['a/1', 'a/2', 'a/b/3'].map(key => BUCKET_PATH + key));
+            assert.strictEqual((await fs.promises.readFile(CANDIDATES_PATH + '_1', 'utf8')), '');
+        });
+    });
+
+    mocha.describe('fsync coalesce', async function() {
+        mocha.it('fsyncs that arrive during a round share the next round', async function() {
+            const { fsync, fsync_coalescer_stats, fsync_coalescer_hold } = nb_native().fs;
+            // exported only when NOOBAA_NATIVE_TEST_HOOKS was set before nb_native was loaded (see coretest)
+            if (!fsync_coalescer_hold) this.skip(); // eslint-disable-line no-invalid-this
+            // the held round and the late callers each take a thread of the uv threadpool (4 by default)
+            const LATE = 3;
+            const wait_requests = async count => {
+                while (fsync_coalescer_stats().requests < count) await P.delay(1);
+            };
+            const before = fsync_coalescer_stats();
+            fsync_coalescer_hold(true);
+            let late;
+            let first;
+            try {
+                first = fsync(DEFAULT_FS_CONFIG, '/tmp', { coalesce: true });
+                await wait_requests(before.requests + 1);
+                late = Array.from({ length: LATE }, () => fsync(DEFAULT_FS_CONFIG, '/tmp', { coalesce: true }));
+                await wait_requests(before.requests + 1 + LATE);
+            } finally {
+                fsync_coalescer_hold(false);
+            }
+            await Promise.all([first, ...late]);
+            const after = fsync_coalescer_stats();
+            assert.strictEqual(after.requests - before.requests, 1 + LATE);
+            assert.strictEqual(after.rounds - before.rounds, 2);
+            assert.ok(after.max_batch > 1);
+            assert.ok(after.max_batch >= LATE);
+            assert.strictEqual(after.inflight, 0);
+        });
+
+        mocha.it('coalesced fsync of a missing path fails', async function() {
+            const { fsync } = nb_native().fs;
+            await assert.rejects(fsync(DEFAULT_FS_CONFIG, `/tmp/fsync_missing${Date.now()}`, { coalesce: true }),
+                { code: 'ENOENT' });
+        });
+    });
+
     mocha.describe('Safe link/unlink', async function() {
         mocha.it('safe link - success', async function() {
             const { safe_link } = nb_native().fs;
@@ -445,6 +767,88 @@ mocha.describe('nb_native fs', async function() {
             }
         });
     });
+
+    mocha.describe('Safe move/exchange', async function() {
+        const tmp_dir = `/tmp/safe_move_tmp${Date.now()}`;
+        mocha.before(async () => fs_utils.create_path(tmp_dir));
+        mocha.after(async () => fs_utils.folder_delete(tmp_dir));
+
+        mocha.it('safe move - success', async function() {
+            const { safe_move } = nb_native().fs;
+            const PATH1 = `/tmp/safe_move${Date.now()}_1`;
+            const PATH2 = `/tmp/safe_move${Date.now()}_2`;
+            await create_file(PATH1);
+            const res1 = await nb_native().fs.stat(DEFAULT_FS_CONFIG, PATH1);
+            await safe_move(DEFAULT_FS_CONFIG, PATH1, PATH2, res1.mtimeNsBigint, res1.ino, tmp_dir);
+            const res2 = await nb_native().fs.stat(DEFAULT_FS_CONFIG, PATH2);
+            assert.deepEqual(res1.ino, res2.ino);
+            assert.deepEqual(res1.mtimeNsBigint, res2.mtimeNsBigint);
+            await fs_utils.file_must_not_exist(PATH1);
+            await fs_utils.file_delete(PATH2);
+        });
+
+        mocha.it('safe move - failure on mismatch keeps the source', async function() {
+            const { safe_move } = nb_native().fs;
+            const PATH1 = `/tmp/safe_move${Date.now()}_1`;
+            const PATH2 = `/tmp/safe_move${Date.now()}_2`;
+            await create_file(PATH1);
+            const res1 = await nb_native().fs.stat(DEFAULT_FS_CONFIG, PATH1);
+            const fake_ino = 12345678;
+            try {
+                await safe_move(DEFAULT_FS_CONFIG, PATH1, PATH2, res1.mtimeNsBigint, fake_ino, tmp_dir);
+                assert.fail('should have failed');
+            } catch (err) {
+                assert.equal(err.message, 'FS::SafeMove ERROR move source doesn\'t match expected inode and mtime');
+            }
+            await fs_utils.file_must_exist(PATH1);
+            await fs_utils.file_must_not_exist(PATH2);
+            await fs_utils.file_delete(PATH1);
+        });
+
+        mocha.it('safe move - target exists', async function() {
+            const { safe_move } = nb_native().fs;
+            const PATH1 = `/tmp/safe_move${Date.now()}_1`;
+            const PATH2 = `/tmp/safe_move${Date.now()}_2`;
+            await create_file(PATH1);
+            await create_file(PATH2);
+            const res1 = await nb_native().fs.stat(DEFAULT_FS_CONFIG, PATH1);
+            const res2 = await nb_native().fs.stat(DEFAULT_FS_CONFIG, PATH2);
+            await assert.rejects(
+                safe_move(DEFAULT_FS_CONFIG, PATH1, PATH2, res1.mtimeNsBigint, res1.ino, tmp_dir),
+                { code: 'EEXIST' });
+            const res3 = await nb_native().fs.stat(DEFAULT_FS_CONFIG, PATH2);
+            assert.equal(res3.ino, res2.ino);
+            await fs_utils.file_delete(PATH1);
+            await fs_utils.file_delete(PATH2);
+        });
+
+        mocha.it('safe exchange - success and mismatch', async function() {
+            const { safe_exchange } = nb_native().fs;
+            const PATH1 = `/tmp/safe_exchange${Date.now()}_1`;
+            const PATH2 = `/tmp/safe_exchange${Date.now()}_2`;
+            await create_file(PATH1);
+            await create_file(PATH2);
+            const res1 = await nb_native().fs.stat(DEFAULT_FS_CONFIG, PATH1);
+            const res2 = await nb_native().fs.stat(DEFAULT_FS_CONFIG, PATH2);
+            try {
+                await safe_exchange(DEFAULT_FS_CONFIG, PATH1, PATH2, res1.mtimeNsBigint, res1.ino, res2.mtimeNsBigint, res2.ino);
+            } catch (err) {
+                // filesystems without RENAME_EXCHANGE
+                if (err.code === 'EINVAL' || err.code === 'ENOSYS') this.skip();
+                throw err;
+            }
+            assert.equal((await nb_native().fs.stat(DEFAULT_FS_CONFIG, PATH1)).ino, res2.ino);
+            assert.equal((await nb_native().fs.stat(DEFAULT_FS_CONFIG, PATH2)).ino, res1.ino);
+            // the paths are now swapped so the same expectations mismatch and swap back
+            await assert.rejects(
+                safe_exchange(DEFAULT_FS_CONFIG, PATH1, PATH2, res1.mtimeNsBigint, res1.ino, res2.mtimeNsBigint, res2.ino),
+                { message: 'FS::SafeExchange ERROR exchanged paths don\'t match expected inode and mtime' });
+            assert.equal((await nb_native().fs.stat(DEFAULT_FS_CONFIG, PATH1)).ino, res2.ino);
+            assert.equal((await nb_native().fs.stat(DEFAULT_FS_CONFIG, PATH2)).ino, res1.ino);
+            await fs_utils.file_delete(PATH1);
+            await fs_utils.file_delete(PATH2);
+        });
+    });
 });
 
 async function create_file(file_path) {
@@ -0,0 +1,165 @@
+/* Copyright (C) 2016 NooBaa */
+'use strict';
+
+const v8 = require('v8');
+const vm = require('vm');
+const net = require('net');
+const mocha = require('mocha');
+const assert = require('assert');
+const crypto = require('crypto');
+const nb_native = require('../../../util/nb_native');
+
+mocha.describe('nb_native Ntcp', function() {
+
+    let server;
+    let port;
+    const connections = [];
+    const accept_waiters = [];
+
+    mocha.before(function() {
+        const Ntcp = nb_native().Ntcp;
+        server = new Ntcp();
+        server.on('connection', conn => {
+            conn.on('error', () => { /* closed connections also emit close */ });
+            connections.push(conn);
+            const waiter = accept_waiters.shift();
+            if (waiter) waiter(conn);
+        });
+        port = server.listen(0, '127.0.0.1');
+    });
+
+    mocha.after(function() {
+        for (const conn of connections) conn.close();
+        server.close();
+    });
+
+    function accept() {
+        return new Promise(resolve => accept_waiters.push(resolve));
+    }
+
+    async function connect() {
+        const Ntcp = nb_native().Ntcp;
+        const client = new Ntcp();
+        client.on('error', () => { /* closed connections also emit close */ });
+        const accepted = accept();
+        await new Promise((resolve, reject) => client.connect(port, '127.0.0.1', err => (err ? reject(err) : resolve())));
+        const conn = await accepted;
+        return { client, conn };
+    }
+
+    function receive(conn, count) {
+        return new Promise(resolve => {
+            const received = [];
+            conn.on('messages', msgs => {
+                received.push(...msgs);
+                if (received.length >= count) resolve(received);
+            });
+        });
+    }
+
+    function wait_close(conn) {
+        return new Promise(resolve => conn.once('close', resolve));
+    }
+
+    mocha.it('receives small and large messages in order', async function() {
+        const { client, conn } = await connect();
+        // sizes around the large message threshold and the receive chunk size
+        const sizes = [0, 1, 100, 4000, 64 * 1024 - 1, 64 * 1024, 100 * 1000, 256 * 1024, 3, 300 * 1000, 7];
+        const sent = sizes.map(size => crypto.randomBytes(size));
+        const received_promise = receive(conn, sent.length);
+        for (const msg of sent) client.write(msg);
+        const received = await received_promise;
+        assert.strictEqual(received.length, sent.length);
+        for (let i = 0; i < sent.length; ++i) {
+            assert(received[i].equals(sent[i]), `message ${i} of size ${sizes[i]} differs`);
+        }
+        client.close();
+        conn.close();
+    });
+
+    mocha.it('sends an array of buffers as one message', async function() {
+        const { client, conn } = await connect();
+        const parts = [crypto.randomBytes(10), crypto.randomBytes(20000), crypto.randomBytes(5)];
+        const received_promise = receive(conn, 1);
+        await new Promise((resolve, reject) => client.write(parts, err => (err ? reject(err) : resolve())));
+        const [msg] = await received_promise;
+        assert(msg.equals(Buffer.concat(parts)));
+        client.close();
+        conn.close();
+    });
+
+    mocha.it('closes the connection on eof', async function() {
+        const { client, conn } = await connect();
+        const closed = wait_close(conn);
+        client.close();
+        await closed;
+        await new Promise(resolve => conn.write(Buffer.from('after close'), err => {
+            assert(err, 'write after close should fail');
+            resolve();
+        }));
+    });
+
+    mocha.it('completes a write in flight of a closed and collected connection', async function() {
+        v8.setFlagsFromString('--expose-gc');
+        const gc = vm.runInNewContext('gc');
+        const write_and_close = async () => {
+            const { client, conn } = await connect();
+            // larger than the socket buffers so that the write is still in flight when closed
+            const written = new Promise(resolve => client.write(crypto.randomBytes(16 * 1024 * 1024), resolve));
+            client.close();
+            conn.close();
+            return { written };
+        };
+        const { written } = await write_and_close();
+        // the client is only referenced by its write now
+        gc();
+        const err = await written;
+        assert(err, 'a write cancelled by close should fail');
+    });
+
+    mocha.it('closes the connection on a bad message header', async function() {
+        const accepted = accept();
+        const socket = net.connect(port, '127.0.0.1');
+        socket.on('error', () => { /* reset by the server */ });
+        const conn = await accepted;
+        const closed = wait_close(conn);
+        // header length above the max message length
+        const hdr = Buffer.alloc(4);
+        hdr.writeUInt32BE((64 * 1024 * 1024) + 1);
+        socket.write(hdr);
+        await closed;
+        socket.destroy();
+    });
+
+    mocha.it('copies small messages once too many receive chunks are pinned', async function() {
+        this.timeout(60000); // eslint-disable-line no-invalid-this
+        const Ntcp = nb_native().Ntcp;
+        const { client, conn } = await connect();
+        const { max_pinned_chunks } = Ntcp.recv_stats();
+        const copied_before = Ntcp.recv_stats().copied_msgs;
+        // retaining one small message from every chunk would pin all of the chunks
+        const msg_size = 1024;
+        const count = ((max_pinned_chunks + 8) * 256 * 1024) / msg_size;
+        const retained = [];
+        let received = 0;
+        const done = new Promise(resolve => {
+            conn.on('messages', msgs => {
+                for (const msg of msgs) {
+                    if (received % 64 === 0) retained.push(msg);
+                    received += 1;
+                }
+                if (received >= count) resolve();
+            });
+        });
+        const msg = crypto.randomBytes(msg_size);
+        for (let i = 0; i < count; ++i) client.write(msg);
+        await done;
+        const stats = Ntcp.recv_stats();
+        assert(stats.pinned_chunks <= max_pinned_chunks + 1, `pinned_chunks ${stats.pinned_chunks}`);
+        assert(stats.copied_msgs > copied_before, `copied_msgs ${stats.copied_msgs}`);
+        for (const m of retained) assert(m.equals(msg));
+        client.close();
+        conn.close();
+    });
+
+});
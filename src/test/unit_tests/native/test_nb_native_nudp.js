@@ -0,0 +1,65 @@
+/* Copyright (C) 2016 NooBaa */
+'use strict';
+
+const mocha = require('mocha');
+const assert = require('assert');
+const crypto = require('crypto');
+const nb_native = require('../../../util/nb_native');
+
+mocha.describe('nb_native Nudp', function() {
+
+    // more udp packets than a send batch (1024), which are flushed in several sendmmsg calls
+    const MSG_COUNT = 3000;
+    const MSG_SIZE = 1000;
+
+    async function send_burst(gso) {
+        const Nudp = nb_native().Nudp;
+        const server = new Nudp({ gso });
+        const client = new Nudp({ gso });
+        for (const nudp of [server, client]) nudp.on('error', () => { /* closed sockets also emit close */ });
+        try {
+            const port = await new Promise((resolve, reject) =>
+                server.bind(0, '127.0.0.1', (err, local_port) => (err ? reject(err) : resolve(local_port))));
+            const received = [];
+            const done = new Promise(resolve => server.on('message', msg => {
+                received.push(msg);
+                if (received.length >= MSG_COUNT) resolve();
+            }));
+            await new Promise((resolve, reject) => client.connect(port, '127.0.0.1', err => (err ? reject(err) : resolve())));
+            const sent = [];
+            for (let i = 0; i < MSG_COUNT; ++i) {
+                const msg = crypto.randomBytes(MSG_SIZE);
+                msg.writeUInt32BE(i, 0);
+                sent.push(msg);
+                client.send(msg, () => { /* delivery is checked by the receiver */ });
+            }
+            await done;
+            assert.strictEqual(received.length, MSG_COUNT);
+            for (let i = 0; i < MSG_COUNT; ++i) {
+                assert(received[i].equals(sent[i]), `message ${i} differs or arrived out of order (got ${received[i].readUInt32BE(0)})`);
+            }
+            return client.stats();
+        } finally {
+            client.close();
+            server.close();
+        }
+    }
+
+    mocha.it('delivers a burst in order without gso', async function() {
+        this.timeout(60000); // eslint-disable-line no-invalid-this
+        const stats = await send_burst(false);
+        assert.strictEqual(stats.udp_gso, false);
+        assert(stats.udp_packets_sent > 1024, `udp_packets_sent ${stats.udp_packets_sent}`);
+        // sendmmsg sends several packets per call
+        assert(stats.udp_send_calls < stats.udp_packets_sent, `udp_send_calls ${stats.udp_send_calls}`);
+    });
+
+    mocha.it('delivers a burst in order with gso', async function() {
+        this.timeout(60000); // eslint-disable-line no-invalid-this
+        // gso is used when the kernel supports UDP_SEGMENT, and falls back to single packets otherwise
+        const stats = await send_burst(true);
+        assert(stats.udp_packets_sent > 1024, `udp_packets_sent ${stats.udp_packets_sent}`);
+        assert(stats.udp_send_calls < stats.udp_packets_sent, `udp_send_calls ${stats.udp_send_calls}`);
+    });
+
+});
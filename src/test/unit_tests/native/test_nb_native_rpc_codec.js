@@ -0,0 +1,149 @@
+/* Copyright (C) 2016 NooBaa */
+'use strict';
+
+const mocha = require('mocha');
+const assert = require('assert');
+const nb_native = require('../../../util/nb_native');
+const RpcMessage = require('../../../rpc/rpc_message');
+const { RpcCodec } = require('../../../rpc/rpc_codec');
+const RpcBaseConnection = require('../../../rpc/rpc_base_conn');
+
+mocha.describe('nb_native RpcCodec', function() {
+
+    const strings = ['bucket', 'chunks', 'frags', 'blocks', 'block_md', 'id', 'size', 'req', 'res', 'op'];
+
+    function round_trip(codec, body) {
+        const expected = JSON.parse(JSON.stringify(body));
+        const decoded = codec.decode(codec.encode(body));
+        assert.deepStrictEqual(decoded, expected);
+        return decoded;
+    }
+
+    mocha.it('decodes like json', function() {
+        const codec = new (nb_native().RpcCodec)(strings);
+        const body = {
+            op: 'req',
+            id: '5f1a2b3c4d5e6f7a8b9c0d1e',
+            upper_id: '5F1A2B3C4D5E6F7A8B9C0D1E',
+            size: 1234567,
+            negative: -42,
+            big: 2 ** 60,
+            float: 3.14159,
+            nan: NaN,
+            inf: -Infinity,
+            yes: true,
+            no: false,
+            nothing: null,
+            skipped: undefined,
+            func: () => 1,
+            date: new Date(1600000000000),
+            unicode: 'שלום 🌍',
+            empty: '',
+            chunks: [{ frags: [{ blocks: [{ block_md: { id: 'x', size: 0 } }] }] }, undefined, () => 1],
+            to_json: { toJSON: () => 'converted' },
+            1: 'numeric key',
+        };
+        round_trip(codec, body);
+        round_trip(codec, []);
+        round_trip(codec, 'req');
+        round_trip(codec, 0);
+    });
+
+    mocha.it('keeps __proto__ as an own property', function() {
+        const codec = new (nb_native().RpcCodec)(strings);
+        const body = JSON.parse('{"__proto__":{"polluted":true}}');
+        const decoded = round_trip(codec, body);
+        assert.strictEqual(Object.getPrototypeOf(decoded), Object.prototype);
+        assert.strictEqual(({}).polluted, undefined);
+    });
+
+    mocha.it('is smaller than json for interned keys and ids', function() {
+        const codec = new (nb_native().RpcCodec)(strings);
+        const blocks = [];
+        for (let i = 0; i < 100; ++i) {
+            blocks.push({ block_md: { id: (0x5f1a2b3c + i).toString(16) + '4d5e6f7a8b9c0d1e', size: 1 << 20 } });
+        }
+        const body = { op: 'res', blocks };
+        const encoded = codec.encode(body);
+        assert(encoded.length < Buffer.byteLength(JSON.stringify(body)) / 2,
+            `encoded ${encoded.length} json ${Buffer.byteLength(JSON.stringify(body))}`);
+        round_trip(codec, body);
+    });
+
+    mocha.it('reserves header bytes', function() {
+        const codec = new (nb_native().RpcCodec)(strings);
+        const buf = codec.encode({ op: 'req' }, 8);
+        assert.deepStrictEqual(buf.subarray(0, 8), Buffer.alloc(8));
+        assert.deepStrictEqual(codec.decode(buf.subarray(8)), { op: 'req' });
+    });
+
+    mocha.it('rejects bad input', function() {
+        const codec = new (nb_native().RpcCodec)(strings);
+        const buf = codec.encode({ bucket: 'some-bucket', chunks: [1, 2, 3] });
+        assert.throws(() => codec.decode(buf.subarray(0, buf.length - 2)), /truncated/);
+        assert.throws(() => codec.decode(Buffer.from([0xff])), /bad tag/);
+        assert.throws(() => codec.encode({ n: BigInt(1) }), /BigInt/);
+        const circular = { a: {} };
+        circular.a.b = circular;
+        assert.throws(() => codec.encode(circular), /max depth/);
+    });
+
+    mocha.it('RpcMessage encodes with the codec', function() {
+        const codec = new RpcCodec(strings, nb_native().RpcCodec);
+        const body = { op: 'req', chunks: [{ id: '5f1a2b3c4d5e6f7a8b9c0d1e', size: 10 }] };
+        const attachment = Buffer.from('attachment');
+
+        // json with codec announcement
+        const json_msg = RpcMessage.decode(new RpcMessage(body, [attachment]).encode(null, codec.id), codec);
+        assert.deepStrictEqual(json_msg.body, body);
+        assert.strictEqual(json_msg.codec_id, codec.id);
+
+        // binary body
+        const msg_buffers = new RpcMessage(body, [attachment]).encode(codec);
+        const msg = RpcMessage.decode(msg_buffers, codec);
+        assert.deepStrictEqual(msg.body, body);
+        assert.strictEqual(msg.codec_id, codec.id);
+        assert.deepStrictEqual(Buffer.concat(msg.buffers), attachment);
+
+        // a peer without the codec
+        assert.throws(() => RpcMessage.decode(new RpcMessage(body).encode(codec)), /RPC CODEC NOT SUPPORTED/);
+    });
+
+    mocha.it('connections announce the codec once and switch after the peer announced', function() {
+        const codec = new RpcCodec(strings, nb_native().RpcCodec);
+        const new_conn = name => {
+            const conn = new RpcBaseConnection(new URL(`tcp://${name}:1234`));
+            conn.codec = codec;
+            return conn;
+        };
+        const a = new_conn('a');
+        const b = new_conn('b');
+        const old_peer = new_conn('old');
+        old_peer.codec = null;
+        const body = { op: 'req', chunks: [{ id: '5f1a2b3c4d5e6f7a8b9c0d1e', size: 10 }] };
+        const is_json_body = buffers => JSON.parse(buffers[1].toString());
+
+        // only the first json body carries the announcement
+        const a1 = a._encode_message(new RpcMessage(body));
+        assert.strictEqual(is_json_body(a1).codec, codec.id);
+        const a2 = a._encode_message(new RpcMessage(body));
+        assert.strictEqual(is_json_body(a2).codec, undefined);
+
+        // an old peer ignores the announcement and never gets binary bodies
+        assert.deepStrictEqual(old_peer._decode_message(a1.slice()).body, body);
+        assert.strictEqual(is_json_body(old_peer._encode_message(new RpcMessage(body))).codec, undefined);
+
+        // b learns the codec from the announcement and answers with binary bodies
+        assert.deepStrictEqual(b._decode_message(a1.slice()).body, body);
+        assert.deepStrictEqual(b._decode_message(a2.slice()).body, body);
+        const b1 = b._encode_message(new RpcMessage(body));
+        assert.strictEqual(b1[0].readUInt8(3), 1);
+        assert.deepStrictEqual(a._decode_message(b1).body, body);
+
+        // a switches once it decoded a message of b with the same codec
+        const a3 = a._encode_message(new RpcMessage(body));
+        assert.strictEqual(a3[0].readUInt8(3), 1);
+        assert.deepStrictEqual(b._decode_message(a3).body, body);
+    });
+
+});
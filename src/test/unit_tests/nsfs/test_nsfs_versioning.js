@@ -101,7 +101,7 @@ mocha.describe('namespace_fs - versioning', function() {
             );
             assert.fail(`safe_move_posix succeeded but should have failed`);
         } catch (err) {
-            assert.equal(err.message, 'FS::SafeLink ERROR link target doesn\'t match expected inode and mtime');
+            assert.equal(err.message, native_fs_utils.posix_move_retry_err);
         }
     });
 
@@ -208,6 +208,13 @@ mocha.describe('signature_utils', function() {
             if (signature !== auth_token.signature) {
                 throw new Error('Signature mismatch');
             }
+            if (!signature_utils.verify_signature_from_auth_token(auth_token, SECRETS[auth_token.access_key])) {
+                throw new Error('Signature verify failed');
+            }
+            if (auth_token.extra &&
+                signature_utils.verify_signature_from_auth_token(auth_token, SECRETS[auth_token.access_key] + 'x')) {
+                throw new Error('Signature verify passed with a wrong secret');
+            }
             res.end(JSON.stringify(auth_token));
 
         } catch (err) {
@@ -17,6 +17,7 @@ process.env.CORETEST = CORETEST;
 process.env.JWT_SECRET = CORETEST;
 const root_secret = crypto.randomBytes(32).toString('base64');
 process.env.ACCOUNTS_CACHE_EXPIRY = '1';
+process.env.NOOBAA_NATIVE_TEST_HOOKS = 'true';
 
 require('../../../util/dotenv').load();
 require('../../../util/panic');
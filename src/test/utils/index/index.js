@@ -53,6 +53,7 @@ require('../../integration_tests/internal/test_map_client');
 //require('./test_map_reader');
 require('../../integration_tests/internal/test_map_deleter');
 require('../../unit_tests/internal/test_chunk_coder');
+require('../../unit_tests/internal/test_map_client_hedged_read');
 require('../../unit_tests/internal/test_chunk_splitter');
 require('../../unit_tests/internal/test_chunk_config_utils');
 require('../../unit_tests/internal/test_core_init');
@@ -65,6 +66,14 @@ require('../../unit_tests/nsfs/test_namespace_fs');
 require('../../unit_tests/api/s3/test_ns_list_objects');
 require('../../unit_tests/nsfs/test_namespace_fs_mpu');
 require('../../unit_tests/native/test_nb_native_fs');
+require('../../unit_tests/native/test_nb_native_block_container');
+require('../../unit_tests/native/test_nb_native_block_scrubber');
+require('../../unit_tests/native/test_nb_native_ntcp');
+require('../../unit_tests/native/test_nb_native_nudp');
+require('../../unit_tests/native/test_nb_native_async_log');
+require('../../unit_tests/native/test_nb_native_rpc_codec');
+require('../../unit_tests/native/test_nb_native_aws_chunked');
+require('../../unit_tests/native/test_nb_native_checksum');
 require('../../unit_tests/api/s3/test_s3select');
 require('../../unit_tests/nsfs/test_nsfs_glacier_backend');
 
@@ -0,0 +1,77 @@
+/* Copyright (C) 2016 NooBaa */
+'use strict';
+
+const crypto = require('crypto');
+const argv = require('minimist')(process.argv);
+const nb_native = require('../util/nb_native');
+
+require('../util/console_wrapper').original_console();
+
+argv.count = Number(argv.count ?? 1000000); // number of items
+argv.size = Number(argv.size ?? 32); // bytes per item (32 = sha256 digest)
+argv.batch = Number(argv.batch ?? 1000); // items per bulk call
+argv.rounds = Number(argv.rounds ?? 3);
+
+/**
+ * Compares converting many small buffers (like digests and keys in metadata paths)
+ * with node Buffer methods one by one, and with the nb_native bulk functions.
+ *
+ * Usage: node src/tools/b64_speed.js [--count 1000000] [--size 32] [--batch 1000] [--rounds 3]
+ */
+function main() {
+    const items = [];
+    for (let i = 0; i < argv.count; ++i) items.push(crypto.randomBytes(argv.size));
+    const b64_items = items.map(b => b.toString('base64'));
+    const hex_items = items.map(b => b.toString('hex'));
+    const batches = [];
+    for (let i = 0; i < items.length; i += argv.batch) {
+        batches.push({
+            items: items.slice(i, i + argv.batch),
+            b64_items: b64_items.slice(i, i + argv.batch),
+            hex_items: hex_items.slice(i, i + argv.batch),
+        });
+    }
+
+    console.log(`b64_speed: count ${argv.count} size ${argv.size} batch ${argv.batch} simd ${nb_native().b64_simd}`);
+
+    const tests = {
+        'node b64 encode': () => {
+            for (const b of items) b.toString('base64');
+        },
+        'native b64 encode bulk': () => {
+            for (const batch of batches) nb_native().b64_encode_bulk(batch.items);
+        },
+        'node b64 decode': () => {
+            for (const s of b64_items) Buffer.from(s, 'base64');
+        },
+        'native b64 decode bulk': () => {
+            for (const batch of batches) nb_native().b64_decode_bulk(batch.b64_items);
+        },
+        'node hex encode': () => {
+            for (const b of items) b.toString('hex');
+        },
+        'native hex encode bulk': () => {
+            for (const batch of batches) nb_native().hex_encode_bulk(batch.items);
+        },
+        'node hex decode': () => {
+            for (const s of hex_items) Buffer.from(s, 'hex');
+        },
+        'native hex decode bulk': () => {
+            for (const batch of batches) nb_native().hex_decode_bulk(batch.hex_items);
+        },
+    };
+
+    for (const [name, func] of Object.entries(tests)) {
+        let best = Infinity;
+        for (let r = 0; r < argv.rounds; ++r) {
+            const start = process.hrtime.bigint();
+            func();
+            const took = Number(process.hrtime.bigint() - start) / 1e6;
+            best = Math.min(best, took);
+        }
+        const mops = argv.count / best / 1000;
+        console.log(`${name.padEnd(24)} ${best.toFixed(1).padStart(9)} ms ${mops.toFixed(2).padStart(8)} M items/sec`);
+    }
+}
+
+main();
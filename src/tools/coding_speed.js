@@ -10,7 +10,9 @@ const assert = require('assert');
 const crypto = require('crypto');
 
 const config = require('../../config');
+const nb_native = require('../util/nb_native');
 const ChunkCoder = require('../util/chunk_coder');
+const ChunkIngest = require('../util/chunk_ingest');
 const RandStream = require('../util/rand_stream');
 const Speedometer = require('../util/speedometer');
 const ChunkEraser = require('../util/chunk_eraser');
@@ -23,6 +25,7 @@ require('../util/console_wrapper').original_console();
 argv.forks = argv.forks || 1;
 argv.size = argv.size || 10240;
 argv.encode = (argv.encode !== false); // default is true, use --no-encode for false
+argv.ingest = Boolean(argv.encode && argv.ingest); // default is false, use --ingest to split+encode with native ChunkIngest
 argv.decode = Boolean(argv.encode && argv.decode); // default is false, use --decode
 argv.erase = Boolean(argv.decode && (argv.erase !== false)); // default is true (if decode), use --no-erase for false
 argv.ec = Boolean(argv.ec); // default is false, use --ec
@@ -31,10 +34,11 @@ argv.sha256 = Boolean(argv.sha256); // default is false
 argv.compare = Boolean(argv.compare); // default is false
 argv.verbose = Boolean(argv.verbose); // default is false
 argv.sse_c = Boolean(argv.sse_c); // default is false
+argv.compress = argv.compress || config.CHUNK_CODER_COMPRESS_TYPE; // e.g --compress igzip-l1 / zlib / none
 delete argv._;
 
 const speedometer = new Speedometer({
-    name: 'Chunk Coder Speed',
+    name: `Chunk Coder Speed (compress ${argv.compress || 'none'}${argv.ingest ? ', ingest' : ''})`,
     argv,
     num_workers: argv.forks,
     workers_func,
@@ -51,7 +55,7 @@ async function workers_func() {
     const chunk_coder_config = _.omitBy({
         digest_type: config.CHUNK_CODER_DIGEST_TYPE,
         frag_digest_type: config.CHUNK_CODER_FRAG_DIGEST_TYPE,
-        compress_type: config.CHUNK_CODER_COMPRESS_TYPE,
+        compress_type: argv.compress,
         cipher_type: config.CHUNK_CODER_CIPHER_TYPE,
         data_frags: 1,
         ...(argv.ec ? {
@@ -79,6 +83,16 @@ async function workers_func() {
         chunk_split_config,
     });
 
+    const ingest = argv.ingest && new ChunkIngest({
+        watermark: 20,
+        concurrency: 20,
+        calc_md5: argv.md5,
+        calc_sha256: argv.sha256,
+        chunk_split_config,
+        chunk_coder_config,
+        cipher_key_b64,
+    });
+
     const coder = new ChunkCoder({
         watermark: 20,
         concurrency: 20,
@@ -101,6 +115,7 @@ async function workers_func() {
     });
 
     let total_size = 0;
+    let total_compress_size = 0;
     let num_parts = 0;
     const reporter = new stream.Writable({
         objectMode: true,
@@ -111,6 +126,7 @@ async function workers_func() {
                 assert(Buffer.concat(chunk.original_data).equals(chunk.data));
             }
             total_size += chunk.size;
+            total_compress_size += chunk.compress_size || chunk.size;
             num_parts += 1;
             speedometer.update(chunk.size);
             callback();
@@ -120,11 +136,15 @@ async function workers_func() {
     /** @type {(stream.Readable | stream.Transform | stream.Writable)[]} */
     const transforms = [
         input,
-        splitter,
     ];
-    if (argv.encode) {
-        transforms.push(coder);
-        transforms.push(new FlattenStream());
+    if (argv.ingest) {
+        transforms.push(ingest);
+    } else {
+        transforms.push(splitter);
+        if (argv.encode) {
+            transforms.push(coder);
+            transforms.push(new FlattenStream());
+        }
     }
     if (argv.erase) transforms.push(eraser);
     if (argv.decode) {
@@ -136,11 +156,19 @@ async function workers_func() {
     try {
         await stream.promises.pipeline(transforms);
         console.log('AVERAGE CHUNK SIZE', (total_size / num_parts).toFixed(0));
-        if (splitter.md5) {
-            console.log('MD5 =', splitter.md5.toString('base64'));
+        if (argv.encode) console.log('COMPRESS RATIO', (total_compress_size / total_size).toFixed(3));
+        const digester = argv.ingest ? ingest : splitter;
+        if (digester.md5) {
+            console.log('MD5 =', digester.md5.toString('base64'));
+        }
+        if (digester.sha256) {
+            console.log('SHA256 =', digester.sha256.toString('base64'));
         }
-        if (splitter.sha256) {
-            console.log('SHA256 =', splitter.sha256.toString('base64'));
+        if (argv.encode) {
+            const pool = nb_native().buf_pool_stats();
+            const hits = pool.thread_hits + pool.depot_hits;
+            console.log('BUF POOL', pool);
+            console.log('BUF POOL HIT RATIO', (hits / (pool.allocs || 1)).toFixed(3));
         }
     } catch (err) {
         if (!err.chunks) throw err;
@@ -126,6 +126,7 @@ async function file_target(chunk_size = CHUNK, parts = PARTS, iov_max = IOV_MAX,
             const file_writer = new FileWriter({
                 target_file,
                 fs_context: DEFAULT_FS_CONFIG,
+                expected_size: part_size,
                 namespace_resource_id: 'MajesticSloth'
             });
             await file_writer.write_entire_stream(source_stream);
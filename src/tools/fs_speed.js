@@ -1,6 +1,8 @@
 /* Copyright (C) 2016 NooBaa */
 'use strict';
 
+/** @typedef {typeof import('../sdk/nb')} nb */
+
 require('../util/panic');
 
 const fs = require('fs');
@@ -35,6 +37,8 @@ Sizes:
 Advanced:
   --device <path>   (default is "/dev/zero") input device to use for dd mode
   --nvec <num>      (default is 1) split blocks to use writev if > 1 (not for dd mode)
+  --root            open files relative to a BucketRoot of --path (nsfs mode only),
+                    to compare with the full path resolution of every open
 
 Example:
     node src/tools/fs_speed --path /mnt/fs/fs_speed_output --time 30 --forks 16
@@ -59,6 +63,7 @@ argv.block_size_units = argv.block_size_units || 'MB';
 argv.fsync = Boolean(argv.fsync ?? true); // true unless otherwise specified
 argv.mode = argv.mode || 'nsfs';
 argv.backend = argv.backend || 'GPFS';
+argv.root = Boolean(argv.root && argv.mode === 'nsfs');
 if (argv.mode === 'dd') {
     argv.device = argv.device || '/dev/zero';
 } else {
@@ -107,6 +112,8 @@ const speedometer = new Speedometer({
 speedometer.start();
 
 let _read_files = [];
+/** @type {nb.NativeBucketRoot} */
+let bucket_root;
 
 async function primary_init() {
     if (!argv.write) {
@@ -135,6 +142,10 @@ async function workers_func(worker_id, worker_info) {
     // nb_native().fs.set_debug_level(5);
     const promises = [];
     fs.mkdirSync(argv.path, { recursive: true });
+    if (argv.root) {
+        bucket_root = await nb_native().fs.open_bucket_root(fs_context, path.resolve(argv.path));
+        console.log('BucketRoot', bucket_root.path, 'resolve_beneath', bucket_root.resolve_beneath);
+    }
     for (let i = 0; i < argv.concur; ++i) promises.push(io_worker(worker_id, i));
     await Promise.all(promises);
 }
@@ -200,7 +211,9 @@ async function io_worker(worker_id, io_worker_id) {
 
 async function work_with_nsfs(file_path, buf) {
     const mode = (argv.write && 'w') || (argv.direct && 'rd') || 'r';
-    const file = await nb_native().fs.open(fs_context, file_path, mode, 0o660);
+    const file = bucket_root ?
+        await bucket_root.open(fs_context, path.relative(bucket_root.path, path.resolve(file_path)), mode, 0o660) :
+        await nb_native().fs.open(fs_context, file_path, mode, 0o660);
     if (!argv.write) {
         const stat = await file.stat(fs_context);
         if (stat.size !== file_size_aligned) {
@@ -5,6 +5,8 @@ const Speedometer = require('../util/speedometer');
 const argv = require('minimist')(process.argv);
 argv.size = argv.size || 1024 * 1024;
 argv.port = Number(argv.port) || 50505;
+// number of writes kept inflight by the client, use small --size with high --concur to measure message rate
+argv.concur = Number(argv.concur) || 1;
 const g_servers = [];
 const g_connections = [];
 main();
@@ -25,7 +27,7 @@ function main() {
 
 function usage() {
     console.log('\nUsage: --server [--port X] [--size X]\n');
-    console.log('\nUsage: --client <host> [--port X] [--size X]\n');
+    console.log('\nUsage: --client <host> [--port X] [--size X] [--concur X]\n');
 }
 
 function run_server(port) {
@@ -47,7 +49,7 @@ function run_server(port) {
 }
 
 function run_client(port, host) {
-    console.log('CLIENT', host + ':' + port, 'size', argv.size);
+    console.log('CLIENT', host + ':' + port, 'size', argv.size, 'concur', argv.concur);
     const conn = new Ntcp();
     conn.connect(port, host, () => run_sender(conn));
     setup_conn(conn);
@@ -66,19 +68,34 @@ function setup_conn(conn) {
 
 function run_sender(conn) {
     console.log('client connected');
-    const send_speedometer = new Speedometer('Send Speed');
-    send();
+    const send_speedometer = new Speedometer({ name: 'Send Speed', argv });
+    for (let i = 0; i < argv.concur; ++i) send();
 
     function send() {
         const buf = Buffer.allocUnsafe(argv.size);
+        const start = process.hrtime.bigint();
         conn.write(buf, () => {
-            send_speedometer.update(buf.length);
+            const took_ms = Number(process.hrtime.bigint() - start) / 1e6;
+            send_speedometer.update(buf.length, took_ms);
             setImmediate(send);
         });
     }
 }
 
 function run_receiver(conn) {
-    const recv_speedometer = new Speedometer('Receive Speed');
-    conn.on('message', data => recv_speedometer.update(data.length));
+    const recv_speedometer = new Speedometer({ name: 'Receive Speed', argv });
+    let num_reads = 0;
+    let num_msgs = 0;
+    conn.on('messages', msgs => {
+        num_reads += 1;
+        for (const data of msgs) {
+            num_msgs += 1;
+            recv_speedometer.update(data.length);
+        }
+    });
+    setInterval(() => {
+        if (num_reads) console.log('Receive messages per read', (num_msgs / num_reads).toFixed(1));
+        num_reads = 0;
+        num_msgs = 0;
+    }, 1000).unref();
 }
@@ -0,0 +1,101 @@
+/* Copyright (C) 2016 NooBaa */
+'use strict';
+
+const stream = require('stream');
+
+const P = require('./promise');
+const semaphore = require('./semaphore');
+const nb_native = require('./nb_native');
+
+/**
+ *
+ * ChunkIngest
+ *
+ * Transform stream that replaces ChunkSplitter + ChunkCoder('enc') for uploads.
+ * The native ChunkIngest splits and encodes on the worker threads and returns
+ * the encoded chunks of every batch of buffers in a single completion,
+ * instead of passing every chunk through JS between the splitter and the coder.
+ *
+ */
+class ChunkIngest extends stream.Transform {
+
+    /**
+     * @param {{
+     *      watermark?: number,
+     *      concurrency?: number,
+     *      chunk_split_config: { avg_chunk: number, delta_chunk: number },
+     *      chunk_coder_config: object,
+     *      calc_md5?: boolean,
+     *      calc_sha256?: boolean,
+     *      cipher_key_b64?: string,
+     * }} args
+     */
+    constructor({ watermark, concurrency, chunk_split_config: { avg_chunk, delta_chunk },
+        chunk_coder_config, calc_md5, calc_sha256, cipher_key_b64 }) {
+        super({
+            objectMode: true,
+            allowHalfOpen: false,
+            highWaterMark: watermark,
+        });
+        this.chunk_coder_config = chunk_coder_config;
+        this.ingest_batch = avg_chunk;
+        this.ingest = new (nb_native().ChunkIngest)({
+            min_chunk: avg_chunk - delta_chunk,
+            max_chunk: avg_chunk + delta_chunk,
+            avg_chunk_bits: delta_chunk >= 1 ? Math.round(Math.log2(delta_chunk)) : 0,
+            calc_md5: Boolean(calc_md5),
+            calc_sha256: Boolean(calc_sha256),
+            chunk_coder_config,
+            cipher_key_b64,
+        });
+        this.pending = [];
+        this.pending_len = 0;
+        this.stream_promise = P.resolve();
+        // same semaphores scheme as ChunkCoder - concurrency counts batches in flight
+        this.stream_sem = new semaphore.Semaphore(concurrency);
+        ChunkIngest.global_sem = ChunkIngest.global_sem || new semaphore.Semaphore(concurrency);
+    }
+
+    _transform(buf, encoding, callback) {
+        this.pending.push(buf);
+        this.pending_len += buf.length;
+        if (this.pending_len < this.ingest_batch) return callback();
+        const buffers = this.pending;
+        this.pending = [];
+        this.pending_len = 0;
+        // the native pushes are split in the order they are called, and since we
+        // call the callback only after submitting, the next transform keeps that order.
+        this.stream_sem.surround(() => ChunkIngest.global_sem.surround(() => {
+                const ingest_promise = this.ingest.push(buffers);
+                this.stream_promise = Promise.all([ingest_promise, this.stream_promise])
+                    .then(([chunks]) => this._push_chunks(chunks));
+                callback();
+                return ingest_promise;
+            }))
+            .catch(err => this.emit('error', err));
+    }
+
+    _flush(callback) {
+        const buffers = this.pending;
+        this.pending = null;
+        Promise.all([this.ingest.finish(buffers), this.stream_promise])
+            .then(([res]) => {
+                this._push_chunks(res.chunks);
+                this.md5 = res.md5;
+                this.sha256 = res.sha256;
+                callback();
+            })
+            .catch(callback);
+    }
+
+    _push_chunks(chunks) {
+        for (const chunk of chunks) {
+            chunk.chunk_coder_config = this.chunk_coder_config;
+            this.push(chunk);
+        }
+    }
+}
+
+ChunkIngest.global_sem = undefined;
+
+module.exports = ChunkIngest;
@@ -2,6 +2,10 @@
 'use strict';
 
 const stream = require('stream');
+const crypto = require('crypto');
+
+const dbg = require('./debug_module')(__filename);
+const config = require('../../config');
 
 const STATE_READ_CHUNK_HEADER = 'STATE_READ_CHUNK_HEADER';
 const STATE_WAIT_NL_HEADER = 'STATE_WAIT_NL_HEADER';
@@ -23,6 +27,11 @@ const MAX_CHUNK_HEADER_SIZE = 1024;
 const MAX_TRAILER_SIZE = 1024;
 const MAX_TRAILERS = 20;
 
+const EMPTY_SHA256 = crypto.createHash('sha256').digest('hex');
+const TRAILER_SIGNATURE = 'x-amz-trailer-signature';
+
+let native_decoder_class;
+
 /**
  *
  * ChunkedContentDecoder
@@ -42,11 +51,27 @@ const MAX_TRAILERS = 20;
  * <trailer>\r\n                   - optional trailer
  * \r\n                            - end of content
  * ---------------------------------------------------
+ *
+ * When signing params are provided (streaming sigv4 upload) every chunk-signature is verified
+ * against the chain that starts with the request seed signature, and so is x-amz-trailer-signature,
+ * which is required when signing.signed_trailer is set (STREAMING-AWS4-HMAC-SHA256-PAYLOAD-TRAILER).
+ * See https://docs.aws.amazon.com/AmazonS3/latest/API/sigv4-streaming.html
+ *
+ * The parsing is done by nb_native AwsChunkedDecoder when available, which also verifies
+ * the checksum trailer (checksum_trailer = x-amz-trailer header), the js state machine
+ * below is kept as fallback and verifies the signatures only.
  */
 class ChunkedContentDecoder extends stream.Transform {
 
+    /**
+     * @param {stream.TransformOptions & {
+     *      signing?: nb.ChunkSigningParams,
+     *      checksum_trailer?: string,
+     * }} [params]
+     */
     constructor(params) {
-        super(params);
+        const { signing, checksum_trailer, ...stream_params } = params || {};
+        super(stream_params);
         this.state = STATE_READ_CHUNK_HEADER;
         this.chunk_header = '';
         this.chunk_size = 0;
@@ -54,6 +79,14 @@ class ChunkedContentDecoder extends stream.Transform {
         this.trailer = '';
         this.trailers = [];
         this.stream_pos = 0;
+        this.signing = signing;
+        this.chunk_signature = '';
+        if (signing) {
+            this.prev_signature = signing.seed_signature;
+            this.chunk_sha256 = crypto.createHash('sha256');
+        }
+        const NativeDecoder = load_native_decoder();
+        this.native = NativeDecoder ? new NativeDecoder({ ...signing, checksum_trailer }) : null;
     }
 
     _transform(buf, encoding, callback) {
@@ -66,6 +99,7 @@ class ChunkedContentDecoder extends stream.Transform {
     }
 
     _flush(callback) {
+        if (this.native) this.load_native_info();
         if (this.state !== STATE_CONTENT_END) return this.error_state(undefined, 0, '');
         return callback();
     }
@@ -90,6 +124,7 @@ class ChunkedContentDecoder extends stream.Transform {
      * @returns {boolean} false on error state
      */
     parse(buf) {
+        if (this.native) return this.parse_native(buf);
         for (let index = 0; index < buf.length; ++index) {
 
             //---------------//
@@ -123,7 +158,10 @@ class ChunkedContentDecoder extends stream.Transform {
 
             } else if (this.state === STATE_SEND_DATA) {
                 index = this.send_data(buf, index);
-                if (!this.chunk_size) this.state = STATE_WAIT_CR_DATA;
+                if (!this.chunk_size) {
+                    if (this.signing && !this.verify_chunk_signature(buf, index + 1)) return false;
+                    this.state = STATE_WAIT_CR_DATA;
+                }
 
             } else if (this.state === STATE_WAIT_CR_DATA) {
                 if (buf[index] !== CR_CODE) return this.error_state(buf, index, `expect CR`);
@@ -167,6 +205,7 @@ class ChunkedContentDecoder extends stream.Transform {
 
             } else if (this.state === STATE_WAIT_NL_END) {
                 if (buf[index] !== NL_CODE) return this.error_state(buf, index, `expect NL`);
+                if (this.signing && !this.verify_trailer_signature(buf, index)) return false;
                 this.state = STATE_CONTENT_END;
 
             } else {
@@ -178,6 +217,40 @@ class ChunkedContentDecoder extends stream.Transform {
         return true;
     }
 
+    /**
+     * Parse the buffer with the native decoder and push the decoded slices.
+     * The js state fields are loaded from the native decoder only when needed
+     * (end of stream, errors, debug info) to keep the per buffer work minimal.
+     * @param {Buffer} buf
+     * @returns {boolean} false on error state
+     */
+    parse_native(buf) {
+        let offsets;
+        try {
+            offsets = this.native.update(buf);
+        } catch (err) {
+            this.load_native_info();
+            return this.error_state(buf, err.index, err.message);
+        }
+        for (let i = 0; i < offsets.length; i += 2) {
+            const start = offsets[i];
+            const end = offsets[i + 1];
+            this.push((start === 0 && end === buf.length) ? buf : buf.subarray(start, end));
+        }
+        this.stream_pos += buf.length;
+        return true;
+    }
+
+    load_native_info() {
+        const info = this.native.info();
+        this.state = info.state;
+        this.chunk_header = info.chunk_header;
+        this.chunk_size = info.chunk_size;
+        this.last_chunk = info.last_chunk;
+        this.trailer = info.trailer;
+        this.trailers = info.trailers;
+    }
+
     /**
      * find index of next CR in this buffer, if exists,
      * and extracts the string from the current index to the CR index
@@ -212,14 +285,21 @@ class ChunkedContentDecoder extends stream.Transform {
         if (isNaN(chunk_size) || chunk_size < 0 || chunk_size > MAX_CHUNK_SIZE) {
             return this.error_state(buf, index, `chunk_size has invalid value ${chunk_size}`);
         }
+        this.chunk_signature = '';
         if (extension) {
-            // TODO check for chunk-signature
-            // const [key, value] = extension.split('=', 2);
-            // const chunk_signature = key === 'chunk-signature' ? value : undefined;
+            for (const ext of this.chunk_header.split(';').slice(1)) {
+                const [key, value] = ext.split('=', 2);
+                if (key === 'chunk-signature') this.chunk_signature = value;
+            }
+        }
+        if (this.signing && !this.chunk_signature) {
+            return this.error_state(buf, index, `missing chunk-signature`);
         }
         this.chunk_size = chunk_size;
         this.last_chunk = chunk_size === 0;
         this.chunk_header = '';
+        // the last chunk is signed with the hash of empty data
+        if (this.last_chunk && this.signing) return this.verify_chunk_signature(buf, index);
         return true;
     }
 
@@ -233,10 +313,71 @@ class ChunkedContentDecoder extends stream.Transform {
         const content = (index === 0 && buf.length <= this.chunk_size) ?
             buf : buf.subarray(index, index + this.chunk_size);
         this.chunk_size -= content.length;
-        if (content.length) this.push(content);
+        if (content.length) {
+            if (this.signing) this.chunk_sha256.update(content);
+            this.push(content);
+        }
         return index + content.length - 1; // -1 because top loop increments
     }
 
+    /**
+     * Verify the chunk-signature of the chunk that ended and reset the chunk hash.
+     * @param {Buffer} buf
+     * @param {number} index
+     * @returns {boolean} false on error state
+     */
+    verify_chunk_signature(buf, index) {
+        const chunk_sha256 = this.chunk_sha256.digest('hex');
+        this.chunk_sha256 = crypto.createHash('sha256');
+        const signature = this.sign('AWS4-HMAC-SHA256-PAYLOAD', EMPTY_SHA256, chunk_sha256);
+        if (!signature_equals(signature, this.chunk_signature)) {
+            return this.error_state(buf, index, `chunk-signature mismatch`);
+        }
+        this.prev_signature = signature;
+        return true;
+    }
+
+    /**
+     * Verify x-amz-trailer-signature which signs the rest of the trailers.
+     * @param {Buffer} buf
+     * @param {number} index
+     * @returns {boolean} false on error state
+     */
+    verify_trailer_signature(buf, index) {
+        if (!this.trailers.length && !this.signing.signed_trailer) return true;
+        let trailer_signature = '';
+        let canonical = '';
+        for (const trailer of this.trailers) {
+            const colon = trailer.indexOf(':');
+            const name = (colon < 0 ? trailer : trailer.slice(0, colon)).toLowerCase();
+            const value = colon < 0 ? '' : trailer.slice(colon + 1);
+            if (name === TRAILER_SIGNATURE) {
+                trailer_signature = value;
+            } else {
+                canonical += `${name}:${value}\n`;
+            }
+        }
+        if (this.signing.signed_trailer && !trailer_signature) {
+            return this.error_state(buf, index, `missing ${TRAILER_SIGNATURE}`);
+        }
+        const trailers_sha256 = crypto.createHash('sha256').update(canonical).digest('hex');
+        if (!signature_equals(this.sign('AWS4-HMAC-SHA256-TRAILER', trailers_sha256), trailer_signature)) {
+            return this.error_state(buf, index, `trailer signature mismatch`);
+        }
+        return true;
+    }
+
+    /**
+     * @param {string} algorithm
+     * @param {...string} hashes
+     * @returns {string}
+     */
+    sign(algorithm, ...hashes) {
+        const { timestamp, scope, signing_key } = this.signing;
+        const string_to_sign = [algorithm, timestamp, scope, this.prev_signature, ...hashes].join('\n');
+        return crypto.createHmac('sha256', signing_key).update(string_to_sign).digest('hex');
+    }
+
     /**
      * Set the state to error and emit stream error.
      * The buf and index are used for better debugging info.
@@ -261,6 +402,7 @@ class ChunkedContentDecoder extends stream.Transform {
     }
 
     get_debug_info() {
+        if (this.native && this.state !== STATE_ERROR) this.load_native_info();
         const debug_info = `ChunkedContentDecoder:` +
             ` pos=${this.stream_pos}` +
             ` state=${this.state}` +
@@ -274,4 +416,33 @@ class ChunkedContentDecoder extends stream.Transform {
 
 }
 
+/**
+ * @param {string} a
+ * @param {string} b
+ * @returns {boolean}
+ */
+function signature_equals(a, b) {
+    const a_buf = Buffer.from(a);
+    const b_buf = Buffer.from(b);
+    return a_buf.length === b_buf.length && crypto.timingSafeEqual(a_buf, b_buf);
+}
+
+/**
+ * @returns {nb.Native['AwsChunkedDecoder']|null}
+ */
+function load_native_decoder() {
+    if (native_decoder_class === undefined) {
+        native_decoder_class = null;
+        if (config.S3_CHUNKED_NATIVE_DECODER) {
+            try {
+                const nb_native = require('./nb_native');
+                native_decoder_class = nb_native().AwsChunkedDecoder || null;
+            } catch (err) {
+                dbg.warn('ChunkedContentDecoder: native decoder not available, using js', err.message);
+            }
+        }
+    }
+    return native_decoder_class;
+}
+
 module.exports = ChunkedContentDecoder;
@@ -71,6 +71,10 @@ if (typeof process !== 'undefined' &&
     console_wrapper = require('./console_wrapper');
 }
 
+// nb_native log_async when config.LOG_ASYNC_ENABLED (node only), which queues the formatted lines
+// to a native writer thread instead of writing them to stderr/syslog on the event loop
+let log_async;
+
 
 const MONTHS = ['Jan', 'Feb', 'Mar', 'Apr', 'May', 'Jun', 'Jul', 'Aug', 'Sep', 'Oct', 'Nov', 'Dec'];
 
@@ -386,6 +390,20 @@ class InternalDebugLogger {
     }
 
     log_internal(msg_info) {
+        if (log_async && config.LOG_ASYNC_ENABLED) {
+            const to_syslog = syslog && config.LOG_TO_SYSLOG_ENABLED;
+            const to_stderr = !this._log_console_silent && config.LOG_TO_STDERR_ENABLED;
+            if (to_syslog || to_stderr) {
+                log_async(
+                    to_stderr ? msg_info.message_console : undefined,
+                    to_syslog ? msg_info.message_syslog : undefined,
+                    this._levels_to_syslog[msg_info.level],
+                    config.DEBUG_FACILITY
+                );
+            }
+            console_wrapper.wrapper_console();
+            return;
+        }
         if (syslog && config.LOG_TO_SYSLOG_ENABLED) {
             // syslog path
             syslog(this._levels_to_syslog[msg_info.level], msg_info.message_syslog, config.DEBUG_FACILITY);
@@ -516,11 +534,17 @@ function log_event(event) {
         host: os.hostname(),
         event: event,
     });
+    const to_stderr = console_wrapper && config.LOG_TO_STDERR_ENABLED;
+    const formatted_event = to_stderr ? int_dbg.message_format("EVENT", [updated_event]) : undefined;
+    if (log_async && config.LOG_ASYNC_ENABLED) {
+        log_async(formatted_event?.message_console, syslog ? updated_event : undefined,
+            config.EVENT_LEVEL, config.EVENT_FACILITY);
+        return;
+    }
     if (syslog) {
         syslog(config.EVENT_LEVEL, updated_event, config.EVENT_FACILITY);
     }
-    if (console_wrapper && config.LOG_TO_STDERR_ENABLED) {
-        const formatted_event = int_dbg.message_format("EVENT", [updated_event]);
+    if (to_stderr) {
         process.stderr.write(formatted_event.message_console + '\n');
     }
 }
@@ -610,6 +634,22 @@ function set_log_config() {
     const dbg_native_conf = debug_config.get_debug_config(process.env.NOOBAA_LOG_LEVEL);
     nb_native().fs.set_debug_level(dbg_native_conf.level);
     nb_native().fs.set_log_config(config.LOG_TO_STDERR_ENABLED, config.LOG_TO_SYSLOG_ENABLED, config.DEBUG_FACILITY);
+    if (config.LOG_ASYNC_ENABLED && console_wrapper && !log_async) init_log_async();
+}
+
+/**
+ * starts the native async logger once, it stays available when LOG_ASYNC_ENABLED is turned off later
+ * and the lines that were queued are flushed on exit.
+ */
+function init_log_async() {
+    try {
+        const native = nb_native();
+        native.log_async_init(config.LOG_ASYNC_QUEUE_SIZE);
+        log_async = native.log_async;
+        process.once('exit', () => native.log_async_flush(config.LOG_ASYNC_EXIT_FLUSH_MS));
+    } catch (err) {
+        console.warn('debug_module: native async log is not available, logging synchronously', err.message);
+    }
 }
 
 config.event_emitter.on("config_updated", set_log_config);
@@ -275,6 +275,10 @@ class NewlineReader {
         this.buf = Buffer.alloc(cfg?.bufsize || 64 * 1024);
         this.start = 0;
         this.end = 0;
+        // newline offsets in this.buf found by the native read_lines scan.
+        // when the file handle does not support it we fallback to searching the buffer.
+        this.line_ends = null;
+        this.line_ends_idx = 0;
         this.overflow_state = false;
         this.next_line_file_offset = cfg?.read_file_offset || 0;
     }
@@ -301,7 +305,7 @@ class NewlineReader {
         while (!this.eof) {
             // extract next line if terminated in current buffer
             if (this.start < this.end) {
-                const term_idx = this.buf.subarray(this.start, this.end).indexOf(NewlineReader.NL_CODE);
+                const term_idx = this._find_newline();
                 if (term_idx >= 0) {
                     if (this.overflow_state) {
                         console.warn('line too long finally terminated:', this.info());
@@ -337,7 +341,7 @@ class NewlineReader {
 
             // read from file
             const avail = this.buf.length - this.end;
-            const read = await this.fh.read(this.fs_context, this.buf, this.end, avail, this.read_file_offset);
+            const read = await this._read(avail);
             if (!read) {
                 this.eof = true;
 
@@ -364,6 +368,41 @@ class NewlineReader {
         return null;
     }
 
+    /**
+     * _find_newline returns the index of the next newline relative to this.start,
+     * or -1 if the data in the buffer is not terminated.
+     * @returns {number}
+     */
+    _find_newline() {
+        if (!this.line_ends) {
+            return this.buf.subarray(this.start, this.end).indexOf(NewlineReader.NL_CODE);
+        }
+        while (this.line_ends_idx < this.line_ends.length) {
+            const pos = this.line_ends[this.line_ends_idx];
+            this.line_ends_idx += 1;
+            if (pos >= this.start && pos < this.end) return pos - this.start;
+        }
+        return -1;
+    }
+
+    /**
+     * _read reads the next bytes from the file into the buffer after this.end.
+     * When the native file supports read_lines we get the newline offsets of
+     * the entire read in a single call, so that consuming the lines of the buffer
+     * does not need to search the buffer again for each line.
+     * @param {number} avail
+     * @returns {Promise<number>}
+     */
+    async _read(avail) {
+        if (typeof this.fh.read_lines !== 'function') {
+            return this.fh.read(this.fs_context, this.buf, this.end, avail, this.read_file_offset);
+        }
+        const { read, lines } = await this.fh.read_lines(this.fs_context, this.buf, this.end, avail, this.read_file_offset);
+        this.line_ends = lines;
+        this.line_ends_idx = 0;
+        return read;
+    }
+
     /**
      * forEach takes a callback function and invokes it
      * with each line as parameter
@@ -406,6 +445,8 @@ class NewlineReader {
         this.start = 0;
         this.end = 0;
         this.overflow_state = false;
+        this.line_ends = null;
+        this.line_ends_idx = 0;
     }
 
     async init() {
@@ -9,7 +9,13 @@ const dbg = require('./debug_module')(__filename);
 
 /**
  * FileWriter is a Writable stream that write data to a filesystem file,
- * with optional calculation of md5 for etag.
+ * with optional calculation of md5 for etag, of S3 flexible checksums,
+ * and of the payload sha256 that is verified against a signed x-amz-content-sha256.
+ *
+ * For large writes it also controls the page cache (see NSFS_WRITE_BEHIND_SIZE) -
+ * the blocks are preallocated when the expected size is known, and the written ranges
+ * are written back while writing and dropped from the cache, instead of piling up
+ * dirty pages that evict hot metadata and stall the final fsync.
  */
 class FileWriter extends stream.Writable {
 
@@ -18,13 +24,17 @@ class FileWriter extends stream.Writable {
      *      target_file: nb.NativeFile,
      *      fs_context: nb.NativeFSContext,
      *      md5_enabled?: boolean,
+     *      checksum_algorithms?: string[],
+     *      payload_sha256?: boolean,
      *      offset?: number,
+     *      expected_size?: number,
      *      stats?: import('../sdk/endpoint_stats_collector').EndpointStatsCollector,
      *      bucket?: string,
      *      namespace_resource_id?: string,
      * }} params
      */
-    constructor({ target_file, fs_context, md5_enabled, offset, stats, bucket, namespace_resource_id }) {
+    constructor({ target_file, fs_context, md5_enabled, checksum_algorithms, payload_sha256, offset, expected_size, stats,
+        bucket, namespace_resource_id }) {
         super({ highWaterMark: config.NSFS_UPLOAD_STREAM_MEM_THRESHOLD });
         this.target_file = target_file;
         this.fs_context = fs_context;
@@ -35,8 +45,28 @@ class FileWriter extends stream.Writable {
         this.bucket = bucket;
         this.namespace_resource_id = namespace_resource_id;
         this.MD5Async = md5_enabled ? new (nb_native().crypto.MD5Async)() : undefined;
+        // the payload sha256 is computed in the same pass as the requested checksums
+        this.checksum_algorithms = checksum_algorithms?.map(algorithm => algorithm.toUpperCase());
+        this.payload_sha256 = Boolean(payload_sha256);
+        const algorithms = this.payload_sha256 ?
+            [...new Set([...(this.checksum_algorithms || []), 'SHA256'])] :
+            this.checksum_algorithms;
+        this.ChecksumAsync = algorithms?.length ?
+            new (nb_native().crypto.ChecksumAsync)(algorithms) : undefined;
         const platform_iov_max = nb_native().fs.PLATFORM_IOV_MAX;
         this.iov_max = platform_iov_max ? Math.min(platform_iov_max, config.NSFS_DEFAULT_IOV_MAX) : config.NSFS_DEFAULT_IOV_MAX;
+        // without an offset we write the whole file from its start
+        this.start_offset = offset >= 0 ? offset : 0;
+        this.expected_size = expected_size;
+        this.preallocate = config.NSFS_WRITE_PREALLOCATE_MIN_SIZE > 0 &&
+            expected_size >= config.NSFS_WRITE_PREALLOCATE_MIN_SIZE;
+        this.preallocated = false;
+        this.write_behind_size = config.NSFS_WRITE_BEHIND_SIZE;
+        // the written range from writeback_pos is not yet submitted for writeback,
+        // and writeback_prev is the last submitted range that we did not wait for yet
+        this.writeback_pos = this.start_offset;
+        /** @type {{ pos: number, len: number }} */
+        this.writeback_prev = undefined;
     }
 
     /**
@@ -51,26 +81,43 @@ class FileWriter extends stream.Writable {
 
     /**
      * Ingests an array of buffers and writes them to the target file,
-     * while handling MD5 calculation and stats update.
+     * while handling MD5 and checksums calculation and stats update.
      * @param {Buffer[]} buffers 
      * @param {number} size 
      */
     async write_buffers(buffers, size) {
         await Promise.all([
             this.MD5Async && this._update_md5(buffers, size),
+            this.ChecksumAsync && this.ChecksumAsync.update(buffers),
             this._write_all_buffers(buffers, size),
         ]);
         this._update_stats(size);
     }
 
     /**
-     * Finalizes the MD5 calculation and sets the digest.
+     * Finalizes the MD5 and checksums calculation and sets the digest and checksums.
+     * checksums are base64 encoded by algorithm name, e.g { CRC32C: 'yZRlqg==' }
+     * and payload_sha256_b64 is set when payload_sha256 was requested.
      */
     async finalize() {
+        if (this.write_behind_size > 0) await this._write_behind(true);
+        await this._trim_preallocated();
         if (this.MD5Async) {
             const digest = await this.MD5Async.digest();
             this.digest = digest.toString('hex');
         }
+        if (this.ChecksumAsync) {
+            const checksums = await this.ChecksumAsync.digest();
+            if (this.payload_sha256) this.payload_sha256_b64 = checksums.SHA256.toString('base64');
+            if (this.checksum_algorithms?.length) {
+                /** @type {Record<string, string>} */
+                this.checksums = {};
+                for (const [algorithm, value] of Object.entries(checksums)) {
+                    if (!this.checksum_algorithms.includes(algorithm)) continue;
+                    this.checksums[algorithm] = value.toString('base64');
+                }
+            }
+        }
     }
 
     ///////////////
@@ -131,9 +178,66 @@ class FileWriter extends stream.Writable {
      */
     async _write_to_file(buffers, size) {
         dbg.log1(`FileWriter._write_to_file: buffers ${buffers.length} size ${size} offset ${this.offset}`);
+        if (this.preallocate) await this._preallocate();
         await this.target_file.writev(this.fs_context, buffers, this.offset);
         if (this.offset >= 0) this.offset += size; // when offset<0 we just append
         this.total_bytes += size;
+        if (this.write_behind_size > 0) await this._write_behind(false);
+    }
+
+    /**
+     * Allocates the blocks of the expected size before the first write,
+     * which fails early when there is no space for the whole object.
+     * Other failures (e.g. a filesystem without fallocate) only skip it.
+     */
+    async _preallocate() {
+        this.preallocate = false;
+        try {
+            await this.target_file.fallocate(this.fs_context, this.start_offset, this.expected_size);
+            this.preallocated = true;
+        } catch (err) {
+            if (err.code === 'ENOSPC') throw err;
+            dbg.warn('FileWriter._preallocate: skipped', this.expected_size, err.code || err.message);
+        }
+    }
+
+    /**
+     * Preallocated blocks beyond the end of the file are kept when it is closed,
+     * so if we wrote less than expected we truncate the file to release them.
+     * This is done only when we own the whole file and not a range of it.
+     */
+    async _trim_preallocated() {
+        if (!this.preallocated || this.offset >= 0 || this.total_bytes >= this.expected_size) return;
+        this.preallocated = false;
+        await this.target_file.truncate(this.fs_context, this.total_bytes);
+    }
+
+    /**
+     * Starts the writeback of the written range once it reaches NSFS_WRITE_BEHIND_SIZE,
+     * and then waits for the previous range, which had the time of a whole range to complete,
+     * so the upload keeps at most about two ranges of dirty pages.
+     * Failures (e.g. a filesystem without sync_file_range) only stop the write behind.
+     * @param {boolean} final submit the remaining tail, and leave the wait to the final fsync
+     */
+    async _write_behind(final) {
+        const end = this.start_offset + this.total_bytes;
+        const len = end - this.writeback_pos;
+        if (len <= 0 || (!final && len < this.write_behind_size)) return;
+        try {
+            const prev = this.writeback_prev;
+            await this.target_file.sync_range(this.fs_context, this.writeback_pos, len, 'write');
+            this.writeback_prev = { pos: this.writeback_pos, len };
+            this.writeback_pos = end;
+            if (prev && !final) {
+                await this.target_file.sync_range(this.fs_context, prev.pos, prev.len, 'wait');
+                if (config.NSFS_WRITE_BEHIND_DROP_CACHE) {
+                    await this.target_file.fadvise(this.fs_context, prev.pos, prev.len, 'dontneed');
+                }
+            }
+        } catch (err) {
+            dbg.warn('FileWriter._write_behind: stopped', err.code || err.message);
+            this.write_behind_size = 0;
+        }
     }
 
     /////////////////////////////
@@ -1232,5 +1232,7 @@ exports.CONTENT_TYPE_APP_OCTET_STREAM = CONTENT_TYPE_APP_OCTET_STREAM;
 exports.CONTENT_TYPE_APP_JSON = CONTENT_TYPE_APP_JSON;
 exports.CONTENT_TYPE_APP_XML = CONTENT_TYPE_APP_XML;
 exports.CONTENT_TYPE_APP_FORM_URLENCODED = CONTENT_TYPE_APP_FORM_URLENCODED;
+exports.STREAMING_PAYLOAD = STREAMING_PAYLOAD;
+exports.STREAMING_AWS4_HMAC_SHA256_PAYLOAD_TRAILER = STREAMING_AWS4_HMAC_SHA256_PAYLOAD_TRAILER;
 exports.set_response_headers_from_request = set_response_headers_from_request;
 exports.authorize_bearer = authorize_bearer;
@@ -17,6 +17,7 @@ const gpfs_link_unlink_retry_err = 'EEXIST';
 const gpfs_unlink_retry_catch = 'GPFS_UNLINK_RETRY';
 const posix_link_retry_err = 'FS::SafeLink ERROR link target doesn\'t match expected inode and mtime';
 const posix_unlink_retry_err = 'FS::SafeUnlink ERROR unlink target doesn\'t match expected inode and mtime';
+const posix_move_retry_err = 'FS::SafeMove ERROR move source doesn\'t match expected inode and mtime';
 const VALID_BUCKET_NAME_REGEXP = /^(([a-z0-9]|[a-z0-9][a-z0-9-]*[a-z0-9])\.)*([a-z0-9]|[a-z0-9][a-z0-9-]*[a-z0-9])$/;
 
 /** @typedef {import('../util/buffer_utils').MultiSizeBuffersPool} MultiSizeBuffersPool */
@@ -35,23 +36,25 @@ function get_umasked_mode(mode) {
     return mode & ~config.NSFS_UMASK;
 }
 
-async function _make_path_dirs(file_path, fs_context) {
+async function _make_path_dirs(file_path, fs_context, use_cache = false) {
     const last_dir_pos = file_path.lastIndexOf('/');
-    if (last_dir_pos > 0) return _create_path(file_path.slice(0, last_dir_pos), fs_context);
+    if (last_dir_pos > 0) return _create_path(file_path.slice(0, last_dir_pos), fs_context, config.BASE_MODE_DIR, use_cache);
 }
 
-async function _create_path(dir, fs_context, dir_permissions = config.BASE_MODE_DIR) {
-    let dir_path = path.isAbsolute(dir) ? path.sep : '';
-    for (const item of dir.split(path.sep)) {
-        dir_path = path.join(dir_path, item);
-        try {
-            await nb_native().fs.mkdir(fs_context, dir_path, get_umasked_mode(dir_permissions));
-        } catch (err) {
-            const ERR_CODES = ['EISDIR', 'EEXIST'];
-            if (!ERR_CODES.includes(err.code)) throw err;
-        }
-    }
-    if (config.NSFS_TRIGGER_FSYNC) await nb_native().fs.fsync(fs_context, dir_path);
+/**
+ * creates dir and its missing parents in a single native call (see Mkdirp in fs_napi.cpp).
+ * the native cache of verified dirs does not notice dirs removed by other processes,
+ * so use_cache is only for callers that retry with use_cache=false on ENOENT under dir.
+ * @param {string} dir
+ * @param {nb.NativeFSContext} fs_context
+ * @param {number} [dir_permissions]
+ * @param {boolean} [use_cache]
+ */
+async function _create_path(dir, fs_context, dir_permissions = config.BASE_MODE_DIR, use_cache = false) {
+    await nb_native().fs.mkdirp(fs_context, path.normalize(dir), get_umasked_mode(dir_permissions), {
+        fsync: config.NSFS_TRIGGER_FSYNC,
+        use_cache,
+    });
 }
 
 async function _generate_unique_path(fs_context, tmp_dir_path) {
@@ -85,7 +88,8 @@ async function open_file(
         try {
             if (should_create_path_dirs) {
                 dbg.log1(`native_fs_utils: open_file mode=${open_mode} creating dirs`, open_path, bucket_path);
-                await _make_path_dirs(open_path, fs_context);
+                // retries skip the mkdirp cache in case the dirs were removed by another process
+                await _make_path_dirs(open_path, fs_context, retries === config.NSFS_MKDIR_PATH_RETRIES && config.NSFS_MKDIRP_CACHE_ENABLED);
             }
             dbg.log1(`native_fs_utils: open_file mode=${open_mode}`, open_path);
             // for 'wt' open the tmpfile with the parent dir path
@@ -260,12 +264,13 @@ async function safe_link(fs_context, src_path, dst_path, src_ver_info, gpfs_opti
 }
 
 // this function handles best effort of files move in posix file systems
-// 1. safe_link
-// 2. safe_unlink
+// moves src_path to dst_path (which must not exist) while verifing it has the expected ino and mtimeNsBigint values.
+// uses a single rename(RENAME_NOREPLACE) when the filesystem supports it,
+// otherwise falls back natively to safe_link + safe_unlink (using tmp_dir_path for the unlink).
 async function safe_move_posix(fs_context, src_path, dst_path, src_ver_info, tmp_dir_path) {
     dbg.log1('Namespace_fs.safe_move_posix', src_path, dst_path, src_ver_info);
-    await safe_link_posix(fs_context, src_path, dst_path, src_ver_info);
-    await safe_unlink_posix(fs_context, src_path, src_ver_info, tmp_dir_path);
+    const { mtimeNsBigint, ino } = src_ver_info;
+    await nb_native().fs.safe_move(fs_context, src_path, dst_path, mtimeNsBigint, ino, tmp_dir_path);
 }
 
 // safe_link_posix links src_path to dst_path while verifing dst_path has the expected ino and mtimeNsBigint values
@@ -343,7 +348,7 @@ async function safe_unlink_gpfs(fs_context, to_delete_path, to_delete_file, dir_
 function should_retry_link_unlink(err) {
     const should_retry_general = ['ENOENT', 'EEXIST', 'VERSION_MOVED', 'MISMATCH_VERSION'].includes(err.code);
     const should_retry_gpfs = [gpfs_link_unlink_retry_err, gpfs_unlink_retry_catch].includes(err.code);
-    const should_retry_posix = [posix_link_retry_err, posix_unlink_retry_err].includes(err.message);
+    const should_retry_posix = [posix_link_retry_err, posix_unlink_retry_err, posix_move_retry_err].includes(err.message);
     return should_retry_general || should_retry_gpfs || should_retry_posix;
 }
 
@@ -387,6 +392,120 @@ async function stat_if_exists(fs_context, entry_path, use_lstat, should_ignore_e
     }
 }
 
+// the output arrays of statx are reused between calls, each one by a single call at a time
+const STATX_ARRAYS_MAX = 64;
+/** @type {Float64Array[]} */
+const statx_arrays = [];
+
+/**
+ * statx stats a path with a single statx syscall, without opening it and without reading xattrs
+ * (unless options.read_xattr), which is much lighter than nb_native().fs.stat() for callers that
+ * need only the basic fields - but it is also not an access check for reading the file.
+ * options.mask can limit the fields to fetch (see nb_native().fs.statx_mask),
+ * and only the fetched fields are converted to the result object.
+ * options.dont_sync allows NFS/GPFS to return cached attributes.
+ * @param {nb.NativeFSContext} fs_context
+ * @param {string} file_path
+ * @param {Parameters<nb.NativeFS['statx']>[3]} [options]
+ * @returns {Promise<nb.NativeFSStatx>}
+ */
+async function statx(fs_context, file_path, options) {
+    return with_statx(fs_context, file_path, options, (out, ix, xattr) => {
+        const res = statx_res(out, options?.mask);
+        if (xattr) res.xattr = xattr;
+        return res;
+    });
+}
+
+/**
+ * statx_ignore_enoent is statx that returns undefined if the path does not exist
+ * @param {nb.NativeFSContext} fs_context
+ * @param {string} file_path
+ * @param {Parameters<nb.NativeFS['statx']>[3]} [options]
+ * @returns {Promise<nb.NativeFSStatx | undefined>}
+ */
+async function statx_ignore_enoent(fs_context, file_path, options) {
+    try {
+        return await statx(fs_context, file_path, options);
+    } catch (err) {
+        if (err.code !== 'ENOENT') throw err;
+    }
+}
+
+/**
+ * with_statx runs statx into a reused output array and returns func(out, statx_index, xattr),
+ * so that hot callers can read the few fields they need from the array without any conversion.
+ * The array is reused by the next calls, so func must not keep it.
+ * @template T
+ * @param {nb.NativeFSContext} fs_context
+ * @param {string} file_path
+ * @param {Parameters<nb.NativeFS['statx']>[3]} options
+ * @param {(out: Float64Array, ix: nb.NativeFS['statx_index'], xattr?: nb.NativeFSXattr) => T} func
+ * @returns {Promise<T>}
+ */
+async function with_statx(fs_context, file_path, options, func) {
+    const native_fs = nb_native().fs;
+    const out = statx_arrays.pop() || new Float64Array(native_fs.statx_index.count);
+    try {
+        const xattr = await native_fs.statx(fs_context, file_path, out, options);
+        return func(out, native_fs.statx_index, xattr);
+    } finally {
+        if (statx_arrays.length < STATX_ARRAYS_MAX) statx_arrays.push(out);
+    }
+}
+
+/**
+ * @param {Float64Array} out
+ * @param {number} [requested_mask] the mask passed to statx, the kernel can return more fields
+ * @returns {nb.NativeFSStatx}
+ */
+function statx_res(out, requested_mask) {
+    const native_fs = nb_native().fs;
+    const ix = native_fs.statx_index;
+    const bits = native_fs.statx_mask;
+    /* eslint-disable no-bitwise */
+    const mask = out[ix.mask] & (requested_mask ?? bits.basic);
+    /** @type {nb.NativeFSStatx} */
+    const res = { mask, dev: out[ix.dev] };
+    if (mask & (bits.type | bits.mode)) res.mode = out[ix.mode];
+    if (mask & bits.nlink) res.nlink = out[ix.nlink];
+    if (mask & bits.uid) res.uid = out[ix.uid];
+    if (mask & bits.gid) res.gid = out[ix.gid];
+    if (mask & bits.ino) res.ino = out[ix.ino];
+    if (mask & bits.size) res.size = out[ix.size];
+    if (mask & bits.blocks) res.blocks = out[ix.blocks];
+    // the NsBigint times are rounded through a double exactly like fs.stat() does, since these are
+    // compared with its results (e.g. in version ids), while btime is new so it keeps the full nanoseconds
+    if (mask & bits.atime) {
+        const sec = out[ix.atime_sec];
+        const nsec = out[ix.atime_nsec];
+        res.atimeMs = (1e3 * sec) + (1e-6 * nsec);
+        res.atimeNsBigint = BigInt(Math.round((1e9 * sec) + nsec));
+    }
+    if (mask & bits.mtime) {
+        const sec = out[ix.mtime_sec];
+        const nsec = out[ix.mtime_nsec];
+        res.mtimeMs = (1e3 * sec) + (1e-6 * nsec);
+        res.mtime = new Date(Math.round(res.mtimeMs));
+        res.mtimeNsBigint = BigInt(Math.round((1e9 * sec) + nsec));
+    }
+    if (mask & bits.ctime) {
+        const sec = out[ix.ctime_sec];
+        const nsec = out[ix.ctime_nsec];
+        res.ctimeMs = (1e3 * sec) + (1e-6 * nsec);
+        res.ctime = new Date(Math.round(res.ctimeMs));
+        res.ctimeNsBigint = BigInt(Math.round((1e9 * sec) + nsec));
+    }
+    if (mask & bits.btime) {
+        const sec = out[ix.btime_sec];
+        const nsec = out[ix.btime_nsec];
+        res.birthtimeMs = (1e3 * sec) + (1e-6 * nsec);
+        res.birthtimeNsBigint = (BigInt(sec) * 1000000000n) + BigInt(nsec);
+    }
+    /* eslint-enable no-bitwise */
+    return res;
+}
+
 ////////////////////////
 /// NON CONTAINERIZED //
 ////////////////////////
@@ -759,31 +878,17 @@ async function is_dir_accessible(fs_context, dir_path) {
 
 /**
  * delete bucket specific temp folder from bucket storage path, config.NSFS_TEMP_DIR_NAME_<bucket_id>
+ * the tree is removed by the native remove_tree with config.NSFS_REMOVE_TREE_CONCURRENCY threads
  * @param {string} dir 
  * @param {nb.NativeFSContext} fs_context
  * @param {boolean} [is_temp]
  * @param {boolean} [silent_if_missing]
  */
 async function folder_delete(dir, fs_context, is_temp, silent_if_missing) {
-    const exists = await is_path_exists(fs_context, dir);
-    if (!exists && is_temp) {
-        return;
-    }
-    const entries = await nb_native().fs.readdir(fs_context, dir);
-    const results = await Promise.all(entries.map(entry => {
-        const fullPath = path.join(dir, entry.name);
-        const task = isDirectory(entry) ? folder_delete(fullPath, fs_context) :
-            nb_native().fs.unlink(fs_context, fullPath);
-        return task.catch(error => ({ error }));
-    }));
-    results.forEach(result => {
-        // Ignore missing files/directories; bail on other errors
-        if (result && result.error && result.error.code !== 'ENOENT') throw result.error;
-    });
     try {
-        await nb_native().fs.rmdir(fs_context, dir);
+        await nb_native().fs.remove_tree(fs_context, dir, { concurrency: config.NSFS_REMOVE_TREE_CONCURRENCY });
     } catch (err) {
-        if (err.code === 'ENOENT' && silent_if_missing) {
+        if (err.code === 'ENOENT' && (is_temp || silent_if_missing)) {
             dbg.warn(`native_fs_utils.folder_delete already deleted, skipping`);
             return;
         }
@@ -996,6 +1101,9 @@ exports.get_supplemental_groups_by_user = get_supplemental_groups_by_user;
 exports.get_config_files_tmpdir = get_config_files_tmpdir;
 exports.stat_ignore_enoent = stat_ignore_enoent;
 exports.stat_if_exists = stat_if_exists;
+exports.statx = statx;
+exports.statx_ignore_enoent = statx_ignore_enoent;
+exports.with_statx = with_statx;
 exports.open_with_lock = open_with_lock;
 
 exports._is_gpfs = _is_gpfs;
@@ -1010,6 +1118,7 @@ exports.safe_link_gpfs = safe_link_gpfs;
 exports.safe_unlink_gpfs = safe_unlink_gpfs;
 exports.should_retry_link_unlink = should_retry_link_unlink;
 exports.posix_unlink_retry_err = posix_unlink_retry_err;
+exports.posix_move_retry_err = posix_move_retry_err;
 exports.gpfs_unlink_retry_catch = gpfs_unlink_retry_catch;
 
 exports.create_config_file = create_config_file;
@@ -7,6 +7,7 @@ const dbg = require('../util/debug_module')(__filename);
 const url = require('url');
 const path = require('path');
 const crypto = require('crypto');
+const config = require('../../config');
 const S3Error = require('../endpoint/s3/s3_errors').S3Error;
 const http_utils = require('./http_utils');
 const time_utils = require('./time_utils');
@@ -96,6 +97,9 @@ function _authenticate_query_v4(req) {
 
 const EMPTY_SHA256 = crypto.createHash('sha256').digest('hex');
 
+/** @type {WeakMap<object, string>} */
+const secret_by_auth_token = new WeakMap();
+
 function _string_to_sign_v4(req, signed_headers, xamzdate, region, service) {
     const aws_request = _aws_request(req, region, service);
     const v4 = new AWS.Signers.V4(aws_request, service, 'signatureCache');
@@ -329,6 +333,13 @@ function get_signature_from_auth_token(auth_token, secret_key) {
         return s3.sign(secret_key, auth_token.string_to_sign);
     }
 
+    const native_sigv4 = load_native_sigv4();
+    if (native_sigv4) {
+        const { xamzdate, region, service } = auth_token.extra;
+        return native_sigv4.signature(auth_token.access_key, secret_key, xamzdate, region, service,
+            auth_token.string_to_sign);
+    }
+
     const aws_request = {
         region: auth_token.extra.region,
     };
@@ -344,6 +355,45 @@ function get_signature_from_auth_token(auth_token, secret_key) {
     return v4.signature(aws_credentials, auth_token.extra.xamzdate);
 }
 
+/**
+ * Checks the signature of the auth token with the secret, in constant time.
+ * @param {object} auth_token
+ * @param {string} secret_key
+ * @returns {boolean}
+ */
+function verify_signature_from_auth_token(auth_token, secret_key) {
+    const native_sigv4 = auth_token.extra && typeof auth_token.signature === 'string' && load_native_sigv4();
+    if (native_sigv4) {
+        const { xamzdate, region, service } = auth_token.extra;
+        return native_sigv4.verify(auth_token.access_key, secret_key, xamzdate, region, service,
+            auth_token.string_to_sign, auth_token.signature);
+    }
+    const signature = get_signature_from_auth_token(auth_token, secret_key);
+    if (typeof auth_token.signature !== 'string' || auth_token.signature.length !== signature.length) return false;
+    return crypto.timingSafeEqual(Buffer.from(auth_token.signature), Buffer.from(signature));
+}
+
+/** @type {nb.NativeSigV4|null|undefined} */
+let native_sigv4_module;
+
+/**
+ * @returns {nb.NativeSigV4|null}
+ */
+function load_native_sigv4() {
+    if (native_sigv4_module === undefined) {
+        native_sigv4_module = null;
+        if (config.S3_SIGV4_NATIVE) {
+            try {
+                const nb_native = require('./nb_native');
+                native_sigv4_module = nb_native().sigv4 || null;
+            } catch (err) {
+                dbg.warn('signature_utils: native sigv4 not available, using aws-sdk', err.message);
+            }
+        }
+    }
+    return native_sigv4_module;
+}
+
 function authorize_client_request(req) {
     req.port = req.port || 80;
     req.host = req.host || 'localhost';
@@ -418,11 +468,49 @@ function authorize_request_account_by_token(token, requesting_account) {
     }
 
     const signature_secret = token.temp_secret_key || access_key_obj.secret_key.unwrap();
-    const signature = get_signature_from_auth_token(token, signature_secret);
-    if (token.signature !== signature) {
+    if (!verify_signature_from_auth_token(token, signature_secret)) {
         dbg.error('authorize_request_account_by_token: signature mismatch for access_key_id', access_key_id_to_find);
         throw new RpcError('SIGNATURE_DOES_NOT_MATCH', `Signature that was calculated did not match`);
     }
+    // kept aside (and not on the token which is sent over rpc) for verifying streaming chunk signatures
+    if (token.extra) secret_by_auth_token.set(token, signature_secret);
+}
+
+/**
+ * Returns the params needed to verify the chunk signatures of a streaming sigv4 payload
+ * (x-amz-content-sha256: STREAMING-AWS4-HMAC-SHA256-PAYLOAD[-TRAILER]).
+ * See https://docs.aws.amazon.com/AmazonS3/latest/API/sigv4-streaming.html
+ * Returns undefined if the payload is not signed, and throws if the request was not authorized
+ * in this process by authorize_request_account_by_token, since the chunks could not be verified.
+ * @param {nb.S3Request} req
+ * @param {object} auth_token
+ * @returns {nb.ChunkSigningParams|undefined}
+ */
+function get_chunk_signing_params(req, auth_token) {
+    if (req.content_sha256_sig !== http_utils.STREAMING_PAYLOAD &&
+        req.content_sha256_sig !== http_utils.STREAMING_AWS4_HMAC_SHA256_PAYLOAD_TRAILER) return;
+    const secret = auth_token && secret_by_auth_token.get(auth_token);
+    if (!secret) {
+        dbg.error('get_chunk_signing_params: no secret to verify the chunk signatures', req.content_sha256_sig);
+        throw new RpcError('SIGNATURE_DOES_NOT_MATCH', `Cannot verify the chunk signatures of a streaming payload`);
+    }
+    const { xamzdate, region, service } = auth_token.extra;
+    const date = xamzdate.slice(0, 8);
+    const native_sigv4 = load_native_sigv4();
+    let signing_key;
+    if (native_sigv4) {
+        signing_key = native_sigv4.signing_key(auth_token.access_key, secret, date, region, service);
+    } else {
+        const hmac = (key, data) => crypto.createHmac('sha256', key).update(data).digest();
+        signing_key = hmac(hmac(hmac(hmac('AWS4' + secret, date), region), service), 'aws4_request');
+    }
+    return {
+        signing_key,
+        timestamp: xamzdate,
+        scope: `${date}/${region}/${service}/aws4_request`,
+        seed_signature: auth_token.signature,
+        signed_trailer: req.content_sha256_sig === http_utils.STREAMING_AWS4_HMAC_SHA256_PAYLOAD_TRAILER,
+    };
 }
 
 /**
@@ -437,6 +525,8 @@ function _throw_error_authorize_request_account_by_token(component) {
 exports.make_auth_token_from_request = make_auth_token_from_request;
 exports.check_request_expiry = check_request_expiry;
 exports.get_signature_from_auth_token = get_signature_from_auth_token;
+exports.verify_signature_from_auth_token = verify_signature_from_auth_token;
 exports.authorize_client_request = authorize_client_request;
 exports.authenticate_request_by_service = authenticate_request_by_service;
 exports.authorize_request_account_by_token = authorize_request_account_by_token;
+exports.get_chunk_signing_params = get_chunk_signing_params;